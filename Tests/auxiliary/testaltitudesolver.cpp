@@ -0,0 +1,110 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "testaltitudesolver.h"
+
+#include "altitudesolver.h"
+#include "geolocation.h"
+#include "skypoint.h"
+
+namespace
+{
+GeoLocation site(dms(-122, 10), dms(37, 26, 30), "Silicon Valley", "CA", "USA", -7);
+
+// A night of samples every 10 minutes, from 18:00 local time
+const KStarsDateTime start(QDate(2021, 4, 17), QTime(1, 0, 0), Qt::UTC);
+constexpr double STEP = 600;
+constexpr int COUNT = 85;
+
+// Circumpolar, rising and setting, and never rising targets
+QVector<SkyPoint> targets()
+{
+    return { SkyPoint(dms(37.95), dms(89.26)), SkyPoint(dms(188.2), dms(37.56)), SkyPoint(dms(83.82), dms(-5.39)),
+             SkyPoint(dms(10.0), dms(-80.0)) };
+}
+}
+
+TestAltitudeSolver::TestAltitudeSolver(QObject *parent) : QObject(parent)
+{
+}
+
+void TestAltitudeSolver::testSamples()
+{
+    AltitudeSolver solver;
+    solver.setTimes(start, STEP, COUNT, &site);
+    solver.setTargets(targets());
+    solver.solve();
+
+    QCOMPARE(solver.targetCount(), static_cast<int>(targets().size()));
+    QCOMPARE(solver.timeCount(), COUNT);
+
+    for (int t = 0; t < solver.targetCount(); t++)
+    {
+        for (int i = 0; i < COUNT; i += 7)
+        {
+            SkyPoint expected = targets()[t];
+            const CachingDms LST = site.GSTtoLST(solver.time(i).gst());
+            expected.EquatorialToHorizontal(&LST, site.lat());
+
+            QVERIFY(qAbs(solver.altitude(t, i) - expected.alt().Degrees()) < 1e-3);
+            if (expected.alt().Degrees() < 85)
+            {
+                const double azimuth = qAbs(solver.azimuth(t, i) - expected.az().Degrees());
+                QVERIFY(std::min(azimuth, 360 - azimuth) < 1e-3);
+            }
+
+            double hourAngle = LST.Hours() - expected.ra().Hours();
+            while (hourAngle > 12)
+                hourAngle -= 24;
+            while (hourAngle < -12)
+                hourAngle += 24;
+            QVERIFY(qAbs(solver.hourAngle(t, i) - hourAngle) < 1e-4);
+        }
+    }
+}
+
+void TestAltitudeSolver::testEvents()
+{
+    AltitudeSolver solver;
+    solver.setTimes(start, STEP, COUNT, &site);
+    solver.setTargets(targets());
+    solver.solve();
+
+    for (int t = 0; t < solver.targetCount(); t++)
+    {
+        const auto crossings = solver.crossings(t, 30);
+        for (const auto &crossing : crossings)
+        {
+            QVERIFY(qAbs(solver.altitudeAt(t, crossing.seconds) - 30) < 1e-4);
+            QCOMPARE(solver.altitudeAt(t, crossing.seconds + 60) > 30, crossing.rising);
+        }
+
+        double maxSeconds;
+        const double maxAlt = solver.maxAltitude(t, &maxSeconds);
+        for (int i = 0; i < COUNT; i++)
+            QVERIFY(solver.altitude(t, i) <= maxAlt);
+
+        for (const double culmination : solver.culminations(t))
+        {
+            QVERIFY(solver.altitudeAt(t, culmination) >= solver.altitudeAt(t, culmination - 60));
+            QVERIFY(solver.altitudeAt(t, culmination) >= solver.altitudeAt(t, culmination + 60));
+            QCOMPARE(maxSeconds, culmination);
+        }
+    }
+
+    // The target on the meridian at midnight culminates then, and crosses 30 degrees before and after
+    const auto culminations = solver.culminations(1);
+    QCOMPARE(static_cast<int>(culminations.size()), 1);
+    QVERIFY(qAbs(culminations[0] - 7 * 3600) < 10 * 60);
+    const auto crossings = solver.crossings(1, 30);
+    QCOMPARE(static_cast<int>(crossings.size()), 2);
+    QVERIFY(crossings[0].rising && !crossings[1].rising);
+    QVERIFY(crossings[0].seconds < culminations[0] && culminations[0] < crossings[1].seconds);
+
+    // Never above the horizon
+    QVERIFY(solver.crossings(3, 0).isEmpty());
+    QVERIFY(solver.maxAltitude(3) < 0);
+}
+
+QTEST_GUILESS_MAIN(TestAltitudeSolver)
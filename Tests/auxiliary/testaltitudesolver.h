@@ -0,0 +1,25 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include <QObject>
+
+class TestAltitudeSolver : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestAltitudeSolver(QObject *parent = nullptr);
+
+    private slots:
+        void testSamples();
+        void testEvents();
+};
@@ -0,0 +1,163 @@
+/*
+    Tests for the queue writing captured images.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "test_imagewritequeue.h"
+
+#include "fitsviewer/framebufferpool.h"
+#include "indi/imagewritequeue.h"
+
+#include <QFile>
+#include <QMutex>
+#include <QSemaphore>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <vector>
+
+namespace
+{
+QByteArray frameData(int size, int seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        data[i] = static_cast<char>((i * 31 + seed) & 0xff);
+    return data;
+}
+
+QSharedPointer<FrameBuffer> frame(const QByteArray &data)
+{
+    return FrameBufferPool::Instance()->acquire(data.constData(), data.size());
+}
+
+QByteArray readFile(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+}
+
+TestImageWriteQueue::TestImageWriteQueue() : QObject()
+{
+}
+
+void TestImageWriteQueue::testWriteFile()
+{
+    QVERIFY(m_Dir.isValid());
+
+    // Larger than the 16 MiB chunks the file is written in, and not a multiple of them
+    const QByteArray data = frameData(40 * 1024 * 1024 + 123, 1);
+    QFile file(m_Dir.filePath("large.fits"));
+    QVERIFY(ISD::ImageWriteQueue::writeFile(file, data.constData(), data.size()));
+    file.close();
+    QCOMPARE(readFile(file.fileName()), data);
+
+    // Unable to open
+    QFile missing(m_Dir.filePath("missing/large.fits"));
+    QVERIFY(!ISD::ImageWriteQueue::writeFile(missing, data.constData(), data.size()));
+}
+
+void TestImageWriteQueue::testOrdering()
+{
+    QVERIFY(m_Dir.isValid());
+
+    // Failures are reported from the writer thread in the order the frames are written
+    QStringList failed;
+    QMutex mutex;
+
+    ISD::ImageWriteQueue queue;
+    queue.setDepth(4);
+    queue.setSyncBatch(3);
+    queue.setFailureHandler([&](const QString & filename)
+    {
+        QMutexLocker locker(&mutex);
+        failed.append(filename);
+    });
+
+    // Good and bad files interleaved, and the same file written twice: the later frame must win
+    std::vector<QByteArray> contents;
+    QStringList expectedFailures;
+    for (int i = 0; i < 10; ++i)
+    {
+        contents.push_back(frameData(1000 + i, i));
+        if (i % 3 == 2)
+        {
+            const QString filename = m_Dir.filePath(QString("missing/%1.fits").arg(i));
+            expectedFailures.append(filename);
+            queue.enqueue(filename, frame(contents.back()));
+        }
+        else
+            queue.enqueue(m_Dir.filePath(QString("%1.fits").arg(i % 2)), frame(contents.back()));
+    }
+    queue.waitForDone();
+
+    QCOMPARE(failed, expectedFailures);
+    // Frames 0, 4 and 6 went to 0.fits, frames 1, 3, 7 and 9 to 1.fits
+    QCOMPARE(readFile(m_Dir.filePath("0.fits")), contents[6]);
+    QCOMPARE(readFile(m_Dir.filePath("1.fits")), contents[9]);
+
+    const auto statistics = queue.statistics();
+    QCOMPARE(statistics.pending, 0);
+    QCOMPARE(statistics.pendingBytes, static_cast<qint64>(0));
+    QCOMPARE(statistics.written, 10 - static_cast<int>(expectedFailures.size()));
+    QCOMPARE(statistics.failed, static_cast<int>(expectedFailures.size()));
+}
+
+void TestImageWriteQueue::testBackPressure()
+{
+    QVERIFY(m_Dir.isValid());
+
+    ISD::ImageWriteQueue queue;
+    queue.setDepth(2);
+
+    // The first frame fails and holds up the writer thread in the failure handler
+    QSemaphore inHandler, release;
+    bool first = true;
+    queue.setFailureHandler([&](const QString &)
+    {
+        if (first)
+        {
+            first = false;
+            inHandler.release();
+            release.acquire();
+        }
+    });
+
+    const QByteArray data = frameData(1000, 0);
+    queue.enqueue(m_Dir.filePath("missing/0.fits"), frame(data));
+    QVERIFY(inHandler.tryAcquire(1, 5000));
+
+    // The writer is busy, so two frames fill the queue
+    queue.enqueue(m_Dir.filePath("a.fits"), frame(data));
+    queue.enqueue(m_Dir.filePath("b.fits"), frame(data));
+    QCOMPARE(queue.statistics().pending, 2);
+    QCOMPARE(queue.statistics().pendingBytes, static_cast<qint64>(2 * data.size()));
+
+    // A third one has to wait for room
+    QThreadPool enqueuer;
+    QFuture<void> blocked = QtConcurrent::run(&enqueuer, [&]()
+    {
+        queue.enqueue(m_Dir.filePath("c.fits"), frame(data));
+    });
+    QTest::qWait(200);
+    QVERIFY(!blocked.isFinished());
+    QCOMPARE(queue.statistics().pending, 2);
+
+    // Once the writer moves on, it is queued
+    release.release();
+    blocked.waitForFinished();
+    queue.waitForDone();
+
+    const auto statistics = queue.statistics();
+    QCOMPARE(statistics.pending, 0);
+    QCOMPARE(statistics.written, 3);
+    QCOMPARE(statistics.failed, 1);
+    QVERIFY(statistics.lastStallTime >= 150);
+    QCOMPARE(readFile(m_Dir.filePath("c.fits")), data);
+}
+
+QTEST_GUILESS_MAIN(TestImageWriteQueue)
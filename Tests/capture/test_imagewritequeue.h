@@ -0,0 +1,42 @@
+/*
+    Tests for the queue writing captured images.
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include <QTemporaryDir>
+
+class TestImageWriteQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TestImageWriteQueue();
+
+private slots:
+    /**
+     * @brief Files larger than a write chunk are written completely
+     */
+    void testWriteFile();
+
+    /**
+     * @brief Frames are written in the order they are queued, including the synced batches
+     */
+    void testOrdering();
+
+    /**
+     * @brief Queuing blocks while depth() frames are waiting, and resumes once one is written
+     */
+    void testBackPressure();
+
+private:
+    QTemporaryDir m_Dir;
+};
@@ -99,6 +99,24 @@ class TestCatalogsDB_DBManager : public QObject
         QCOMPARE(obj.name(), objs.front().name());
     }
 
+    void find_by_partial_name()
+    {
+        const auto &obj  = some_object();
+        const auto &part = obj.name().mid(1).toLower();
+
+        const auto &objs = m_manager.find_objects_by_name(part, 50);
+        QVERIFY(objs.size() > 0);
+
+        for (const auto &found : objs)
+            QVERIFY(found.name().contains(part, Qt::CaseInsensitive) ||
+                    found.longname().contains(part, Qt::CaseInsensitive));
+
+        QBENCHMARK
+        {
+            m_manager.find_objects_by_name(part, 50);
+        }
+    }
+
     void get_by_id()
     {
         const auto &obj     = some_object();
@@ -0,0 +1,142 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include <QObject>
+#include "ekos/auxiliary/darkframeindex.h"
+
+class TestDarkFrameIndex : public QObject
+{
+        Q_OBJECT
+
+    public:
+        /** @short Constructor */
+        TestDarkFrameIndex();
+
+        /** @short Destructor */
+        ~TestDarkFrameIndex() override = default;
+
+    private slots:
+        void darkFrameTest();
+        void defectMapTest();
+};
+
+#include "testdarkframeindex.moc"
+
+namespace
+{
+QVariantMap frame(const QString &filename, double duration, double temperature, const QString &timestamp,
+                  int binX = 1, int gain = 100, const QString &defectMap = QString())
+{
+    QVariantMap map;
+    map["ccd"] = "CCD Simulator";
+    map["chip"] = 0;
+    map["binX"] = binX;
+    map["binY"] = binX;
+    map["temperature"] = temperature;
+    map["gain"] = gain;
+    map["iso"] = QString();
+    map["duration"] = duration;
+    map["filename"] = filename;
+    map["defectmap"] = defectMap;
+    map["timestamp"] = timestamp;
+    return map;
+}
+
+Ekos::DarkFrameIndex::Query query(double duration, double temperature)
+{
+    Ekos::DarkFrameIndex::Query query;
+    query.camera = "CCD Simulator";
+    query.duration = duration;
+    query.hasTemperature = true;
+    query.temperature = temperature;
+    return query;
+}
+
+QString filename(const Ekos::DarkFrameIndex::Entry *entry)
+{
+    return entry ? entry->filename : QString();
+}
+}
+
+TestDarkFrameIndex::TestDarkFrameIndex() : QObject()
+{
+}
+
+void TestDarkFrameIndex::darkFrameTest()
+{
+    Ekos::DarkFrameIndex index;
+    index.rebuild(
+    {
+        frame("a", 10, -10, "2023-01-01T20:00:00"),
+        frame("b", 30, -10, "2023-01-01T20:00:00"),
+        frame("c", 30, 0, "2023-01-02T20:00:00"),
+        frame("d", 60, -10, "2023-01-01T20:00:00"),
+        frame("e", 60, -10, "2023-01-03T20:00:00"),
+        frame("f", 30, -10, "2023-01-01T20:00:00", 2),
+        frame("g", 120, -10, "2023-01-01T20:00:00", 1, 200),
+    });
+    QCOMPARE(index.size(), 7);
+
+    // Closest duration wins
+    QCOMPARE(filename(index.findDarkFrame(query(12, -10))), QString("a"));
+    QCOMPARE(filename(index.findDarkFrame(query(1000, -10))), QString("g"));
+
+    // Then closest temperature and most recent frame, which tie here so the first frame stays
+    QCOMPARE(filename(index.findDarkFrame(query(30, -10))), QString("b"));
+    QCOMPARE(filename(index.findDarkFrame(query(30, 0))), QString("c"));
+
+    // Most recent frame wins at the same temperature
+    QCOMPARE(filename(index.findDarkFrame(query(60, -10))), QString("e"));
+
+    // Gain must match if requested
+    Ekos::DarkFrameIndex::Query gainQuery = query(1000, -10);
+    gainQuery.gain = 100;
+    QCOMPARE(filename(index.findDarkFrame(gainQuery)), QString("e"));
+
+    // Frames too far from the temperature are rejected
+    Ekos::DarkFrameIndex::Query temperatureQuery = query(30, 0);
+    temperatureQuery.maxTemperatureDiff = 2;
+    QCOMPARE(filename(index.findDarkFrame(temperatureQuery)), QString("c"));
+    temperatureQuery.temperature = -10;
+    temperatureQuery.duration = 25;
+    QCOMPARE(filename(index.findDarkFrame(temperatureQuery)), QString("b"));
+    temperatureQuery.temperature = 20;
+    QVERIFY(index.findDarkFrame(temperatureQuery) == nullptr);
+
+    // Binning must match
+    Ekos::DarkFrameIndex::Query binningQuery = query(10, -10);
+    binningQuery.binX = binningQuery.binY = 2;
+    QCOMPARE(filename(index.findDarkFrame(binningQuery)), QString("f"));
+    binningQuery.binX = binningQuery.binY = 4;
+    QVERIFY(index.findDarkFrame(binningQuery) == nullptr);
+}
+
+void TestDarkFrameIndex::defectMapTest()
+{
+    Ekos::DarkFrameIndex index;
+    index.rebuild(
+    {
+        frame("a", 10, -10, "2023-01-01T20:00:00"),
+        frame("b", 30, -10, "2023-01-01T20:00:00", 1, 100, "b.json"),
+        frame("c", 60, -10, "2023-01-01T20:00:00", 1, 200, "c.json"),
+    });
+
+    // Only frames with a defect map are candidates, whatever their gain
+    const Ekos::DarkFrameIndex::Entry *entry = index.findDefectMap(query(10, -10));
+    QCOMPARE(filename(entry), QString("b"));
+    QCOMPARE(entry->defectMap, QString("b.json"));
+    QCOMPARE(filename(index.findDefectMap(query(50, -10))), QString("c"));
+
+    index.rebuild({ frame("a", 10, -10, "2023-01-01T20:00:00") });
+    QVERIFY(index.findDefectMap(query(10, -10)) == nullptr);
+}
+
+QTEST_GUILESS_MAIN(TestDarkFrameIndex)
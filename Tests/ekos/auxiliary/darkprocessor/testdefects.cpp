@@ -11,7 +11,9 @@
 #include <QTest>
 #endif
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include <QObject>
 #include "fitsviewer/fitsdata.h"
@@ -33,6 +35,8 @@ class TestDefects : public QObject
 
     private slots:
         void basicTest();
+        void medianTest();
+        void subtractAndNormalizeTest();
 };
 
 #include "testdefects.moc"
@@ -101,4 +105,110 @@ void TestDefects::basicTest()
     }
 }
 
+void TestDefects::medianTest()
+{
+    // Compare the median filter of many pixels at once to the one of a single pixel
+    const uint32_t width = 64, height = 48;
+    std::vector<uint16_t> buffer(width * height);
+    for (uint32_t i = 0; i < buffer.size(); i++)
+        buffer[i] = (i * 7919u) % 4093u;
+
+    std::vector<uint32_t> offsets;
+    for (uint32_t y = 1; y < height - 1; y++)
+        for (uint32_t x = 1; x < width - 1; x += 3)
+            offsets.push_back(x + y * width);
+
+    QPointer<Ekos::DarkProcessor> processor = new Ekos::DarkProcessor();
+    std::vector<uint16_t> medians(offsets.size());
+    processor->median3x3Filter(buffer.data(), width, offsets.data(), offsets.size(), medians.data());
+
+    for (uint32_t i = 0; i < offsets.size(); i++)
+    {
+        const uint16_t x = offsets[i] % width, y = offsets[i] / width;
+        QCOMPARE(medians[i], processor->median3x3Filter(x, y, width, buffer.data()));
+    }
+}
+
+void TestDefects::subtractAndNormalizeTest()
+{
+    const QString filename = "../Tests/ekos/auxiliary/darkprocessor/hotpixels.fits";
+    if (!QFileInfo::exists(filename))
+        QSKIP(QString("Failed to locate file %1, skipping test.").arg(filename).toLatin1());
+
+    QSharedPointer<FITSData> darkData, lightData, referenceData;
+    darkData.reset(new FITSData());
+    lightData.reset(new FITSData());
+    referenceData.reset(new FITSData());
+    QFuture<bool> darkResult = darkData->loadFromFile(filename);
+    QFuture<bool> lightResult = lightData->loadFromFile(filename);
+    QFuture<bool> referenceResult = referenceData->loadFromFile(filename);
+    darkResult.waitForFinished();
+    lightResult.waitForFinished();
+    referenceResult.waitForFinished();
+
+    if (darkResult.result() == false || lightResult.result() == false || referenceResult.result() == false)
+        QSKIP("Failed to load image, skipping test.");
+
+    // The frame is taller than the 64 rows filtered by each job. Add neighboring hot pixels on both sides of the
+    // first band edge, whose rows are only filtered once all rows are subtracted.
+    const uint32_t width = darkData->width(), height = darkData->height();
+    QVERIFY(height > 64);
+    const std::vector<uint32_t> edgePixels = { 10 + 63 * width, 11 + 64 * width, 40 + 63 * width, 40 + 64 * width };
+    uint8_t *dark = darkData->getWritableImageBuffer();
+    for (auto offset : edgePixels)
+        dark[offset] = 255;
+    darkData->calculateStats(true);
+
+    QSharedPointer<DefectMap> map;
+    map.reset(new DefectMap());
+    map->setDarkData(darkData);
+    const auto offsets = map->offsets(width, height, 0, 0);
+    for (auto offset : edgePixels)
+        QVERIFY(std::binary_search(offsets->begin(), offsets->end(), offset));
+
+    // The light frame is the dark frame over a gradient, but for the bad pixels which are well off both
+    std::vector<uint8_t> subtracted(width * height);
+    for (uint8_t *light : { lightData->getWritableImageBuffer(), referenceData->getWritableImageBuffer() })
+    {
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const uint32_t i = x + y * width;
+                light[i] = std::min(255, dark[i] + 20 + static_cast<int>((3 * x + 5 * y) % 60));
+                subtracted[i] = light[i] - dark[i];
+            }
+        for (auto offset : *offsets)
+        {
+            light[offset] = 255;
+            subtracted[offset] = 255 - dark[offset];
+        }
+    }
+
+    QPointer<Ekos::DarkProcessor> processor = new Ekos::DarkProcessor();
+    processor->subtractAndNormalize(darkData, map, lightData, 0, 0);
+
+    // Each bad pixel is the median around it in the subtracted frame, before any other bad pixel is replaced
+    const uint8_t *buffer = lightData->getImageBuffer();
+    uint32_t changed = 0;
+    for (auto offset : *offsets)
+    {
+        const uint8_t median = processor->median3x3Filter(offset % width, offset / width, width, subtracted.data());
+        QCOMPARE(buffer[offset], median);
+        if (median != subtracted[offset])
+            changed++;
+    }
+    QVERIFY(changed >= edgePixels.size());
+
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        if (!std::binary_search(offsets->begin(), offsets->end(), i))
+            QCOMPARE(buffer[i], subtracted[i]);
+    }
+
+    // Same as subtracting first and correcting the defects after
+    processor->subtractDarkData(darkData, referenceData, 0, 0);
+    processor->normalizeDefects(map, referenceData, 0, 0);
+    QVERIFY(std::equal(buffer, buffer + width * height, referenceData->getImageBuffer()));
+}
+
 QTEST_GUILESS_MAIN(TestDefects)
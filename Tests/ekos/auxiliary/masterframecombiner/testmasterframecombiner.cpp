@@ -0,0 +1,172 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include <QObject>
+#include "ekos/auxiliary/masterframecombiner.h"
+
+#include <vector>
+
+class TestMasterFrameCombiner : public QObject
+{
+        Q_OBJECT
+
+    public:
+        /** @short Constructor */
+        TestMasterFrameCombiner();
+
+        /** @short Destructor */
+        ~TestMasterFrameCombiner() override = default;
+
+    private slots:
+        void rejectionTest();
+        void flatRejectionTest();
+        void averageTest();
+};
+
+#include "testmasterframecombiner.moc"
+
+namespace
+{
+// More than one band of pixels with the smallest memory budget
+constexpr uint32_t ELEMENTS = 100000;
+constexpr float COSMIC_RAY = 60000;
+// Pixels hit by a cosmic ray in one frame, and a dead value in another
+constexpr uint32_t HOT_PIXEL = 12345;
+constexpr uint32_t COLD_PIXEL = 70000;
+
+float base(uint32_t pixel)
+{
+    return 1000 + pixel % 7;
+}
+
+// Frames alternate between the base value and one above it
+std::vector<float> frame(uint32_t index)
+{
+    std::vector<float> values(ELEMENTS);
+    for (uint32_t i = 0; i < ELEMENTS; i++)
+        values[i] = base(i) + index % 2;
+    return values;
+}
+}
+
+TestMasterFrameCombiner::TestMasterFrameCombiner() : QObject()
+{
+}
+
+void TestMasterFrameCombiner::rejectionTest()
+{
+    Ekos::MasterFrameCombiner combiner;
+    combiner.setMemoryBudget(1);
+    combiner.reset(ELEMENTS);
+
+    for (uint32_t f = 0; f < 5; f++)
+    {
+        std::vector<float> values = frame(f);
+        if (f == 2)
+            values[HOT_PIXEL] = COSMIC_RAY;
+        if (f == 4)
+            values[COLD_PIXEL] = 0;
+        combiner.add(values.data());
+    }
+    QCOMPARE(combiner.count(), 5u);
+
+    std::vector<float> master(ELEMENTS);
+    combiner.combine(master.data());
+
+    // Only the two outliers are rejected, the other values are averaged
+    QCOMPARE(combiner.rejected(), static_cast<uint64_t>(2));
+    QCOMPARE(master[0], base(0) + 0.4f);
+    QCOMPARE(master[ELEMENTS - 1], base(ELEMENTS - 1) + 0.4f);
+    QCOMPARE(master[HOT_PIXEL], base(HOT_PIXEL) + 0.5f);
+    QCOMPARE(master[COLD_PIXEL], base(COLD_PIXEL) + 0.5f);
+}
+
+void TestMasterFrameCombiner::flatRejectionTest()
+{
+    // Identical frames have a median absolute deviation of 0, which must still reject the cosmic ray
+    Ekos::MasterFrameCombiner combiner;
+    combiner.reset(ELEMENTS);
+
+    for (uint32_t f = 0; f < 5; f++)
+    {
+        std::vector<float> values(ELEMENTS);
+        for (uint32_t i = 0; i < ELEMENTS; i++)
+            values[i] = base(i);
+        if (f == 3)
+            values[HOT_PIXEL] = COSMIC_RAY;
+        combiner.add(values.data());
+    }
+
+    std::vector<float> master(ELEMENTS);
+    combiner.combine(master.data());
+    QCOMPARE(combiner.rejected(), static_cast<uint64_t>(1));
+    QCOMPARE(master[0], base(0));
+    QCOMPARE(master[HOT_PIXEL], base(HOT_PIXEL));
+
+    // Same with normalized values, which are not quantized to whole units
+    combiner.reset(ELEMENTS);
+    for (uint32_t f = 0; f < 5; f++)
+    {
+        std::vector<float> values(ELEMENTS);
+        for (uint32_t i = 0; i < ELEMENTS; i++)
+            values[i] = base(i) / 4096;
+        if (f == 3)
+            values[HOT_PIXEL] = 0.9f;
+        combiner.add(values.data());
+    }
+
+    combiner.combine(master.data());
+    QCOMPARE(combiner.rejected(), static_cast<uint64_t>(1));
+    QCOMPARE(master[0], base(0) / 4096);
+    QCOMPARE(master[HOT_PIXEL], base(HOT_PIXEL) / 4096);
+}
+
+void TestMasterFrameCombiner::averageTest()
+{
+    Ekos::MasterFrameCombiner combiner;
+    std::vector<float> master(ELEMENTS);
+
+    // Too few frames to reject anything
+    combiner.reset(ELEMENTS);
+    for (uint32_t f = 0; f < 2; f++)
+    {
+        std::vector<float> values = frame(f);
+        if (f == 1)
+            values[HOT_PIXEL] = COSMIC_RAY;
+        combiner.add(values.data());
+    }
+    combiner.combine(master.data());
+    QCOMPARE(combiner.rejected(), static_cast<uint64_t>(0));
+    QCOMPARE(master[0], base(0) + 0.5f);
+    QCOMPARE(master[HOT_PIXEL], (base(HOT_PIXEL) + COSMIC_RAY) / 2);
+
+    // Rejection turned off
+    combiner.setRejection(3, 3, 0);
+    combiner.reset(ELEMENTS);
+    for (uint32_t f = 0; f < 5; f++)
+    {
+        std::vector<float> values = frame(f);
+        if (f == 2)
+            values[HOT_PIXEL] = COSMIC_RAY;
+        combiner.add(values.data());
+    }
+    combiner.combine(master.data());
+    QCOMPARE(combiner.rejected(), static_cast<uint64_t>(0));
+    QCOMPARE(master[0], base(0) + 0.4f);
+    QCOMPARE(master[HOT_PIXEL], (4 * base(HOT_PIXEL) + 2 + COSMIC_RAY) / 5);
+
+    // Integer masters are rounded
+    std::vector<uint16_t> integerMaster(ELEMENTS);
+    combiner.combine(integerMaster.data());
+    QCOMPARE(integerMaster[0], static_cast<uint16_t>(base(0)));
+}
+
+QTEST_GUILESS_MAIN(TestMasterFrameCombiner)
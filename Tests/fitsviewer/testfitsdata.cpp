@@ -10,9 +10,11 @@
 #include <QTest>
 #endif
 
+#include <algorithm>
 #include <memory>
 #include "testfitsdata.h"
 #include "Options.h"
+#include "fitsviewer/stretch.h"
 #include "ekos/auxiliary/solverutils.h"
 #include "ekos/auxiliary/stellarsolverprofile.h"
 
@@ -142,6 +144,47 @@ void TestFitsData::testBahtinovFocusHFR()
 #endif
 }
 
+void TestFitsData::testSetImageBuffer()
+{
+#if QT_VERSION < 0x050900
+    QSKIP("Skipping fixture-based test on old QT version.");
+#else
+    const QString name = "m47_sim_stars.fits";
+    if(!QFile::exists(name))
+        QSKIP("Skipping load test because of missing fixture");
+
+    std::unique_ptr<FITSData> d(new FITSData(FITS_NORMAL));
+    QFuture<bool> worker = d->loadFromFile(name);
+    QTRY_VERIFY_WITH_TIMEOUT(worker.isFinished(), 10000);
+    QVERIFY(worker.result());
+    QCOMPARE(d->dataType(), static_cast<uint32_t>(TUSHORT));
+
+    Stretch stretch(d->width(), d->height(), d->channels(), d->dataType());
+    const StretchParams params = stretch.computeParams(d->getImageBuffer());
+    stretch.setParams(params);
+    QImage before(d->width(), d->height(), QImage::Format_Indexed8);
+    stretch.run(d->getImageBuffer(), &before);
+    const uint32_t generation = d->dataGeneration();
+
+    // Applying a histogram, or undoing it, swaps in a new buffer of the same size
+    const uint32_t samples = d->samplesPerChannel() * d->channels();
+    uint8_t *buffer = new uint8_t[samples * sizeof(uint16_t)];
+    const uint16_t *current = reinterpret_cast<const uint16_t *>(d->getImageBuffer());
+    uint16_t *scaled = reinterpret_cast<uint16_t *>(buffer);
+    for (uint32_t i = 0; i < samples; i++)
+        scaled[i] = static_cast<uint16_t>(std::min(current[i] * 4, 65535));
+    d->setImageBuffer(buffer);
+
+    // Views cache stretched images by data generation, so it must change for them to stretch again
+    QVERIFY(d->dataGeneration() != generation);
+    QVERIFY(stretch.computeParams(d->getImageBuffer()) != params);
+    QImage after(d->width(), d->height(), QImage::Format_Indexed8);
+    stretch.setParams(params);
+    stretch.run(d->getImageBuffer(), &after);
+    QVERIFY(after != before);
+#endif
+}
+
 void TestFitsData::initGenericDataFixture()
 {
 #if QT_VERSION < 0x050900
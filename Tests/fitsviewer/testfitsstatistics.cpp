@@ -0,0 +1,232 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include "testfitsstatistics.h"
+#include "fitsviewer/fitsstatistics.h"
+
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using FITSStatistics::ChannelStatistics;
+
+namespace
+{
+// The statistics of the finite samples, computed the straightforward way
+template <typename T>
+ChannelStatistics reference(const T *data, uint32_t samples)
+{
+    std::vector<double> values;
+    for (uint32_t i = 0; i < samples; ++i)
+    {
+        if (std::isfinite(static_cast<double>(data[i])))
+            values.push_back(static_cast<double>(data[i]));
+    }
+
+    ChannelStatistics result;
+    if (values.empty())
+        return result;
+
+    long double sum = 0;
+    for (auto value : values)
+        sum += value;
+    result.mean = static_cast<double>(sum / values.size());
+
+    long double squares = 0;
+    for (auto value : values)
+        squares += (value - result.mean) * (value - result.mean);
+    result.stddev = std::sqrt(static_cast<double>(squares / values.size()));
+
+    std::sort(values.begin(), values.end());
+    result.min = values.front();
+    result.max = values.back();
+    result.median = (values[(values.size() - 1) / 2] + values[values.size() / 2]) / 2.0;
+    return result;
+}
+
+bool isClose(double value, double expected, double tolerance)
+{
+    return std::fabs(value - expected) <= tolerance * std::max(1.0, std::fabs(expected));
+}
+
+template <typename T>
+void compare(const T *data, uint32_t samples, double tolerance)
+{
+    const ChannelStatistics expected = reference(data, samples);
+    const ChannelStatistics result = FITSStatistics::computeChannel(data, samples);
+
+    // Min, max and median are sample values (or the mean of two), so they are exact
+    QCOMPARE(result.min, expected.min);
+    QCOMPARE(result.max, expected.max);
+    QCOMPARE(result.median, expected.median);
+    QVERIFY2(isClose(result.mean, expected.mean, tolerance),
+             qPrintable(QString("mean %1, expected %2").arg(result.mean, 0, 'g', 17).arg(expected.mean, 0, 'g', 17)));
+    QVERIFY2(isClose(result.stddev, expected.stddev, tolerance),
+             qPrintable(QString("stddev %1, expected %2").arg(result.stddev, 0, 'g', 17).arg(expected.stddev, 0, 'g', 17)));
+}
+
+// Random samples over the whole range of the type
+template <typename T>
+std::vector<T> makeIntegers(uint32_t samples, int seed)
+{
+    QRandomGenerator generator(seed);
+    std::vector<T> values(samples);
+    for (auto &value : values)
+        value = static_cast<T>(generator.generate64());
+    return values;
+}
+
+template <typename T>
+std::vector<T> makeFloats(uint32_t samples, int seed)
+{
+    QRandomGenerator generator(seed);
+    std::vector<T> values(samples);
+    for (auto &value : values)
+    {
+        // A noisy background, negative values and a few much brighter samples
+        value = static_cast<T>(generator.generateDouble() * 200.0 - 50.0);
+        if (generator.bounded(1000) == 0)
+            value = static_cast<T>(generator.generateDouble() * 1e6);
+    }
+    return values;
+}
+}
+
+TestFITSStatistics::TestFITSStatistics(QObject *parent) : QObject(parent)
+{
+}
+
+void TestFITSStatistics::testIntegers_data()
+{
+    QTest::addColumn<int>("samples");
+
+    // Single sample, both median parities, partial blocks and channels split into chunks
+    QTest::newRow("one") << 1;
+    QTest::newRow("two") << 2;
+    QTest::newRow("block") << 4097;
+    QTest::newRow("odd") << 300001;
+    QTest::newRow("even") << 300002;
+}
+
+void TestFITSStatistics::testIntegers()
+{
+    QFETCH(int, samples);
+
+    compare(makeIntegers<uint8_t>(samples, 1).data(), samples, 1e-9);
+    compare(makeIntegers<int16_t>(samples, 2).data(), samples, 1e-9);
+    compare(makeIntegers<uint16_t>(samples, 3).data(), samples, 1e-9);
+    compare(makeIntegers<int32_t>(samples, 4).data(), samples, 1e-9);
+    compare(makeIntegers<uint32_t>(samples, 5).data(), samples, 1e-9);
+
+    // Mostly the same few values, so many samples share the median
+    std::vector<uint16_t> flat = makeIntegers<uint16_t>(samples, 6);
+    for (auto &value : flat)
+        value = 1000 + value % 3;
+    compare(flat.data(), samples, 1e-9);
+}
+
+void TestFITSStatistics::testFloats_data()
+{
+    testIntegers_data();
+}
+
+void TestFITSStatistics::testFloats()
+{
+    QFETCH(int, samples);
+
+    compare(makeFloats<float>(samples, 7).data(), samples, 1e-6);
+    compare(makeFloats<double>(samples, 8).data(), samples, 1e-9);
+
+    // Values which differ in their low bits only, resolved by the refinement passes of the median
+    std::vector<float> narrow = makeFloats<float>(samples, 9);
+    for (auto &value : narrow)
+        value = 1.0f + std::fmod(std::fabs(value), 1.0f) * 1e-5f;
+    compare(narrow.data(), samples, 1e-6);
+}
+
+void TestFITSStatistics::testNonFinite()
+{
+    const uint32_t samples = 200001;
+    std::vector<float> values = makeFloats<float>(samples, 10);
+    for (uint32_t i = 0; i < samples; i += 97)
+        values[i] = std::numeric_limits<float>::quiet_NaN();
+    for (uint32_t i = 5; i < samples; i += 1009)
+        values[i] = std::numeric_limits<float>::infinity();
+    for (uint32_t i = 7; i < samples; i += 2003)
+        values[i] = -std::numeric_limits<float>::infinity();
+    compare(values.data(), samples, 1e-6);
+
+    std::vector<double> doubles(values.begin(), values.end());
+    compare(doubles.data(), samples, 1e-9);
+
+    // Nothing finite at all
+    std::fill(values.begin(), values.end(), std::numeric_limits<float>::quiet_NaN());
+    values[samples / 2] = std::numeric_limits<float>::infinity();
+    const ChannelStatistics result = FITSStatistics::computeChannel(values.data(), samples);
+    QCOMPARE(result.min, 0.0);
+    QCOMPARE(result.max, 0.0);
+    QCOMPARE(result.mean, 0.0);
+    QCOMPARE(result.stddev, 0.0);
+    QCOMPARE(result.median, 0.0);
+}
+
+void TestFITSStatistics::testMultiChannel()
+{
+    // FITSData keeps the channels one after the other and computes each on its own
+    const uint32_t samples = 150001;
+    std::vector<uint16_t> rgb(3 * samples);
+    QRandomGenerator generator(11);
+    for (uint32_t channel = 0; channel < 3; ++channel)
+        for (uint32_t i = 0; i < samples; ++i)
+            rgb[channel * samples + i] = static_cast<uint16_t>(1000 * (channel + 1) + generator.bounded(500));
+
+    double previousMean = 0;
+    for (uint32_t channel = 0; channel < 3; ++channel)
+    {
+        compare(rgb.data() + channel * samples, samples, 1e-9);
+
+        // Each channel only sees its own samples
+        const ChannelStatistics result = FITSStatistics::computeChannel(rgb.data() + channel * samples, samples);
+        QVERIFY(result.min >= 1000 * (channel + 1));
+        QVERIFY(result.max < 1000 * (channel + 1) + 500);
+        QVERIFY(result.mean > previousMean);
+        previousMean = result.mean;
+    }
+}
+
+void TestFITSStatistics::testFields()
+{
+    const uint32_t samples = 100000;
+    const std::vector<int32_t> values = makeIntegers<int32_t>(samples, 12);
+    const ChannelStatistics expected = reference(values.data(), samples);
+
+    ChannelStatistics result = FITSStatistics::computeChannel(values.data(), samples, FITSStatistics::MIN_MAX);
+    QCOMPARE(result.min, expected.min);
+    QCOMPARE(result.max, expected.max);
+    QCOMPARE(result.mean, 0.0);
+    QCOMPARE(result.stddev, 0.0);
+    QCOMPARE(result.median, 0.0);
+
+    result = FITSStatistics::computeChannel(values.data(), samples, FITSStatistics::MEDIAN);
+    QCOMPARE(result.min, 0.0);
+    QCOMPARE(result.max, 0.0);
+    QCOMPARE(result.median, expected.median);
+
+    result = FITSStatistics::computeChannel(values.data(), samples, FITSStatistics::MEAN_STDDEV);
+    QCOMPARE(result.median, 0.0);
+    QVERIFY(isClose(result.mean, expected.mean, 1e-9));
+    QVERIFY(isClose(result.stddev, expected.stddev, 1e-9));
+}
+
+QTEST_GUILESS_MAIN(TestFITSStatistics)
@@ -0,0 +1,23 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class TestFITSStatistics : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestFITSStatistics(QObject *parent = nullptr);
+
+    private slots:
+        void testIntegers_data();
+        void testIntegers();
+        void testFloats_data();
+        void testFloats();
+        void testNonFinite();
+        void testMultiChannel();
+        void testFields();
+};
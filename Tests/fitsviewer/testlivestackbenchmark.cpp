@@ -0,0 +1,523 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "testlivestackbenchmark.h"
+
+#include "fitsviewer/fitsdata.h"
+#include "fitsviewer/fitsstack.h"
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtMath>
+
+#include <wcs.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <type_traits>
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_LINUX)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+int envInt(const char *name, int value)
+{
+    bool ok = false;
+    const int result = qEnvironmentVariable(name).toInt(&ok);
+    return ok ? result : value;
+}
+
+double envDouble(const char *name, double value)
+{
+    bool ok = false;
+    const double result = qEnvironmentVariable(name).toDouble(&ok);
+    return ok ? result : value;
+}
+
+// Levels of the synthetic frames as fractions of full scale
+constexpr double BACKGROUND = 0.012;
+constexpr double PEDESTAL = 0.0015;
+constexpr double HOT_PIXEL = 0.3;
+constexpr double READ_NOISE = 0.0004;
+constexpr double FLAT_LEVEL = 0.4;
+constexpr double VIGNETTING = 0.25;
+// Relative response of the red, green and blue pixels of a colour sensor
+constexpr double RESPONSE[3] = { 0.8, 1.0, 0.7 };
+}
+
+TestLiveStackBenchmark::TestLiveStackBenchmark(QObject *parent) : QObject(parent)
+{
+}
+
+void TestLiveStackBenchmark::initTestCase()
+{
+    m_Config.width = std::max(64, envInt("KSTARS_LIVESTACK_BENCHMARK_WIDTH", m_Config.width));
+    m_Config.height = std::max(64, envInt("KSTARS_LIVESTACK_BENCHMARK_HEIGHT", m_Config.height));
+    m_Config.bits = envInt("KSTARS_LIVESTACK_BENCHMARK_BITS", m_Config.bits);
+    m_Config.subs = std::max(1, envInt("KSTARS_LIVESTACK_BENCHMARK_SUBS", m_Config.subs));
+    m_Config.inMem = std::max(1, envInt("KSTARS_LIVESTACK_BENCHMARK_INMEM", m_Config.inMem));
+    m_Config.drift = envDouble("KSTARS_LIVESTACK_BENCHMARK_DRIFT", m_Config.drift);
+    m_Config.rotation = envDouble("KSTARS_LIVESTACK_BENCHMARK_ROTATION", m_Config.rotation);
+    m_Config.output = qEnvironmentVariable("KSTARS_LIVESTACK_BENCHMARK_OUTPUT");
+
+    const QString bayer = qEnvironmentVariable("KSTARS_LIVESTACK_BENCHMARK_BAYER");
+    if (!bayer.isEmpty())
+        m_Config.bayer = bayer.toUpper().split(',', Qt::SkipEmptyParts);
+
+    QVERIFY2(m_Config.bits == 8 || m_Config.bits == 16 || m_Config.bits == -32,
+             qPrintable(QString("Unsupported bit depth %1").arg(m_Config.bits)));
+    m_FullScale = m_Config.bits == 8 ? 255 : 65535;
+
+    makeSky();
+}
+
+void TestLiveStackBenchmark::cleanupTestCase()
+{
+    if (m_Config.output.isEmpty())
+        return;
+
+    QFile file(m_Config.output);
+    QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Truncate), qPrintable(file.errorString()));
+    file.write(QJsonDocument(m_Results).toJson());
+}
+
+void TestLiveStackBenchmark::makeSky()
+{
+    const int width = m_Config.width, height = m_Config.height;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // Cover the area the subs drift and rotate over, not just the align master
+    const double margin = m_Config.subs * (m_Config.drift + std::hypot(width, height) * std::fabs(m_Config.rotation) * M_PI /
+                                           180.0);
+    const int numStars = width * height / 2500;
+    m_Stars.clear();
+    for (int i = 0; i < numStars; i++)
+    {
+        Star star;
+        star.x = -margin + uniform(rng) * (width + 2 * margin);
+        star.y = -margin + uniform(rng) * (height + 2 * margin);
+        // Many faint stars and a few bright ones, peaks from 2% to 60% of full scale
+        star.flux = m_FullScale * 0.02 * std::pow(30.0, std::pow(uniform(rng), 3.0));
+        star.colour[0] = 0.7 + 0.6 * uniform(rng);
+        star.colour[1] = 1.0;
+        star.colour[2] = 0.7 + 0.6 * uniform(rng);
+        const double mean = (star.colour[0] + star.colour[1] + star.colour[2]) / 3;
+        for (double &c : star.colour)
+            c /= mean;
+        m_Stars.append(star);
+    }
+
+    m_DarkSignal.assign(static_cast<size_t>(width) * height, m_FullScale * PEDESTAL);
+    for (int i = 0; i < width * height / 5000; i++)
+        m_DarkSignal[static_cast<size_t>(uniform(rng) * (m_DarkSignal.size() - 1))] += m_FullScale * HOT_PIXEL * uniform(rng);
+}
+
+void TestLiveStackBenchmark::transform(int index, double x, double y, double &sx, double &sy) const
+{
+    const double angle = index * m_Config.rotation * M_PI / 180.0;
+    const double cx = (m_Config.width - 1) / 2.0, cy = (m_Config.height - 1) / 2.0;
+    sx = std::cos(angle) * (x - cx) - std::sin(angle) * (y - cy) + cx + index * m_Config.drift;
+    sy = std::sin(angle) * (x - cx) + std::cos(angle) * (y - cy) + cy + index * m_Config.drift * 0.5;
+}
+
+wcsprm *TestLiveStackBenchmark::makeWCS(int index) const
+{
+    wcsprm *wcs = new wcsprm;
+    wcs->flag = -1;
+    if (wcsini(1, 2, wcs) != 0)
+    {
+        delete wcs;
+        return nullptr;
+    }
+
+    // The reference pixel follows the drift, and PC undoes the rotation of the sub
+    const double angle = index * m_Config.rotation * M_PI / 180.0;
+    transform(index, (m_Config.width - 1) / 2.0, (m_Config.height - 1) / 2.0, wcs->crpix[0], wcs->crpix[1]);
+    wcs->pc[0] = std::cos(angle);
+    wcs->pc[1] = std::sin(angle);
+    wcs->pc[2] = -std::sin(angle);
+    wcs->pc[3] = std::cos(angle);
+    wcs->cdelt[0] = -PIXEL_SCALE;
+    wcs->cdelt[1] = PIXEL_SCALE;
+    wcs->crval[0] = 83.82;
+    wcs->crval[1] = -5.39;
+    strcpy(wcs->ctype[0], "RA---TAN");
+    strcpy(wcs->ctype[1], "DEC--TAN");
+
+    if (wcsset(wcs) != 0)
+    {
+        freeWCS(wcs);
+        return nullptr;
+    }
+    return wcs;
+}
+
+void TestLiveStackBenchmark::freeWCS(wcsprm *wcs)
+{
+    if (wcs)
+    {
+        wcsfree(wcs);
+        delete wcs;
+    }
+}
+
+std::vector<float> TestLiveStackBenchmark::renderFrame(FrameType type, int index, const QString &bayer) const
+{
+    const int width = m_Config.width, height = m_Config.height;
+    const bool mono = bayer == "NONE";
+    std::mt19937 rng(1000 + index * 3 + type);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+
+    // Colour of each pixel of the mosaic, -1 for mono
+    auto channel = [&](int x, int y)
+    {
+        return mono ? -1 : QString("RGB").indexOf(bayer.at((y % 2) * 2 + (x % 2)));
+    };
+
+    std::vector<float> frame(static_cast<size_t>(width) * height, 0.0f);
+    if (type == LIGHT)
+    {
+        std::fill(frame.begin(), frame.end(), m_FullScale * BACKGROUND);
+        const int radius = std::ceil(4 * PSF_SIGMA);
+        for (const auto &star : m_Stars)
+        {
+            double sx, sy;
+            transform(index, star.x, star.y, sx, sy);
+            if (sx < -radius || sy < -radius || sx >= width + radius || sy >= height + radius)
+                continue;
+
+            for (int y = std::max(0, static_cast<int>(sy) - radius); y <= std::min(height - 1, static_cast<int>(sy) + radius); y++)
+            {
+                for (int x = std::max(0, static_cast<int>(sx) - radius); x <= std::min(width - 1, static_cast<int>(sx) + radius); x++)
+                {
+                    const int c = channel(x, y);
+                    const double r2 = (x - sx) * (x - sx) + (y - sy) * (y - sy);
+                    frame[static_cast<size_t>(y) * width + x] += star.flux * (c < 0 ? 1.0 : star.colour[c]) *
+                            std::exp(-r2 / (2 * PSF_SIGMA * PSF_SIGMA));
+                }
+            }
+        }
+    }
+    else if (type == FLAT)
+        std::fill(frame.begin(), frame.end(), m_FullScale * FLAT_LEVEL);
+
+    const double cx = (width - 1) / 2.0, cy = (height - 1) / 2.0;
+    const double r2max = cx * cx + cy * cy;
+    const double shotNoise = m_FullScale / 65535.0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const size_t i = static_cast<size_t>(y) * width + x;
+            const int c = channel(x, y);
+            // Light reaching the sensor is vignetted and filtered, the dark signal isn't
+            const double vignetting = 1 - VIGNETTING * ((x - cx) * (x - cx) + (y - cy) * (y - cy)) / r2max;
+            const double signal = frame[i] * vignetting * (c < 0 ? 1.0 : RESPONSE[c]);
+            const double dark = type == FLAT ? 0.0 : m_DarkSignal[i];
+            const double sigma = std::sqrt(std::pow(m_FullScale * READ_NOISE, 2) + signal * shotNoise);
+            frame[i] = signal + dark + sigma * normal(rng);
+        }
+    }
+    return frame;
+}
+
+std::vector<uint8_t> TestLiveStackBenchmark::quantize(const std::vector<float> &frame) const
+{
+    std::vector<uint8_t> buffer;
+    if (m_Config.bits == -32)
+    {
+        buffer.resize(frame.size() * sizeof(float));
+        memcpy(buffer.data(), frame.data(), buffer.size());
+    }
+    else if (m_Config.bits == 16)
+    {
+        buffer.resize(frame.size() * sizeof(uint16_t));
+        auto out = reinterpret_cast<uint16_t *>(buffer.data());
+        for (size_t i = 0; i < frame.size(); i++)
+            out[i] = static_cast<uint16_t>(std::clamp(std::lround(frame[i]), 0L, 65535L));
+    }
+    else
+    {
+        buffer.resize(frame.size());
+        for (size_t i = 0; i < frame.size(); i++)
+            buffer[i] = static_cast<uint8_t>(std::clamp(std::lround(frame[i]), 0L, 255L));
+    }
+    return buffer;
+}
+
+template <typename T>
+std::vector<uint8_t> TestLiveStackBenchmark::debayerBuffer(const std::vector<uint8_t> &mosaic,
+        dc1394color_filter_t filter) const
+{
+    const size_t pixels = static_cast<size_t>(m_Config.width) * m_Config.height;
+    std::vector<T> rgb(pixels * 3);
+    dc1394error_t error_code;
+    if constexpr (std::is_same_v<T, uint16_t>)
+        error_code = dc1394_bayer_decoding_16bit(reinterpret_cast<const uint16_t *>(mosaic.data()), rgb.data(),
+                     m_Config.width, m_Config.height, filter, DC1394_BAYER_METHOD_NEAREST, 16);
+    else
+        error_code = dc1394_bayer_decoding_8bit(mosaic.data(), rgb.data(), m_Config.width, m_Config.height, filter,
+                                                DC1394_BAYER_METHOD_NEAREST);
+    if (error_code != DC1394_SUCCESS)
+        return std::vector<uint8_t>();
+
+    // FITSStack takes colour subs as planes, like the FITS file
+    std::vector<uint8_t> planar(pixels * 3 * sizeof(T));
+    T *r = reinterpret_cast<T *>(planar.data());
+    T *g = r + pixels;
+    T *b = g + pixels;
+    for (size_t i = 0; i < pixels; i++)
+    {
+        r[i] = rgb[i * 3];
+        g[i] = rgb[i * 3 + 1];
+        b[i] = rgb[i * 3 + 2];
+    }
+    return planar;
+}
+
+std::vector<uint8_t> TestLiveStackBenchmark::debayer(const std::vector<uint8_t> &mosaic, const QString &bayer) const
+{
+    static const QMap<QString, dc1394color_filter_t> filters =
+    {
+        { "RGGB", DC1394_COLOR_FILTER_RGGB },
+        { "GBRG", DC1394_COLOR_FILTER_GBRG },
+        { "GRBG", DC1394_COLOR_FILTER_GRBG },
+        { "BGGR", DC1394_COLOR_FILTER_BGGR }
+    };
+
+    if (m_Config.bits == 16)
+        return debayerBuffer<uint16_t>(mosaic, filters.value(bayer));
+    return debayerBuffer<uint8_t>(mosaic, filters.value(bayer));
+}
+
+void TestLiveStackBenchmark::resetPeakMemory()
+{
+#if defined(Q_OS_LINUX)
+    // Writing 5 resets the peak resident set size, so each row reports its own
+    QFile file("/proc/self/clear_refs");
+    if (file.open(QIODevice::WriteOnly))
+        file.write("5");
+#endif
+}
+
+qint64 TestLiveStackBenchmark::peakMemoryKB()
+{
+#if defined(Q_OS_LINUX)
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    for (const QByteArray &line : file.readAll().split('\n'))
+    {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).simplified().split(' ').first().toLongLong();
+    }
+    return -1;
+#elif defined(Q_OS_UNIX)
+    // Peak of the whole run, it can't be reset between rows
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_MACOS)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+void TestLiveStackBenchmark::testStackPipeline_data()
+{
+    QTest::addColumn<int>("METHOD");
+    QTest::addColumn<QString>("BAYER");
+
+    for (const auto &bayer : m_Config.bayer)
+    {
+        for (auto method = LiveStackStackingMethodNames.cbegin(); method != LiveStackStackingMethodNames.cend(); ++method)
+            QTest::newRow(qPrintable(QString("%1-%2").arg(method.value(), bayer))) << static_cast<int>(method.key()) << bayer;
+    }
+}
+
+void TestLiveStackBenchmark::testStackPipeline()
+{
+    QFETCH(int, METHOD);
+    QFETCH(QString, BAYER);
+
+    const bool mono = BAYER == "NONE";
+    if (!mono && !QStringList({ "RGGB", "GBRG", "GRBG", "BGGR" }).contains(BAYER))
+        QSKIP(qPrintable(QString("Unknown bayer pattern %1").arg(BAYER)));
+    if (!mono && m_Config.bits == -32)
+        QSKIP("Only 8 and 16 bit subs are debayered");
+
+    const auto method = static_cast<LiveStackStackingMethod>(METHOD);
+    const int width = m_Config.width, height = m_Config.height;
+
+    LiveStackData params {};
+    params.calcSNR = true;
+    params.alignMethod = LiveStackAlignMethod::PLATE_SOLVE;
+    params.numInMem = m_Config.inMem;
+    params.memBudgetMB = 0;
+    params.streaming = false;
+    params.reservoirSize = 0;
+    params.downscale = LiveStackDownscale::NONE;
+    params.weighting = LiveStackFrameWeighting::EQUAL;
+    params.stackingMethod = method;
+    params.lowSigma = 3.0;
+    params.highSigma = 3.0;
+    params.windsorCutoff = 3.0;
+    params.iterations = 3;
+    params.kappa = 1.5;
+    params.alpha = 0.9;
+    params.sigma = 0.9;
+    params.PSFUpdate = 0;
+    params.postProcessing = { true, 0.5, 1.0, 0.5, 1.0, 3, 3.0 };
+
+    resetPeakMemory();
+
+    FITSData data(FITS_LIVESTACKING);
+    // Owned by data
+    auto stack = new FITSStack(&data, LiveStackChannel::SINGLE, params);
+
+    double synthesizeTime = 0, debayerTime = 0, pipelineTime = 0;
+    QElapsedTimer timer;
+
+    // Render, quantize and debayer a frame, only the debayering is part of the pipeline
+    auto makeFrame = [&](FrameType type, int index, int &cvType, int &bytesPerPixel)
+    {
+        timer.start();
+        std::vector<uint8_t> buffer = quantize(renderFrame(type, index, BAYER));
+        synthesizeTime += timer.nsecsElapsed() / 1e6;
+
+        const int depth = m_Config.bits == 8 ? CV_8U : m_Config.bits == 16 ? CV_16U : CV_32F;
+        bytesPerPixel = m_Config.bits == 8 ? 1 : m_Config.bits == 16 ? 2 : 4;
+        cvType = CV_MAKETYPE(depth, mono ? 1 : 3);
+        if (mono)
+            return buffer;
+
+        timer.start();
+        buffer = debayer(buffer, BAYER);
+        const double elapsed = timer.nsecsElapsed() / 1e6;
+        debayerTime += elapsed;
+        pipelineTime += elapsed;
+        return buffer;
+    };
+
+    QSharedPointer<wcsprm> masterWCS(makeWCS(0), &TestLiveStackBenchmark::freeWCS);
+    QVERIFY(masterWCS);
+    stack->addAlignMasterWCS(masterWCS);
+
+    int cvType = 0, bytesPerPixel = 0;
+    for (FrameType type : { DARK, FLAT })
+    {
+        std::vector<uint8_t> master = makeFrame(type, 0, cvType, bytesPerPixel);
+        QVERIFY(!master.empty());
+        timer.start();
+        stack->addMaster(type == DARK, master.data(), width, height, bytesPerPixel, cvType);
+        pipelineTime += timer.nsecsElapsed() / 1e6;
+    }
+
+    // The half flux radius of a gaussian star
+    const double hfr = PSF_SIGMA * std::sqrt(2 * std::log(2.0));
+    int pending = 0;
+    for (int i = 0; i < m_Config.subs; i++)
+    {
+        std::vector<uint8_t> sub = makeFrame(LIGHT, i, cvType, bytesPerPixel);
+        QVERIFY(!sub.empty());
+
+        std::unique_ptr<wcsprm, void(*)(wcsprm *)> wcs(makeWCS(i), &TestLiveStackBenchmark::freeWCS);
+        QVERIFY(wcs);
+
+        LiveStackFile file;
+        file.file = QString("sub%1.fits").arg(i);
+        file.ID = i;
+        file.baseChannel = LiveStackChannel::SINGLE;
+        file.channels = { LiveStackChannel::SINGLE };
+
+        timer.start();
+        double snr = 0;
+        stack->setupNextSub(file);
+        QVERIFY(stack->addSub(sub.data(), cvType, width, height, bytesPerPixel, snr));
+        QVERIFY(stack->solverDone(wcs.get(), false, true, hfr, static_cast<int>(m_Stars.size())));
+        stack->addSubStatus(true);
+
+        // Stack once enough subs are loaded, as FITSData does when subs arrive faster than they are stacked
+        if (++pending == m_Config.inMem || i == m_Config.subs - 1)
+        {
+            QVERIFY(stack->getInitialStackDone() ? stack->stackn() : stack->stack());
+            pending = 0;
+        }
+        pipelineTime += timer.nsecsElapsed() / 1e6;
+    }
+
+    const cv::Mat image = stack->getStackImage();
+    QVERIFY(!image.empty());
+    QCOMPARE(image.channels(), mono ? 1 : 3);
+
+    // Misaligned subs smear the stars, so the brightest star in the align master must still stand out
+    const auto brightest = std::max_element(m_Stars.cbegin(), m_Stars.cend(), [](const Star & a, const Star & b)
+    {
+        return a.flux < b.flux;
+    });
+    if (brightest->x >= 0 && brightest->y >= 0 && brightest->x < width && brightest->y < height)
+    {
+        std::vector<cv::Mat> channels;
+        cv::split(image, channels);
+        const cv::Mat &green = channels[mono ? 0 : 1];
+        std::vector<float> values(green.begin<float>(), green.end<float>());
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        const float median = values[values.size() / 2];
+        const float peak = green.at<float>(qRound(brightest->y), qRound(brightest->x));
+        QVERIFY2(peak > median + 0.1 * brightest->flux,
+                 qPrintable(QString("Star peak %1 over a median of %2").arg(peak).arg(median)));
+    }
+
+    const FITSStack::StageTimes &times = stack->getStageTimes();
+    QJsonObject result
+    {
+        {"method", LiveStackStackingMethodNames.value(method)},
+        {"bayer", BAYER},
+        {"width", width},
+        {"height", height},
+        {"bits", m_Config.bits},
+        {"subs", m_Config.subs},
+        {"in_mem", m_Config.inMem},
+        {"drift", m_Config.drift},
+        {"rotation", m_Config.rotation},
+        {
+            "stages_ms", QJsonObject
+            {
+                {"synthesize", synthesizeTime},
+                {"debayer", debayerTime},
+                {"load", times.load},
+                {"calibrate", times.calibrate},
+                {"align", times.align},
+                {"stack", times.stack},
+                {"post_process", times.postProcess}
+            }
+        },
+        {"pipeline_ms", pipelineTime},
+        {"subs_per_min", pipelineTime > 0 ? m_Config.subs * 60000.0 / pipelineTime : 0.0},
+        {"peak_memory_kb", peakMemoryKB()}
+    };
+    m_Results.append(result);
+    qInfo().noquote() << QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+QTEST_GUILESS_MAIN(TestLiveStackBenchmark)
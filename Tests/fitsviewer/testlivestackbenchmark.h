@@ -0,0 +1,103 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "fitsviewer/bayer.h"
+
+#include <QJsonArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <vector>
+
+struct wcsprm;
+
+/**
+ * @brief End to end benchmark of the Live Stacking pipeline on synthetic star fields.
+ *
+ * Each row stacks the same sequence of drifting and rotating subs with one of the stacking
+ * methods, feeding FITSStack the way FITSData::loadStack does, with a synthetic WCS standing in
+ * for the plate solver. The sequence is configured through environment variables:
+ *
+ * KSTARS_LIVESTACK_BENCHMARK_WIDTH, _HEIGHT  sub size in pixels (1024 x 768)
+ * KSTARS_LIVESTACK_BENCHMARK_BITS            8, 16 or -32 for float (16)
+ * KSTARS_LIVESTACK_BENCHMARK_BAYER           comma separated patterns, NONE for mono (NONE,RGGB)
+ * KSTARS_LIVESTACK_BENCHMARK_SUBS            number of subs (12)
+ * KSTARS_LIVESTACK_BENCHMARK_INMEM           subs per stacking pass (6)
+ * KSTARS_LIVESTACK_BENCHMARK_DRIFT           drift in pixels per sub (2)
+ * KSTARS_LIVESTACK_BENCHMARK_ROTATION        rotation in degrees per sub (0.05)
+ * KSTARS_LIVESTACK_BENCHMARK_OUTPUT          file to write the results to as a JSON array
+ *
+ * Each row also prints its results as a single line of JSON.
+ */
+class TestLiveStackBenchmark : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestLiveStackBenchmark(QObject *parent = nullptr);
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+
+        void testStackPipeline_data();
+        void testStackPipeline();
+
+    private:
+        struct Config
+        {
+            int width { 1024 };
+            int height { 768 };
+            int bits { 16 };
+            QStringList bayer { "NONE", "RGGB" };
+            int subs { 12 };
+            int inMem { 6 };
+            double drift { 2.0 };
+            double rotation { 0.05 };
+            QString output;
+        };
+
+        struct Star
+        {
+            double x, y;
+            double flux;
+            double colour[3];
+        };
+
+        // Frame types rendered by the synthesizer
+        enum FrameType { LIGHT, DARK, FLAT };
+
+        void makeSky();
+        // Render a raw frame in ADU, a mosaic unless bayer is NONE
+        std::vector<float> renderFrame(FrameType type, int index, const QString &bayer) const;
+        // Quantize a raw frame to the configured bit depth, as loaded from its FITS file
+        std::vector<uint8_t> quantize(const std::vector<float> &frame) const;
+        // Debayer a quantized mosaic into planar RGB the way FITSData::stackDebayer does
+        std::vector<uint8_t> debayer(const std::vector<uint8_t> &mosaic, const QString &bayer) const;
+        template <typename T>
+        std::vector<uint8_t> debayerBuffer(const std::vector<uint8_t> &mosaic, dc1394color_filter_t filter) const;
+
+        // WCS of sub index, the align master is index 0. Free with freeWCS.
+        wcsprm *makeWCS(int index) const;
+        static void freeWCS(wcsprm *wcs);
+        // Sub pixel position of a point of the align master
+        void transform(int index, double x, double y, double &sx, double &sy) const;
+
+        static void resetPeakMemory();
+        static qint64 peakMemoryKB();
+
+        Config m_Config;
+        QVector<Star> m_Stars;
+        // Pedestal and hot pixels, the same in every dark and light frame
+        std::vector<float> m_DarkSignal;
+        double m_FullScale { 65535 };
+        QJsonArray m_Results;
+
+        // Pixel scale of the synthetic sky in degrees, and the star PSF sigma in pixels
+        static constexpr double PIXEL_SCALE = 1.5 / 3600.0;
+        static constexpr double PSF_SIGMA = 1.6;
+};
@@ -0,0 +1,32 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+#include <vector>
+
+class TestLiveStackKernels : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestLiveStackKernels(QObject *parent = nullptr);
+
+    private slots:
+        void testSigmaClip_data();
+        void testSigmaClip();
+
+        void testStreamingSigmaClip_data();
+        void testStreamingSigmaClip();
+
+        void testSigmaClipBenchmark_data();
+        void testSigmaClipBenchmark();
+
+    private:
+        void makeSubs(const int numSubs, const int pixels, const int channels);
+
+        std::vector<std::vector<float>> m_Subs;
+        std::vector<const float *> m_SubPtrs;
+        std::vector<float> m_Weights;
+};
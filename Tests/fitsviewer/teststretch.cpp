@@ -0,0 +1,106 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+#include "teststretch.h"
+#include "fitsviewer/stretch.h"
+
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace
+{
+// The medians as computeParams() found them before the histograms: the samples are copied and
+// partially sorted.
+template <typename T>
+void sortedMedians(const std::vector<T> &values, int sampleBy, T *median, T *deviation)
+{
+    const int numSamples = static_cast<int>(values.size()) / sampleBy;
+    std::vector<T> samples(numSamples);
+    for (int index = 0, i = 0; i < numSamples; ++i, index += sampleBy)
+        samples[i] = values[index];
+
+    std::nth_element(samples.begin(), samples.begin() + numSamples / 2, samples.end());
+    *median = samples[numSamples / 2];
+
+    for (auto &sample : samples)
+        sample = sample > *median ? sample - *median : *median - sample;
+    std::nth_element(samples.begin(), samples.begin() + numSamples / 2, samples.end());
+    *deviation = samples[numSamples / 2];
+}
+
+// A sky background with some noise, and a few saturated stars
+template <typename T>
+std::vector<T> makeChannel(int size, int background, int noise, int seed)
+{
+    QRandomGenerator generator(seed);
+    std::vector<T> values(size);
+    for (auto &value : values)
+    {
+        int sample = background + generator.bounded(noise + 1) - noise / 2;
+        if (generator.bounded(100) == 0)
+            sample = std::numeric_limits<T>::max();
+        value = static_cast<T>(std::max(0, std::min<int>(sample, std::numeric_limits<T>::max())));
+    }
+    return values;
+}
+
+template <typename T>
+void compareMedians(const std::vector<T> &values, int sampleBy)
+{
+    T median = 0, deviation = 0, expectedMedian = 0, expectedDeviation = 0;
+    Stretch::medians(values.data(), static_cast<int>(values.size()), sampleBy, &median, &deviation);
+    sortedMedians(values, sampleBy, &expectedMedian, &expectedDeviation);
+    QCOMPARE(median, expectedMedian);
+    QCOMPARE(deviation, expectedDeviation);
+}
+}
+
+TestStretch::TestStretch(QObject *parent) : QObject(parent)
+{
+}
+
+void TestStretch::testMedians_data()
+{
+    QTest::addColumn<int>("SIZE");
+    QTest::addColumn<int>("SAMPLE_BY");
+    QTest::addColumn<int>("BACKGROUND");
+    QTest::addColumn<int>("NOISE");
+
+    QTest::newRow("odd") << 10001 << 1 << 100 << 40;
+    QTest::newRow("even") << 10000 << 1 << 100 << 40;
+    QTest::newRow("sampled") << 100003 << 7 << 30 << 20;
+    QTest::newRow("flat") << 4096 << 1 << 50 << 0;
+    QTest::newRow("dark") << 4096 << 3 << 0 << 6;
+    QTest::newRow("single") << 1 << 1 << 70 << 10;
+}
+
+void TestStretch::testMedians()
+{
+    QFETCH(int, SIZE);
+    QFETCH(int, SAMPLE_BY);
+    QFETCH(int, BACKGROUND);
+    QFETCH(int, NOISE);
+
+    compareMedians(makeChannel<uint8_t>(SIZE, BACKGROUND, NOISE, 1), SAMPLE_BY);
+    compareMedians(makeChannel<uint16_t>(SIZE, BACKGROUND * 200, NOISE * 200, 2), SAMPLE_BY);
+
+    // Fewer values than the sampling step have no samples
+    uint16_t median = 1, deviation = 1;
+    const std::vector<uint16_t> values(SAMPLE_BY > 1 ? SAMPLE_BY - 1 : 0, 1000);
+    Stretch::medians(values.data(), static_cast<int>(values.size()), SAMPLE_BY, &median, &deviation);
+    QCOMPARE(median, static_cast<uint16_t>(0));
+    QCOMPARE(deviation, static_cast<uint16_t>(0));
+}
+
+QTEST_GUILESS_MAIN(TestStretch)
@@ -0,0 +1,18 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+
+class TestStretch : public QObject
+{
+        Q_OBJECT
+    public:
+        explicit TestStretch(QObject *parent = nullptr);
+
+    private slots:
+        void testMedians_data();
+        void testMedians();
+};
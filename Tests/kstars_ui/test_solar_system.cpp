@@ -0,0 +1,128 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "test_solar_system.h"
+
+#if defined(HAVE_INDI)
+
+#include "kstars_ui_tests.h"
+#include "kstarsdata.h"
+#include "Options.h"
+#include "skycomponents/asteroidscomponent.h"
+#include "skycomponents/cometscomponent.h"
+#include "skycomponents/skymapcomposite.h"
+#include "skycomponents/skymesh.h"
+#include "skycomponents/solarsystemcomposite.h"
+#include "skyobjects/ksasteroid.h"
+#include "skyobjects/kscomet.h"
+#include "skyobjects/ksplanet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+TestSolarSystem::TestSolarSystem(QObject *parent) : QObject(parent)
+{
+}
+
+void TestSolarSystem::initTestCase()
+{
+    m_ShowAsteroids = Options::showAsteroids();
+    m_ShowDeepSky = Options::showDeepSky();
+    m_ShowComets = Options::showComets();
+    m_MagLimitAsteroid = Options::magLimitAsteroid();
+}
+
+void TestSolarSystem::cleanupTestCase()
+{
+    Options::setShowAsteroids(m_ShowAsteroids);
+    Options::setShowDeepSky(m_ShowDeepSky);
+    Options::setShowComets(m_ShowComets);
+    Options::setMagLimitAsteroid(m_MagLimitAsteroid);
+}
+
+void TestSolarSystem::testNearestAsteroid()
+{
+    // The catalogs are switched off, so they don't set up the trixels searched by the other components
+    Options::setShowAsteroids(true);
+    Options::setShowDeepSky(false);
+
+    SkyMapComposite *composite = KStarsData::Instance()->skyComposite();
+    AsteroidsComponent *asteroids = composite->solarSystemComposite()->asteroidsComponent();
+    asteroids->updateSolarSystemBodies(KStarsData::Instance()->updateNum());
+
+    KSAsteroid *asteroid = nullptr;
+    for (SkyObject *object : asteroids->objectList())
+    {
+        auto candidate = static_cast<KSAsteroid *>(object);
+        if (candidate->toDraw())
+        {
+            asteroid = candidate;
+            break;
+        }
+    }
+    QVERIFY2(asteroid != nullptr, "No asteroid bright enough to be drawn");
+
+    // Leave the trixels of the opposite side of the sky in the buffer, as a previous search could
+    SkyPoint opposite(dms(asteroid->ra().Degrees() + 180.0).reduce(), dms(-asteroid->dec().Degrees()));
+    SkyMesh::Instance()->aperture(&opposite, 1.0, OBJ_NEAREST_BUF);
+
+    SkyPoint target(asteroid->ra(), asteroid->dec());
+    double maxrad = 0.5;
+    QCOMPARE(asteroids->objectNearest(&target, maxrad), static_cast<SkyObject *>(asteroid));
+    QVERIFY(maxrad < 0.5);
+
+    // Through the whole sky map as well, with the stars searched before the asteroids
+    maxrad = 0.5;
+    QCOMPARE(composite->objectNearest(&target, maxrad), static_cast<SkyObject *>(asteroid));
+}
+
+void TestSolarSystem::testPropagator()
+{
+    Options::setShowAsteroids(true);
+    Options::setShowComets(true);
+
+    KStarsData *data = KStarsData::Instance();
+    KSNumbers *num = data->updateNum();
+    SolarSystemComposite *solarSystem = data->skyComposite()->solarSystemComposite();
+
+    // The propagator must update the faint asteroids too, which are only left out of the drawing
+    Options::setMagLimitAsteroid(-30.0);
+    solarSystem->asteroidsComponent()->updateSolarSystemBodies(num);
+    solarSystem->cometsComponent()->updateSolarSystemBodies(num);
+
+    // The reference positions are found one body at a time, which skips the asteroids below the limit
+    Options::setMagLimitAsteroid(30.0);
+
+    QList<SkyObject *> bodies;
+    for (auto list : { &solarSystem->asteroidsComponent()->objectList(), &solarSystem->cometsComponent()->objectList() })
+    {
+        // A few bodies from each list, the comets include near-parabolic orbits
+        const int step = std::max(1, static_cast<int>(list->size()) / 10);
+        for (int i = 0; i < list->size(); i += step)
+            bodies.append(list->at(i));
+    }
+    QVERIFY(bodies.size() > 10);
+
+    for (SkyObject *object : bodies)
+    {
+        auto body = static_cast<KSPlanetBase *>(object);
+        std::unique_ptr<KSPlanetBase> reference(static_cast<KSPlanetBase *>(body->clone()));
+        reference->findPosition(num, data->geo()->lat(), data->lst(), solarSystem->earth());
+        reference->EquatorialToHorizontal(data->lst(), data->geo()->lat());
+
+        const QString name = body->name();
+        QVERIFY2(body->angularDistanceTo(reference.get()).Degrees() < 1.0 / 3600.0, qPrintable(name));
+        QVERIFY2(std::fabs(body->rsun() - reference->rsun()) < 1e-6, qPrintable(name));
+        QVERIFY2(std::fabs(body->rearth() - reference->rearth()) < 1e-6, qPrintable(name));
+        QVERIFY2(std::fabs((body->helEcLat() - reference->helEcLat()).Degrees()) < 1.0 / 3600.0, qPrintable(name));
+        QVERIFY2(std::fabs(body->alt().Degrees() - reference->alt().Degrees()) < 1.0 / 3600.0, qPrintable(name));
+        if (body->type() == SkyObject::ASTEROID)
+            QVERIFY2(std::fabs(body->mag() - reference->mag()) < 0.01, qPrintable(name));
+    }
+}
+
+QTEST_KSTARS_MAIN(TestSolarSystem)
+
+#endif // HAVE_INDI
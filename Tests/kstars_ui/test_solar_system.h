@@ -0,0 +1,41 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "config-kstars.h"
+
+#if defined(HAVE_INDI)
+
+#include <QObject>
+
+#include <QtGlobal>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QtTest/QTest>
+#else
+#include <QTest>
+#endif
+
+class TestSolarSystem : public QObject
+{
+        Q_OBJECT
+
+    public:
+        explicit TestSolarSystem(QObject *parent = nullptr);
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+
+        void testNearestAsteroid();
+        void testPropagator();
+
+    private:
+        bool m_ShowAsteroids { false };
+        bool m_ShowDeepSky { false };
+        bool m_ShowComets { false };
+        double m_MagLimitAsteroid { 0 };
+};
+
+#endif // HAVE_INDI
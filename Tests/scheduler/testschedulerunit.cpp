@@ -14,10 +14,12 @@
 #include "ekos/scheduler/greedyscheduler.h"
 #include "ekos/scheduler/schedulerjob.h"
 #include "ekos/scheduler/schedulermodulestate.h"
+#include "ekos/scheduler/schedulerephemeris.h"
 #include "indi/indiproperty.h"
 #include "ekos/capture/sequencejob.h"
 #include "ekos/capture/placeholderpath.h"
 #include "geolocation.h"
+#include "ksnumbers.h"
 #include "Options.h"
 
 #include <QtGlobal>
@@ -46,6 +48,7 @@ class TestSchedulerUnit : public QObject
 
     private slots:
         void setupGeoAndTimeTest();
+        void ephemerisTest();
         void setupJobTest_data();
         void setupJobTest();
         void loadSequenceQueueTest();
@@ -233,6 +236,33 @@ void TestSchedulerUnit::setupGeoAndTimeTest()
     QVERIFY(job.getLocalTime() == midNight);
 }
 
+// Tests that the ephemeris shared by the jobs matches positions computed from scratch.
+void TestSchedulerUnit::ephemerisTest()
+{
+    const SkyPoint target(midnightRA, testDEC);
+    const KStarsDateTime midNightUT = siliconValley.LTtoUT(midNight);
+
+    // Minutes which fall between the slots of the ephemeris, over a whole day
+    for (int minute = 0; minute < 24 * 60; minute += 7)
+    {
+        const KStarsDateTime ut = midNightUT.addSecs(minute * 60);
+
+        SkyPoint expected(target.ra0(), target.dec0());
+        KSNumbers numbers(ut.djd());
+        expected.updateCoordsNow(&numbers);
+        const CachingDms LST = siliconValley.GSTtoLST(ut.gst());
+        expected.EquatorialToHorizontal(&LST, siliconValley.lat());
+
+        dms lst;
+        const SkyPoint position = Ekos::SchedulerEphemeris::Instance()->horizontal(target, ut, &siliconValley, &lst);
+        QVERIFY(compareFloat(lst.Degrees(), LST.Degrees(), 1e-6));
+        QVERIFY(compareFloat(position.alt().Degrees(), expected.alt().Degrees(), 1e-4));
+        // The azimuth is meaningless close to the zenith, which the target crosses at midnight
+        if (expected.alt().Degrees() < 80)
+            QVERIFY(compareFloat(position.az().Degrees(), expected.az().Degrees(), 1e-3));
+    }
+}
+
 Q_DECLARE_METATYPE(Ekos::StartupCondition);
 Q_DECLARE_METATYPE(Ekos::CompletionCondition);
 
@@ -9,6 +9,8 @@
 
 #include "skyobjects/skypoint.h"
 #include "skyobjects/starobject.h"
+#include "skyobjects/deepstardata.h"
+#include "skycomponents/starblock.h"
 #include "ksnumbers.h"
 #include "time/kstarsdatetime.h"
 #include "auxiliary/dms.h"
@@ -292,6 +294,50 @@ void TestStarObject::testUpdateCoords()
 
 }
 
+void TestStarObject::testBlockJITupdate()
+{
+    /*
+     * StarBlock::JITupdate() must give the same coordinates as updating
+     * each star on its own with StarObject::updateCoords() and
+     * SkyPoint::EquatorialToHorizontal()
+     */
+    const KSNumbers num(KStarsDateTime::fromString("2024-03-20T21:30").djd());
+    const CachingDms LST(123.456), lat(48.2);
+
+    StarBlock block(40);
+    QList<StarObject> reference;
+    for (int i = 0; i < 40; ++i)
+    {
+        // Spread over the sky, including stars near both poles which take the per star path
+        DeepStarData data;
+        data.RA   = static_cast<qint32>((i * 0.61) * 1000000.0);
+        data.Dec  = static_cast<qint32>((-89.0 + i * 4.5) * 100000.0);
+        data.dRA  = static_cast<qint16>((i % 7 - 3) * 5000);
+        data.dDec = static_cast<qint16>((i % 5 - 2) * 7000);
+        data.B    = 12000 + i * 10;
+        data.V    = 11000 + i * 10;
+        block.addStar(data);
+
+        StarObject star;
+        star.init(&data);
+        star.updateCoords(&num);
+        star.EquatorialToHorizontal(&LST, &lat);
+        reference << star;
+    }
+
+    block.JITupdate(&num, &LST, &lat, 1, 1, 99.0);
+
+    constexpr double tolerance = 1e-9;
+    for (int i = 0; i < 40; ++i)
+    {
+        const StarObject *star = block.star(i);
+        compare(QString("Block RA %1").arg(i), star->ra().Degrees(), reference[i].ra().Degrees(), tolerance);
+        compare(QString("Block Dec %1").arg(i), star->dec().Degrees(), reference[i].dec().Degrees(), tolerance);
+        compare(QString("Block Alt %1").arg(i), star->alt().Degrees(), reference[i].alt().Degrees(), tolerance);
+        compare(QString("Block Az %1").arg(i), star->az().Degrees(), reference[i].az().Degrees(), tolerance);
+    }
+}
+
 #ifdef HAVE_LIBERFA
 void TestStarObject::compareProperMotionAgainstErfa_data()
 {
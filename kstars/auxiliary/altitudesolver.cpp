@@ -0,0 +1,232 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "altitudesolver.h"
+
+#include "dms.h"
+#include "geolocation.h"
+#include "skypoint.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Sidereal time advances by this many degrees per second of UT
+constexpr double SIDEREAL_RATE = SIDEREALSECOND * 15.0 / 3600.0;
+// A sidereal day, in seconds of UT
+constexpr double SIDEREAL_DAY = 360.0 / SIDEREAL_RATE;
+}
+
+void AltitudeSolver::setTimes(const KStarsDateTime &start, double step, int count, const GeoLocation *geo)
+{
+    m_Start = start;
+    m_Step = step;
+    m_Count = std::max(count, 0);
+    geo->lat()->SinCos(m_SinLat, m_CosLat);
+    m_LST0 = geo->GSTtoLST(start.gst()).Degrees();
+
+    m_SinLST.resize(m_Count);
+    m_CosLST.resize(m_Count);
+    for (int i = 0; i < m_Count; i++)
+    {
+        const double lst = (m_LST0 + i * m_Step * SIDEREAL_RATE) * dms::DegToRad;
+        m_SinLST[i] = std::sin(lst);
+        m_CosLST[i] = std::cos(lst);
+    }
+}
+
+void AltitudeSolver::setTargets(const QVector<SkyPoint> &targets)
+{
+    const size_t count = targets.size();
+    m_RA.resize(count);
+    m_SinRA.resize(count);
+    m_CosRA.resize(count);
+    m_SinDec.resize(count);
+    m_CosDec.resize(count);
+
+    for (size_t t = 0; t < count; t++)
+    {
+        m_RA[t] = targets[t].ra().Degrees();
+        targets[t].ra().SinCos(m_SinRA[t], m_CosRA[t]);
+        targets[t].dec().SinCos(m_SinDec[t], m_CosDec[t]);
+    }
+}
+
+void AltitudeSolver::solve()
+{
+    const uint32_t targets = targetCount();
+    const size_t size = static_cast<size_t>(targets) * m_Count;
+    m_Alt.resize(size);
+    m_Az.resize(size);
+    m_HA.resize(size);
+
+    if (size == 0)
+        return;
+
+    std::vector<Block> blocks;
+    blocks.reserve(targets / BLOCK_SIZE + 1);
+    for (uint32_t begin = 0; begin < targets; begin += BLOCK_SIZE)
+        blocks.push_back({ begin, std::min<uint32_t>(begin + BLOCK_SIZE, targets) });
+
+    if (blocks.size() == 1)
+        solve(blocks.front());
+    else
+        QtConcurrent::blockingMap(blocks, [this](const Block & block)
+        {
+            solve(block);
+        });
+}
+
+void AltitudeSolver::solve(const Block &block)
+{
+    const double *sinLST = m_SinLST.data();
+    const double *cosLST = m_CosLST.data();
+    const double sinLat = m_SinLat, cosLat = m_CosLat;
+
+    for (uint32_t t = block.begin; t < block.end; t++)
+    {
+        const double sinRA = m_SinRA[t], cosRA = m_CosRA[t];
+        const double sinDec = m_SinDec[t], cosDec = m_CosDec[t];
+        double *alt = m_Alt.data() + index(t, 0);
+        double *az = m_Az.data() + index(t, 0);
+        double *ha = m_HA.data() + index(t, 0);
+
+        // Products and sums only, so that this loop is vectorized. The hour angle H = LST - RA goes
+        // through the angle difference formulas, az and ha hold cos H and sin H until the next loop.
+        for (int i = 0; i < m_Count; i++)
+        {
+            const double cosH = cosLST[i] * cosRA + sinLST[i] * sinRA;
+            const double sinH = sinLST[i] * cosRA - cosLST[i] * sinRA;
+            alt[i] = sinLat * sinDec + cosLat * cosDec * cosH;
+            az[i] = cosH;
+            ha[i] = sinH;
+        }
+
+        for (int i = 0; i < m_Count; i++)
+        {
+            const double cosH = az[i], sinH = ha[i];
+            alt[i] = std::asin(std::max(-1.0, std::min(1.0, alt[i]))) / dms::DegToRad;
+            // Azimuth from the north through the east
+            const double azimuth = std::atan2(-cosDec * sinH, sinDec * cosLat - cosDec * cosH * sinLat) / dms::DegToRad;
+            az[i] = azimuth < 0 ? azimuth + 360.0 : azimuth;
+            ha[i] = std::atan2(sinH, cosH) / dms::DegToRad / 15.0;
+        }
+    }
+}
+
+KStarsDateTime AltitudeSolver::time(int index) const
+{
+    return m_Start.addSecs(index * m_Step);
+}
+
+QVector<double> AltitudeSolver::altitudes(int target) const
+{
+    QVector<double> result(m_Count);
+    std::copy_n(m_Alt.data() + index(target, 0), m_Count, result.begin());
+    return result;
+}
+
+double AltitudeSolver::lst(double seconds) const
+{
+    return m_LST0 + seconds * SIDEREAL_RATE;
+}
+
+double AltitudeSolver::altitudeAt(int target, double seconds) const
+{
+    const double cosH = std::cos((lst(seconds) - m_RA[target]) * dms::DegToRad);
+    const double sinAlt = m_SinLat * m_SinDec[target] + m_CosLat * m_CosDec[target] * cosH;
+    return std::asin(std::max(-1.0, std::min(1.0, sinAlt))) / dms::DegToRad;
+}
+
+QVector<AltitudeSolver::Crossing> AltitudeSolver::crossings(int target, double threshold) const
+{
+    QVector<Crossing> result;
+    const double *alt = m_Alt.data() + index(target, 0);
+
+    for (int i = 0; i + 1 < m_Count; i++)
+    {
+        double fa = alt[i] - threshold;
+        double fb = alt[i + 1] - threshold;
+        if ((fa < 0) == (fb < 0))
+            continue;
+
+        // Illinois variant of the false position method, the sign change brackets the crossing
+        double a = i * m_Step, b = (i + 1) * m_Step;
+        double c = a;
+        int side = 0;
+        for (int iteration = 0; iteration < 50; iteration++)
+        {
+            c = (a * fb - b * fa) / (fb - fa);
+            const double fc = altitudeAt(target, c) - threshold;
+            if (std::fabs(fc) < 1e-7 || b - a < 1e-3)
+                break;
+
+            if ((fc < 0) == (fb < 0))
+            {
+                b = c;
+                fb = fc;
+                if (side == -1)
+                    fa /= 2;
+                side = -1;
+            }
+            else
+            {
+                a = c;
+                fa = fc;
+                if (side == 1)
+                    fb /= 2;
+                side = 1;
+            }
+        }
+
+        result.append({ c, alt[i + 1] > alt[i] });
+    }
+    return result;
+}
+
+QVector<double> AltitudeSolver::culminations(int target, bool upper) const
+{
+    QVector<double> result;
+    if (m_Count == 0)
+        return result;
+
+    // Seconds until the hour angle next reaches 0h, or 12h for the lower culmination
+    double degrees = std::fmod(m_RA[target] + (upper ? 0.0 : 180.0) - m_LST0, 360.0);
+    if (degrees < 0)
+        degrees += 360.0;
+
+    const double end = (m_Count - 1) * m_Step;
+    for (double seconds = degrees / SIDEREAL_RATE; seconds <= end; seconds += SIDEREAL_DAY)
+        result.append(seconds);
+    return result;
+}
+
+double AltitudeSolver::maxAltitude(int target, double *seconds) const
+{
+    if (m_Count == 0)
+        return -90;
+
+    const double *alt = m_Alt.data() + index(target, 0);
+    const int best = std::max_element(alt, alt + m_Count) - alt;
+    double maxAlt = alt[best];
+    double maxSeconds = best * m_Step;
+
+    // The altitude peaks at the upper culmination, which is likely between two samples
+    for (const double culmination : culminations(target, true))
+    {
+        const double culminationAlt = altitudeAt(target, culmination);
+        if (culminationAlt > maxAlt)
+        {
+            maxAlt = culminationAlt;
+            maxSeconds = culmination;
+        }
+    }
+
+    if (seconds)
+        *seconds = maxSeconds;
+    return maxAlt;
+}
@@ -0,0 +1,146 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kstarsdatetime.h"
+
+#include <QVector>
+
+#include <cstdint>
+#include <vector>
+
+class GeoLocation;
+class SkyPoint;
+
+/**
+ * @class AltitudeSolver
+ * @short Computes the horizontal coordinates of many targets over a grid of times at once.
+ *
+ * The targets are set from their apparent equatorial coordinates, which are taken as constant over
+ * the grid (a night or so), and the sidereal time of the grid advances linearly from its start. The
+ * altitude, azimuth and hour angle of all targets at all times are then computed in blocks of
+ * targets spread over worker threads, each block being plain loops over the time grid which the
+ * compiler can vectorize.
+ *
+ * The sampled curves are used as brackets for the events between the samples: threshold crossings
+ * such as rising and setting are refined by root finding on the altitude, and culminations are
+ * solved for directly from the hour angle.
+ */
+class AltitudeSolver
+{
+    public:
+        /** A crossing of an altitude threshold */
+        struct Crossing
+        {
+            /** Time of the crossing, in seconds from the start of the grid */
+            double seconds;
+            /** True if the target rises above the threshold, false if it sets below it */
+            bool rising;
+        };
+
+        /**
+         * @brief setTimes Set the time grid.
+         * @param start first time of the grid, in UT.
+         * @param step time between the samples, in seconds.
+         * @param count number of samples.
+         * @param geo observing site.
+         */
+        void setTimes(const KStarsDateTime &start, double step, int count, const GeoLocation *geo);
+
+        /** Set the targets from their apparent coordinates, ra() and dec(). */
+        void setTargets(const QVector<SkyPoint> &targets);
+
+        /** Compute the horizontal coordinates of all targets over the time grid. */
+        void solve();
+
+        int targetCount() const
+        {
+            return static_cast<int>(m_SinDec.size());
+        }
+        int timeCount() const
+        {
+            return m_Count;
+        }
+
+        /** @return time of sample @p index, in UT */
+        KStarsDateTime time(int index) const;
+
+        /** @return altitudes of @p target in degrees, one per sample */
+        QVector<double> altitudes(int target) const;
+        /** @return altitude of @p target at @p sample in degrees */
+        double altitude(int target, int sample) const
+        {
+            return m_Alt[index(target, sample)];
+        }
+        /** @return azimuth of @p target at @p sample in degrees */
+        double azimuth(int target, int sample) const
+        {
+            return m_Az[index(target, sample)];
+        }
+        /** @return hour angle of @p target at @p sample in hours, in [-12, 12] */
+        double hourAngle(int target, int sample) const
+        {
+            return m_HA[index(target, sample)];
+        }
+
+        /** @return altitude of @p target at any time, @p seconds from the start of the grid */
+        double altitudeAt(int target, double seconds) const;
+
+        /**
+         * @brief crossings Find when a target crosses an altitude within the grid.
+         * @param target index of the target.
+         * @param threshold altitude in degrees, e.g. -0.5667 for rising and setting.
+         * @return crossings in time order, refined to a fraction of a second.
+         */
+        QVector<Crossing> crossings(int target, double threshold) const;
+
+        /**
+         * @brief culminations Find when a target crosses the meridian within the grid.
+         * @param target index of the target.
+         * @param upper true for the upper culminations (transits), false for the lower ones.
+         * @return times in seconds from the start of the grid.
+         */
+        QVector<double> culminations(int target, bool upper = true) const;
+
+        /**
+         * @brief maxAltitude Highest altitude of a target within the grid.
+         * @param target index of the target.
+         * @param seconds if not null, set to the time of the highest altitude from the start of the grid.
+         * @return altitude in degrees, at an upper culmination if one falls between the samples.
+         */
+        double maxAltitude(int target, double *seconds = nullptr) const;
+
+    private:
+        struct Block
+        {
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        size_t index(int target, int sample) const
+        {
+            return static_cast<size_t>(target) * m_Count + sample;
+        }
+        // Local sidereal time in degrees, seconds from the start of the grid
+        double lst(double seconds) const;
+        void solve(const Block &block);
+
+        // Targets per block of work
+        static constexpr uint32_t BLOCK_SIZE = 64;
+
+        KStarsDateTime m_Start;
+        double m_Step { 0 };
+        int m_Count { 0 };
+        double m_SinLat { 0 };
+        double m_CosLat { 1 };
+        double m_LST0 { 0 };
+
+        // Sidereal time of each sample
+        std::vector<double> m_SinLST, m_CosLST;
+        // Apparent coordinates of each target, right ascension in degrees
+        std::vector<double> m_RA, m_SinRA, m_CosRA, m_SinDec, m_CosDec;
+        // Results, one row of samples per target
+        std::vector<double> m_Alt, m_Az, m_HA;
+};
@@ -28,6 +28,7 @@ BinFileHelper::~BinFileHelper()
 
 void BinFileHelper::init()
 {
+    unmapFile();
     if (fileHandle)
         fclose(fileHandle);
 
@@ -83,6 +84,7 @@ FILE *BinFileHelper::openFile(const QString &fileName)
         errnum = ERR_FILEOPEN;
         return nullptr;
     }
+    mappedFile.setFileName(FilePath);
     return fileHandle;
 }
 
@@ -275,10 +277,33 @@ bool BinFileHelper::readHeader()
 
 void BinFileHelper::closeFile()
 {
+    unmapFile();
     fclose(fileHandle);
     fileHandle = nullptr;
 }
 
+const char *BinFileHelper::mapFile()
+{
+    if (mappedData)
+        return mappedData;
+    if (!fileHandle || !mappedFile.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    mappedData = reinterpret_cast<const char *>(mappedFile.map(0, mappedFile.size()));
+    if (!mappedData)
+        mappedFile.close();
+    return mappedData;
+}
+
+void BinFileHelper::unmapFile()
+{
+    if (!mappedData)
+        return;
+    mappedFile.unmap(reinterpret_cast<uchar *>(const_cast<char *>(mappedData)));
+    mappedFile.close();
+    mappedData = nullptr;
+}
+
 int BinFileHelper::getErrorNumber()
 {
     int err = errnum;
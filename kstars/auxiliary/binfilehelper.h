@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <QFile>
 #include <QString>
 #include <QVector>
 
@@ -69,6 +70,26 @@ class BinFileHelper
      */
     void closeFile();
 
+    /**
+     * @short  Map the whole of the open file into memory, so records can be read without file I/O
+     * @note   The mapping is released when the file is closed. Records in the mapping are in file byte order,
+     *         see getByteSwap()
+     * @return Pointer to the start of the file, nullptr if no file is open or it could not be mapped
+     */
+    const char *mapFile();
+
+    /**
+     * @short  Get the mapping of the currently open file
+     * @return Pointer to the start of the file, nullptr if the file has not been mapped
+     */
+    inline const char *getMappedData() const { return mappedData; }
+
+    /**
+     * @short  Returns the size of the mapping of the currently open file
+     * @return Size of the mapping in bytes, zero if the file has not been mapped
+     */
+    inline qint64 getMappedSize() const { return (mappedData ? mappedFile.size() : 0); }
+
     /**
      * @short   Get error number
      * @return  A number corresponding to the error
@@ -227,8 +248,17 @@ class BinFileHelper
      */
     void init();
 
+    /**
+     * @short  Helper function that releases the mapping of the file, if any
+     */
+    void unmapFile();
+
     /// Handle to the file.
     FILE *fileHandle { nullptr};
+    /// The same file, used to map it into memory
+    QFile mappedFile;
+    /// Start of the mapping of the file, nullptr if not mapped
+    const char *mappedData { nullptr };
     /// Stores offsets corresponding to each index table entry
     QVector<unsigned long> indexOffset;
     /// Stores number of records under each index table entry
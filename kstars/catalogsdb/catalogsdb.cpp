@@ -174,6 +174,28 @@ DBManager::DBManager(const QString &filename) : m_db_file(filename)
     m_q_obj_by_trixel_null_mag = make_query(m_db, SqlStatements::dso_by_trixel_null_mag, false);
     m_q_obj_by_name       = make_query(m_db, SqlStatements::dso_by_name, true);
     m_q_obj_by_name_exact = make_query(m_db, SqlStatements::dso_by_name_exact, true);
+
+    // databases compiled before the name index existed get it now
+    if (!m_has_name_index)
+    {
+        QSqlQuery name_index_exists{ m_db };
+        name_index_exists.exec(SqlStatements::exists_master_name_index);
+        m_has_name_index = name_index_exists.next();
+        name_index_exists.finish();
+
+        if (!m_has_name_index)
+        {
+            m_db.transaction();
+            m_has_name_index = create_name_index();
+            m_db.commit();
+        }
+    }
+
+    m_q_obj_by_name_fts = QSqlQuery{ m_db };
+    m_q_obj_by_name_fts.setForwardOnly(true);
+    m_has_name_index =
+        m_has_name_index && m_q_obj_by_name_fts.prepare(SqlStatements::dso_by_name_fts);
+
     m_q_obj_by_lim        = make_query(m_db, SqlStatements::dso_by_lim, true);
     m_q_obj_by_maglim     = make_query(m_db, SqlStatements::dso_by_maglim, true);
     m_q_obj_by_maglim_and_type =
@@ -343,7 +365,8 @@ bool DBManager::compile_master_catalog()
     QSqlQuery query{ m_db };
     m_db.transaction();
 
-    if (!query.exec(SqlStatements::drop_master))
+    if (!query.exec(SqlStatements::drop_master_name_index) ||
+            !query.exec(SqlStatements::drop_master))
     {
         return false;
     }
@@ -358,9 +381,29 @@ bool DBManager::compile_master_catalog()
     success &= query.exec(SqlStatements::create_master_mag_index);
     success &= query.exec(SqlStatements::create_master_type_index);
     success &= query.exec(SqlStatements::create_master_name_index);
+
+    // not fatal, name searches fall back to a scan of the master catalog
+    m_has_name_index = create_name_index();
+
     return success;
 };
 
+bool DBManager::create_name_index()
+{
+    QSqlQuery query{ m_db };
+
+    if (!query.exec(SqlStatements::create_master_name_index_fts))
+        return false;
+
+    if (!query.exec(SqlStatements::fill_master_name_index))
+    {
+        query.exec(SqlStatements::drop_master_name_index);
+        return false;
+    }
+
+    return true;
+}
+
 const Catalog read_catalog(const QSqlQuery &query)
 {
     return { query.value("id").toInt(),
@@ -514,10 +557,18 @@ CatalogObjectList DBManager::find_objects_by_name(const QString &name, const int
 
     Q_ASSERT(objs.size() <= 1);
 
-    m_q_obj_by_name.bindValue(":name", name);
-    m_q_obj_by_name.bindValue(":limit", int(limit - objs.size()));
+    // the name index is only of use for queries at least one trigram long
+    const bool use_index =
+        m_has_name_index && name.size() >= SqlStatements::min_name_index_query_length;
+    auto &query = use_index ? m_q_obj_by_name_fts : m_q_obj_by_name;
+
+    if (use_index)
+        query.bindValue(":query", SqlStatements::name_index_query(name));
+
+    query.bindValue(":name", name);
+    query.bindValue(":limit", int(limit - objs.size()));
 
-    CatalogObjectList moreObjects = fetch_objects(m_q_obj_by_name);
+    CatalogObjectList moreObjects = fetch_objects(query);
     moreObjects.splice(moreObjects.begin(), objs);
     return moreObjects;
 
@@ -207,6 +207,8 @@ class DBManager
         swap(m_q_obj_by_trixel_null_mag, other.m_q_obj_by_trixel_null_mag);
         swap(m_q_obj_by_name, other.m_q_obj_by_name);
         swap(m_q_obj_by_name_exact, other.m_q_obj_by_name_exact);
+        swap(m_q_obj_by_name_fts, other.m_q_obj_by_name_fts);
+        swap(m_has_name_index, other.m_has_name_index);
         swap(m_q_obj_by_lim, other.m_q_obj_by_lim);
         swap(m_q_obj_by_maglim, other.m_q_obj_by_maglim);
         swap(m_q_obj_by_maglim_and_type, other.m_q_obj_by_maglim_and_type);
@@ -510,10 +512,21 @@ class DBManager
      * the master table. **Caution** you may want to call
      * `update_catalog_views` beforehand.
      *
+     * The full text name index is rebuilt as well if sqlite supports it.
+     *
      * @return true in case of success, false in case of an error
      */
     bool compile_master_catalog();
 
+    /**
+     * Creates and fills the fts5 (trigram) index over the names in the
+     * master table used by `find_objects_by_name`.
+     *
+     * @return true in case of success, false if sqlite lacks fts5 or
+     * the trigram tokenizer
+     */
+    bool create_name_index();
+
     /**
      * Updates the all_catalog_view so that it includes all known
      * catalogs.
@@ -572,6 +585,7 @@ class DBManager
     QSqlQuery m_q_obj_by_trixel_no_nulls;
     QSqlQuery m_q_obj_by_name;
     QSqlQuery m_q_obj_by_name_exact;
+    QSqlQuery m_q_obj_by_name_fts;
     QSqlQuery m_q_obj_by_lim;
     QSqlQuery m_q_obj_by_maglim;
     QSqlQuery m_q_obj_by_maglim_and_type;
@@ -597,6 +611,12 @@ class DBManager
      */
     int m_db_version = -1;
 
+    /**
+     * Whether the master catalog has a full text name index. If not,
+     * name searches use `like` on the master table.
+     */
+    bool m_has_name_index = false;
+
     /**
      * A simple mutex to be locked when using prepared statements,
      * that are stored in the class.
@@ -299,6 +299,25 @@ const QString create_master_name_index =
     "COLLATE NOCASE ASC, long_name COLLATE NOCASE ASC, "
     "magnitude ASC)";
 
+/* Full text index over the names in the master catalog. The trigram
+ * tokenizer lets fts5 answer substring queries without scanning the
+ * whole table. It needs sqlite >= 3.34, so callers have to fall
+ * back to the `like` queries if it can't be created. */
+const QString drop_master_name_index = "DROP TABLE IF EXISTS master_names";
+
+const QString create_master_name_index_fts =
+    "CREATE VIRTUAL TABLE master_names USING fts5(name, long_name, "
+    "content='master', content_rowid='rowid', tokenize='trigram')";
+
+const QString fill_master_name_index =
+    "INSERT INTO master_names(master_names) VALUES('rebuild')";
+
+const QString exists_master_name_index =
+    "SELECT name FROM sqlite_master WHERE type='table' AND name='master_names';";
+
+// trigrams need at least three characters to match anything
+constexpr int min_name_index_query_length = 3;
+
 const QString get_first_catalog = "SELECT id, name, precedence, author, source, "
                                   "description, mut, enabled, version, color, license, "
                                   "maintainer, timestamp FROM catalogs LIMIT 1";
@@ -358,6 +377,23 @@ const QString _dso_by_name_exact = "SELECT %1 FROM master WHERE name = :name LIM
 const QString dso_by_name       = QString(_dso_by_name).arg(object_fields).arg(mag_asc);
 const QString dso_by_name_exact = QString(_dso_by_name_exact).arg(object_fields);
 
+// Matches in `name` weigh more than in `long_name`. Objects whose name starts
+// with the query come first, then the shortest (closest) names.
+const QString _dso_by_name_fts =
+    "SELECT %1 FROM (SELECT master.*, bm25(master_names, 10.0, 1.0) AS name_rank "
+    "FROM master_names JOIN master ON master.rowid = master_names.rowid "
+    "WHERE master_names MATCH :query) "
+    "ORDER BY name like :name || \"%\" DESC, length(name), name_rank, "
+    "%2 LIMIT :limit";
+
+const QString dso_by_name_fts = QString(_dso_by_name_fts).arg(object_fields).arg(mag_asc);
+
+/** \returns \p name as a single fts5 phrase, so it is matched literally */
+inline QString name_index_query(QString name)
+{
+    return '"' + name.replace('"', "\"\"") + '"';
+}
+
 inline const QString dso_by_name_and_catalog(const int id)
 {
     return QString("SELECT %1 FROM cat_%2 WHERE name like \"%\" || :name || \"%\" "
@@ -0,0 +1,164 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "darkframeindex.h"
+
+#include "ekos/ekos.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+namespace Ekos
+{
+
+bool DarkFrameIndex::Key::operator<(const Key &other) const
+{
+    return std::tie(camera, chip, binX, binY) < std::tie(other.camera, other.chip, other.binX, other.binY);
+}
+
+void DarkFrameIndex::rebuild(const QList<QVariantMap> &frames)
+{
+    m_Groups.clear();
+    m_DefectMaps.clear();
+    m_Size = frames.size();
+
+    for (int i = 0; i < frames.size(); i++)
+    {
+        const QVariantMap &map = frames[i];
+        const Key key { map["ccd"].toString(), map["chip"].toInt(), map["binX"].toInt(), map["binY"].toInt() };
+
+        Entry entry;
+        entry.filename = map["filename"].toString();
+        entry.defectMap = map["defectmap"].toString();
+        entry.gain = map["gain"].toInt();
+        entry.iso = map["iso"].toString();
+        entry.duration = map["duration"].toDouble();
+        entry.temperature = map["temperature"].toDouble();
+        entry.timestamp = map["timestamp"].toDateTime();
+        entry.order = i;
+        if (!entry.defectMap.isEmpty())
+            m_DefectMaps.insert(entry.filename, entry.defectMap);
+        m_Groups[key].append(entry);
+    }
+
+    for (auto &group : m_Groups)
+    {
+        std::sort(group.begin(), group.end(), [](const Entry & a, const Entry & b)
+        {
+            return std::tie(a.duration, a.temperature, a.order) < std::tie(b.duration, b.temperature, b.order);
+        });
+    }
+}
+
+const DarkFrameIndex::Entry *DarkFrameIndex::findDarkFrame(const Query &query) const
+{
+    return find(query, false);
+}
+
+const DarkFrameIndex::Entry *DarkFrameIndex::findDefectMap(const Query &query) const
+{
+    return find(query, true);
+}
+
+const DarkFrameIndex::Entry *DarkFrameIndex::find(const Query &query, bool defectMap) const
+{
+    auto group = m_Groups.constFind({ query.camera, query.chip, query.binX, query.binY });
+    if (group == m_Groups.constEnd())
+        return nullptr;
+
+    const QVector<Entry> &entries = group.value();
+
+    auto accepted = [&](const Entry & entry)
+    {
+        if (defectMap)
+            return !entry.defectMap.isEmpty();
+
+        if (query.gain >= 0 && entry.gain != query.gain)
+            return false;
+        if (!query.iso.isEmpty() && entry.iso != query.iso)
+            return false;
+        // If different is above threshold, it is completely rejected.
+        if (query.maxTemperatureDiff >= 0 && entry.temperature != INVALID_VALUE &&
+                std::fabs(entry.temperature - query.temperature) > query.maxTemperatureDiff)
+            return false;
+        return true;
+    };
+
+    // Closest accepted durations below and above the requested one
+    const int position = std::lower_bound(entries.begin(), entries.end(), query.duration, [](const Entry & entry,
+                                          double duration)
+    {
+        return entry.duration < duration;
+    }) - entries.begin();
+
+    int below = position - 1;
+    while (below >= 0 && !accepted(entries[below]))
+        below--;
+    int above = position;
+    while (above < entries.size() && !accepted(entries[above]))
+        above++;
+
+    if (below < 0 && above >= entries.size())
+        return nullptr;
+
+    // Duration has the highest priority, so only the frames of the closest duration are candidates
+    const double belowDiff = below >= 0 ? std::fabs(entries[below].duration - query.duration) : INFINITY;
+    const double aboveDiff = above < entries.size() ? std::fabs(entries[above].duration - query.duration) : INFINITY;
+    const double closest = std::min(belowDiff, aboveDiff);
+
+    QVector<const Entry *> candidates;
+    if (belowDiff == closest)
+    {
+        for (int i = below; i >= 0 && entries[i].duration == entries[below].duration; i--)
+            if (accepted(entries[i]))
+                candidates.append(&entries[i]);
+    }
+    if (aboveDiff == closest)
+    {
+        for (int i = above; i < entries.size() && entries[i].duration == entries[above].duration; i++)
+            if (accepted(entries[i]))
+                candidates.append(&entries[i]);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Entry * a, const Entry * b)
+    {
+        return a->order < b->order;
+    });
+
+    const Entry *bestCandidate = candidates.first();
+    for (int i = 1; i < candidates.size(); i++)
+    {
+        const Entry *entry = candidates[i];
+        uint32_t thisScore = 0;
+        uint32_t bestCandidateScore = 0;
+
+        // Prefer temperatures closest to target
+        if (query.hasTemperature)
+        {
+            const double diffEntry = std::fabs(query.temperature - entry->temperature);
+            const double diffBest = std::fabs(query.temperature - bestCandidate->temperature);
+            if (diffEntry < diffBest)
+                thisScore++;
+            else if (diffBest < diffEntry)
+                bestCandidateScore++;
+        }
+
+        // More recent has a higher score than older.
+        if (!defectMap)
+        {
+            if (entry->timestamp > bestCandidate->timestamp)
+                thisScore++;
+            else if (bestCandidate->timestamp > entry->timestamp)
+                bestCandidateScore++;
+        }
+
+        if (thisScore > bestCandidateScore)
+            bestCandidate = entry;
+    }
+
+    return bestCandidate;
+}
+
+}
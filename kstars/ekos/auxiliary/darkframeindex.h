@@ -0,0 +1,105 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+namespace Ekos
+{
+
+/**
+ * @class DarkFrameIndex
+ * @short Typed in memory index of the dark frames database, to find the best master dark or defect map for a frame.
+ *
+ * The dark frame records are converted from QVariantMap once when the database is loaded, and grouped by camera, chip
+ * and binning. Each group is sorted by duration then temperature, so a lookup is a binary search for the closest
+ * duration followed by a tie break on the few records of that duration, instead of converting every record on every
+ * captured frame.
+ *
+ * The best record is the same as the one found by scoring all records in turn: the closest duration wins, then the
+ * closest temperature and, for dark frames, the most recent one.
+ */
+class DarkFrameIndex
+{
+    public:
+        struct Entry
+        {
+            QString filename;
+            QString defectMap;
+            int gain { 0 };
+            QString iso;
+            double duration { 0 };
+            double temperature { 0 };
+            QDateTime timestamp;
+            // Position in the database records, ties are resolved in this order
+            int order { 0 };
+        };
+
+        struct Query
+        {
+            QString camera;
+            int chip { 0 };
+            int binX { 1 };
+            int binY { 1 };
+            double duration { 0 };
+            /** Only match frames of this gain, unless negative */
+            int gain { -1 };
+            /** Only match frames of this ISO, if set */
+            QString iso;
+            /** Prefer frames closest to temperature */
+            bool hasTemperature { false };
+            double temperature { 0 };
+            /** Reject frames more than this many degrees away from temperature, unless negative */
+            double maxTemperatureDiff { -1 };
+        };
+
+        /** @brief rebuild Replace the index with the records of the darkframe table. */
+        void rebuild(const QList<QVariantMap> &frames);
+
+        /** @return best dark frame for the query, or nullptr if none matches */
+        const Entry *findDarkFrame(const Query &query) const;
+
+        /** @return best frame with a defect map for the query, or nullptr if none matches. Gain, ISO and temperature
+         *  limit are not used for defect maps. */
+        const Entry *findDefectMap(const Query &query) const;
+
+        /** @return defect map file of a master dark, or an empty string if it has none */
+        QString defectMap(const QString &filename) const
+        {
+            return m_DefectMaps.value(filename);
+        }
+
+        int size() const
+        {
+            return m_Size;
+        }
+
+    private:
+        struct Key
+        {
+            QString camera;
+            int chip;
+            int binX;
+            int binY;
+
+            bool operator<(const Key &other) const;
+        };
+
+        const Entry *find(const Query &query, bool defectMap) const;
+
+        // Records of a camera, chip and binning sorted by duration then temperature
+        QMap<Key, QVector<Entry>> m_Groups;
+        // Defect map files by master dark file
+        QHash<QString, QString> m_DefectMaps;
+        int m_Size { 0 };
+};
+
+}
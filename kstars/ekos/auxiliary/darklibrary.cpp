@@ -18,6 +18,7 @@
 #include "kstarsdata.h"
 #include "fitsviewer/fitsdata.h"
 #include "fitsviewer/fitsview.h"
+#include "ekos_debug.h"
 
 #include <QDesktopServices>
 #include <QSqlRecord>
@@ -140,7 +141,7 @@ DarkLibrary::DarkLibrary(QWidget *parent) : QDialog(parent)
     connect(startB, &QPushButton::clicked, this, &DarkLibrary::start);
     connect(stopB, &QPushButton::clicked, this, &DarkLibrary::stop);
 
-    KStarsData::Instance()->userdb()->GetAllDarkFrames(m_DarkFramesDatabaseList);
+    refreshFromDB();
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Defect Map Connections
     ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -206,6 +207,7 @@ DarkLibrary::~DarkLibrary()
 void DarkLibrary::refreshFromDB()
 {
     KStarsData::Instance()->userdb()->GetAllDarkFrames(m_DarkFramesDatabaseList);
+    m_DarkFramesIndex.rebuild(m_DarkFramesDatabaseList);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -213,108 +215,33 @@ void DarkLibrary::refreshFromDB()
 ///////////////////////////////////////////////////////////////////////////////////////
 bool DarkLibrary::findDarkFrame(ISD::CameraChip *m_TargetChip, double duration, QSharedPointer<FITSData> &darkData)
 {
-    QVariantMap bestCandidate;
-    for (auto &map : m_DarkFramesDatabaseList)
-    {
-        // First check CCD name matches and check if we are on the correct chip
-        if (map["ccd"].toString() == m_TargetChip->getCCD()->getDeviceName() &&
-                map["chip"].toInt() == static_cast<int>(m_TargetChip->getType()))
-        {
-            // Match Gain
-            int gain = getGain();
-            if (gain >= 0 && map["gain"].toInt() != gain)
-                continue;
-
-            // Match ISO
-            QString isoValue;
-            if (m_TargetChip->getISOValue(isoValue) && map["iso"].toString() != isoValue)
-                continue;
-
-            // Match binning
-            int binX = 1, binY = 1;
-            m_TargetChip->getBinning(&binX, &binY);
-
-            // Then check if binning is the same
-            if (map["binX"].toInt() != binX || map["binY"].toInt() != binY)
-                continue;
-
-            // If camera has an active cooler, then we check temperature against the absolute threshold.
-            if (m_TargetChip->getCCD()->hasCoolerControl())
-            {
-                double temperature = 0;
-                m_TargetChip->getCCD()->getTemperature(&temperature);
-                double darkTemperature = map["temperature"].toDouble();
-                // If different is above threshold, it is completely rejected.
-                if (darkTemperature != INVALID_VALUE && fabs(darkTemperature - temperature) > maxDarkTemperatureDiff->value())
-                    continue;
-            }
+    DarkFrameIndex::Query query = darkFrameQuery(m_TargetChip, duration);
 
-            if (bestCandidate.isEmpty())
-            {
-                bestCandidate = map;
-                continue;
-            }
+    // Match Gain
+    query.gain = getGain();
 
-            // We try to find the best frame
-            // Frame closest in exposure duration wins
-            // Frame with temperature closest to stored temperature wins (if temperature is reported)
-            uint32_t thisMapScore = 0;
-            uint32_t bestCandidateScore = 0;
+    // Match ISO
+    QString isoValue;
+    if (m_TargetChip->getISOValue(isoValue))
+        query.iso = isoValue;
 
-            // Else we check for the closest passive temperature
-            if (m_TargetChip->getCCD()->hasCooler())
-            {
-                double temperature = 0;
-                m_TargetChip->getCCD()->getTemperature(&temperature);
-                double diffMap = std::fabs(temperature - map["temperature"].toDouble());
-                double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
-                // Prefer temperatures closest to target
-                if (diffMap < diffBest)
-                    thisMapScore++;
-                else if (diffBest < diffMap)
-                    bestCandidateScore++;
-            }
+    // If camera has an active cooler, then we check temperature against the absolute threshold.
+    if (m_TargetChip->getCCD()->hasCoolerControl())
+        query.maxTemperatureDiff = maxDarkTemperatureDiff->value();
 
-            // Duration has a higher score priority over temperature
-            {
-                double diffMap = std::fabs(map["duration"].toDouble() - duration);
-                double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
-                if (diffMap < diffBest)
-                    thisMapScore += 5;
-                else if (diffBest < diffMap)
-                    bestCandidateScore += 5;
-            }
-
-            // More recent has a higher score than older.
-            {
-                const QDateTime now = QDateTime::currentDateTime();
-                int64_t diffMap  = map["timestamp"].toDateTime().secsTo(now);
-                int64_t diffBest = bestCandidate["timestamp"].toDateTime().secsTo(now);
-                if (diffMap < diffBest)
-                    thisMapScore++;
-                else if (diffBest < diffMap)
-                    bestCandidateScore++;
-            }
-
-            // Find candidate with closest time in case we have multiple defect maps
-            if (thisMapScore > bestCandidateScore)
-                bestCandidate = map;
-        }
-    }
-
-    if (bestCandidate.isEmpty())
+    const DarkFrameIndex::Entry *bestCandidate = m_DarkFramesIndex.findDarkFrame(query);
+    if (bestCandidate == nullptr)
         return false;
 
-    if (fabs(bestCandidate["duration"].toDouble() - duration) > 3)
+    if (fabs(bestCandidate->duration - duration) > 3)
         emit i18n("Using available dark frame with %1 seconds exposure. Please take a dark frame with %1 seconds exposure for more accurate results.",
-                  QString::number(bestCandidate["duration"].toDouble(), 'f', 1),
+                  QString::number(bestCandidate->duration, 'f', 1),
                   QString::number(duration, 'f', 1));
 
-    QString filename = bestCandidate["filename"].toString();
+    QString filename = bestCandidate->filename;
 
     // Finally check if the duration is acceptable
-    QDateTime frameTime = bestCandidate["timestamp"].toDateTime();
-    if (frameTime.daysTo(QDateTime::currentDateTime()) > Options::darkLibraryDuration())
+    if (bestCandidate->timestamp.daysTo(QDateTime::currentDateTime()) > Options::darkLibraryDuration())
     {
         emit i18n("Dark frame %s is expired. Please create new master dark.", filename);
         return false;
@@ -322,7 +249,7 @@ bool DarkLibrary::findDarkFrame(ISD::CameraChip *m_TargetChip, double duration,
 
     if (m_CachedDarkFrames.contains(filename))
     {
-        darkData = m_CachedDarkFrames[filename];
+        darkData = *m_CachedDarkFrames.object(filename);
         return true;
     }
 
@@ -332,17 +259,15 @@ bool DarkLibrary::findDarkFrame(ISD::CameraChip *m_TargetChip, double duration,
         m_CachedDarkFrames.clear();
 
     // Finally we made it, let's put it in the hash
-    if (cacheDarkFrameFromFile(filename))
-    {
-        darkData = m_CachedDarkFrames[filename];
+    if (cacheDarkFrameFromFile(filename, &darkData))
         return true;
-    }
 
     // Remove bad dark frame
     emit newLog(i18n("Removing bad dark frame file %1", filename));
     m_CachedDarkFrames.remove(filename);
     QFile::remove(filename);
     KStarsData::Instance()->userdb()->DeleteDarkFrame(filename);
+    refreshFromDB();
     return false;
 
 }
@@ -352,86 +277,32 @@ bool DarkLibrary::findDarkFrame(ISD::CameraChip *m_TargetChip, double duration,
 ///////////////////////////////////////////////////////////////////////////////////////
 bool DarkLibrary::findDefectMap(ISD::CameraChip *m_TargetChip, double duration, QSharedPointer<DefectMap> &defectMap)
 {
-    QVariantMap bestCandidate;
-    for (auto &map : m_DarkFramesDatabaseList)
-    {
-        if (map["defectmap"].toString().isEmpty())
-            continue;
-
-        // First check CCD name matches and check if we are on the correct chip
-        if (map["ccd"].toString() == m_TargetChip->getCCD()->getDeviceName() &&
-                map["chip"].toInt() == static_cast<int>(m_TargetChip->getType()))
-        {
-            int binX, binY;
-            m_TargetChip->getBinning(&binX, &binY);
-
-            // Then check if binning is the same
-            if (map["binX"].toInt() == binX && map["binY"].toInt() == binY)
-            {
-                if (bestCandidate.isEmpty())
-                {
-                    bestCandidate = map;
-                    continue;
-                }
-
-                // We try to find the best frame
-                // Frame closest in exposure duration wins
-                // Frame with temperature closest to stored temperature wins (if temperature is reported)
-                uint32_t thisMapScore = 0;
-                uint32_t bestCandidateScore = 0;
-
-                // Else we check for the closest passive temperature
-                if (m_TargetChip->getCCD()->hasCooler())
-                {
-                    double temperature = 0;
-                    m_TargetChip->getCCD()->getTemperature(&temperature);
-                    double diffMap = std::fabs(temperature - map["temperature"].toDouble());
-                    double diffBest = std::fabs(temperature - bestCandidate["temperature"].toDouble());
-                    // Prefer temperatures closest to target
-                    if (diffMap < diffBest)
-                        thisMapScore++;
-                    else if (diffBest < diffMap)
-                        bestCandidateScore++;
-                }
-
-                // Duration has a higher score priority over temperature
-                double diffMap = std::fabs(map["duration"].toDouble() - duration);
-                double diffBest = std::fabs(bestCandidate["duration"].toDouble() - duration);
-                if (diffMap < diffBest)
-                    thisMapScore += 2;
-                else if (diffBest < diffMap)
-                    bestCandidateScore += 2;
-
-                // Find candidate with closest time in case we have multiple defect maps
-                if (thisMapScore > bestCandidateScore)
-                    bestCandidate = map;
-            }
-        }
-    }
-
-
-    if (bestCandidate.isEmpty())
+    const DarkFrameIndex::Entry *bestCandidate = m_DarkFramesIndex.findDefectMap(darkFrameQuery(m_TargetChip, duration));
+    if (bestCandidate == nullptr)
         return false;
 
+    return findDefectMap(bestCandidate->filename, defectMap);
+}
 
-    QString darkFilename = bestCandidate["filename"].toString();
-    QString defectFilename = bestCandidate["defectmap"].toString();
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::findDefectMap(const QString &darkFilename, QSharedPointer<DefectMap> &defectMap)
+{
+    const QString defectFilename = m_DarkFramesIndex.defectMap(darkFilename);
 
     if (darkFilename.isEmpty() || defectFilename.isEmpty())
         return false;
 
     if (m_CachedDefectMaps.contains(darkFilename))
     {
-        defectMap = m_CachedDefectMaps[darkFilename];
+        defectMap = *m_CachedDefectMaps.object(darkFilename);
         return true;
     }
 
     // Finally we made it, let's put it in the hash
-    if (cacheDefectMapFromFile(darkFilename, defectFilename))
-    {
-        defectMap = m_CachedDefectMaps[darkFilename];
+    if (cacheDefectMapFromFile(darkFilename, defectFilename, &defectMap))
         return true;
-    }
     else
     {
         // Remove bad dark frame
@@ -443,7 +314,23 @@ bool DarkLibrary::findDefectMap(ISD::CameraChip *m_TargetChip, double duration,
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &filename)
+DarkFrameIndex::Query DarkLibrary::darkFrameQuery(ISD::CameraChip *targetChip, double duration) const
+{
+    DarkFrameIndex::Query query;
+    query.camera = targetChip->getCCD()->getDeviceName();
+    query.chip = static_cast<int>(targetChip->getType());
+    query.duration = duration;
+    targetChip->getBinning(&query.binX, &query.binY);
+    targetChip->getCCD()->getTemperature(&query.temperature);
+    // Prefer the closest passive temperature
+    query.hasTemperature = targetChip->getCCD()->hasCooler();
+    return query;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &filename, QSharedPointer<DefectMap> *defectMap)
 {
     QSharedPointer<DefectMap> oneMap;
     oneMap.reset(new DefectMap());
@@ -451,7 +338,9 @@ bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &file
     if (oneMap->load(filename))
     {
         oneMap->filterPixels();
-        m_CachedDefectMaps[key] = oneMap;
+        m_CachedDefectMaps.insert(key, new QSharedPointer<DefectMap>(oneMap));
+        if (defectMap)
+            *defectMap = oneMap;
         return true;
     }
 
@@ -462,7 +351,7 @@ bool DarkLibrary::cacheDefectMapFromFile(const QString &key, const QString &file
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkLibrary::cacheDarkFrameFromFile(const QString &filename)
+bool DarkLibrary::cacheDarkFrameFromFile(const QString &filename, QSharedPointer<FITSData> *darkData)
 {
     QSharedPointer<FITSData> data;
     data.reset(new FITSData(FITS_CALIBRATE), &QObject::deleteLater);
@@ -471,7 +360,12 @@ bool DarkLibrary::cacheDarkFrameFromFile(const QString &filename)
     rc.waitForFinished();
     if (rc.result())
     {
-        m_CachedDarkFrames[filename] = data;
+        // Least recently used frames are dropped once the cache is full
+        const int costMB = std::max(1, static_cast<int>(static_cast<int64_t>(data->samplesPerChannel()) * data->channels() *
+                                    data->getBytesPerPixel() / 1000000));
+        m_CachedDarkFrames.insert(filename, new QSharedPointer<FITSData>(data), costMB);
+        if (darkData)
+            *darkData = data;
     }
     else
     {
@@ -547,8 +441,8 @@ void DarkLibrary::updateProperty(INDI::Property prop)
     }
 
     uint32_t totalElements = m_CurrentDarkFrame->channels() * m_CurrentDarkFrame->samplesPerChannel();
-    if (totalElements != m_DarkMasterBuffer.size())
-        m_DarkMasterBuffer.assign(totalElements, 0);
+    if (totalElements != m_DarkCombiner.elements())
+        m_DarkCombiner.reset(totalElements);
 
     aggregate(m_CurrentDarkFrame);
     darkProgress->setValue(darkProgress->value() + 1);
@@ -849,9 +743,9 @@ void DarkLibrary::loadCurrentMasterDefectMap()
     // Find if we have an existing map
     if (m_CachedDefectMaps.contains(m_MasterDarkFrameFilename))
     {
-        if (m_CurrentDefectMap != m_CachedDefectMaps.value(m_MasterDarkFrameFilename))
+        if (m_CurrentDefectMap != *m_CachedDefectMaps.object(m_MasterDarkFrameFilename))
         {
-            m_CurrentDefectMap = m_CachedDefectMaps.value(m_MasterDarkFrameFilename);
+            m_CurrentDefectMap = *m_CachedDefectMaps.object(m_MasterDarkFrameFilename);
             m_DarkView->setDefectMap(m_CurrentDefectMap);
             m_CurrentDefectMap->setDarkData(m_CurrentDarkFrame);
         }
@@ -1199,6 +1093,8 @@ void DarkLibrary::generateDarkJobs()
 void DarkLibrary::execute()
 {
     m_DarkImagesCounter = 0;
+    // Drop frames left over from an aborted run
+    m_DarkCombiner.reset(0);
     darkProgress->setValue(0);
     darkProgress->setTextVisible(true);
     connect(m_CaptureModule, &Capture::newImage, this, &DarkLibrary::processNewImage, Qt::UniqueConnection);
@@ -1295,9 +1191,7 @@ void DarkLibrary::aggregate(const QSharedPointer<FITSData> &data)
 template <typename T>
 void DarkLibrary::aggregateInternal(const QSharedPointer<FITSData> &data)
 {
-    T const *darkBuffer  = reinterpret_cast<T const*>(data->getImageBuffer());
-    for (uint32_t i = 0; i < m_DarkMasterBuffer.size(); i++)
-        m_DarkMasterBuffer[i] += darkBuffer[i];
+    m_DarkCombiner.add(reinterpret_cast<T const*>(data->getImageBuffer()));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -1345,7 +1239,7 @@ void DarkLibrary::generateMasterFrame(const QSharedPointer<FITSData> &data, cons
 
     emit newImage(data);
     // Reset Master Buffer
-    m_DarkMasterBuffer.assign(m_DarkMasterBuffer.size(), 0);
+    m_DarkCombiner.reset(m_DarkCombiner.elements());
 
 }
 
@@ -1356,10 +1250,10 @@ template <typename T>  void DarkLibrary::generateMasterFrameInternal(const QShar
         const QJsonObject &metadata)
 {
     T *writableBuffer = reinterpret_cast<T *>(data->getWritableImageBuffer());
-    const uint32_t count = metadata["count"].toInt();
-    // Average the values
-    for (uint32_t i = 0; i < m_DarkMasterBuffer.size(); i++)
-        writableBuffer[i] = m_DarkMasterBuffer[i] / count;
+    // Sigma clipped mean of the values received
+    m_DarkCombiner.combine(writableBuffer);
+    if (m_DarkCombiner.count() != static_cast<uint32_t>(metadata["count"].toInt()))
+        qCWarning(KSTARS_EKOS) << "Master dark made from" << m_DarkCombiner.count() << "frames out of" << metadata["count"].toInt();
 
     QString ts = QDateTime::currentDateTime().toString("yyyy-MM-ddThh-mm-ss");
     QString path = QDir(KSPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).filePath("darks/darkframe_" + ts +
@@ -1389,6 +1283,7 @@ template <typename T>  void DarkLibrary::generateMasterFrameInternal(const QShar
     map["timestamp"]   = QDateTime::currentDateTime().toString(Qt::ISODate);
 
     m_DarkFramesDatabaseList.append(map);
+    m_DarkFramesIndex.rebuild(m_DarkFramesDatabaseList);
     m_FileLabel->setText(i18n("Master Dark saved to %1", path));
     KStarsData::Instance()->userdb()->AddDarkFrame(map);
 }
@@ -1456,6 +1351,7 @@ void DarkLibrary::saveDefectMap()
                 (*currentMap)["defectmap"] = filename;
                 (*currentMap)["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
                 KStarsData::Instance()->userdb()->UpdateDarkFrame(*currentMap);
+                m_DarkFramesIndex.rebuild(m_DarkFramesDatabaseList);
             }
         }
     }
@@ -1482,9 +1378,11 @@ void DarkLibrary::setCameraPresets(const QJsonObject &settings)
     const auto opticalTrain = settings["optical_train"].toString();
     const auto isDarkPrefer = settings["isDarkPrefer"].toBool(preferDarksRadio->isChecked());
     const auto isDefectPrefer = settings["isDefectPrefer"].toBool(preferDefectsRadio->isChecked());
+    const auto isBothPrefer = settings["isBothPrefer"].toBool(preferBothRadio->isChecked());
     opticalTrainCombo->setCurrentText(opticalTrain);
     preferDarksRadio->setChecked(isDarkPrefer);
     preferDefectsRadio->setChecked(isDefectPrefer);
+    preferBothRadio->setChecked(isBothPrefer);
     checkCamera();
     reloadDarksFromDatabase();
 }
@@ -1499,6 +1397,7 @@ QJsonObject DarkLibrary::getCameraPresets()
         {"optical_train", opticalTrainCombo->currentText()},
         {"preferDarksRadio", preferDarksRadio->isChecked()},
         {"preferDefectsRadio", preferDefectsRadio->isChecked()},
+        {"preferBothRadio", preferBothRadio->isChecked()},
         {"fileName", m_FileLabel->text()}
     };
     return cameraSettings;
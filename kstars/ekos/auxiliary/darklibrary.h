@@ -8,10 +8,13 @@
 
 #include "indi/indicamera.h"
 #include "indi/indidustcap.h"
+#include "darkframeindex.h"
 #include "darkview.h"
 #include "defectmap.h"
+#include "masterframecombiner.h"
 #include "ekos/ekos.h"
 
+#include <QCache>
 #include <QDialog>
 #include <QPointer>
 #include "ui_darklibrary.h"
@@ -33,8 +36,9 @@ class SequenceJob;
  *
  * Dark Frames:
  *
- * The user can generate dark frames from an average combination of the camera dark frames. By default, 5 dark frames
- * are captured to merged into a single master frame. Frame duration, binning, and temperature are all configurable.
+ * The user can generate dark frames from a sigma clipped mean combination of the camera dark frames. By default, 5 dark frames
+ * are captured to merged into a single master frame, so that a cosmic ray hitting one of them does not end up in the master.
+ * Frame duration, binning, and temperature are all configurable.
  * If the user select "Dark" in any of the Ekos module, Dark Library can be queried if a suitable dark frame exists given
  * the current camera settings (binning, temperature..etc). If a suitable frame exists, it is loaded up and send to /class DarkProcessor
  * class along with the light frame to perform subtraction or defect map corrections.
@@ -72,7 +76,15 @@ class DarkLibrary : public QDialog, public Ui::DarkLibrary
          * @param defectMap If a frame is found, load it from disk and store it in a shared DefectMap pointer.
          * @return True if a suitable frame was found the loaded successfully, false otherwise.
          */
-        bool findDefectMap(ISD::CameraChip *targetChip, double duration, QSharedPointer<DefectMap> &defectMap);        
+        bool findDefectMap(ISD::CameraChip *targetChip, double duration, QSharedPointer<DefectMap> &defectMap);
+
+        /**
+         * @brief findDefectMap Get the defect map made from a master dark frame.
+         * @param darkFilename path of the master dark frame.
+         * @param defectMap If the master dark has a defect map, load it from disk and store it in a shared DefectMap pointer.
+         * @return True if the master dark has a defect map and it was loaded successfully, false otherwise.
+         */
+        bool findDefectMap(const QString &darkFilename, QSharedPointer<DefectMap> &defectMap);
 
         void refreshFromDB();
         bool setCamera(ISD::Camera *device);
@@ -187,7 +199,7 @@ protected:
 
         /**
          * @brief aggregate Aggregate the data as per the selected algorithm. Each time a new dark frame is received, this function
-         * adds the frame data to the dark buffer.
+         * adds the frame data to the master frame combiner.
          * @param data Dark frame data.
          */
         template <typename T> void aggregateInternal(const QSharedPointer<FITSData> &data);
@@ -195,9 +207,15 @@ protected:
         /**
          * @brief cacheDarkFrameFromFile Load dark frame from disk and saves it in the local dark frames cache
          * @param filename path of dark frame to load
+         * @param darkData if not null, set to the loaded dark frame.
          * @return True if file is successfully loaded, false otherwise.
          */
-        bool cacheDarkFrameFromFile(const QString &filename);
+        bool cacheDarkFrameFromFile(const QString &filename, QSharedPointer<FITSData> *darkData = nullptr);
+
+        /**
+         * @brief darkFrameQuery Index query for the current camera, chip, binning and temperature.
+         */
+        DarkFrameIndex::Query darkFrameQuery(ISD::CameraChip *targetChip, double duration) const;
 
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -230,9 +248,10 @@ protected:
          * @brief cacheDefectMapFromFile Load defect map from disk and saves it in the local defect maps cache
          * @param key dark file name that is used as the key in the defect map cache
          * @param filename path of dark frame to load
+         * @param defectMap if not null, set to the loaded defect map.
          * @return True if file is successfully loaded, false otherwise.
          */
-        bool cacheDefectMapFromFile(const QString &key, const QString &filename);
+        bool cacheDefectMapFromFile(const QString &key, const QString &filename, QSharedPointer<DefectMap> *defectMap = nullptr);
 
         ////////////////////////////////////////////////////////////////////
         /// Settings
@@ -277,8 +296,10 @@ protected:
         ////////////////////////////////////////////////////////////////////////////////////////////////
 
         QList<QVariantMap> m_DarkFramesDatabaseList;
-        QMap<QString, QSharedPointer<FITSData>> m_CachedDarkFrames;
-        QMap<QString, QSharedPointer<DefectMap>> m_CachedDefectMaps;
+        DarkFrameIndex m_DarkFramesIndex;
+        // Decoded masters, least recently used first to go. Dark frames cost their size in MB.
+        QCache<QString, QSharedPointer<FITSData>> m_CachedDarkFrames { DARK_CACHE_LIMIT };
+        QCache<QString, QSharedPointer<DefectMap>> m_CachedDefectMaps { DEFECT_CACHE_LIMIT };
 
         ISD::Camera *m_Camera {nullptr};
         ISD::CameraChip *m_TargetChip {nullptr};
@@ -289,7 +310,7 @@ protected:
         QSqlTableModel *darkFramesModel = nullptr;
         QSortFilterProxyModel *sortFilter = nullptr;
 
-        std::vector<uint32_t> m_DarkMasterBuffer;
+        MasterFrameCombiner m_DarkCombiner;
         uint32_t m_DarkImagesCounter {0};
         bool m_RememberFITSViewer {true};
         bool m_RememberSummaryView {true};
@@ -311,5 +332,9 @@ protected:
 
         // Do not add to cache if system memory falls below 250MB.
         static constexpr uint16_t CACHE_MEMORY_LIMIT {250};
+        // Size of the cached dark frames in MB
+        static constexpr int DARK_CACHE_LIMIT {1000};
+        // Number of cached defect maps
+        static constexpr int DEFECT_CACHE_LIMIT {16};
 };
 }
@@ -8,6 +8,9 @@
 #include "darklibrary.h"
 #include "ekos/auxiliary/opticaltrainsettings.h"
 
+#include <QtConcurrent>
+
+#include <algorithm>
 #include <array>
 
 #include "ekos_debug.h"
@@ -15,6 +18,45 @@
 namespace Ekos
 {
 
+namespace
+{
+// Comparators of a sorting network for 8 values
+constexpr std::array<std::pair<uint8_t, uint8_t>, 19> SORT8 =
+{
+    {
+        {0, 2}, {1, 3}, {4, 6}, {5, 7}, {0, 4}, {1, 5}, {2, 6}, {3, 7}, {0, 1}, {2, 3},
+        {4, 5}, {6, 7}, {2, 4}, {3, 5}, {1, 4}, {3, 6}, {1, 2}, {3, 4}, {5, 6}
+    }
+};
+// Bad pixels filtered together by the sorting network
+constexpr uint32_t MEDIAN_BLOCK_SIZE = 256;
+// Bad pixels per job of the worker threads
+constexpr uint32_t DEFECT_BLOCK_SIZE = 4096;
+// Rows per job of the worker threads
+constexpr uint32_t ROW_BLOCK_SIZE = 64;
+
+struct Block
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Split [0, count) in blocks and call function on each, spread over the worker threads
+template <typename F>
+void forEachBlock(uint32_t count, uint32_t blockSize, F function)
+{
+    std::vector<Block> blocks;
+    blocks.reserve(count / blockSize + 1);
+    for (uint32_t begin = 0; begin < count; begin += blockSize)
+        blocks.push_back({ begin, std::min(begin + blockSize, count) });
+
+    if (blocks.size() == 1)
+        function(blocks.front());
+    else if (blocks.size() > 1)
+        QtConcurrent::blockingMap(blocks, function);
+}
+}
+
 DarkProcessor::DarkProcessor(QObject *parent) : QObject(parent)
 {
     connect(&m_Watcher, &QFutureWatcher<bool>::finished, this, [this]()
@@ -80,37 +122,21 @@ void DarkProcessor::normalizeDefectsInternal(const QSharedPointer<DefectMap> &de
     T *lightBuffer = reinterpret_cast<T *>(lightData->getWritableImageBuffer());
     const uint32_t width = lightData->width();
 
-    // Account for offset X and Y
-    // e.g. if we send a subframed light frame 100x100 pixels wide
-    // but the source defect map covers 1000x1000 pixels array, then we need to only compensate
-    // for the 100x100 region.
-    for (BadPixelSet::const_iterator onePixel = defectMap->hotThreshold();
-            onePixel != defectMap->hotPixels().cend(); ++onePixel)
-    {
-        const uint16_t x = (*onePixel).x;
-        const uint16_t y = (*onePixel).y;
-
-        if (x <= offsetX || y <= offsetY)
-            continue;
-
-        uint32_t offset = (x - offsetX) + (y - offsetY) * width;
+    // Offsets of the bad pixels in the light frame, compiled once by the defect map for this subframe
+    const auto offsets = defectMap->offsets(width, lightData->height(), offsetX, offsetY);
+    const uint32_t count = offsets->size();
 
-        lightBuffer[offset] = median3x3Filter(x - offsetX, y - offsetY, width, lightBuffer);
-    }
-
-    for (BadPixelSet::const_iterator onePixel = defectMap->coldPixels().cbegin();
-            onePixel != defectMap->coldThreshold(); ++onePixel)
+    // The medians are all taken from the uncorrected frame then written back, so that the bad pixels can be
+    // filtered in any order on all threads.
+    std::vector<T> medians(count);
+    forEachBlock(count, DEFECT_BLOCK_SIZE, [&](const Block & block)
     {
-        const uint16_t x = (*onePixel).x;
-        const uint16_t y = (*onePixel).y;
-
-        if (x <= offsetX || y <= offsetY)
-            continue;
-
-        uint32_t offset = (x - offsetX) + (y - offsetY) * width;
+        median3x3Filter(lightBuffer, width, offsets->data() + block.begin, block.end - block.begin,
+                        medians.data() + block.begin);
+    });
 
-        lightBuffer[offset] = median3x3Filter(x - offsetX, y - offsetY, width, lightBuffer);
-    }
+    for (uint32_t i = 0; i < count; i++)
+        lightBuffer[(*offsets)[i]] = medians[i];
 
     lightData->calculateStats(true);
 
@@ -146,6 +172,47 @@ T DarkProcessor::median3x3Filter(uint16_t x, uint16_t y, uint32_t width, T *buff
     return median;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void DarkProcessor::median3x3Filter(const T *buffer, uint32_t width, const uint32_t *offsets, uint32_t count, T *medians)
+{
+    const int64_t stride = width;
+    const std::array<int64_t, 8> neighbors = { -stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1 };
+
+    // One row per neighbor, so that each comparator of the sorting network is a loop over all the pixels of
+    // the block which the compiler can vectorize.
+    std::array<std::array<T, MEDIAN_BLOCK_SIZE>, 8> elements;
+
+    for (uint32_t begin = 0; begin < count; begin += MEDIAN_BLOCK_SIZE)
+    {
+        const uint32_t size = std::min(MEDIAN_BLOCK_SIZE, count - begin);
+
+        for (uint8_t n = 0; n < 8; n++)
+        {
+            T *row = elements[n].data();
+            for (uint32_t i = 0; i < size; i++)
+                row[i] = buffer[offsets[begin + i] + neighbors[n]];
+        }
+
+        for (const auto &comparator : SORT8)
+        {
+            T *low = elements[comparator.first].data();
+            T *high = elements[comparator.second].data();
+            for (uint32_t i = 0; i < size; i++)
+            {
+                const T a = low[i], b = high[i];
+                low[i] = std::min(a, b);
+                high[i] = std::max(a, b);
+            }
+        }
+
+        for (uint32_t i = 0; i < size; i++)
+            medians[begin + i] = (elements[3][i] + elements[4][i]) / 2;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -218,6 +285,110 @@ void DarkProcessor::subtractInternal(const QSharedPointer<FITSData> &darkData, c
     lightData->calculateStats(true);
 }
 
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+void DarkProcessor::subtractAndNormalize(const QSharedPointer<FITSData> &darkData, const QSharedPointer<DefectMap> &defectMap,
+        const QSharedPointer<FITSData> &lightData, uint16_t offsetX, uint16_t offsetY)
+{
+    switch (darkData->dataType())
+    {
+        case TBYTE:
+            subtractAndNormalizeInternal<uint8_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TSHORT:
+            subtractAndNormalizeInternal<int16_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TUSHORT:
+            subtractAndNormalizeInternal<uint16_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TLONG:
+            subtractAndNormalizeInternal<int32_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TULONG:
+            subtractAndNormalizeInternal<uint32_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TFLOAT:
+            subtractAndNormalizeInternal<float>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TLONGLONG:
+            subtractAndNormalizeInternal<int64_t>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        case TDOUBLE:
+            subtractAndNormalizeInternal<double>(darkData, defectMap, lightData, offsetX, offsetY);
+            break;
+
+        default:
+            break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void DarkProcessor::subtractAndNormalizeInternal(const QSharedPointer<FITSData> &darkData,
+        const QSharedPointer<DefectMap> &defectMap, const QSharedPointer<FITSData> &lightData, uint16_t offsetX, uint16_t offsetY)
+{
+    const uint32_t width = lightData->width();
+    const uint32_t height = lightData->height();
+    T *lightBuffer = reinterpret_cast<T *>(lightData->getWritableImageBuffer());
+
+    const uint32_t darkStride = darkData->width();
+    const uint32_t darkoffset = offsetX + offsetY * darkStride;
+    T const *darkBuffer  = reinterpret_cast<T const*>(darkData->getImageBuffer()) + darkoffset;
+
+    const auto offsets = defectMap->offsets(width, height, offsetX, offsetY);
+    const uint32_t *firstDefect = offsets->data();
+    const uint32_t *lastDefect = offsets->data() + offsets->size();
+
+    // As in normalizeDefectsInternal, the medians are all taken from the subtracted but uncorrected frame and only
+    // written back at the end, so no bad pixel is filtered with neighbors which were already corrected.
+    std::vector<T> medians(offsets->size());
+    auto filterRow = [&](uint32_t y)
+    {
+        const uint32_t *begin = std::lower_bound(firstDefect, lastDefect, y * width);
+        const uint32_t *end = std::lower_bound(begin, lastDefect, (y + 1) * width);
+        median3x3Filter(static_cast<const T *>(lightBuffer), width, begin, end - begin, medians.data() + (begin - firstDefect));
+    };
+
+    // Each job subtracts its rows and filters the bad pixels one row behind, while the rows are still in cache. The
+    // first and last rows of a job have neighbors in the other jobs, so they are filtered once all rows are subtracted.
+    forEachBlock(height, ROW_BLOCK_SIZE, [&](const Block & block)
+    {
+        for (uint32_t y = block.begin; y < block.end; y++)
+        {
+            T *light = lightBuffer + y * width;
+            T const *dark = darkBuffer + y * darkStride;
+            for (uint32_t x = 0; x < width; x++)
+                light[x] = (light[x] > dark[x]) ? (light[x] - dark[x]) : 0;
+
+            if (y >= block.begin + 2)
+                filterRow(y - 1);
+        }
+    });
+
+    for (uint32_t begin = 0; begin < height; begin += ROW_BLOCK_SIZE)
+    {
+        const uint32_t end = std::min(begin + ROW_BLOCK_SIZE, height);
+        filterRow(begin);
+        if (end - 1 > begin)
+            filterRow(end - 1);
+    }
+
+    for (uint32_t i = 0; i < medians.size(); i++)
+        lightBuffer[firstDefect[i]] = medians[i];
+
+    lightData->calculateStats(true);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -227,15 +398,19 @@ void DarkProcessor::denoise(int trainID, ISD::CameraChip *m_TargetChip, const QS
     info = {trainID, m_TargetChip, targetData, duration, offsetX, offsetY};
 
     auto useDefect = false;
+    auto useBoth = false;
     // Get the train settings
     OpticalTrainSettings::Instance()->setOpticalTrainID(trainID);
     auto settings = OpticalTrainSettings::Instance()->getOneSetting(OpticalTrainSettings::DarkLibrary);
     if (settings.isValid())
+    {
         useDefect = settings.toMap().contains("preferDefectsRadio");
+        useBoth = settings.toMap().contains("preferBothRadio");
+    }
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    QFuture<bool> result = QtConcurrent::run(&DarkProcessor::denoiseInternal, this, useDefect);
+    QFuture<bool> result = QtConcurrent::run(&DarkProcessor::denoiseInternal, this, useDefect, useBoth);
 #else
-    QFuture<bool> result = QtConcurrent::run(this, &DarkProcessor::denoiseInternal, useDefect);
+    QFuture<bool> result = QtConcurrent::run(this, &DarkProcessor::denoiseInternal, useDefect, useBoth);
 #endif
     m_Watcher.setFuture(result);
 }
@@ -243,7 +418,7 @@ void DarkProcessor::denoise(int trainID, ISD::CameraChip *m_TargetChip, const QS
 ///////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////
-bool DarkProcessor::denoiseInternal(bool useDefect)
+bool DarkProcessor::denoiseInternal(bool useDefect, bool useBoth)
 {
     // Check if we have preference for defect map
     // If yes, check if defect map exists
@@ -271,6 +446,16 @@ bool DarkProcessor::denoiseInternal(bool useDefect)
             emit newLog(i18n("No suitable dark frames or defect maps found. Please run the Dark Library wizard in Capture module."));
             return false;
         }
+
+        // If both are preferred and a defect map was made from this dark frame, treat its bad pixels in the same pass
+        QSharedPointer<DefectMap> darkDefectMap;
+        if (useBoth && DarkLibrary::Instance()->findDefectMap(darkData->filename(), darkDefectMap))
+        {
+            subtractAndNormalize(darkData, darkDefectMap, info.targetData, info.offsetX, info.offsetY);
+            qCDebug(KSTARS_EKOS) << "Dark frame subtraction and defect map denoising applied";
+            return true;
+        }
+
         subtractDarkData(darkData, info.targetData, info.offsetX, info.offsetY);
         qCDebug(KSTARS_EKOS) << "Dark frame subtraction applied";
         return true;
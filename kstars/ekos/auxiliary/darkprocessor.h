@@ -28,7 +28,8 @@ namespace Ekos
  * The primary denoise function searches first for defect maps that matches the criteria of the passed parameters.
  * These include sensor binning, size, temperature, and date. If a defect map is found, then it is loaded from disk and all the bad
  * pixels are treated with a 3x3 median filter. If no defect map is found, it searches for suitable dark frames and if any is found then
- * a simple subtraction is applied.
+ * a simple subtraction is applied. If both are preferred and the dark frame has a defect map, its bad pixels are treated in the same
+ * pass over the light frame as the subtraction.
  *
  * @author Jasem Mutlaq
  * @version 1.0
@@ -47,7 +48,7 @@ class DarkProcessor : public QObject
     private:
 
         // Denoise Internal
-        bool denoiseInternal(bool useDefect);
+        bool denoiseInternal(bool useDefect, bool useBoth);
         void processDenoiseResult();
 
         ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -97,6 +98,41 @@ class DarkProcessor : public QObject
         template <typename T>
         T median3x3Filter(uint16_t x, uint16_t y, uint32_t width, T *buffer);
 
+        /**
+        * @brief median3x3Filter Median of the 8 neighbors of many pixels at once.
+        * @param buffer Frame buffer.
+        * @param width Width of the frame.
+        * @param offsets Offsets of the pixels in the frame, none of them on its border.
+        * @param count Number of pixels.
+        * @param medians Set to the median around each pixel.
+        */
+        template <typename T>
+        void median3x3Filter(const T *buffer, uint32_t width, const uint32_t *offsets, uint32_t count, T *medians);
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////
+        /// Combined Functions
+        ////////////////////////////////////////////////////////////////////////////////////////////////
+
+        /**
+        * @brief subtractAndNormalize Calls templated subtractAndNormalizeInternal function
+        */
+        void subtractAndNormalize(const QSharedPointer<FITSData> &darkData, const QSharedPointer<DefectMap> &defectMap,
+                                  const QSharedPointer<FITSData> &lightData, uint16_t offsetX, uint16_t offsetY);
+
+        /**
+        * @brief subtractAndNormalizeInternal Subtracts dark pixels from light pixels and replaces the bad pixels of the
+        * defect map with a 3x3 median filter of the subtracted pixels around them, in one pass over the light frame.
+        * As with normalizeDefectsInternal, the medians are taken before any bad pixel is replaced.
+        * @param darkData Dark frame data.
+        * @param defectMap Defect Map containing a list of hot and cold pixels.
+        * @param lightData Light frame data. The light frame data is modified in this process.
+        * @param offsetX Only apply beyond offsetX in X-axis.
+        * @param offsetY Only apply beyond offsetY in Y-axis.
+        */
+        template <typename T>
+        void subtractAndNormalizeInternal(const QSharedPointer<FITSData> &darkData, const QSharedPointer<DefectMap> &defectMap,
+                                          const QSharedPointer<FITSData> &lightData, uint16_t offsetX, uint16_t offsetY);
+
     signals:
         void darkFrameCompleted(bool);
         void newLog(const QString &message);
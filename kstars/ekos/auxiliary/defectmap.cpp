@@ -6,6 +6,7 @@
 
 #include "defectmap.h"
 #include <QJsonDocument>
+#include <algorithm>
 
 //////////////////////////////////////////////////////////////////////////////
 ///
@@ -58,6 +59,7 @@ bool DefectMap::load(const QString &filename)
 
     m_HotPixels.clear();
     m_ColdPixels.clear();
+    clearOffsets();
 
     for (const auto &onePixel : qAsConst(hot))
     {
@@ -167,6 +169,7 @@ void DefectMap::initBadPixels()
 
     m_ColdPixels.clear();
     m_HotPixels.clear();
+    clearOffsets();
 
     switch (m_DarkData->dataType())
     {
@@ -253,6 +256,7 @@ void DefectMap::filterPixels()
 
     m_HotPixelsThreshold = m_HotPixels.lower_bound(BadPixel(0, 0, hotPixelThreshold));
     m_ColdPixelsThreshold = m_ColdPixels.lower_bound(BadPixel(0, 0, coldPixelThreshold));
+    clearOffsets();
 
     if (m_HotPixelsThreshold == m_HotPixels.cend())
         m_HotPixelsCount = 0;
@@ -273,6 +277,7 @@ void DefectMap::filterPixels()
 void DefectMap::setHotEnabled(bool enabled)
 {
     m_HotEnabled = enabled;
+    clearOffsets();
     emit pixelsUpdated(m_HotEnabled ? m_HotPixelsCount : 0, m_ColdPixelsCount);
 }
 
@@ -282,5 +287,62 @@ void DefectMap::setHotEnabled(bool enabled)
 void DefectMap::setColdEnabled(bool enabled)
 {
     m_ColdEnabled = enabled;
+    clearOffsets();
     emit pixelsUpdated(m_HotPixelsCount, m_ColdEnabled ? m_ColdPixelsCount : 0);
 }
+
+//////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////
+QSharedPointer<const std::vector<uint32_t>> DefectMap::offsets(uint32_t width, uint32_t height, uint16_t offsetX,
+        uint16_t offsetY)
+{
+    QMutexLocker locker(&m_OffsetsMutex);
+
+    if (m_Offsets && m_OffsetsWidth == width && m_OffsetsHeight == height && m_OffsetsX == offsetX && m_OffsetsY == offsetY)
+        return m_Offsets;
+
+    QSharedPointer<std::vector<uint32_t>> offsets(new std::vector<uint32_t>());
+    offsets->reserve((m_HotEnabled ? m_HotPixelsCount : 0) + (m_ColdEnabled ? m_ColdPixelsCount : 0));
+
+    // Account for offset X and Y
+    // e.g. if we send a subframed light frame 100x100 pixels wide
+    // but the source defect map covers 1000x1000 pixels array, then we need to only compensate
+    // for the 100x100 region.
+    auto addPixel = [&](const BadPixel & onePixel)
+    {
+        if (onePixel.x <= offsetX || onePixel.y <= offsetY)
+            return;
+
+        const uint32_t x = onePixel.x - offsetX;
+        const uint32_t y = onePixel.y - offsetY;
+        if (x + 1 >= width || y + 1 >= height)
+            return;
+
+        offsets->push_back(x + y * width);
+    };
+
+    for (auto onePixel = hotThreshold(); onePixel != m_HotPixels.cend(); ++onePixel)
+        addPixel(*onePixel);
+    for (auto onePixel = m_ColdPixels.cbegin(); onePixel != coldThreshold(); ++onePixel)
+        addPixel(*onePixel);
+
+    std::sort(offsets->begin(), offsets->end());
+    offsets->erase(std::unique(offsets->begin(), offsets->end()), offsets->end());
+
+    m_Offsets = offsets;
+    m_OffsetsWidth = width;
+    m_OffsetsHeight = height;
+    m_OffsetsX = offsetX;
+    m_OffsetsY = offsetY;
+    return m_Offsets;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////
+void DefectMap::clearOffsets()
+{
+    QMutexLocker locker(&m_OffsetsMutex);
+    m_Offsets.clear();
+}
@@ -7,8 +7,10 @@
 #pragma once
 
 #include <set>
+#include <vector>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QMutex>
 
 #include "fitsviewer/fitsdata.h"
 
@@ -90,6 +92,18 @@ class DefectMap : public QObject
             return m_ColdPixelsCount;
         }
 
+        /**
+         * @brief offsets Compile the enabled hot and cold pixels past the current thresholds into a sorted array of
+         * offsets into a frame. The array is kept until the thresholds or the frame geometry change.
+         * @param width width of the frame.
+         * @param height height of the frame.
+         * @param offsetX X position of the frame on the sensor, if subframed.
+         * @param offsetY Y position of the frame on the sensor, if subframed.
+         * @return offsets of the bad pixels in the frame, leaving out those on its border which have no 3x3 neighborhood.
+         */
+        QSharedPointer<const std::vector<uint32_t>> offsets(uint32_t width, uint32_t height, uint16_t offsetX,
+                uint16_t offsetY);
+
         void filterPixels();
     signals:
         //        void hotPixelsUpdated(const BadPixelSet::const_iterator &start, const BadPixelSet::const_iterator &end);
@@ -102,6 +116,7 @@ class DefectMap : public QObject
         double calculateSigma(uint8_t aggressiveness);
         template <typename T>
         void initBadPixelsInternal(double hotPixelThreshold, double coldPixelThreshold);
+        void clearOffsets();
 
         BadPixelSet m_ColdPixels, m_HotPixels;
         BadPixelSet::const_iterator m_ColdPixelsThreshold, m_HotPixelsThreshold;
@@ -114,5 +129,11 @@ class DefectMap : public QObject
 
         QSharedPointer<FITSData> m_DarkData;
 
+        // Compiled offsets of the bad pixels and the frame geometry they are for
+        QMutex m_OffsetsMutex;
+        QSharedPointer<const std::vector<uint32_t>> m_Offsets;
+        uint32_t m_OffsetsWidth {0}, m_OffsetsHeight {0};
+        uint16_t m_OffsetsX {0}, m_OffsetsY {0};
+
 };
 
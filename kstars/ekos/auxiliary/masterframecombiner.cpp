@@ -0,0 +1,299 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "masterframecombiner.h"
+
+#include "ekos_debug.h"
+
+#include <QDir>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+namespace Ekos
+{
+
+namespace
+{
+// Values converted and written to the scratch file at once
+constexpr uint32_t CHUNK_SIZE = 1 << 20;
+// Values per job of the worker threads
+constexpr uint32_t BLOCK_SIZE = 1 << 16;
+// The standard deviation of a normal distribution is 1.4826 times its median absolute deviation
+constexpr double MAD_TO_SIGMA = 1.4826;
+
+struct Range
+{
+    uint32_t begin;
+    uint32_t end;
+};
+
+// Call function on ranges of [0, count) spread over the worker threads
+template <typename F>
+void parallelFor(uint32_t count, F function)
+{
+    std::vector<Range> ranges;
+    ranges.reserve(count / BLOCK_SIZE + 1);
+    for (uint32_t begin = 0; begin < count; begin += BLOCK_SIZE)
+        ranges.push_back({ begin, std::min(begin + BLOCK_SIZE, count) });
+
+    if (ranges.size() == 1)
+        function(ranges.front());
+    else
+        QtConcurrent::blockingMap(ranges, function);
+}
+
+template <typename T>
+T toType(double value)
+{
+    if constexpr (std::is_integral<T>::value)
+    {
+        value = std::round(value);
+        value = std::max(value, static_cast<double>(std::numeric_limits<T>::lowest()));
+        value = std::min(value, static_cast<double>(std::numeric_limits<T>::max()));
+    }
+    return static_cast<T>(value);
+}
+}
+
+void MasterFrameCombiner::reset(uint32_t elements)
+{
+    closeSpill();
+    m_Elements = elements;
+    m_Count = 0;
+    m_Rejected = 0;
+    m_ReferenceMean = 0;
+    m_Sum.assign(elements, 0);
+}
+
+void MasterFrameCombiner::setRejection(double sigmaLow, double sigmaHigh, int iterations)
+{
+    m_SigmaLow = sigmaLow;
+    m_SigmaHigh = sigmaHigh;
+    m_Iterations = iterations;
+}
+
+bool MasterFrameCombiner::openSpill()
+{
+    m_Spill.reset(new QTemporaryFile(QDir::tempPath() + "/kstars_master_XXXXXX.raw"));
+    if (!m_Spill->open())
+    {
+        qCWarning(KSTARS_EKOS) << "Unable to create master frame scratch file:" << m_Spill->errorString();
+        m_Spill.reset();
+        return false;
+    }
+    return true;
+}
+
+void MasterFrameCombiner::closeSpill()
+{
+    // QTemporaryFile removes the file from disk when destroyed
+    m_Spill.reset();
+}
+
+template <typename T>
+void MasterFrameCombiner::add(const T *frame)
+{
+    if (m_Elements == 0)
+        return;
+
+    double scale = 1.0;
+    if (m_Scaling == MultiplicativeScaling)
+    {
+        double sum = 0;
+        for (uint32_t i = 0; i < m_Elements; i++)
+            sum += frame[i];
+        const double mean = sum / m_Elements;
+        if (m_Count == 0)
+            m_ReferenceMean = mean;
+        if (mean > 0)
+            scale = m_ReferenceMean / mean;
+    }
+
+    // Spill the frames only while they can all be read back
+    if (m_Count == 0)
+        openSpill();
+    else if (m_Spill && m_Spill->size() != static_cast<qint64>(m_Count) * m_Elements * sizeof(float))
+        closeSpill();
+
+    std::vector<float> chunk(std::min(CHUNK_SIZE, m_Elements));
+    for (uint32_t begin = 0; begin < m_Elements; begin += CHUNK_SIZE)
+    {
+        const uint32_t size = std::min(CHUNK_SIZE, m_Elements - begin);
+        const T *source = frame + begin;
+        float *sum = m_Sum.data() + begin;
+        float *values = chunk.data();
+
+        parallelFor(size, [ = ](const Range & range)
+        {
+            for (uint32_t i = range.begin; i < range.end; i++)
+            {
+                values[i] = static_cast<float>(source[i] * scale);
+                sum[i] += values[i];
+            }
+        });
+
+        if (m_Spill)
+        {
+            const qint64 bytes = static_cast<qint64>(size) * sizeof(float);
+            if (m_Spill->write(reinterpret_cast<const char *>(values), bytes) != bytes)
+            {
+                qCWarning(KSTARS_EKOS) << "Unable to write master frame scratch file, frames will be averaged:" <<
+                                       m_Spill->errorString();
+                closeSpill();
+            }
+        }
+    }
+
+    m_Count++;
+}
+
+template <typename T>
+void MasterFrameCombiner::combine(T *master)
+{
+    m_Rejected = 0;
+    if (m_Count == 0)
+        return;
+
+    const uint32_t count = m_Count;
+    const bool reject = m_Spill && m_Spill->flush() && count >= MIN_REJECTION_FRAMES && m_Iterations > 0;
+
+    if (reject)
+    {
+        // Integer frames are quantized, so many frames may have the same value and a median absolute
+        // deviation of 0. Half a unit keeps values one unit away from the median.
+        const double minSigma = std::is_integral<T>::value ? 0.5 : 0;
+        const qint64 frameBytes = static_cast<qint64>(m_Elements) * sizeof(float);
+        const uint32_t band = static_cast<uint32_t>(std::max<qint64>(BLOCK_SIZE, std::min<qint64>(m_Elements,
+                              m_MemoryBudget / (static_cast<qint64>(count) * sizeof(float)))));
+
+        for (uint32_t begin = 0; begin < m_Elements; begin += band)
+        {
+            const uint32_t size = std::min(band, m_Elements - begin);
+
+            std::vector<const float *> frames(count, nullptr);
+            bool mapped = true;
+            for (uint32_t f = 0; f < count && mapped; f++)
+            {
+                uchar *data = m_Spill->map(f * frameBytes + static_cast<qint64>(begin) * sizeof(float),
+                                           static_cast<qint64>(size) * sizeof(float));
+                frames[f] = reinterpret_cast<const float *>(data);
+                mapped = data != nullptr;
+            }
+
+            if (mapped)
+            {
+                std::atomic<uint64_t> rejected { 0 };
+                parallelFor(size, [&](const Range & range)
+                {
+                    std::vector<float> values(count), scratch(count);
+                    uint32_t rangeRejected = 0;
+                    for (uint32_t i = range.begin; i < range.end; i++)
+                    {
+                        for (uint32_t f = 0; f < count; f++)
+                            values[f] = frames[f][i];
+                        master[begin + i] = toType<T>(clippedMean(values.data(), scratch.data(), count, minSigma,
+                                                      &rangeRejected));
+                    }
+                    rejected += rangeRejected;
+                });
+                m_Rejected += rejected;
+            }
+            else
+            {
+                qCWarning(KSTARS_EKOS) << "Unable to map master frame scratch file, averaging frames:" << m_Spill->errorString();
+                for (uint32_t i = 0; i < size; i++)
+                    master[begin + i] = toType<T>(static_cast<double>(m_Sum[begin + i]) / count);
+            }
+
+            for (const float *frame : frames)
+            {
+                if (frame)
+                    m_Spill->unmap(reinterpret_cast<uchar *>(const_cast<float *>(frame)));
+            }
+        }
+    }
+    else
+    {
+        const float *sum = m_Sum.data();
+        parallelFor(m_Elements, [ = ](const Range & range)
+        {
+            for (uint32_t i = range.begin; i < range.end; i++)
+                master[i] = toType<T>(static_cast<double>(sum[i]) / count);
+        });
+    }
+
+    qCDebug(KSTARS_EKOS) << "Combined" << count << "frames into a master frame," << m_Rejected << "values rejected.";
+}
+
+double MasterFrameCombiner::clippedMean(float *values, float *scratch, uint32_t count, double minSigma,
+                                        uint32_t *rejected) const
+{
+    uint32_t kept = count;
+    for (int iteration = 0; iteration < m_Iterations && kept >= MIN_REJECTION_FRAMES; iteration++)
+    {
+        // The median and the median absolute deviation are not pulled by the outliers, unlike the
+        // mean and the standard deviation.
+        std::nth_element(values, values + kept / 2, values + kept);
+        const double median = values[kept / 2];
+
+        for (uint32_t i = 0; i < kept; i++)
+            scratch[i] = std::fabs(values[i] - median);
+        std::nth_element(scratch, scratch + kept / 2, scratch + kept);
+        double sigma = std::max(MAD_TO_SIGMA * scratch[kept / 2], minSigma);
+        if (sigma <= 0)
+        {
+            // Most values equal the median. Float frames of camera counts are as quantized as integer
+            // ones, so they get the same half unit. Otherwise all the values off the median are rejected.
+            const bool whole = std::all_of(values, values + kept, [](float value)
+            {
+                return std::floor(value) == value;
+            });
+            sigma = whole ? 0.5 : 0;
+        }
+
+        const double low = median - m_SigmaLow * sigma;
+        const double high = median + m_SigmaHigh * sigma;
+        uint32_t inside = 0;
+        for (uint32_t i = 0; i < kept; i++)
+        {
+            if (values[i] >= low && values[i] <= high)
+                values[inside++] = values[i];
+        }
+
+        if (inside == kept)
+            break;
+        *rejected += kept - inside;
+        kept = inside;
+    }
+
+    double sum = 0;
+    for (uint32_t i = 0; i < kept; i++)
+        sum += values[i];
+    return sum / kept;
+}
+
+template void MasterFrameCombiner::add<uint8_t>(const uint8_t *frame);
+template void MasterFrameCombiner::add<int16_t>(const int16_t *frame);
+template void MasterFrameCombiner::add<uint16_t>(const uint16_t *frame);
+template void MasterFrameCombiner::add<int32_t>(const int32_t *frame);
+template void MasterFrameCombiner::add<uint32_t>(const uint32_t *frame);
+template void MasterFrameCombiner::add<float>(const float *frame);
+template void MasterFrameCombiner::add<int64_t>(const int64_t *frame);
+template void MasterFrameCombiner::add<double>(const double *frame);
+
+template void MasterFrameCombiner::combine<uint8_t>(uint8_t *master);
+template void MasterFrameCombiner::combine<int16_t>(int16_t *master);
+template void MasterFrameCombiner::combine<uint16_t>(uint16_t *master);
+template void MasterFrameCombiner::combine<int32_t>(int32_t *master);
+template void MasterFrameCombiner::combine<uint32_t>(uint32_t *master);
+template void MasterFrameCombiner::combine<float>(float *master);
+template void MasterFrameCombiner::combine<int64_t>(int64_t *master);
+template void MasterFrameCombiner::combine<double>(double *master);
+
+}
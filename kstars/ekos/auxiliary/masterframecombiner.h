@@ -0,0 +1,119 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QSharedPointer>
+#include <QTemporaryFile>
+
+#include <cstdint>
+#include <vector>
+
+namespace Ekos
+{
+
+/**
+ * @class MasterFrameCombiner
+ * @short Combines dark, bias or flat frames into a master frame with per pixel outlier rejection.
+ *
+ * Frames are streamed in as they are captured: each one is converted to float, added to a running
+ * sum and appended to a scratch file, so only one frame is held in memory whatever the number of
+ * frames. When the master is made, the scratch file is memory mapped back in bands of pixels sized
+ * to the memory budget, and the values of each pixel across all frames are sigma clipped around
+ * their median, with the sigma estimated from the median absolute deviation so that a cosmic ray
+ * or a satellite trail in a single frame is rejected even from a handful of frames. The mean of
+ * the remaining values is the master value.
+ *
+ * Frames are converted and clipped over bands of pixels spread over worker threads. If the scratch
+ * file can't be written, or there are too few frames to reject anything, the master is the average
+ * of the frames.
+ */
+class MasterFrameCombiner
+{
+    public:
+        enum Scaling
+        {
+            /** Darks and biases are combined as they are */
+            NoScaling,
+            /** Flats are scaled to the mean of the first frame before they are combined */
+            MultiplicativeScaling
+        };
+
+        /**
+         * @brief reset Drop all frames and get ready for frames of a given size.
+         * @param elements number of values in a frame, all channels included.
+         */
+        void reset(uint32_t elements);
+
+        /**
+         * @brief setRejection Set the outlier rejection.
+         * @param sigmaLow values below the median by more than sigmaLow standard deviations are rejected.
+         * @param sigmaHigh values above the median by more than sigmaHigh standard deviations are rejected.
+         * @param iterations number of rejection passes, 0 to average the frames.
+         */
+        void setRejection(double sigmaLow, double sigmaHigh, int iterations);
+
+        void setScaling(Scaling scaling)
+        {
+            m_Scaling = scaling;
+        }
+
+        /** @brief setMemoryBudget Bytes of frame values mapped at once while combining. */
+        void setMemoryBudget(qint64 bytes)
+        {
+            m_MemoryBudget = bytes;
+        }
+
+        /** @brief add Add a frame of elements() values. */
+        template <typename T> void add(const T *frame);
+
+        /**
+         * @brief combine Make the master frame from the frames added so far. The frames are kept until reset().
+         * @param master buffer of elements() values to write the master to.
+         */
+        template <typename T> void combine(T *master);
+
+        uint32_t elements() const
+        {
+            return m_Elements;
+        }
+        uint32_t count() const
+        {
+            return m_Count;
+        }
+        /** @return number of values rejected by the last combine() */
+        uint64_t rejected() const
+        {
+            return m_Rejected;
+        }
+
+    private:
+        // Clipped mean of the values of one pixel across the frames. values is reordered, scratch is
+        // working space of the same size.
+        double clippedMean(float *values, float *scratch, uint32_t count, double minSigma, uint32_t *rejected) const;
+        bool openSpill();
+        void closeSpill();
+
+        // Fewer frames than this are averaged
+        static constexpr uint32_t MIN_REJECTION_FRAMES = 3;
+
+        uint32_t m_Elements { 0 };
+        uint32_t m_Count { 0 };
+        uint64_t m_Rejected { 0 };
+
+        double m_SigmaLow { 3.0 };
+        double m_SigmaHigh { 3.0 };
+        int m_Iterations { 3 };
+        Scaling m_Scaling { NoScaling };
+        qint64 m_MemoryBudget { 256 * 1024 * 1024 };
+
+        // Mean of the first frame, flats are scaled to it
+        double m_ReferenceMean { 0 };
+        // Running sum of the frames, the master if they can't be clipped
+        std::vector<float> m_Sum;
+        // Frames as float, one after the other
+        QSharedPointer<QTemporaryFile> m_Spill;
+};
+
+}
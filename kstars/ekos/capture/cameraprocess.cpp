@@ -1047,6 +1047,13 @@ bool Ekos::CameraProcess::checkSavingReceivedImage(const QSharedPointer<FITSData
             {
                 data->setFilename(filename);
                 KStars::Instance()->statusBar()->showMessage(i18n("file saved to %1", filename), 0);
+
+                // Report when storage can't keep up with the camera
+                const auto writes = activeCamera()->imageWriteStatistics();
+                if (writes.lastStallTime >= 1)
+                    qCInfo(KSTARS_EKOS_CAPTURE) << "Saving" << filename << "waited" << writes.lastStallTime
+                                                << "ms for earlier images to be written. Pending:" << writes.pending
+                                                << "Write rate:" << writes.throughput << "MiB/s";
                 return true;
             }
             else
@@ -1407,6 +1414,10 @@ void CameraProcess::processJobCompletion2()
         KSNotification::event(QLatin1String("CaptureSuccessful"), i18n("Camera capture sequence completed"),
                               KSNotification::Capture);
 
+        // The images of the sequence are written in the background, make sure they reach storage
+        if (activeCamera())
+            activeCamera()->syncImageFiles();
+
         emit stopCapture(CAPTURE_COMPLETE);
 
         //Resume guiding if it was suspended before
@@ -2202,6 +2213,9 @@ void CameraProcess::processCaptureError(ISD::Camera::ErrorType type)
     }
     else
     {
+        // Images are written in the background, so failures to save them are reported here
+        if (type == ISD::Camera::ERROR_SAVE)
+            emit newLog(i18n("Failed writing image. Please check folder, filename & permissions."));
         emit stopCapture(CAPTURE_ABORTED);
     }
 }
@@ -190,6 +190,11 @@ enum COMMANDS
     // Storage Options
     SET_BLOBS,
 
+    // Media streaming
+    MEDIA_SET_STREAMING,
+    MEDIA_SET_VIEWPORT,
+    MEDIA_STREAM_STATS,
+
     // DSLRs
     DSLR_GET_INFO,
     DSLR_SET_INFO,
@@ -417,6 +422,10 @@ static QMap<COMMANDS, QString> const commands =
 
     {SET_BLOBS, "set_blobs"},
 
+    {MEDIA_SET_STREAMING, "media_set_streaming"},
+    {MEDIA_SET_VIEWPORT, "media_set_viewport"},
+    {MEDIA_STREAM_STATS, "media_stream_stats"},
+
     {DSLR_GET_INFO, "dslr_get_info"},
     {DSLR_SET_INFO, "dslr_set_info"},
     {DSLR_SET_MODE, "dslr_set_mode"},
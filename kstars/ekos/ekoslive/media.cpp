@@ -8,6 +8,7 @@
 
 #include "media.h"
 #include "commands.h"
+#include "previewstream.h"
 #include "skymapcomposite.h"
 #include "fitsviewer/fitsview.h"
 #include "fitsviewer/fitsdata.h"
@@ -30,6 +31,7 @@
 #include <QtConcurrent>
 #include <KFormat>
 #include <QImageWriter>
+#include <QJsonArray>
 
 namespace EkosLive
 {
@@ -52,6 +54,48 @@ Media::Media(Ekos::Manager * manager, QVector<QSharedPointer<NodeManager>> &node
     {
         uploadImage(image, uuid);
     });
+
+    m_PreviewStream = new PreviewStream(METADATA_PACKET);
+    m_PreviewStream->moveToThread(&m_StreamThread);
+    connect(&m_StreamThread, &QThread::finished, m_PreviewStream, &QObject::deleteLater);
+    connect(m_PreviewStream, &PreviewStream::newPacket, this, &Media::uploadImage);
+    connect(m_PreviewStream, &PreviewStream::newStatistics, this, [this](const QJsonObject & statistics)
+    {
+        sendResponse(commands[MEDIA_STREAM_STATS], statistics);
+    });
+    m_StreamThread.setObjectName("EkosLive Preview Stream");
+    m_StreamThread.start();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////////
+Media::~Media()
+{
+    m_StreamThread.quit();
+    m_StreamThread.wait();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////////
+void Media::sendResponse(const QString &command, const QJsonObject &payload)
+{
+    for (auto &nodeManager : m_NodeManagers)
+    {
+        nodeManager->media()->sendResponse(command, payload);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////////
+void Media::sendResponse(const QString &command, const QJsonArray &payload)
+{
+    for (auto &nodeManager : m_NodeManagers)
+    {
+        nodeManager->media()->sendResponse(command, payload);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -140,6 +184,34 @@ void Media::onTextReceived(const QString &message)
         extension = payload["ext"].toString();
     else if (command == commands[SET_BLOBS])
         m_sendBlobs = msgObj["payload"].toBool();
+    // Send previews as a base layer and viewport tiles instead of whole images
+    else if (command == commands[MEDIA_SET_STREAMING])
+    {
+        m_Streaming = payload["enabled"].toBool();
+        const QString format = payload["format"].toString("jpg");
+        QMetaObject::invokeMethod(m_PreviewStream, [this, format]()
+        {
+            m_PreviewStream->reset();
+            m_PreviewStream->setFormat(format);
+        }, Qt::QueuedConnection);
+
+        QJsonObject response =
+        {
+            {"enabled", m_Streaming.load()},
+            {"formats", QJsonArray::fromStringList(PreviewStream::availableFormats())}
+        };
+        sendResponse(commands[MEDIA_SET_STREAMING], response);
+    }
+    else if (command == commands[MEDIA_SET_VIEWPORT])
+    {
+        const QString uuid = payload["uuid"].toString();
+        const QRectF viewport(payload["x"].toDouble(0), payload["y"].toDouble(0),
+                              payload["w"].toDouble(1), payload["h"].toDouble(1));
+        QMetaObject::invokeMethod(m_PreviewStream, [this, uuid, viewport]()
+        {
+            m_PreviewStream->setViewport(uuid, viewport);
+        }, Qt::QueuedConnection);
+    }
     // Get a list of object based on criteria
     else if (command == commands[ASTRO_GET_OBJECTS_IMAGE])
     {
@@ -359,6 +431,12 @@ void Media::stretch(const QSharedPointer<FITSData> &data, QImage &image, Stretch
     auto channels = data->channels();
     auto dataType = data->dataType();
 
+    // Only a preview at most HB_IMAGE_WIDTH wide is sent, so the image is stretched at the coarsest
+    // sampling that still leaves it at least that wide, rather than at full resolution.
+    const int sampling = std::max(1, static_cast<int>(width / HB_IMAGE_WIDTH));
+    const int imageWidth = (width + sampling - 1) / sampling;
+    const int imageHeight = (height + sampling - 1) / sampling;
+
     if (min == max)
     {
         image.fill(Qt::white);
@@ -366,7 +444,7 @@ void Media::stretch(const QSharedPointer<FITSData> &data, QImage &image, Stretch
 
     if (channels == 1)
     {
-        image = QImage(width, height, QImage::Format_Indexed8);
+        image = QImage(imageWidth, imageHeight, QImage::Format_Indexed8);
 
         image.setColorCount(256);
         for (int i = 0; i < 256; i++)
@@ -374,7 +452,7 @@ void Media::stretch(const QSharedPointer<FITSData> &data, QImage &image, Stretch
     }
     else
     {
-        image = QImage(width, height, QImage::Format_RGB32);
+        image = QImage(imageWidth, imageHeight, QImage::Format_RGB32);
     }
 
     Stretch stretch(width, height, channels, dataType);
@@ -382,7 +460,7 @@ void Media::stretch(const QSharedPointer<FITSData> &data, QImage &image, Stretch
     // Compute new auto-stretch params.
     params = stretch.computeParams(data->getImageBuffer());
     stretch.setParams(params);
-    stretch.run(data->getImageBuffer(), &image, 1);
+    stretch.run(data->getImageBuffer(), &image, sampling);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////
@@ -444,6 +522,15 @@ void Media::upload(const QSharedPointer<FITSView> &view, const QString &uuid)
         {"ext", ext}
     };
 
+    auto fastImage = (!Options::ekosLiveHighBandwidth() || uuid[0] == '+');
+    auto scaleWidth = fastImage ? HB_IMAGE_WIDTH / 2 : HB_IMAGE_WIDTH;
+
+    if (m_Streaming)
+    {
+        stream(view->getScaledDisplayImage(HB_IMAGE_WIDTH), uuid, metadata);
+        return;
+    }
+
     // First METADATA_PACKET bytes of the binary data is always allocated
     // to the metadata
     // the rest to the image data.
@@ -451,14 +538,9 @@ void Media::upload(const QSharedPointer<FITSView> &view, const QString &uuid)
     meta = meta.leftJustified(METADATA_PACKET, 0);
     buffer.write(meta);
 
-    auto fastImage = (!Options::ekosLiveHighBandwidth() || uuid[0] == '+');
-    auto scaleWidth = fastImage ? HB_IMAGE_WIDTH / 2 : HB_IMAGE_WIDTH;
-
     // For low bandwidth images
     // Except for dark frames +D
-    QPixmap scaledImage = view->getDisplayPixmap().width() > scaleWidth ?
-                          view->getDisplayPixmap().scaledToWidth(scaleWidth, fastImage ? Qt::FastTransformation : Qt::SmoothTransformation) :
-                          view->getDisplayPixmap();
+    QImage scaledImage = view->getScaledDisplayImage(scaleWidth, fastImage ? Qt::FastTransformation : Qt::SmoothTransformation);
     scaledImage.save(&buffer, ext.toLatin1().constData(), HB_IMAGE_QUALITY);
 
     buffer.close();
@@ -518,6 +600,16 @@ void Media::upload(const QSharedPointer<FITSData> &data, const QImage &image, co
         {"ext", ext}
     };
 
+    auto fastImage = (!Options::ekosLiveHighBandwidth() || uuid[0] == '+');
+    auto scaleWidth = fastImage ? HB_IMAGE_WIDTH / 2 : HB_IMAGE_WIDTH;
+
+    if (m_Streaming)
+    {
+        stream(image.width() > HB_IMAGE_WIDTH ? image.scaledToWidth(HB_IMAGE_WIDTH, Qt::SmoothTransformation) : image,
+               uuid, metadata);
+        return;
+    }
+
     // First METADATA_PACKET bytes of the binary data is always allocated
     // to the metadata
     // the rest to the image data.
@@ -525,9 +617,6 @@ void Media::upload(const QSharedPointer<FITSData> &data, const QImage &image, co
     meta = meta.leftJustified(METADATA_PACKET, 0);
     buffer.write(meta);
 
-    auto fastImage = (!Options::ekosLiveHighBandwidth() || uuid[0] == '+');
-    auto scaleWidth = fastImage ? HB_IMAGE_WIDTH / 2 : HB_IMAGE_WIDTH;
-
     // For low bandwidth images
     // Except for dark frames +D
     QImage scaledImage = image.width() > scaleWidth ?
@@ -627,11 +716,16 @@ void Media::sendUpdatedFrame(const QSharedPointer<FITSView> &view)
 
         scaledImage = scaledImage.copy(boundingRectable);
     }
+    // Whole frames can be streamed, only sending the tiles which changed since the last frame
+    else if (m_Streaming)
+    {
+        emit newBoundingRect(QRect(), QSize(), 100);
+        stream(view->getScaledDisplayImage(HB_IMAGE_WIDTH), "+A", metadata);
+        return;
+    }
     else
     {
-        scaledImage = view->getDisplayPixmap().width() > HB_IMAGE_WIDTH / 2 ?
-                      view->getDisplayPixmap().scaledToWidth(HB_IMAGE_WIDTH / 2, Qt::FastTransformation) :
-                      view->getDisplayPixmap();
+        scaledImage = QPixmap::fromImage(view->getScaledDisplayImage(HB_IMAGE_WIDTH / 2, Qt::FastTransformation));
         emit newBoundingRect(QRect(), QSize(), 100);
     }
 
@@ -640,6 +734,18 @@ void Media::sendUpdatedFrame(const QSharedPointer<FITSView> &view)
     emit newImage(jpegData, "+A");
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////
+///
+///////////////////////////////////////////////////////////////////////////////////////////
+void Media::stream(const QImage &image, const QString &uuid, const QJsonObject &metadata)
+{
+    // Streamed previews are always sent at full width, only the tiles the client views are refined
+    QMetaObject::invokeMethod(m_PreviewStream, [this, image, uuid, metadata]()
+    {
+        m_PreviewStream->encode(image, uuid, metadata);
+    }, Qt::QueuedConnection);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 ///
 ///////////////////////////////////////////////////////////////////////////////////////////
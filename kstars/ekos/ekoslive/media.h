@@ -9,6 +9,8 @@
 #pragma once
 
 #include <QtWebSockets/QWebSocket>
+#include <QThread>
+#include <atomic>
 #include <memory>
 
 #include "ekos/manager.h"
@@ -18,13 +20,15 @@ class FITSView;
 
 namespace EkosLive
 {
+class PreviewStream;
+
 class Media : public QObject
 {
         Q_OBJECT
 
     public:
         explicit Media(Ekos::Manager * manager, QVector<QSharedPointer<NodeManager>> &nodeManagers);
-        virtual ~Media() = default;
+        virtual ~Media();
 
         bool isConnected() const;
         void sendResponse(const QString &command, const QJsonObject &payload);
@@ -83,6 +87,8 @@ class Media : public QObject
 
         void upload(const QSharedPointer<FITSData> &data, const QImage &image, const StretchParams &params, const QString &uuid);
         void stretch(const QSharedPointer<FITSData> &data, QImage &image, StretchParams &params) const;
+        // Hand a preview to the stream encoder, when the client asked for streaming
+        void stream(const QImage &image, const QString &uuid, const QJsonObject &metadata);
 
         Ekos::Manager * m_Manager { nullptr };
         QVector<QSharedPointer<NodeManager>> m_NodeManagers;
@@ -92,6 +98,11 @@ class Media : public QObject
 
         bool m_sendBlobs { true};
 
+        // Progressive preview streaming, encoded on its own thread
+        std::atomic<bool> m_Streaming { false };
+        QThread m_StreamThread;
+        PreviewStream *m_PreviewStream { nullptr };
+
         // Image width for high-bandwidth setting
         static const uint16_t HB_IMAGE_WIDTH = 1920;
         // Video width for high-bandwidth setting
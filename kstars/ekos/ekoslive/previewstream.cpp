@@ -0,0 +1,219 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "previewstream.h"
+
+#include "ekos_debug.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+
+namespace EkosLive
+{
+
+PreviewStream::PreviewStream(uint16_t metadataSize, QObject *parent) : QObject(parent), m_MetadataSize(metadataSize)
+{
+    m_Writer.setFormat(m_Format.toLatin1());
+}
+
+QStringList PreviewStream::availableFormats()
+{
+    const auto supported = QImageWriter::supportedImageFormats();
+    QStringList formats;
+    for (const QString format : {"webp", "jxl", "jpg"})
+    {
+        if (supported.contains(format.toLatin1()))
+            formats << format;
+    }
+    return formats;
+}
+
+void PreviewStream::setFormat(const QString &format)
+{
+    const QString selected = availableFormats().contains(format) ? format : QString("jpg");
+    if (selected == m_Format)
+        return;
+
+    if (selected != format)
+        qCWarning(KSTARS_EKOS) << "Image format" << format << "is not available for streaming, using" << selected;
+
+    m_Format = selected;
+    m_Writer.setFormat(m_Format.toLatin1());
+    // The client can't mix tiles of different formats
+    reset();
+}
+
+void PreviewStream::reset()
+{
+    m_Previews.clear();
+}
+
+QVector<QRect> PreviewStream::tileRects(const QSize &size) const
+{
+    QVector<QRect> rects;
+    for (int y = 0; y < size.height(); y += TILE_SIZE)
+        for (int x = 0; x < size.width(); x += TILE_SIZE)
+            rects.append(QRect(x, y, std::min(TILE_SIZE, size.width() - x), std::min(TILE_SIZE, size.height() - y)));
+    return rects;
+}
+
+quint64 PreviewStream::hashTile(const QImage &image, const QRect &rect)
+{
+    const int bytesPerPixel = image.depth() / 8;
+    quint64 hash = 0;
+    for (int y = rect.top(); y <= rect.bottom(); y++)
+    {
+        const uchar *line = image.constScanLine(y) + rect.left() * bytesPerPixel;
+        hash = hash * 31 + qHashBits(line, rect.width() * bytesPerPixel, y);
+    }
+    return hash;
+}
+
+void PreviewStream::encode(const QImage &source, const QString &uuid, const QJsonObject &metadata)
+{
+    if (source.isNull())
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Tiles are hashed on their pixels, keep to formats with whole bytes per pixel
+    const QImage image = (source.format() == QImage::Format_Indexed8 || source.format() == QImage::Format_RGB32) ?
+                         source : source.convertToFormat(QImage::Format_RGB32);
+
+    if (!m_Previews.contains(uuid) && m_Previews.size() >= MAX_PREVIEWS)
+        m_Previews.erase(m_Previews.begin());
+
+    Preview &preview = m_Previews[uuid];
+    const QVector<QRect> rects = tileRects(image.size());
+    if (preview.image.size() != image.size())
+        preview.sent.fill(0, rects.size());
+
+    QVector<quint64> hashes(rects.size());
+    for (int i = 0; i < rects.size(); i++)
+        hashes[i] = hashTile(image, rects[i]);
+
+    // Nothing to send if the same preview is sent again, e.g. after a view change
+    if (preview.image.size() == image.size() && hashes == preview.hashes)
+        return;
+
+    preview.image = image;
+    preview.hashes = hashes;
+    preview.frame++;
+
+    // The caller's resolution and ext describe the captured image, so the stream adds its own keys
+    QJsonObject base = metadata;
+    base["uuid"] = uuid;
+    base["preview_ext"] = m_Format;
+    base["layer"] = "base";
+    base["frame"] = static_cast<int>(preview.frame);
+    base["preview_resolution"] = QString("%1x%2").arg(image.width()).arg(image.height());
+    base["tile_size"] = TILE_SIZE;
+
+    const QImage reduced = image.width() > BASE_REDUCTION * TILE_SIZE ?
+                           image.scaledToWidth(image.width() / BASE_REDUCTION, Qt::SmoothTransformation) :
+                           image;
+    qint64 bytes = send(base, reduced, BASE_QUALITY, uuid);
+
+    int tiles = 0;
+    bytes += sendTiles(uuid, preview, &tiles);
+
+    emit newStatistics(
+    {
+        {"uuid", uuid},
+        {"frame", static_cast<int>(preview.frame)},
+        {"format", m_Format},
+        {"bytes", bytes},
+        {"tiles", tiles},
+        {"encode_ms", timer.nsecsElapsed() / 1e6}
+    });
+}
+
+void PreviewStream::setViewport(const QString &uuid, const QRectF &viewport)
+{
+    auto preview = m_Previews.find(uuid);
+    if (preview == m_Previews.end())
+        return;
+
+    preview->viewport = viewport.normalized().intersected(QRectF(0, 0, 1, 1));
+
+    QElapsedTimer timer;
+    timer.start();
+    int tiles = 0;
+    const qint64 bytes = sendTiles(uuid, *preview, &tiles);
+    if (tiles == 0)
+        return;
+
+    emit newStatistics(
+    {
+        {"uuid", uuid},
+        {"frame", static_cast<int>(preview->frame)},
+        {"format", m_Format},
+        {"bytes", bytes},
+        {"tiles", tiles},
+        {"encode_ms", timer.nsecsElapsed() / 1e6}
+    });
+}
+
+qint64 PreviewStream::sendTiles(const QString &uuid, Preview &preview, int *tiles)
+{
+    const QSizeF size = preview.image.size();
+    const QRectF visible(preview.viewport.x() * size.width(), preview.viewport.y() * size.height(),
+                         preview.viewport.width() * size.width(), preview.viewport.height() * size.height());
+    const QVector<QRect> rects = tileRects(preview.image.size());
+
+    qint64 bytes = 0;
+    for (int i = 0; i < rects.size(); i++)
+    {
+        if (preview.sent[i] == preview.hashes[i] || !visible.intersects(rects[i]))
+            continue;
+
+        const QJsonObject metadata =
+        {
+            {"uuid", uuid},
+            {"preview_ext", m_Format},
+            {"layer", "tile"},
+            {"frame", static_cast<int>(preview.frame)},
+            {"x", rects[i].x()},
+            {"y", rects[i].y()},
+            {"w", rects[i].width()},
+            {"h", rects[i].height()}
+        };
+        bytes += send(metadata, preview.image.copy(rects[i]), TILE_QUALITY, uuid);
+        preview.sent[i] = preview.hashes[i];
+        (*tiles)++;
+    }
+    return bytes;
+}
+
+qint64 PreviewStream::send(const QJsonObject &metadata, const QImage &image, int quality, const QString &uuid)
+{
+    QByteArray packet;
+    QBuffer buffer(&packet);
+    buffer.open(QIODevice::WriteOnly);
+
+    // First m_MetadataSize bytes of the binary data is always allocated
+    // to the metadata, the rest to the image data.
+    QByteArray meta = QJsonDocument(metadata).toJson(QJsonDocument::Compact);
+    meta = meta.leftJustified(m_MetadataSize, 0);
+    buffer.write(meta);
+
+    m_Writer.setDevice(&buffer);
+    m_Writer.setQuality(quality);
+    const bool written = m_Writer.write(image);
+    m_Writer.setDevice(nullptr);
+    buffer.close();
+
+    if (!written)
+    {
+        qCWarning(KSTARS_EKOS) << "Failed to encode preview" << uuid << m_Writer.errorString();
+        return 0;
+    }
+
+    emit newPacket(packet, uuid);
+    return packet.size();
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QImageWriter>
+#include <QJsonObject>
+#include <QObject>
+#include <QRectF>
+#include <QVector>
+
+namespace EkosLive
+{
+/**
+ * @class PreviewStream
+ * @short Encodes image previews progressively for clients on slow links.
+ *
+ * Instead of a whole image, each new preview is sent as a low resolution base layer followed by
+ * full resolution tiles covering only the client's viewport. Tiles which did not change since they
+ * were last sent are skipped, and when the client moves its viewport only the newly visible tiles
+ * are sent. The encoder lives on its own thread and its slots should be invoked through queued
+ * connections.
+ *
+ * Each packet has the usual EkosLive framing: a metadata JSON object padded to METADATA_PACKET
+ * bytes, followed by the encoded image. Base layers carry the metadata of the preview as given plus
+ * "layer": "base", the size of the full preview in "preview_resolution" and "tile_size". Tiles carry
+ * "layer": "tile" and their x, y, w, h in the full preview. Both carry the image format of the
+ * stream in "preview_ext".
+ */
+class PreviewStream : public QObject
+{
+        Q_OBJECT
+
+    public:
+        explicit PreviewStream(uint16_t metadataSize, QObject *parent = nullptr);
+
+        /** @return the image formats available for streaming, preferred ones first */
+        static QStringList availableFormats();
+
+    public slots:
+        /**
+         * @brief setFormat Select the codec of the stream, if available, else JPEG is used.
+         * @param format image format name, e.g. "webp", "jxl" or "jpg".
+         */
+        void setFormat(const QString &format);
+
+        /**
+         * @brief setViewport Set the part of the previews the client shows, and send the tiles of
+         * the last preview of uuid which it is still missing.
+         * @param viewport normalized to the preview size, 0 to 1 on both axes.
+         */
+        void setViewport(const QString &uuid, const QRectF &viewport);
+
+        /**
+         * @brief encode Send a new preview.
+         * @param image preview to send, already reduced to the streaming resolution.
+         * @param uuid of the preview, previews with the same uuid replace each other.
+         * @param metadata sent with the base layer.
+         */
+        void encode(const QImage &image, const QString &uuid, const QJsonObject &metadata);
+
+        /** @brief reset Forget all the previews sent, the next ones are sent in full */
+        void reset();
+
+    signals:
+        void newPacket(const QByteArray &packet, const QString &uuid);
+        /** Bytes, tiles and encoding time of each preview or viewport update */
+        void newStatistics(const QJsonObject &statistics);
+
+    private:
+        struct Preview
+        {
+            QImage image;
+            QRectF viewport { 0, 0, 1, 1 };
+            // Content hash of each tile, and of the version of it the client has
+            QVector<quint64> hashes;
+            QVector<quint64> sent;
+            quint32 frame { 0 };
+        };
+
+        // Sends the tiles of the viewport the client doesn't have, returns the bytes sent
+        qint64 sendTiles(const QString &uuid, Preview &preview, int *tiles);
+        qint64 send(const QJsonObject &metadata, const QImage &image, int quality, const QString &uuid);
+        QVector<QRect> tileRects(const QSize &size) const;
+        static quint64 hashTile(const QImage &image, const QRect &rect);
+
+        // Width of the tiles sent, and the factor by which the base layer is reduced
+        static constexpr int TILE_SIZE = 256;
+        static constexpr int BASE_REDUCTION = 4;
+        static constexpr int BASE_QUALITY = 40;
+        static constexpr int TILE_QUALITY = 90;
+        // Previews remembered, one per uuid
+        static constexpr int MAX_PREVIEWS = 8;
+
+        uint16_t m_MetadataSize;
+        QImageWriter m_Writer;
+        QString m_Format { "jpg" };
+        QHash<QString, Preview> m_Previews;
+};
+}
@@ -48,7 +48,10 @@ GP::GP() : covFunc_(nullptr), // initialize pointer to null
     feature_vectors_(Eigen::MatrixXd()),
     feature_matrix_(Eigen::MatrixXd()),
     chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()),
-    beta_(Eigen::VectorXd())
+    beta_(Eigen::VectorXd()),
+    use_incremental_inference_(false),
+    chol_factor_(Eigen::MatrixXd()),
+    incremental_factor_(false)
 { }
 
 GP::GP(const covariance_functions::CovFunc &covFunc) :
@@ -65,7 +68,10 @@ GP::GP(const covariance_functions::CovFunc &covFunc) :
     feature_vectors_(Eigen::MatrixXd()),
     feature_matrix_(Eigen::MatrixXd()),
     chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()),
-    beta_(Eigen::VectorXd())
+    beta_(Eigen::VectorXd()),
+    use_incremental_inference_(false),
+    chol_factor_(Eigen::MatrixXd()),
+    incremental_factor_(false)
 { }
 
 GP::GP(const double noise_variance,
@@ -83,7 +89,10 @@ GP::GP(const double noise_variance,
     feature_vectors_(Eigen::MatrixXd()),
     feature_matrix_(Eigen::MatrixXd()),
     chol_feature_matrix_(Eigen::LDLT<Eigen::MatrixXd>()),
-    beta_(Eigen::VectorXd())
+    beta_(Eigen::VectorXd()),
+    use_incremental_inference_(false),
+    chol_factor_(Eigen::MatrixXd()),
+    incremental_factor_(false)
 { }
 
 GP::~GP()
@@ -106,7 +115,10 @@ GP::GP(const GP &that) :
     feature_vectors_(that.feature_vectors_),
     feature_matrix_(that.feature_matrix_),
     chol_feature_matrix_(that.chol_feature_matrix_),
-    beta_(that.beta_)
+    beta_(that.beta_),
+    use_incremental_inference_(that.use_incremental_inference_),
+    chol_factor_(that.chol_factor_),
+    incremental_factor_(that.incremental_factor_)
 {
     covFunc_ = that.covFunc_->clone();
     covFuncProj_ = that.covFuncProj_->clone();
@@ -151,6 +163,9 @@ GP &GP::operator=(const GP &that)
         alpha_ = that.alpha_;
         chol_gram_matrix_ = that.chol_gram_matrix_;
         log_noise_sd_ = that.log_noise_sd_;
+        use_incremental_inference_ = that.use_incremental_inference_;
+        chol_factor_ = that.chol_factor_;
+        incremental_factor_ = that.incremental_factor_;
     }
     return *this;
 }
@@ -173,7 +188,7 @@ Eigen::VectorXd GP::drawSample(const Eigen::VectorXd &locations,
     prior_covariance = covFunc_->evaluate(locations, locations);
     kernel_matrix = prior_covariance;
 
-    if (gram_matrix_.cols() == 0)   // no data, i.e. only a prior
+    if (data_loc_.rows() == 0)   // no data, i.e. only a prior
     {
         kernel_matrix = prior_covariance + JITTER * Eigen::MatrixXd::Identity(
                             prior_covariance.rows(), prior_covariance.cols());
@@ -184,7 +199,7 @@ Eigen::VectorXd GP::drawSample(const Eigen::VectorXd &locations,
         mixed_covariance = covFunc_->evaluate(locations, data_loc_);
         Eigen::MatrixXd posterior_covariance;
         posterior_covariance = prior_covariance - mixed_covariance *
-                               (chol_gram_matrix_.solve(mixed_covariance.transpose()));
+                               (solveGram(mixed_covariance.transpose()));
         kernel_matrix = posterior_covariance + JITTER * Eigen::MatrixXd::Identity(
                             posterior_covariance.rows(), posterior_covariance.cols());
     }
@@ -218,10 +233,29 @@ void GP::infer()
     }
 
     // compute the Cholesky decomposition of the Gram matrix
-    chol_gram_matrix_ = gram_matrix_.ldlt();
+    incremental_factor_ = false;
+    if (use_incremental_inference_)
+    {
+        // the plain Cholesky factor can be updated later on, the pivoted LDLT cannot
+        Eigen::LLT<Eigen::MatrixXd> llt = gram_matrix_.llt();
+        if (llt.info() == Eigen::Success)
+        {
+            chol_factor_ = llt.matrixL();
+            incremental_factor_ = true;
+        }
+    }
+    if (!incremental_factor_)
+    {
+        chol_gram_matrix_ = gram_matrix_.ldlt();
+    }
 
+    inferOutputs();
+}
+
+void GP::inferOutputs()
+{
     // pre-compute the alpha, which is the solution of the chol to the data
-    alpha_ = chol_gram_matrix_.solve(data_out_);
+    alpha_ = solveGram(data_out_);
 
     if (use_explicit_trend_)
     {
@@ -230,7 +264,7 @@ void GP::infer()
         feature_vectors_.row(0) = Eigen::MatrixXd::Ones(1, data_loc_.rows()); // instead of pow(0)
         feature_vectors_.row(1) = data_loc_.array(); // instead of pow(1)
 
-        feature_matrix_ = feature_vectors_ * chol_gram_matrix_.solve(feature_vectors_.transpose());
+        feature_matrix_ = feature_vectors_ * solveGram(feature_vectors_.transpose());
         chol_feature_matrix_ = feature_matrix_.ldlt();
 
         beta_ = chol_feature_matrix_.solve(feature_vectors_) * alpha_;
@@ -301,6 +335,15 @@ void GP::inferSD(const Eigen::VectorXd &data_loc,
             }
         }
 
+        if (use_incremental_inference_)
+        {
+            inferIncremental(Eigen::Map<Eigen::VectorXd>(loc_arr.data(), n, 1),
+                             Eigen::Map<Eigen::VectorXd>(out_arr.data(), n, 1),
+                             use_var ? Eigen::VectorXd(Eigen::Map<Eigen::VectorXd>(var_arr.data(), n, 1))
+                             : Eigen::VectorXd());
+            return;
+        }
+
         data_loc_ = Eigen::Map<Eigen::VectorXd>(loc_arr.data(), n, 1);
         data_out_ = Eigen::Map<Eigen::VectorXd>(out_arr.data(), n, 1);
         if (use_var)
@@ -310,6 +353,12 @@ void GP::inferSD(const Eigen::VectorXd &data_loc,
     }
     else // we can use all points and don't need to select
     {
+        if (use_incremental_inference_)
+        {
+            inferIncremental(data_loc, data_out, use_var ? data_var : Eigen::VectorXd());
+            return;
+        }
+
         data_loc_ = data_loc;
         data_out_ = data_out;
         if (use_var)
@@ -320,10 +369,183 @@ void GP::inferSD(const Eigen::VectorXd &data_loc,
     infer();
 }
 
+void GP::inferIncremental(const Eigen::VectorXd &data_loc,
+                          const Eigen::VectorXd &data_out,
+                          const Eigen::VectorXd &data_var)
+{
+    bool use_var = data_var.rows() > 0;
+    int n = data_loc_.rows();
+    int m = data_loc.rows();
+
+    // match the current datapoints against the new ones. The Gram matrix only
+    // depends on the location and the noise, the output is taken from the new data.
+    std::vector<int> order; // new index of each datapoint after the update
+    std::vector<int> removed;
+    std::vector<bool> matched(m, false);
+    if (incremental_factor_ && use_var == (data_var_.rows() > 0))
+    {
+        order.reserve(m);
+        for (int i = 0; i < n; ++i)
+        {
+            int match = -1;
+            for (int j = 0; j < m; ++j)
+            {
+                if (!matched[j] && data_loc[j] == data_loc_[i] && (!use_var || data_var[j] == data_var_[i]))
+                {
+                    match = j;
+                    break;
+                }
+            }
+            if (match < 0)
+            {
+                removed.push_back(i);
+            }
+            else
+            {
+                matched[match] = true;
+                order.push_back(match);
+            }
+        }
+    }
+
+    // each changed datapoint costs O(n^2), so beyond some point the full
+    // factorization is cheaper
+    int added = m - static_cast<int>(order.size());
+    bool rebuild = !incremental_factor_ || order.empty()
+                   || static_cast<int>(removed.size()) + added > n / 4 + 1;
+
+    if (!rebuild)
+    {
+        // remove from the back so that the indices stay valid
+        for (auto it = removed.rbegin(); it != removed.rend(); ++it)
+        {
+            removeDataPoint(*it);
+        }
+
+        for (int j = 0; j < m && !rebuild; ++j)
+        {
+            if (!matched[j])
+            {
+                rebuild = !appendDataPoint(data_loc[j], use_var ? data_var[j] : 0.0);
+                order.push_back(j);
+            }
+        }
+    }
+
+    if (rebuild)
+    {
+        data_loc_ = data_loc;
+        data_out_ = data_out;
+        if (use_var)
+        {
+            data_var_ = data_var;
+        }
+        infer();
+        return;
+    }
+
+    data_out_.resize(m);
+    for (int i = 0; i < m; ++i)
+    {
+        data_out_[i] = data_out[order[i]];
+    }
+
+    // the Gram matrix is not kept up to date in incremental mode
+    gram_matrix_ = Eigen::MatrixXd();
+
+    inferOutputs();
+}
+
+void GP::removeDataPoint(int index)
+{
+    int n = chol_factor_.rows();
+    int tail = n - index - 1;
+
+    // Removing row and column index from the Gram matrix leaves the factor above
+    // and left of it unchanged. The lower right block L33 has to absorb the removed
+    // column l32: L33' * L33'^T = L33 * L33^T + l32 * l32^T, a rank-one update.
+    Eigen::MatrixXd lower = chol_factor_.bottomRightCorner(tail, tail);
+    Eigen::VectorXd x = chol_factor_.col(index).tail(tail);
+    for (int k = 0; k < tail; ++k)
+    {
+        double r = std::hypot(lower(k, k), x(k));
+        double c = r / lower(k, k);
+        double s = x(k) / lower(k, k);
+        lower(k, k) = r;
+
+        int rest = tail - k - 1;
+        if (rest > 0)
+        {
+            lower.col(k).tail(rest) = (lower.col(k).tail(rest) + s * x.tail(rest)) / c;
+            x.tail(rest) = c * x.tail(rest) - s * lower.col(k).tail(rest);
+        }
+    }
+
+    Eigen::MatrixXd factor = Eigen::MatrixXd::Zero(n - 1, n - 1);
+    factor.topLeftCorner(index, index) = chol_factor_.topLeftCorner(index, index);
+    factor.bottomLeftCorner(tail, index) = chol_factor_.bottomLeftCorner(tail, index);
+    factor.bottomRightCorner(tail, tail) = lower;
+    chol_factor_.swap(factor);
+
+    data_loc_.segment(index, tail) = data_loc_.tail(tail).eval();
+    data_loc_.conservativeResize(n - 1);
+    if (data_var_.rows() > 0)
+    {
+        data_var_.segment(index, tail) = data_var_.tail(tail).eval();
+        data_var_.conservativeResize(n - 1);
+    }
+}
+
+bool GP::appendDataPoint(double location, double variance)
+{
+    int n = data_loc_.rows();
+
+    Eigen::VectorXd new_loc(1);
+    new_loc << location;
+
+    double noise = data_var_.rows() == 0 ? std::exp(2 * log_noise_sd_) + JITTER : variance;
+    Eigen::VectorXd mixed_cov = covFunc_->evaluate(data_loc_, new_loc);
+    double prior_cov = covFunc_->evaluate(new_loc, new_loc)(0, 0) + noise;
+
+    // the new row of the factor is l = L^-1 k, the new diagonal element sqrt(k** - l^T l)
+    Eigen::VectorXd row = chol_factor_.triangularView<Eigen::Lower>().solve(mixed_cov);
+    double diagonal = prior_cov - row.squaredNorm();
+    if (!(diagonal > 0))
+    {
+        return false;
+    }
+
+    chol_factor_.conservativeResize(n + 1, n + 1);
+    chol_factor_.col(n).setZero();
+    chol_factor_.row(n).head(n) = row.transpose();
+    chol_factor_(n, n) = std::sqrt(diagonal);
+
+    data_loc_.conservativeResize(n + 1);
+    data_loc_[n] = location;
+    if (data_var_.rows() > 0)
+    {
+        data_var_.conservativeResize(n + 1);
+        data_var_[n] = variance;
+    }
+    return true;
+}
+
+Eigen::MatrixXd GP::solveGram(const Eigen::MatrixXd &rhs) const
+{
+    if (incremental_factor_)
+    {
+        return chol_factor_.triangularView<Eigen::Lower>().transpose().solve(
+                   chol_factor_.triangularView<Eigen::Lower>().solve(rhs));
+    }
+    return chol_gram_matrix_.solve(rhs);
+}
+
 void GP::clearData()
 {
     gram_matrix_ = Eigen::MatrixXd();
     chol_gram_matrix_ = Eigen::LDLT<Eigen::MatrixXd>();
+    chol_factor_ = Eigen::MatrixXd();
+    incremental_factor_ = false;
     data_loc_ = Eigen::VectorXd();
     data_out_ = Eigen::VectorXd();
 }
@@ -413,7 +635,7 @@ const
     Eigen::VectorXd m = mixed_cov * alpha_;
 
     // precompute K^{-1} * mixed_cov
-    Eigen::MatrixXd gamma = chol_gram_matrix_.solve(mixed_cov.transpose());
+    Eigen::MatrixXd gamma = solveGram(mixed_cov.transpose());
 
     Eigen::MatrixXd R;
 
@@ -478,3 +700,17 @@ void GP::disableExplicitTrend()
 {
     use_explicit_trend_ = false;
 }
+
+void GP::enableIncrementalInference()
+{
+    use_incremental_inference_ = true;
+}
+
+void GP::disableIncrementalInference()
+{
+    use_incremental_inference_ = false;
+    if (incremental_factor_ && data_loc_.rows() > 0)
+    {
+        infer(); // go back to the LDLT factorization
+    }
+}
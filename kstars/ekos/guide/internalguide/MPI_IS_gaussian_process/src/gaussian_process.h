@@ -52,6 +52,41 @@ private:
     Eigen::MatrixXd feature_matrix_;
     Eigen::LDLT<Eigen::MatrixXd> chol_feature_matrix_;
     Eigen::VectorXd beta_;
+    bool use_incremental_inference_;
+    // lower Cholesky factor of the Gram matrix, used instead of chol_gram_matrix_
+    // when incremental_factor_ is set
+    Eigen::MatrixXd chol_factor_;
+    bool incremental_factor_;
+
+    /*!
+     * Solves the Gram matrix for \a rhs with whichever factorization is current.
+     */
+    Eigen::MatrixXd solveGram(const Eigen::MatrixXd& rhs) const;
+
+    /*!
+     * Computes alpha and the explicit trend from the current factorization.
+     */
+    void inferOutputs();
+
+    /*!
+     * Replaces the data with the given datapoints by removing the datapoints
+     * which are not part of it any more from the Cholesky factor and appending
+     * the new ones. Falls back to infer() if too much has changed.
+     */
+    void inferIncremental(const Eigen::VectorXd& data_loc,
+                          const Eigen::VectorXd& data_out,
+                          const Eigen::VectorXd& data_var);
+
+    /*!
+     * Removes datapoint \a index from the data and the Cholesky factor.
+     */
+    void removeDataPoint(int index);
+
+    /*!
+     * Appends a datapoint to the data and the Cholesky factor. Returns false
+     * if the extended Gram matrix is not numerically positive definite.
+     */
+    bool appendDataPoint(double location, double variance);
 
 public:
     typedef std::pair<Eigen::VectorXd, Eigen::MatrixXd> VectorMatrixPair;
@@ -177,6 +212,20 @@ public:
      */
     void disableExplicitTrend();
 
+    /*!
+     * Enables incremental inference for inferSD(). Datapoints that are still
+     * selected keep their part of the Cholesky factor, only removed and added
+     * datapoints are updated, which costs O(n^2) per changed point instead of
+     * O(n^3) for the full factorization.
+     */
+    void enableIncrementalInference();
+
+    /*!
+     * Disables incremental inference, the Gram matrix is factorized anew
+     * for every inference.
+     */
+    void disableIncrementalInference();
+
 
 };
 
@@ -59,6 +59,7 @@ GaussianProcessGuider::GaussianProcessGuider(guide_parameters parameters) :
     circular_buffer_data_.push_front(data_point()); // add first point
     circular_buffer_data_[0].control = 0; // set first control to zero
     gp_.enableExplicitTrend(); // enable the explicit basis function for the linear drift
+    gp_.enableIncrementalInference(); // only update the points that changed on each UpdateGP()
     gp_.enableOutputProjection(output_covariance_function_); // for prediction
 
     std::vector<double> hyperparameters(NumParameters);
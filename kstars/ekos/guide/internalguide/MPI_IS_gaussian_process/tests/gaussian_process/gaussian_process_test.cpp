@@ -196,6 +196,43 @@ TEST_F(GPTest, infer_prediction_clear_test)
     EXPECT_NEAR(prediction(1), 0, 1e-6);
 }
 
+TEST_F(GPTest, incremental_inference_test)
+{
+    // a sliding window over a noisy periodic signal, the subset selection in
+    // inferSD() drops and adds a few points on every step
+    Eigen::VectorXd locations = Eigen::VectorXd::LinSpaced(400, 0, 40);
+    Eigen::VectorXd outputs = (locations.array() * 2 * M_PI / 5).sin() + 0.01 * locations.array();
+    outputs += 0.1 * math_tools::generate_normal_random_matrix(outputs.rows(), 1);
+    Eigen::VectorXd variances = Eigen::VectorXd::Constant(locations.rows(), 0.01);
+
+    GP incremental_gp(covariance_function_);
+    incremental_gp.enableExplicitTrend();
+    incremental_gp.enableIncrementalInference();
+    gp_.enableExplicitTrend();
+
+    Eigen::VectorXd prediction_locations(3);
+    const int window = 120;
+    for (int start = 0; start + window <= locations.rows(); start += 7)
+    {
+        const double prediction_point = locations(start + window - 1) + 0.5;
+        gp_.inferSD(locations.segment(start, window), outputs.segment(start, window), 60,
+                    variances.segment(start, window), prediction_point);
+        incremental_gp.inferSD(locations.segment(start, window), outputs.segment(start, window), 60,
+                               variances.segment(start, window), prediction_point);
+
+        prediction_locations << prediction_point - 1, prediction_point, prediction_point + 1;
+        Eigen::VectorXd variances_full, variances_incremental;
+        Eigen::VectorXd prediction_full = gp_.predict(prediction_locations, &variances_full);
+        Eigen::VectorXd prediction_incremental = incremental_gp.predict(prediction_locations, &variances_incremental);
+
+        for (int i = 0; i < prediction_locations.rows(); i++)
+        {
+            EXPECT_NEAR(prediction_incremental(i), prediction_full(i), 1e-6);
+            EXPECT_NEAR(variances_incremental(i), variances_full(i), 1e-6);
+        }
+    }
+}
+
 TEST_F(GPTest, squareDistanceTest)
 {
     Eigen::MatrixXd a(4, 3);
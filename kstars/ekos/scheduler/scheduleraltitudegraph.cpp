@@ -9,7 +9,9 @@
 #include "kplotwidget.h"
 #include "kplotobject.h"
 #include "kplotaxis.h"
+#include "altitudesolver.h"
 #include "ksalmanac.h"
+#include "ksnumbers.h"
 #include "schedulerjob.h"
 #include "schedulerutils.h"
 
@@ -204,19 +206,30 @@ void SchedulerAltitudeGraph::plot()
 
     const int currentPosition = m_State->currentPosition();
 
+    // The curves of all the jobs are computed at once, from the apparent coordinates of the targets at midnight.
+    QVector<double> times;
+    for (auto t = plotStart; t.secsTo(plotEnd) > 0; t = t.addSecs(60 * 10))
+        times.push_back(midnight.secsTo(t) / 3600.0);
+
+    KSNumbers numbers(ut.djd());
+    QVector<SkyPoint> targets;
+    for (const auto job : m_State->jobs())
+    {
+        SkyPoint target(job->getTargetCoords().ra0(), job->getTargetCoords().dec0());
+        target.updateCoordsNow(&numbers);
+        targets.push_back(target);
+    }
+
+    AltitudeSolver solver;
+    solver.setTimes(SchedulerModuleState::getGeo()->LTtoUT(KStarsDateTime(plotStart)), 10 * 60, times.size(),
+                    SchedulerModuleState::getGeo());
+    solver.setTargets(targets);
+    solver.solve();
+
     for (int index = 0; index < m_State->jobs().size(); index++)
     {
-        auto t = plotStart;
-        QVector<double> times, alts;
         auto job = m_State->jobs().at(index);
-        while (t.secsTo(plotEnd) > 0)
-        {
-            double alt = SchedulerUtils::findAltitude(job->getTargetCoords(), t);
-            alts.push_back(alt);
-            double hour = midnight.secsTo(t) / 3600.0;
-            times.push_back(hour);
-            t = t.addSecs(60 * 10);
-        }
+        const QVector<double> alts = solver.altitudes(index);
 
         const int lineWidth = (index == currentPosition) ? 2 : 1;
         if (index == 0)
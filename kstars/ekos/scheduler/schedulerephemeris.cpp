@@ -0,0 +1,193 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "schedulerephemeris.h"
+
+#include "geolocation.h"
+#include "ksalmanac.h"
+#include "ksnumbers.h"
+#include "kstarsdatetime.h"
+#include "ksmoon.h"
+
+#include <QMutexLocker>
+
+#include <cmath>
+
+namespace Ekos
+{
+
+SchedulerEphemeris *SchedulerEphemeris::Instance()
+{
+    static SchedulerEphemeris instance;
+    return &instance;
+}
+
+void SchedulerEphemeris::checkSite(const GeoLocation *geo)
+{
+    if (m_HasSite && geo->lat()->Degrees() == m_Latitude && geo->lng()->Degrees() == m_Longitude &&
+            geo->elevation() == m_Elevation && geo->TZ0() == m_TZ0)
+        return;
+
+    // The positions don't depend on the site, but the sidereal time, the topocentric Moon and
+    // the almanacs do. Sites change seldom enough to start from scratch.
+    m_Numbers.clear();
+    m_GST0.clear();
+    m_Targets.clear();
+    m_Moon.clear();
+    m_Almanacs.clear();
+
+    m_Latitude = geo->lat()->Degrees();
+    m_Longitude = geo->lng()->Degrees();
+    m_Elevation = geo->elevation();
+    m_TZ0 = geo->TZ0();
+    m_HasSite = true;
+}
+
+SkyPoint SchedulerEphemeris::horizontal(const SkyPoint &target, const KStarsDateTime &ut, const GeoLocation *geo,
+                                        dms *lst)
+{
+    QMutexLocker locker(&m_Mutex);
+    checkSite(geo);
+
+    const long double position = ut.djd() * SLOTS_PER_DAY;
+    const qint64 slot = static_cast<qint64>(std::floor(position));
+
+    SkyPoint point;
+    point.setRA0(target.ra0());
+    point.setDec0(target.dec0());
+    interpolate(targetAt(target, slot), targetAt(target, slot + 1), static_cast<double>(position - slot), point);
+
+    const CachingDms LST = lstAt(ut, geo);
+    point.EquatorialToHorizontal(&LST, geo->lat());
+    if (lst)
+        *lst = LST;
+
+    return point;
+}
+
+SkyPoint SchedulerEphemeris::moon(KSMoon *moon, const KStarsDateTime &ut, const GeoLocation *geo)
+{
+    QMutexLocker locker(&m_Mutex);
+    checkSite(geo);
+
+    const long double position = ut.djd() * SLOTS_PER_DAY;
+    const qint64 slot = static_cast<qint64>(std::floor(position));
+
+    SkyPoint point;
+    interpolate(moonAt(moon, slot, geo), moonAt(moon, slot + 1, geo), static_cast<double>(position - slot), point);
+
+    const CachingDms LST = lstAt(ut, geo);
+    point.EquatorialToHorizontal(&LST, geo->lat());
+
+    return point;
+}
+
+QSharedPointer<const KSAlmanac> SchedulerEphemeris::almanac(const KStarsDateTime &midnight, const GeoLocation *geo)
+{
+    QMutexLocker locker(&m_Mutex);
+    checkSite(geo);
+
+    const qint64 key = std::llround(midnight.djd() * 24 * 60);
+    auto almanac = m_Almanacs.constFind(key);
+    if (almanac != m_Almanacs.constEnd())
+        return almanac.value();
+
+    if (m_Almanacs.size() >= MAX_ALMANACS)
+        m_Almanacs.clear();
+
+    QSharedPointer<const KSAlmanac> result(new KSAlmanac(midnight, geo));
+    m_Almanacs.insert(key, result);
+    return result;
+}
+
+const KSNumbers *SchedulerEphemeris::numbers(qint64 slot)
+{
+    auto numbers = m_Numbers.constFind(slot);
+    if (numbers != m_Numbers.constEnd())
+        return numbers.value().data();
+
+    if (m_Numbers.size() >= MAX_SLOTS)
+        m_Numbers.clear();
+
+    QSharedPointer<KSNumbers> result(new KSNumbers(static_cast<long double>(slot) / SLOTS_PER_DAY));
+    m_Numbers.insert(slot, result);
+    return result.data();
+}
+
+dms SchedulerEphemeris::lstAt(const KStarsDateTime &ut, const GeoLocation *geo)
+{
+    // Same as KStarsDateTime::gst(), with the sidereal time at 0h UT computed once a day
+    const QDate date = ut.date();
+    auto gst0 = m_GST0.constFind(date.toJulianDay());
+    if (gst0 == m_GST0.constEnd())
+    {
+        if (m_GST0.size() >= MAX_SLOTS)
+            m_GST0.clear();
+        gst0 = m_GST0.insert(date.toJulianDay(), KStarsDateTime(date, QTime(0, 0, 0)).gst().Degrees());
+    }
+
+    const QTime time = ut.time();
+    const double hr = time.hour() - ut.offsetFromUtc() / 3600.0;
+    const double mn = time.minute();
+    const double sc = time.second() + 0.001 * time.msec();
+    const double st = (hr + (mn + sc / 60.0) / 60.0) * SIDEREALSECOND;
+
+    return geo->GSTtoLST(dms(gst0.value() + st * 15.0).reduce());
+}
+
+SchedulerEphemeris::Coordinates SchedulerEphemeris::targetAt(const SkyPoint &target, qint64 slot)
+{
+    // Catalog coordinates to the milliarcsecond, far below what the constraints need
+    const quint64 ra0 = static_cast<quint64>(std::llround(target.ra0().reduce().Degrees() * 3600000.0));
+    const quint64 dec0 = static_cast<quint64>(std::llround((target.dec0().Degrees() + 90.0) * 3600000.0));
+    const QPair<qint64, quint64> key(slot, (ra0 << 32) | dec0);
+
+    auto coordinates = m_Targets.constFind(key);
+    if (coordinates != m_Targets.constEnd())
+        return coordinates.value();
+
+    if (m_Targets.size() >= MAX_TARGET_POSITIONS)
+        m_Targets.clear();
+
+    SkyPoint point(target.ra0(), target.dec0());
+    point.updateCoordsNow(numbers(slot));
+
+    const Coordinates result(point.ra().Degrees(), point.dec().Degrees());
+    m_Targets.insert(key, result);
+    return result;
+}
+
+SchedulerEphemeris::Coordinates SchedulerEphemeris::moonAt(KSMoon *moon, qint64 slot, const GeoLocation *geo)
+{
+    auto coordinates = m_Moon.constFind(slot);
+    if (coordinates != m_Moon.constEnd())
+        return coordinates.value();
+
+    if (m_Moon.size() >= MAX_SLOTS)
+        m_Moon.clear();
+
+    // Topocentric position, the parallax of the Moon is up to a degree
+    const KStarsDateTime ut(static_cast<long double>(slot) / SLOTS_PER_DAY);
+    const CachingDms LST = lstAt(ut, geo);
+    moon->updateCoords(numbers(slot), true, geo->lat(), &LST, true);
+
+    const Coordinates result(moon->ra().Degrees(), moon->dec().Degrees());
+    m_Moon.insert(slot, result);
+    return result;
+}
+
+void SchedulerEphemeris::interpolate(const Coordinates &from, const Coordinates &to, double fraction, SkyPoint &point)
+{
+    double deltaRA = to.first - from.first;
+    if (deltaRA > 180.0)
+        deltaRA -= 360.0;
+    else if (deltaRA < -180.0)
+        deltaRA += 360.0;
+
+    dms ra = dms(from.first + fraction * deltaRA).reduce();
+    point.setRA(ra);
+    point.setDec(dms(from.second + fraction * (to.second - from.second)));
+}
+
+}
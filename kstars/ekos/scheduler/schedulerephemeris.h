@@ -0,0 +1,111 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "dms.h"
+#include "skypoint.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSharedPointer>
+
+class GeoLocation;
+class KSAlmanac;
+class KSMoon;
+class KSNumbers;
+class KStarsDateTime;
+
+namespace Ekos
+{
+
+/**
+ * @class SchedulerEphemeris
+ * @short Time indexed ephemeris shared by all scheduler jobs.
+ *
+ * Evaluating the altitude, moon and twilight constraints of a job at a given time needs the
+ * nutation and aberration series, the sidereal time, the position of the Moon and the almanac of
+ * the night, and the scheduler evaluates them minute by minute for every job. This cache computes
+ * them once on a grid of SLOT_MINUTES slots for the observing site, and interpolates the apparent
+ * coordinates of targets and of the Moon between the slots. The horizontal coordinates are then
+ * computed exactly for the time asked for, which only takes a few trigonometric functions.
+ *
+ * Jobs read the positions of their targets and of the Moon from this shared instance rather than
+ * computing their own. All times are UT. The cache is cleared when it is used for another site.
+ */
+class SchedulerEphemeris
+{
+    public:
+        static SchedulerEphemeris *Instance();
+
+        /**
+         * @brief horizontal Position of a target at a given time.
+         * @param target target, only its catalog coordinates are used.
+         * @param ut time of the position, in UT.
+         * @param geo observing site.
+         * @param lst if not null, set to the local sidereal time at ut.
+         * @return target with its catalog and apparent equatorial coordinates, and its horizontal coordinates.
+         */
+        SkyPoint horizontal(const SkyPoint &target, const KStarsDateTime &ut, const GeoLocation *geo,
+                            dms *lst = nullptr);
+
+        /**
+         * @brief moon Topocentric position of the Moon at a given time.
+         * @param moon moon object used to compute the positions at the slots.
+         * @param ut time of the position, in UT.
+         * @param geo observing site.
+         * @return apparent equatorial and horizontal coordinates of the Moon.
+         */
+        SkyPoint moon(KSMoon *moon, const KStarsDateTime &ut, const GeoLocation *geo);
+
+        /**
+         * @brief almanac Almanac of the night around a local midnight.
+         * @param midnight local time, as passed to KSAlmanac.
+         * @param geo observing site.
+         */
+        QSharedPointer<const KSAlmanac> almanac(const KStarsDateTime &midnight, const GeoLocation *geo);
+
+        // Grid of the cached positions
+        static constexpr int SLOT_MINUTES = 10;
+        static constexpr int SLOTS_PER_DAY = 24 * 60 / SLOT_MINUTES;
+
+    private:
+        SchedulerEphemeris() = default;
+
+        // Apparent right ascension and declination in degrees
+        typedef QPair<double, double> Coordinates;
+
+        // Clear the cache if geo is another site than the cached one
+        void checkSite(const GeoLocation *geo);
+        const KSNumbers *numbers(qint64 slot);
+        dms lstAt(const KStarsDateTime &ut, const GeoLocation *geo);
+        Coordinates targetAt(const SkyPoint &target, qint64 slot);
+        Coordinates moonAt(KSMoon *moon, qint64 slot, const GeoLocation *geo);
+        static void interpolate(const Coordinates &from, const Coordinates &to, double fraction, SkyPoint &point);
+
+        // Bounds of the cache, it is cleared when one is reached
+        static constexpr int MAX_SLOTS = 4 * SLOTS_PER_DAY;
+        static constexpr int MAX_TARGET_POSITIONS = 100000;
+        static constexpr int MAX_ALMANACS = 16;
+
+        QMutex m_Mutex;
+
+        // Site of the cached values
+        double m_Latitude { 0 };
+        double m_Longitude { 0 };
+        double m_Elevation { 0 };
+        double m_TZ0 { 0 };
+        bool m_HasSite { false };
+
+        QHash<qint64, QSharedPointer<KSNumbers>> m_Numbers;
+        // Greenwich sidereal time at 0h UT in degrees, by julian day
+        QHash<qint64, double> m_GST0;
+        // Target positions by slot and catalog coordinates
+        QHash<QPair<qint64, quint64>, Coordinates> m_Targets;
+        QHash<qint64, Coordinates> m_Moon;
+        QHash<qint64, QSharedPointer<const KSAlmanac>> m_Almanacs;
+};
+
+}
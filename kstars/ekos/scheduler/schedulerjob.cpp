@@ -13,6 +13,7 @@
 #include "Options.h"
 #include "scheduler.h"
 #include "schedulermodulestate.h"
+#include "schedulerephemeris.h"
 #include "schedulerutils.h"
 #include "ksmoon.h"
 #include "ksnotification.h"
@@ -636,24 +637,15 @@ bool SchedulerJob::moonConstraintsOK(QDateTime const &when, QString *reason, dou
                           Qt::UTC == when.timeSpec() ? SchedulerModuleState::getGeo()->UTtoLT(KStarsDateTime(when)) : when :
                           getLocalTime());
 
-    // Create a sky object with the target catalog coordinates
-    SkyPoint const target = getTargetCoords();
-    SkyObject o;
-    o.setRA0(target.ra0());
-    o.setDec0(target.dec0());
-
-    // Update RA/DEC of the target for the current fraction of the day
-    KSNumbers numbers(ltWhen.djd());
-    o.updateCoordsNow(&numbers);
-
-    CachingDms LST = SchedulerModuleState::getGeo()->GSTtoLST(SchedulerModuleState::getGeo()->LTtoUT(ltWhen).gst());
-    moon->updateCoords(&numbers, true, SchedulerModuleState::getGeo()->lat(), &LST, true);
-    moon->EquatorialToHorizontal(&LST, SchedulerModuleState::getGeo()->lat());
+    const GeoLocation *geo = SchedulerModuleState::getGeo();
+    const KStarsDateTime ut = geo->LTtoUT(ltWhen);
+    SkyPoint const o = SchedulerEphemeris::Instance()->horizontal(getTargetCoords(), ut, geo);
+    SkyPoint const moonPosition = SchedulerEphemeris::Instance()->moon(moon, ut, geo);
 
     bool separationOK = true;
     if (getMinMoonSeparation() > 0)
     {
-        const double val = moon->angularDistanceTo(&o).Degrees() - getMinMoonSeparation();
+        const double val = moonPosition.angularDistanceTo(&o).Degrees() - getMinMoonSeparation();
         separationOK = val >= 0;
         if (margin)
             *margin = fabs(val);
@@ -662,7 +654,7 @@ bool SchedulerJob::moonConstraintsOK(QDateTime const &when, QString *reason, dou
     bool altitudeOK = true;
     if (getMaxMoonAltitude() < 90)
     {
-        const double val = moon->alt().Degrees() - getMaxMoonAltitude();
+        const double val = moonPosition.alt().Degrees() - getMaxMoonAltitude();
         altitudeOK = val <= 0;
         if (margin)
             *margin = std::min(*margin, fabs(val));
@@ -797,17 +789,13 @@ QDateTime SchedulerJob::calculateNextTime(QDateTime const &when, bool checkIfCon
     return QDateTime();
 }
 
-bool SchedulerJob::checkAltitudeAndMoon(SkyObject o, const KStarsDateTime &ltOffset, QString *reason, double *margin) const
+bool SchedulerJob::checkAltitudeAndMoon(const SkyPoint &target, const KStarsDateTime &ltOffset, QString *reason, double *margin) const
 {
-    // Update RA/DEC of the target for the current fraction of the day
-    KSNumbers numbers(ltOffset.djd());
-    o.updateCoordsNow(&numbers);
-
-    // Compute local sidereal time for the current fraction of the day, calculate altitude
-    CachingDms const LST = SchedulerModuleState::getGeo()->GSTtoLST(SchedulerModuleState::getGeo()->LTtoUT(ltOffset).gst());
-    o.EquatorialToHorizontal(&LST, SchedulerModuleState::getGeo()->lat());
-    double const altitude = o.alt().Degrees();
-    double const azimuth = o.az().Degrees();
+    // Position of the target for the current fraction of the day
+    const GeoLocation *geo = SchedulerModuleState::getGeo();
+    SkyPoint const position = SchedulerEphemeris::Instance()->horizontal(target, geo->LTtoUT(ltOffset), geo);
+    double const altitude = position.alt().Degrees();
+    double const azimuth = position.az().Degrees();
 
     bool const altitudeOK = satisfiesAltitudeConstraint(azimuth, altitude, reason, margin);
     if (altitudeOK)
@@ -547,7 +547,7 @@ class SchedulerJob
                                            const QDateTime &until = QDateTime()) const;
         QDateTime getNextEndTime(const QDateTime &start, int increment = 1, QString *reason = nullptr,
                                  const QDateTime &until = QDateTime()) const;
-        bool checkAltitudeAndMoon(SkyObject o, const KStarsDateTime &ltOffset, QString *reason, double *margin) const;
+        bool checkAltitudeAndMoon(const SkyPoint &target, const KStarsDateTime &ltOffset, QString *reason, double *margin) const;
 
 
         /**
@@ -5,6 +5,7 @@
 */
 #include "schedulermodulestate.h"
 #include "schedulerjob.h"
+#include "schedulerephemeris.h"
 #include <ekos_scheduler_debug.h>
 #include "schedulerprocess.h"
 #include "schedulerjob.h"
@@ -459,33 +460,8 @@ void SchedulerModuleState::calculateDawnDusk(const QDateTime &when, QDateTime &n
     {
         // KSAlmanac computes the closest dawn and dusk events from the local sidereal time corresponding to the midnight argument
 
-#if 0
-        KSAlmanac const ksal(midnight, getGeo());
-        // If dawn is in the past compared to this observation, fetch the next dawn
-        if (dawn <= startup)
-            dawn = getGeo()->UTtoLT(ksal.getDate().addSecs((ksal.getDawnAstronomicalTwilight() * 24.0 + Options::dawnOffset()) *
-                                    3600.0));
-        // If dusk is in the past compared to this observation, fetch the next dusk
-        if (dusk <= startup)
-            dusk = getGeo()->UTtoLT(ksal.getDate().addSecs((ksal.getDuskAstronomicalTwilight() * 24.0 + Options::duskOffset()) *
-                                    3600.0));
-#else
-        // Creating these almanac instances seems expensive.
-        static QMap<QString, KSAlmanac const * > almanacMap;
-        const QString key = QString("%1 %2 %3").arg(midnight.toString()).arg(getGeo()->lat()->Degrees()).arg(
-                                getGeo()->lng()->Degrees());
-        KSAlmanac const * ksal = almanacMap.value(key, nullptr);
-        if (ksal == nullptr)
-        {
-            if (almanacMap.size() > 5)
-            {
-                // don't allow this to grow too large.
-                qDeleteAll(almanacMap);
-                almanacMap.clear();
-            }
-            ksal = new KSAlmanac(midnight, getGeo());
-            almanacMap[key] = ksal;
-        }
+        // Creating these almanac instances seems expensive, they are shared by all jobs.
+        QSharedPointer<const KSAlmanac> const ksal = SchedulerEphemeris::Instance()->almanac(midnight, getGeo());
 
         // If dawn is in the past compared to this observation, fetch the next dawn
         if (dawn <= startup)
@@ -496,7 +472,6 @@ void SchedulerModuleState::calculateDawnDusk(const QDateTime &when, QDateTime &n
         if (dusk <= startup)
             dusk = getGeo()->UTtoLT(ksal->getDate().addSecs((ksal->getDuskAstronomicalTwilight() * 24.0 + Options::duskOffset()) *
                                     3600.0));
-#endif
     }
 
     // Now we have the next events:
@@ -7,6 +7,7 @@
 #include "schedulerutils.h"
 #include "schedulerjob.h"
 #include "schedulermodulestate.h"
+#include "schedulerephemeris.h"
 #include "ekos/capture/sequencejob.h"
 #include "Options.h"
 #include "skypoint.h"
@@ -750,18 +751,8 @@ double SchedulerUtils::findAltitude(const SkyPoint &target, const QDateTime &whe
                           Qt::UTC == when.timeSpec() ? geoLocation->UTtoLT(KStarsDateTime(when)) : when :
                           SchedulerModuleState::getLocalTime());
 
-    // Create a sky object with the target catalog coordinates
-    SkyObject o;
-    o.setRA0(target.ra0());
-    o.setDec0(target.dec0());
-
-    // Update RA/DEC of the target for the current fraction of the day
-    KSNumbers numbers(ltWhen.djd());
-    o.updateCoordsNow(&numbers);
-
-    // Calculate alt/az coordinates using KStars instance's geolocation
-    CachingDms const LST = geoLocation->GSTtoLST(geoLocation->LTtoUT(ltWhen).gst());
-    o.EquatorialToHorizontal(&LST, geoLocation->lat());
+    dms LST;
+    SkyPoint const o = SchedulerEphemeris::Instance()->horizontal(target, geoLocation->LTtoUT(ltWhen), geoLocation, &LST);
 
     // Hours are reduced to [0,24[, meridian being at 0
     double offset = LST.Hours() - o.ra().Hours();
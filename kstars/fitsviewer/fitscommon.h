@@ -380,6 +380,9 @@ struct LiveStackPPData
     double sharpenSigma;
 };
 
+// Number of subs loaded at a time when streaming. Each sub is merged into the stack and released
+static constexpr int LIVE_STACK_STREAMING_SUBS = 2;
+
 struct LiveStackData
 {
     bool calcSNR;
@@ -388,6 +391,9 @@ struct LiveStackData
     QString alignMaster;
     LiveStackAlignMethod alignMethod;
     int numInMem;
+    int memBudgetMB;
+    bool streaming;
+    int reservoirSize;
     LiveStackDownscale downscale;
     LiveStackFrameWeighting weighting;
     LiveStackStackingMethod stackingMethod;
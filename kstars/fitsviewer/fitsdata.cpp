@@ -13,6 +13,7 @@
 #include "fitsgradientdetector.h"
 #include "fitscentroiddetector.h"
 #include "fitssepdetector.h"
+#include "fitsstatistics.h"
 
 #include "fpack.h"
 
@@ -29,6 +30,7 @@
 #include <QImage>
 #include <QtConcurrent>
 #include <QImageReader>
+#include <QtEndian>
 #include <QUrl>
 #include <QNetworkAccessManager>
 
@@ -210,6 +212,33 @@ bool FITSData::loadFromBuffer(const QByteArray &buffer)
     return privateLoad(buffer);
 }
 
+bool FITSData::loadFromBuffer(const QSharedPointer<FrameBuffer> &frame)
+{
+    loadCommon("");
+    qCDebug(KSTARS_FITS) << "Reading frame buffer (" << KFormat().formatByteSize(frame->size()) << ")";
+
+    const QByteArray bytes = frame->bytes();
+    if (bytes.isEmpty())
+    {
+        m_LastError = i18n("Frame of %1 is too large to load.", KFormat().formatByteSize(frame->size()));
+        qCCritical(KSTARS_FITS) << m_LastError;
+        return false;
+    }
+
+    const bool loaded = privateLoad(bytes);
+
+    // The header was parsed into the records, which serve all later lookups when fptr is closed. Close
+    // it unless it reads from an unpacked copy, so the frame can go back to the pool right away.
+    if (fptr != nullptr && m_PackBuffer == nullptr)
+    {
+        int status = 0;
+        fits_close_file(fptr, &status);
+        fptr = nullptr;
+    }
+
+    return loaded;
+}
+
 QFuture<bool> FITSData::loadFromFile(const QString &inFilename)
 {
     loadCommon(inFilename);
@@ -286,8 +315,10 @@ bool FITSData::loadStack(const QStringList &inDir, const LiveStackData &params)
 
     if (subs.size() > 0)
     {
-        // We have some existing subs in the directory to process
-        int subsToProcess = m_LiveStackData.numInMem;
+        // We have some existing subs in the directory to process. Streaming stacks merge and release
+        // each sub as it is stacked so only a couple are loaded at a time
+        int subsToProcess = m_LiveStackData.streaming ? std::min(LIVE_STACK_STREAMING_SUBS, m_LiveStackData.numInMem)
+                                                      : m_LiveStackData.numInMem;
         LiveStackChannel prevChannel;
         QVector<LiveStackChannel> channels;
         getChannelInfoforSub(subs[0].file, prevChannel, channels);
@@ -565,7 +596,8 @@ void FITSData::incrementalStack()
     if (m_CurrentStack->getStackInProgress() || hasUnprocessedSubs)
         return;
 
-    int subsToProcess = m_LiveStackData.numInMem;
+    int subsToProcess = m_LiveStackData.streaming ? std::min(LIVE_STACK_STREAMING_SUBS, m_LiveStackData.numInMem)
+                                                  : m_LiveStackData.numInMem;
     m_StackSubs.clear();
     m_StackSubPos = -1;
     LiveStackChannel currentChannel = channelForStack(m_CurrentStack);
@@ -1552,6 +1584,16 @@ QString fitsErrorToString(int status)
     QString message = error_status;
     return message;
 }
+
+// Convert big endian FITS samples to host order in place, flipping the sign bit to turn the
+// BZERO offset representation of unsigned integers into the unsigned value.
+template <typename T>
+void fromBigEndian(uint8_t *data, const uint32_t count, const T signBit)
+{
+    T *values = reinterpret_cast<T *>(data);
+    for (uint32_t i = 0; i < count; i++)
+        values[i] = qFromBigEndian(values[i]) ^ signBit;
+}
 }
 
 bool FITSData::privateLoad(const QByteArray &buffer)
@@ -1677,6 +1719,9 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const bool isCompressed)
         return false;
     }
 
+    // BITPIX as stored in the file, before SHORT/LONG images are switched to their unsigned types below
+    const int fileBITPIX = m_FITSBITPIX;
+
     // Reload if it is transparently compressed.
     if ((fits_is_compressed_image(fptr, &status) || m_Statistics.ndim <= 0) && !isCompressed)
     {
@@ -1770,26 +1815,31 @@ bool FITSData::loadFITSImage(const QByteArray &buffer, const bool isCompressed)
         m_Statistics.channels = 1;
 
     m_ImageBufferSize = m_Statistics.samples_per_channel * m_Statistics.channels * m_Statistics.bytesPerPixel;
-    m_ImageBuffer = new uint8_t[m_ImageBufferSize];
-    if (m_ImageBuffer == nullptr)
-    {
-        qCWarning(KSTARS_FITS) << "FITSData: Not enough memory for image_buffer channel. Requested: "
-                               << m_ImageBufferSize << " bytes.";
-        clearImageBuffers();
-        free(m_PackBuffer);
-        m_PackBuffer = nullptr;
-        return false;
-    }
 
     rotCounter     = 0;
     flipHCounter   = 0;
     flipVCounter   = 0;
     long nelements = m_Statistics.samples_per_channel * m_Statistics.channels;
 
-    if (fits_read_img(fptr, m_Statistics.dataType, 1, nelements, nullptr, m_ImageBuffer, &anynull, &status))
+    // Uncompressed files on disk are mapped and converted in place, otherwise let cfitsio read the image
+    if (!(buffer.isEmpty() && !isCompressed && mapImageData(fileBITPIX)))
     {
-        m_LastError = i18n("Error reading image: %1", fitsErrorToString(status));
-        return false;
+        m_ImageBuffer = new uint8_t[m_ImageBufferSize];
+        if (m_ImageBuffer == nullptr)
+        {
+            qCWarning(KSTARS_FITS) << "FITSData: Not enough memory for image_buffer channel. Requested: "
+                                   << m_ImageBufferSize << " bytes.";
+            clearImageBuffers();
+            free(m_PackBuffer);
+            m_PackBuffer = nullptr;
+            return false;
+        }
+
+        if (fits_read_img(fptr, m_Statistics.dataType, 1, nelements, nullptr, m_ImageBuffer, &anynull, &status))
+        {
+            m_LastError = i18n("Error reading image: %1", fitsErrorToString(status));
+            return false;
+        }
     }
 
     parseHeader();
@@ -2829,10 +2879,115 @@ bool FITSData::saveImage(const QString &newFilename)
     return true;
 }
 
-void FITSData::clearImageBuffers()
+bool FITSData::mapImageData(int bitpix)
 {
-    delete[] m_ImageBuffer;
+#ifdef Q_OS_WIN
+    // Windows does not allow a mapped file to be removed or overwritten, which Ekos does with its images
+    Q_UNUSED(bitpix)
+    return false;
+#else
+    int status = 0;
+    double bscale = 1, bzero = 0;
+    if (fits_read_key_dbl(fptr, "BSCALE", &bscale, nullptr, &status))
+    {
+        bscale = 1;
+        status = 0;
+    }
+    if (fits_read_key_dbl(fptr, "BZERO", &bzero, nullptr, &status))
+    {
+        bzero = 0;
+        status = 0;
+    }
+
+    // Only handle the layouts where the samples are the file data after a byte swap (and a sign bit flip
+    // for unsigned integers). Anything scaled is left to cfitsio. 8 bit data would not need converting, so
+    // its pages would stay backed by the file and could change under us if the file is overwritten.
+    if (bscale != 1)
+        return false;
+    switch (bitpix)
+    {
+        case SHORT_IMG:
+            if (bzero != 32768)
+                return false;
+            break;
+        case LONG_IMG:
+            if (bzero != 2147483648.0)
+                return false;
+            break;
+        case FLOAT_IMG:
+        case LONGLONG_IMG:
+        case DOUBLE_IMG:
+            if (bzero != 0)
+                return false;
+            break;
+        default:
+            return false;
+    }
+
+    LONGLONG headStart = 0, dataStart = 0, dataEnd = 0;
+    if (fits_get_hduaddrll(fptr, &headStart, &dataStart, &dataEnd, &status))
+        return false;
+
+    m_MappedFile.setFileName(m_Filename);
+    if (!m_MappedFile.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 mapSize = dataStart + m_ImageBufferSize;
+    if (m_MappedFile.size() < mapSize)
+    {
+        m_MappedFile.close();
+        return false;
+    }
+
+    // Map from the start of the file so the mapping is page aligned. FITS data starts on a
+    // 2880 byte boundary so the samples are suitably aligned too.
+    m_MappedData = m_MappedFile.map(0, mapSize, QFileDevice::MapPrivateOption);
+    if (m_MappedData == nullptr)
+    {
+        m_MappedFile.close();
+        return false;
+    }
+
+    // Converting touches every page, so the image ends up in private memory detached from the file.
+    m_ImageBuffer = m_MappedData + dataStart;
+    const uint32_t samples = m_Statistics.samples_per_channel * m_Statistics.channels;
+    switch (bitpix)
+    {
+        case SHORT_IMG:
+            fromBigEndian<uint16_t>(m_ImageBuffer, samples, 0x8000);
+            break;
+        case LONG_IMG:
+            fromBigEndian<uint32_t>(m_ImageBuffer, samples, 0x80000000);
+            break;
+        case FLOAT_IMG:
+            fromBigEndian<uint32_t>(m_ImageBuffer, samples, 0);
+            break;
+        default:
+            fromBigEndian<uint64_t>(m_ImageBuffer, samples, 0);
+            break;
+    }
+
+    qCDebug(KSTARS_FITS) << "Mapped image data of" << m_Filename;
+    return true;
+#endif
+}
+
+void FITSData::releaseImageBuffer()
+{
+    if (m_MappedData != nullptr)
+    {
+        m_MappedFile.unmap(m_MappedData);
+        m_MappedFile.close();
+        m_MappedData = nullptr;
+    }
+    else
+        delete[] m_ImageBuffer;
     m_ImageBuffer = nullptr;
+}
+
+void FITSData::clearImageBuffers()
+{
+    releaseImageBuffer();
     if(m_ImageRoiBuffer != nullptr )
     {
         delete[] m_ImageRoiBuffer;
@@ -2915,571 +3070,137 @@ void FITSData::setupWCSParams()
 
 void FITSData::calculateStats(bool refresh, bool roi)
 {
-    // Calculate min max
-    if(roi == false)
-    {
-        calculateMinMax(refresh);
-        calculateMedian(refresh);
-
-        // Try to read mean/median/stddev if in file
-        if (refresh == false && fptr)
-        {
-            int status = 0;
-            int nfound = 0;
-            if (fits_read_key_dbl(fptr, "MEAN1", &m_Statistics.mean[0], nullptr, &status) == 0)
-                nfound++;
-            // NB. These could fail if missing, which is OK.
-            fits_read_key_dbl(fptr, "MEAN2", & m_Statistics.mean[1], nullptr, &status);
-            fits_read_key_dbl(fptr, "MEAN3", &m_Statistics.mean[2], nullptr, &status);
-
-            status = 0;
-            if (fits_read_key_dbl(fptr, "STDDEV1", &m_Statistics.stddev[0], nullptr, &status) == 0)
-                nfound++;
-            // NB. These could fail if missing, which is OK.
-            fits_read_key_dbl(fptr, "STDDEV2", &m_Statistics.stddev[1], nullptr, &status);
-            fits_read_key_dbl(fptr, "STDDEV3", &m_Statistics.stddev[2], nullptr, &status);
-
-            // If all is OK, we're done
-            if (nfound == 2)
-                return;
-        }
-
-        // Get standard deviation and mean in one run
-        switch (m_Statistics.dataType)
-        {
-            case TBYTE:
-                calculateStdDev<uint8_t>();
-                break;
+    Statistic &stats = roi ? m_ROIStatistics : m_Statistics;
+    int fields = FITSStatistics::ALL;
 
-            case TSHORT:
-                calculateStdDev<int16_t>();
-                break;
-
-            case TUSHORT:
-                calculateStdDev<uint16_t>();
-                break;
-
-            case TLONG:
-                calculateStdDev<int32_t>();
-                break;
-
-            case TULONG:
-                calculateStdDev<uint32_t>();
-                break;
-
-            case TFLOAT:
-                calculateStdDev<float>();
-                break;
-
-            case TLONGLONG:
-                calculateStdDev<int64_t>();
-                break;
-
-            case TDOUBLE:
-                calculateStdDev<double>();
-                break;
-
-            default:
-                return;
-        }
-
-        // FIXME That's not really SNR, must implement a proper solution for this value
-        m_Statistics.SNR = m_Statistics.mean[0] / m_Statistics.stddev[0];
-    }
-    else
+    // Try to read min/max, median and mean/stddev from the header. Only fetch from header for the
+    // whole image, the ROI is always calculated
+    if (!roi && !refresh && fptr != nullptr)
     {
-        calculateMinMax(refresh, roi);
-        calculateMedian(refresh, roi);
-
-        switch (m_ROIStatistics.dataType)
-        {
-            case TBYTE:
-                calculateStdDev<uint8_t>(roi);
-                break;
-
-            case TSHORT:
-                calculateStdDev<int16_t>(roi);
-                break;
-
-            case TUSHORT:
-                calculateStdDev<uint16_t>(roi);
-                break;
-
-            case TLONG:
-                calculateStdDev<int32_t>(roi);
-                break;
-
-            case TULONG:
-                calculateStdDev<uint32_t>(roi);
-                break;
-
-            case TFLOAT:
-                calculateStdDev<float>(roi);
-                break;
-
-            case TLONGLONG:
-                calculateStdDev<int64_t>(roi);
-                break;
+        int status = 0;
+        int nfound = 0;
 
-            case TDOUBLE:
-                calculateStdDev<double>(roi);
-                break;
+        if (fits_read_key_dbl(fptr, "DATAMIN", &(m_Statistics.min[0]), nullptr, &status) == 0)
+            nfound++;
+        else if (fits_read_key_dbl(fptr, "MIN1", &(m_Statistics.min[0]), nullptr, &status) == 0)
+            nfound++;
 
-            default:
-                return;
-        }
-    }
-}
-
-void FITSData::calculateMinMax(bool refresh, bool roi)
-{
-    if(roi == false)
-    {
-        int status, nfound = 0;
+        // NB. These could fail if missing, which is OK.
+        fits_read_key_dbl(fptr, "MIN2", &m_Statistics.min[1], nullptr, &status);
+        fits_read_key_dbl(fptr, "MIN3", &m_Statistics.min[2], nullptr, &status);
 
         status = 0;
 
-        // Only fetch from header if we have a single channel
-        // Otherwise, calculate manually.
-        if (fptr != nullptr && !refresh)
-        {
-
-            status = 0;
-
-            if (fits_read_key_dbl(fptr, "DATAMIN", &(m_Statistics.min[0]), nullptr, &status) == 0)
-                nfound++;
-            else if (fits_read_key_dbl(fptr, "MIN1", &(m_Statistics.min[0]), nullptr, &status) == 0)
-                nfound++;
-
-            // NB. These could fail if missing, which is OK.
-            fits_read_key_dbl(fptr, "MIN2", &m_Statistics.min[1], nullptr, &status);
-            fits_read_key_dbl(fptr, "MIN3", &m_Statistics.min[2], nullptr, &status);
-
-            status = 0;
-
-            if (fits_read_key_dbl(fptr, "DATAMAX", &(m_Statistics.max[0]), nullptr, &status) == 0)
-                nfound++;
-            else if (fits_read_key_dbl(fptr, "MAX1", &(m_Statistics.max[0]), nullptr, &status) == 0)
-                nfound++;
-
-            // NB. These could fail if missing, which is OK.
-            fits_read_key_dbl(fptr, "MAX2", &m_Statistics.max[1], nullptr, &status);
-            fits_read_key_dbl(fptr, "MAX3", &m_Statistics.max[2], nullptr, &status);
-
-            // If we found both keywords, no need to calculate them, unless they are both zeros
-            if (nfound == 2 && !(m_Statistics.min[0] == 0 && m_Statistics.max[0] == 0))
-                return;
-        }
-
-        m_Statistics.min[0] = 1.0E30;
-        m_Statistics.max[0] = -1.0E30;
-
-        m_Statistics.min[1] = 1.0E30;
-        m_Statistics.max[1] = -1.0E30;
-
-        m_Statistics.min[2] = 1.0E30;
-        m_Statistics.max[2] = -1.0E30;
-
-        switch (m_Statistics.dataType)
-        {
-            case TBYTE:
-                calculateMinMax<uint8_t>();
-                break;
-
-            case TSHORT:
-                calculateMinMax<int16_t>();
-                break;
-
-            case TUSHORT:
-                calculateMinMax<uint16_t>();
-                break;
-
-            case TLONG:
-                calculateMinMax<int32_t>();
-                break;
-
-            case TULONG:
-                calculateMinMax<uint32_t>();
-                break;
-
-            case TFLOAT:
-                calculateMinMax<float>();
-                break;
-
-            case TLONGLONG:
-                calculateMinMax<int64_t>();
-                break;
-
-            case TDOUBLE:
-                calculateMinMax<double>();
-                break;
-
-            default:
-                break;
-        }
-    }
-    else
-    {
-        m_ROIStatistics.min[0] = 1.0E30;
-        m_ROIStatistics.max[0] = -1.0E30;
-
-        m_ROIStatistics.min[1] = 1.0E30;
-        m_ROIStatistics.max[1] = -1.0E30;
-
-        m_ROIStatistics.min[2] = 1.0E30;
-        m_ROIStatistics.max[2] = -1.0E30;
-
-        switch (m_Statistics.dataType)
-        {
-            case TBYTE:
-                calculateMinMax<uint8_t>(roi);
-                break;
-
-            case TSHORT:
-                calculateMinMax<int16_t>(roi);
-                break;
-
-            case TUSHORT:
-                calculateMinMax<uint16_t>(roi);
-                break;
-
-            case TLONG:
-                calculateMinMax<int32_t>(roi);
-                break;
-
-            case TULONG:
-                calculateMinMax<uint32_t>(roi);
-                break;
-
-            case TFLOAT:
-                calculateMinMax<float>(roi);
-                break;
-
-            case TLONGLONG:
-                calculateMinMax<int64_t>(roi);
-                break;
-
-            case TDOUBLE:
-                calculateMinMax<double>(roi);
-                break;
-
-            default:
-                break;
-        }
+        if (fits_read_key_dbl(fptr, "DATAMAX", &(m_Statistics.max[0]), nullptr, &status) == 0)
+            nfound++;
+        else if (fits_read_key_dbl(fptr, "MAX1", &(m_Statistics.max[0]), nullptr, &status) == 0)
+            nfound++;
 
-    }
-}
+        // NB. These could fail if missing, which is OK.
+        fits_read_key_dbl(fptr, "MAX2", &m_Statistics.max[1], nullptr, &status);
+        fits_read_key_dbl(fptr, "MAX3", &m_Statistics.max[2], nullptr, &status);
 
-void FITSData::calculateMedian(bool refresh, bool roi)
-{
-    if(!roi)
-    {
-        int status, nfound = 0;
+        // If we found both keywords, no need to calculate them, unless they are both zeros
+        if (nfound == 2 && !(m_Statistics.min[0] == 0 && m_Statistics.max[0] == 0))
+            fields &= ~FITSStatistics::MIN_MAX;
 
         status = 0;
-
-        // Only fetch from header if we have a single channel
-        // Otherwise, calculate manually.
-        if (fptr != nullptr && !refresh)
+        if (fits_read_key_dbl(fptr, "MEDIAN1", &m_Statistics.median[0], nullptr, &status) == 0)
         {
-            status = 0;
-            if (fits_read_key_dbl(fptr, "MEDIAN1", &m_Statistics.median[0], nullptr, &status) == 0)
-                nfound++;
-
             // NB. These could fail if missing, which is OK.
             fits_read_key_dbl(fptr, "MEDIAN2", &m_Statistics.median[1], nullptr, &status);
             fits_read_key_dbl(fptr, "MEDIAN3", &m_Statistics.median[2], nullptr, &status);
-
-            if (nfound == 1)
-                return;
+            fields &= ~FITSStatistics::MEDIAN;
         }
 
-        m_Statistics.median[RED_CHANNEL] = 0;
-        m_Statistics.median[GREEN_CHANNEL] = 0;
-        m_Statistics.median[BLUE_CHANNEL] = 0;
-
-        switch (m_Statistics.dataType)
-        {
-            case TBYTE:
-                calculateMedian<uint8_t>();
-                break;
-
-            case TSHORT:
-                calculateMedian<int16_t>();
-                break;
-
-            case TUSHORT:
-                calculateMedian<uint16_t>();
-                break;
-
-            case TLONG:
-                calculateMedian<int32_t>();
-                break;
-
-            case TULONG:
-                calculateMedian<uint32_t>();
-                break;
-
-            case TFLOAT:
-                calculateMedian<float>();
-                break;
-
-            case TLONGLONG:
-                calculateMedian<int64_t>();
-                break;
+        status = 0;
+        nfound = 0;
+        if (fits_read_key_dbl(fptr, "MEAN1", &m_Statistics.mean[0], nullptr, &status) == 0)
+            nfound++;
+        // NB. These could fail if missing, which is OK.
+        fits_read_key_dbl(fptr, "MEAN2", & m_Statistics.mean[1], nullptr, &status);
+        fits_read_key_dbl(fptr, "MEAN3", &m_Statistics.mean[2], nullptr, &status);
 
-            case TDOUBLE:
-                calculateMedian<double>();
-                break;
+        status = 0;
+        if (fits_read_key_dbl(fptr, "STDDEV1", &m_Statistics.stddev[0], nullptr, &status) == 0)
+            nfound++;
+        // NB. These could fail if missing, which is OK.
+        fits_read_key_dbl(fptr, "STDDEV2", &m_Statistics.stddev[1], nullptr, &status);
+        fits_read_key_dbl(fptr, "STDDEV3", &m_Statistics.stddev[2], nullptr, &status);
 
-            default:
-                break;
-        }
+        if (nfound == 2)
+            fields &= ~FITSStatistics::MEAN_STDDEV;
     }
-    else
-    {
-        m_ROIStatistics.median[RED_CHANNEL] = 0;
-        m_ROIStatistics.median[GREEN_CHANNEL] = 0;
-        m_ROIStatistics.median[BLUE_CHANNEL] = 0;
 
-        switch (m_ROIStatistics.dataType)
+    // Calculate whatever is left in a single pass per channel
+    if (fields != 0)
+    {
+        switch (stats.dataType)
         {
             case TBYTE:
-                calculateMedian<uint8_t>(roi);
+                calculateStats<uint8_t>(stats, roi, fields);
                 break;
 
             case TSHORT:
-                calculateMedian<int16_t>(roi);
+                calculateStats<int16_t>(stats, roi, fields);
                 break;
 
             case TUSHORT:
-                calculateMedian<uint16_t>(roi);
+                calculateStats<uint16_t>(stats, roi, fields);
                 break;
 
             case TLONG:
-                calculateMedian<int32_t>(roi);
+                calculateStats<int32_t>(stats, roi, fields);
                 break;
 
             case TULONG:
-                calculateMedian<uint32_t>(roi);
+                calculateStats<uint32_t>(stats, roi, fields);
                 break;
 
             case TFLOAT:
-                calculateMedian<float>(roi);
+                calculateStats<float>(stats, roi, fields);
                 break;
 
             case TLONGLONG:
-                calculateMedian<int64_t>(roi);
+                calculateStats<int64_t>(stats, roi, fields);
                 break;
 
             case TDOUBLE:
-                calculateMedian<double>(roi);
+                calculateStats<double>(stats, roi, fields);
                 break;
 
             default:
-                break;
+                return;
         }
-
-    }
-}
-
-template <typename T>
-void FITSData::calculateMedian(bool roi)
-{
-    auto * buffer = reinterpret_cast<T *>(roi ? m_ImageRoiBuffer : m_ImageBuffer);
-    const uint32_t maxMedianSize = 500000;
-    uint32_t medianSize = roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel;
-    uint8_t downsample = 1;
-    if (medianSize > maxMedianSize)
-    {
-        downsample = (static_cast<double>(medianSize) / maxMedianSize) + 0.999;
-        medianSize /= downsample;
     }
-    // Ideally samples would be declared like this...
-    // std::vector<T> samples;
-    // Unfortunately this doesn't compile on Mac - see the comments in robuststatistics.cpp for more details
-    // So for now declare samples like this...
-    std::vector<int32_t> samples;
-    samples.reserve(medianSize);
 
-    for (uint8_t n = 0; n < m_Statistics.channels; n++)
-    {
-        auto *oneChannel = buffer + n * (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel);
-        for (uint32_t upto = 0; upto < (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel);
-                upto += downsample)
-            samples.push_back(oneChannel[upto]);
-        auto median = Mathematics::RobustStatistics::ComputeLocation(Mathematics::RobustStatistics::LOCATION_MEDIAN, samples);
-        roi ? m_ROIStatistics.median[n] = median : m_Statistics.median[n] = median;
-    }
+    // FIXME That's not really SNR, must implement a proper solution for this value
+    if (!roi)
+        m_Statistics.SNR = m_Statistics.mean[0] / m_Statistics.stddev[0];
 }
 
 template <typename T>
-QPair<T, T> FITSData::getParitionMinMax(uint32_t start, uint32_t stride, bool roi)
+void FITSData::calculateStats(Statistic &stats, bool roi, int fields)
 {
     auto * buffer = reinterpret_cast<T *>(roi ? m_ImageRoiBuffer : m_ImageBuffer);
-    T min = std::numeric_limits<T>::max();
-    T max = std::numeric_limits<T>::min();
-
-    uint32_t end = start + stride;
-
-    for (uint32_t i = start; i < end; i++)
-    {
-        min = qMin(buffer[i], min);
-        max = qMax(buffer[i], max);
-        //        if (buffer[i] < min)
-        //            min = buffer[i];
-        //        else if (buffer[i] > max)
-        //            max = buffer[i];
-    }
-
-    return qMakePair(min, max);
-}
-
-template <typename T>
-void FITSData::calculateMinMax(bool roi)
-{
-    T min = std::numeric_limits<T>::max();
-    T max = std::numeric_limits<T>::min();
-
-
-    // Create N threads
-    const uint8_t nThreads = 16;
+    const uint32_t samples = stats.samples_per_channel;
 
     for (int n = 0; n < m_Statistics.channels; n++)
     {
-        uint32_t cStart = n * (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel);
-
-        // Calculate how many elements we process per thread
-        uint32_t tStride = (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel) / nThreads;
-
-        // Calculate the final stride since we can have some left over due to division above
-        uint32_t fStride = tStride + ((roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel) -
-                                      (tStride * nThreads));
-
-        // Start location for inspecting elements
-        uint32_t tStart = cStart;
-
-        // List of futures
-        QList<QFuture<QPair<T, T>>> futures;
+        const FITSStatistics::ChannelStatistics channel =
+            FITSStatistics::computeChannel<T>(buffer + n * samples, samples, fields);
 
-        for (int i = 0; i < nThreads; i++)
+        if (fields & FITSStatistics::MIN_MAX)
         {
-            // Run threads
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            futures.append(QtConcurrent::run(&FITSData::getParitionMinMax<T>, this, tStart, (i == (nThreads - 1)) ? fStride : tStride,
-                                             roi));
-#else
-            futures.append(QtConcurrent::run(this, &FITSData::getParitionMinMax<T>, tStart, (i == (nThreads - 1)) ? fStride : tStride,
-                                             roi));
-#endif
-            tStart += tStride;
-        }
-
-        // Now wait for results
-        for (int i = 0; i < nThreads; i++)
-        {
-            QPair<T, T> result = futures[i].result();
-            min = qMin(result.first, min);
-            max = qMax(result.second, max);
+            stats.min[n] = channel.min;
+            stats.max[n] = channel.max;
         }
-
-        if(!roi)
-        {
-            m_Statistics.min[n] = min;
-            m_Statistics.max[n] = max;
-        }
-        else
+        if (fields & FITSStatistics::MEDIAN)
+            stats.median[n] = channel.median;
+        if (fields & FITSStatistics::MEAN_STDDEV)
         {
-            m_ROIStatistics.min[n] = min;
-            m_ROIStatistics.max[n] = max;
-        }
-    }
-
-}
-
-// This struct is used when returning results from the threaded getSumAndSquaredSum calculations
-// used to compute the mean and variance of the image.
-struct SumData
-{
-    double sum;
-    double squaredSum;
-    double numSamples;
-    SumData(double s, double sq, int n) : sum(s), squaredSum(sq), numSamples(n) {}
-    SumData() : sum(0), squaredSum(0), numSamples(0) {}
-};
-
-template <typename T>
-SumData getSumAndSquaredSum(uint32_t start, uint32_t stride, uint8_t *buff)
-{
-    auto * buffer = reinterpret_cast<T *>(buff);
-    const uint32_t end = start + stride;
-    double sum = 0;
-    double squaredSum = 0;
-    for (uint32_t i = start; i < end; i++)
-    {
-        double sample = buffer[i];
-        sum += sample;
-        squaredSum += sample * sample;
-    }
-    const double numSamples = end - start;
-    return SumData(sum, squaredSum, numSamples);
-}
-
-template <typename T>
-void FITSData::calculateStdDev(bool roi )
-{
-    // Create N threads
-    const uint8_t nThreads = 16;
-
-    for (int n = 0; n < m_Statistics.channels; n++)
-    {
-        uint32_t cStart = n * (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel);
-
-        // Calculate how many elements we process per thread
-        uint32_t tStride = (roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel) / nThreads;
-
-        // Calculate the final stride since we can have some left over due to division above
-        uint32_t fStride = tStride + ((roi ? m_ROIStatistics.samples_per_channel : m_Statistics.samples_per_channel) -
-                                      (tStride * nThreads));
-
-        // Start location for inspecting elements
-        uint32_t tStart = cStart;
-
-        // List of futures
-        QList<QFuture<SumData>> futures;
-
-        for (int i = 0; i < nThreads; i++)
-        {
-            // Run threads
-            uint8_t *buff = roi ? m_ImageRoiBuffer : m_ImageBuffer;
-            futures.append(QtConcurrent::run(&getSumAndSquaredSum<T>, tStart,
-                                             (i == (nThreads - 1)) ? fStride : tStride, buff));
-            tStart += tStride;
-        }
-
-        // Now wait for results
-        double sum = 0, squared_sum = 0;
-        double numSamples = 0;
-        for (int i = 0; i < nThreads; i++)
-        {
-            const SumData result = futures[i].result();
-            sum += result.sum;
-            squared_sum += result.squaredSum;
-            numSamples += result.numSamples;
-
-        }
-        if (numSamples <= 0) continue;
-        const double mean = sum / numSamples;
-        const double variance = squared_sum / numSamples - mean * mean;
-        if(!roi)
-        {
-            m_Statistics.mean[n]   = mean;
-            m_Statistics.stddev[n] = sqrt(variance);
-        }
-        else
-        {
-            m_ROIStatistics.mean[n] = mean;
-            m_ROIStatistics.stddev[n] = sqrt(variance);
+            stats.mean[n] = channel.mean;
+            stats.stddev[n] = channel.stddev;
         }
     }
 }
@@ -4320,7 +4041,7 @@ void FITSData::applyFilter(FITSScale type, uint8_t * targetImage, QVector<double
                     m_Statistics.min[i] = min[i];
                     m_Statistics.max[i] = max[i];
                 }
-                calculateStdDev<T>();
+                calculateStats<T>(m_Statistics, false, FITSStatistics::MEAN_STDDEV);
             }
         }
         break;
@@ -4424,7 +4145,7 @@ void FITSData::applyFilter(FITSScale type, uint8_t * targetImage, QVector<double
             delete[] extension;
 
             if (calcStats)
-                calculateStdDev<T>();
+                calculateStats<T>(m_Statistics, false, FITSStatistics::MEAN_STDDEV);
         }
         break;
 
@@ -5610,7 +5331,7 @@ bool FITSData::rotFITS(int rotate, int mirror)
         }
     }
 
-    delete[] m_ImageBuffer;
+    releaseImageBuffer();
     m_ImageBuffer = rotimage;
 
     return true;
@@ -5901,6 +5622,7 @@ void FITSData::rotWCSFITS(int angle, int mirror)
 
 uint8_t * FITSData::getWritableImageBuffer()
 {
+    m_DataGeneration++;
     return m_ImageBuffer;
 }
 
@@ -5911,8 +5633,9 @@ uint8_t const * FITSData::getImageBuffer() const
 
 void FITSData::setImageBuffer(uint8_t * buffer)
 {
-    delete[] m_ImageBuffer;
+    releaseImageBuffer();
     m_ImageBuffer = buffer;
+    m_DataGeneration++;
 }
 
 bool FITSData::checkDebayer()
@@ -6104,6 +5827,7 @@ void FITSData::setBayerParams(BayerParams * param)
 
 bool FITSData::debayer(bool reload)
 {
+    m_DataGeneration++;
     if (reload)
     {
         int anynull = 0, status = 0;
@@ -6183,7 +5907,7 @@ bool FITSData::debayer_8bit()
 
     if (m_ImageBufferSize != rgb_size)
     {
-        delete[] m_ImageBuffer;
+        releaseImageBuffer();
         try
         {
             m_ImageBuffer = new uint8_t[rgb_size];
@@ -6275,7 +5999,7 @@ bool FITSData::debayer_16bit()
 
     if (m_ImageBufferSize != rgb_size)
     {
-        delete[] m_ImageBuffer;
+        releaseImageBuffer();
         try
         {
             m_ImageBuffer = new uint8_t[rgb_size];
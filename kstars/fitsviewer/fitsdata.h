@@ -42,6 +42,8 @@
 #include <QTimer>
 #include <QQueue>
 
+#include <atomic>
+
 #ifndef KSTARS_LITE
 #include <kxmlguiwindow.h>
 #ifdef HAVE_WCSLIB
@@ -50,6 +52,7 @@
 #endif
 
 #include "fitsskyobject.h"
+#include "framebufferpool.h"
 #include "fitsdirwatcher.h"
 #if !defined (KSTARS_LITE) && defined (HAVE_WCSLIB) && defined (HAVE_OPENCV)
 #include "fitsstack.h"
@@ -128,6 +131,14 @@ class FITSData : public QObject
          */
         bool loadFromBuffer(const QByteArray &buffer);
 
+        /**
+         * @brief loadFromBuffer Loading an image from a frame buffer without copying it.
+         * @param frame The frame buffer containing the image. It is only read while loading, so it may go
+         * back to the pool as soon as this returns.
+         * @return bool indicating success or failure.
+         */
+        bool loadFromBuffer(const QSharedPointer<FrameBuffer> &frame);
+
         /**
          * @brief parseSolution Parse the WCS solution information from the header into the given struct.
          * @param solution Solution structure to fill out.
@@ -143,6 +154,12 @@ class FITSData : public QObject
         void setImageBuffer(uint8_t *buffer);
         uint8_t const *getImageBuffer() const;
         uint8_t *getWritableImageBuffer();
+        // Incremented whenever the image data may have changed without a reload: a new buffer, a writer of the
+        // buffer or debayering
+        uint32_t dataGeneration() const
+        {
+            return m_DataGeneration;
+        }
 
         ////////////////////////////////////////////////////////////////////////////////////////
         ////////////////////////////////////////////////////////////////////////////////////////
@@ -930,8 +947,10 @@ class FITSData : public QObject
         bool loadRAWImage(const QByteArray &buffer);
 
         void rotWCSFITS(int angle, int mirror);
-        void calculateMinMax(bool refresh = false, bool roi = false);
-        void calculateMedian(bool refresh = false, bool roi = false);
+        /* Map the image data of an uncompressed FITS file on disk into m_ImageBuffer, converting it in place */
+        bool mapImageData(int bitpix);
+        /* Free m_ImageBuffer, whether allocated or mapped */
+        void releaseImageBuffer();
         bool checkDebayer();
         void readWCSKeys();
 
@@ -970,13 +989,9 @@ class FITSData : public QObject
         template <typename T>
         void applyFilter(FITSScale type, uint8_t *targetImage, QVector<double> * min = nullptr, QVector<double> * max = nullptr);
 
+        /* Calculate the requested FITSStatistics::Fields for each channel in a single pass */
         template <typename T>
-        void calculateMinMax(bool roi = false);
-        template <typename T>
-        void calculateMedian(bool roi = false);
-
-        template <typename T>
-        QPair<T, T> getParitionMinMax(uint32_t start, uint32_t stride, bool roi);
+        void calculateStats(Statistic &stats, bool roi, int fields);
 
         /* Calculate the Gaussian blur matrix and apply it to the image using the convolution filter */
         QVector<double> createGaussianKernel(int size, double sigma);
@@ -985,10 +1000,6 @@ class FITSData : public QObject
         template <typename T>
         void gaussianBlur(int kernelSize, double sigma);
 
-        /* Calculate running average & standard deviation */
-        template <typename T>
-        void calculateStdDev( bool roi = false );
-
         template <typename T>
         void convertToQImage(double dataMin, double dataMax, double scale, double zero, QImage &image);
 
@@ -1165,6 +1176,12 @@ class FITSData : public QObject
         uint8_t *m_ImageBuffer { nullptr };
         /// Above buffer size in bytes
         uint32_t m_ImageBufferSize { 0 };
+        /// See dataGeneration()
+        std::atomic<uint32_t> m_DataGeneration { 0 };
+        /// File holding m_ImageBuffer when the image data is mapped rather than read
+        QFile m_MappedFile;
+        /// Start of the file mapping, m_ImageBuffer points to the image data within it
+        uchar *m_MappedData { nullptr };
         /// Image Buffer if Selection is to be done
         uint8_t *m_ImageRoiBuffer { nullptr };
         /// Above buffer size in bytes
@@ -17,6 +17,9 @@
 #include <wcshdr.h>
 #include <fitsio.h>
 
+// Number of pixels sigma clipped between checks for a cancel request
+constexpr int SIGMA_CLIP_CANCEL_PIXELS = 1024;
+
 /**
  * @file fitsstack.cpp
  * @brief Implementation of the FITSStack class used in the KStars Live Stacker module.
@@ -66,6 +69,13 @@ FITSStack::~FITSStack()
 {
     tidyUpInitalStack();
     tidyUpRunningStack();
+
+    // Sigma clip buffers may point into the spill's scratch files so release them first
+    m_SigmaClip32FC4.clear();
+    m_StreamStats32FC4.clear();
+    m_StreamReservoir32F.clear();
+    m_Spill.reset();
+
     if (m_WCSStackImage)
     {
         wcsfree(m_WCSStackImage);
@@ -111,6 +121,8 @@ bool FITSStack::addSub(void * imageBuffer, const int cvType, const int width, co
                        const int bytesPerPixel, double &snr)
 {
     snr = -1;
+    QElapsedTimer timer;
+    timer.start();
     try
     {
         int channels = CV_MAT_CN(cvType);
@@ -169,7 +181,24 @@ bool FITSStack::addSub(void * imageBuffer, const int cvType, const int width, co
             subs += m_RunningStackImageData.numSubs;
         m_MeanSubSNR = ((m_MeanSubSNR * (subs - 1)) + snr) / subs;
 
+        if (useOutOfCore())
+        {
+            // Out-of-core stacking so write the sub to disk rather than hold it in memory
+            if (!m_Spill)
+                m_Spill.reset(new FITSStackSpill(newImage.rows, newImage.cols, m_Channels));
+            int index = m_Spill->addSub(newImage);
+            if (index < 0)
+            {
+                qCDebug(KSTARS_FITS) << QString("%1 Unable to spill sub to disk").arg(__FUNCTION__);
+                return false;
+            }
+            m_StackImageData.last().spillIndex = index;
+            m_StageTimes.load += timer.nsecsElapsed() / 1e6;
+            return true;
+        }
+
         m_StackImageData.last().image = newImage;
+        m_StageTimes.load += timer.nsecsElapsed() / 1e6;
         return true;
     }
     catch (const cv::Exception &ex)
@@ -457,7 +486,7 @@ bool FITSStack::stack()
 {
     try
     {
-        QElapsedTimer timer;
+        QElapsedTimer timer, stageTimer;
         timer.start();
         int numSubs = m_StackImageData.size();
 
@@ -473,14 +502,23 @@ bool FITSStack::stack()
                                                                             LSStatus::LSStatusOK) };
             emit updateStackMon(subs, infos);
 
+            // Out-of-core subs are read back from disk for calibration and alignment
+            const bool spilled = m_StackImageData[i].spillIndex >= 0 && m_Spill;
+            if (spilled && (!m_StackImageData[i].isCalibrated || !m_StackImageData[i].isAligned))
+                m_StackImageData[i].image = m_Spill->readSub(m_StackImageData[i].spillIndex);
+
             // Calibrate sub
             if (!m_StackImageData[i].isCalibrated)
             {
-                if (calibrateSub(m_StackImageData[i].sub, m_StackImageData[i].image))
+                stageTimer.start();
+                const bool calibrated = calibrateSub(m_StackImageData[i].sub, m_StackImageData[i].image);
+                m_StageTimes.calibrate += stageTimer.nsecsElapsed() / 1e6;
+                if (calibrated)
                     m_StackImageData[i].isCalibrated = true;
                 else
                 {
                     m_StackImageData[i].status = CALIBRATION_FAILED;
+                    m_StackImageData[i].image.release();
                     continue;
                 }
             }
@@ -492,6 +530,7 @@ bool FITSStack::stack()
             {
                 // Align this image to the reference image
                 cv::Mat warp, warpedImage;
+                stageTimer.start();
                 bool ok = calcWarpMatrix(m_AlignMasterWCS.get(), m_StackImageData[i].wcsprm, warp);
                 if (!ok)
                     m_StackImageData[i].status = ALIGNMENT_FAILED;
@@ -502,6 +541,7 @@ bool FITSStack::stack()
                     m_StackImageData[i].image = warpedImage;
                     m_StackImageData[i].isAligned = true;
                 }
+                m_StageTimes.align += stageTimer.nsecsElapsed() / 1e6;
 
                 // Signal the Alignment stage complete to Stack Monitor
                 double dx, dy, rotationDeg;
@@ -515,16 +555,29 @@ bool FITSStack::stack()
                 QVector<LiveStackFile> subs { m_StackImageData[i].sub };
                 emit updateStackMon(subs, infos);
             }
+
+            // Write the calibrated, aligned sub back to disk and release the memory
+            if (spilled && !m_StackImageData[i].image.empty())
+            {
+                if (!m_Spill->writeSub(m_StackImageData[i].spillIndex, m_StackImageData[i].image))
+                    m_StackImageData[i].status = ALIGNMENT_FAILED;
+                m_StackImageData[i].image.release();
+            }
         }
         // Stack the aligned subs
         float totalWeight = 0.0;
-        stackSubs(true, totalWeight, m_StackedImage32F);
+        stageTimer.start();
+        bool stacked = stackSubs(true, totalWeight, m_StackedImage32F);
+        m_StageTimes.stack += stageTimer.nsecsElapsed() / 1e6;
 
-        if (m_StackData.numInMem <= m_StackImageData.size())
+        // A streaming stack doesn't need a full set of subs to start so move straight to running stacking
+        if (m_StackData.numInMem <= m_StackImageData.size() || (stacked && useStreaming()))
         {
             // We've completed the initial stack so perform post processing such as sharpening / denoising
+            stageTimer.start();
             cv::Mat finalImage = postProcessImage(m_StackedImage32F);
             finalImage.copyTo(m_StackedImageFinal);
+            m_StageTimes.postProcess += stageTimer.nsecsElapsed() / 1e6;
             // Move to incremental stacking as new subs arrive
             setupRunningStack(m_StackImageData.size(), totalWeight);
         }
@@ -548,7 +601,7 @@ bool FITSStack::stackn()
 {
     try
     {
-        QElapsedTimer timer;
+        QElapsedTimer timer, stageTimer;
         timer.start();
         int numSubs = m_StackImageData.size();
 
@@ -567,7 +620,10 @@ bool FITSStack::stackn()
             // Calibrate sub
             if (!m_StackImageData[i].isCalibrated)
             {
-                if (calibrateSub(m_StackImageData[i].sub, m_StackImageData[i].image))
+                stageTimer.start();
+                const bool calibrated = calibrateSub(m_StackImageData[i].sub, m_StackImageData[i].image);
+                m_StageTimes.calibrate += stageTimer.nsecsElapsed() / 1e6;
+                if (calibrated)
                     m_StackImageData[i].isCalibrated = true;
                 else
                 {
@@ -583,6 +639,7 @@ bool FITSStack::stackn()
                 m_StackImageData[i].isAligned = true;
             else
             {
+                stageTimer.start();
                 bool ok = calcWarpMatrix(m_AlignMasterWCS.get(), m_StackImageData[i].wcsprm, warp);
                 if (!ok)
                     m_StackImageData[i].status = ALIGNMENT_FAILED;
@@ -593,6 +650,7 @@ bool FITSStack::stackn()
                     m_StackImageData[i].image = warpedImage;
                     m_StackImageData[i].isAligned = true;
                 }
+                m_StageTimes.align += stageTimer.nsecsElapsed() / 1e6;
 
                 // Signal the Alignment stage complete to Stack Monitor
                 double dx, dy, rotationDeg;
@@ -609,12 +667,17 @@ bool FITSStack::stackn()
         }
         // Stack the aligned subs
         float totalWeight = m_RunningStackImageData.totalWeight;
-        if (stackSubs(false, totalWeight, m_StackedImage32F))
+        stageTimer.start();
+        const bool stacked = stackSubs(false, totalWeight, m_StackedImage32F);
+        m_StageTimes.stack += stageTimer.nsecsElapsed() / 1e6;
+        if (stacked)
         {
             // Perform any post stacking processing such as sharpening / denoising
+            stageTimer.start();
             cv::Mat finalImage = postProcessImage(m_StackedImage32F);
 
             finalImage.copyTo(m_StackedImageFinal);
+            m_StageTimes.postProcess += stageTimer.nsecsElapsed() / 1e6;
         }
 
         updateRunningStack(m_StackImageData.size(), totalWeight);
@@ -803,7 +866,13 @@ bool FITSStack::stackSubs(const bool initial, float &totalWeight, cv::Mat &stack
             m_StackData.stackingMethod == LiveStackStackingMethod::WINDSOR)
         {
             // Sigma clipping (standard or Windsorized
-            if (initial)
+            if (useStreaming())
+            {
+                stack = stackSubsStreaming(weights);
+                for (const auto &weight : weights)
+                    totalWeight += weight;
+            }
+            else if (initial)
                 stack = stackSubsSigmaClipping(weights);
             else
                 stack = stacknSubsSigmaClipping(weights);
@@ -923,6 +992,11 @@ cv::Mat FITSStack::stackSubsSigmaClipping(const QVector<float> &weights)
             return cv::Mat();
         }
 
+        // If the subs have been spilled to disk then process them a band at a time
+        if (m_Spill && std::all_of(m_StackImageData.begin(), m_StackImageData.end(),
+                                   [](const StackImageData &data) { return data.spillIndex >= 0; }))
+            return stackSubsSigmaClippingTiled(weights);
+
         int rows = m_StackImageData[0].image.rows;
         int cols = m_StackImageData[0].image.cols;
         int numImages = m_StackImageData.size();
@@ -958,8 +1032,9 @@ cv::Mat FITSStack::stackSubsSigmaClipping(const QVector<float> &weights)
                 pixelChunks.append(qMakePair(start, end));
             }
 
-            qCDebug(KSTARS_FITS) << QString("Starting sigma clipping: %1 chunks on %2 threads")
-                                                .arg(pixelChunks.size()).arg(QThread::idealThreadCount());
+            qCDebug(KSTARS_FITS) << QString("Starting sigma clipping: %1 chunks on %2 threads (%3)")
+                                                .arg(pixelChunks.size()).arg(QThread::idealThreadCount())
+                                                .arg(LiveStackKernels::simdLevel());
 
             // Get pointers once (since rows=1)
             std::vector<const float *> imagesPtrs(numImages);
@@ -974,14 +1049,15 @@ cv::Mat FITSStack::stackSubsSigmaClipping(const QVector<float> &weights)
             // Setup the function for parallel processing to handle a chunk of pixels
             auto processPixelChunk = [&](const QPair<int, int>& chunk)
             {
-                for (int x = chunk.first; x < chunk.second; x++)
+                for (int x = chunk.first; x < chunk.second; x += SIGMA_CLIP_CANCEL_PIXELS)
                 {
-                    // Cancellation check every once per 100 iterations
-                    if ((x - chunk.first) % 100 == 0 && QThread::currentThread()->isInterruptionRequested())
+                    // Cancellation check between each batch of pixels
+                    if (QThread::currentThread()->isInterruptionRequested())
                         return;
 
-                    // Process the pixel
-                    stackSigmaClipPixel(x, imagesPtrs, finalImagePtr, sigmaClipPtr, weights);
+                    // Process the batch of pixels
+                    stackSigmaClipPixels(x, std::min(x + SIGMA_CLIP_CANCEL_PIXELS, chunk.second), imagesPtrs,
+                                         finalImagePtr, sigmaClipPtr, weights);
                 }
             };
 
@@ -991,8 +1067,6 @@ cv::Mat FITSStack::stackSubsSigmaClipping(const QVector<float> &weights)
         {
             qCDebug(KSTARS_FITS) << QString("Starting single thread sigma clipping");
 
-            std::vector<float> values(numImages);
-
             // Process each pixel position
             std::vector<const float *> imagesPtrs(numImages);
             for (int y = 0; y < rows; y++)
@@ -1005,172 +1079,261 @@ cv::Mat FITSStack::stackSubsSigmaClipping(const QVector<float> &weights)
                 for (int ch = 0; ch < m_Channels; ch++)
                     sigmaClipPtr[ch] = m_SigmaClip32FC4[ch].ptr<cv::Vec4f>(y);
 
-                for (int x = 0; x < cols; x++)
-                {
-                    // Process the pixel
-                    stackSigmaClipPixel(x, imagesPtrs, finalImagePtr, sigmaClipPtr, weights);
+                // Process the row
+                stackSigmaClipPixels(0, cols, imagesPtrs, finalImagePtr, sigmaClipPtr, weights);
+            }
+        }
+        qCDebug(KSTARS_FITS) << QString("Sigma clipping completed in %1 ms").arg(timer.elapsed());
+        return finalImage;
+    }
+    catch (const cv::Exception &ex)
+    {
+        QString s1 = ex.what();
+        qCDebug(KSTARS_FITS) << QString("openCV exception %1 called from %2").arg(s1).arg(__FUNCTION__);
+        return cv::Mat();
+    }
+}
 
-                    // Collect values for this pixel/channel from all images
-                    for (int ch = 0; ch < m_Channels; ch++)
-                    {
-                        for (int image = 0; image < numImages; image++)
-                            values[image] = imagesPtrs[image][x * m_Channels + ch];
+// Out-of-core sigma clipping. Subs are memory mapped from the disk spill in bands of rows
+// sized so the bands from all subs fit in the user's memory budget. Each band is processed
+// in parallel with stackSigmaClipPixels so the results match the in-memory path.
+cv::Mat FITSStack::stackSubsSigmaClippingTiled(const QVector<float> &weights)
+{
+    try
+    {
+        QElapsedTimer timer;
+        timer.start();
 
-                        float pixelValue = 0.0;
+        const int rows = m_Spill->rows();
+        const int cols = m_Spill->cols();
+        const int numImages = m_StackImageData.size();
+        cv::Mat finalImage = cv::Mat::zeros(rows, cols, m_CVType);
 
-                        if (m_StackData.stackingMethod == LiveStackStackingMethod::WINDSOR)
-                        {
-                            // Winsorize the data
-                            float median = Mathematics::RobustStatistics::ComputeLocation(
-                                                    Mathematics::RobustStatistics::LOCATION_MEDIAN, values);
-                            auto const stddev = std::sqrt(Mathematics::RobustStatistics::ComputeScale(
-                                                    Mathematics::RobustStatistics::SCALE_VARIANCE, values));
-
-                            float lower = std::max(0.0, median - (stddev * m_StackData.windsorCutoff));
-                            float upper = median + (stddev * m_StackData.windsorCutoff);
-
-                            for (unsigned int i = 0; i < values.size(); i++)
-                            {
-                                if (values[i] < lower)
-                                    values[i] = lower;
-                                else if (values[i] > upper)
-                                    values[i] = upper;
-                            }
-                        }
+        // The sigma clip side buffers are needed for the running stack. They live in memory
+        // mapped scratch files but are written for every pixel so they still count against the budget
+        m_SigmaClip32FC4.clear();
+        m_Spill->releaseScratch();
+        m_SigmaClip32FC4.resize(m_Channels);
+        for (int ch = 0; ch < m_Channels; ch++)
+        {
+            m_SigmaClip32FC4[ch] = m_Spill->createScratchMat(rows, cols, CV_32FC4);
+            if (m_SigmaClip32FC4[ch].empty())
+            {
+                qCDebug(KSTARS_FITS) << QString("%1 Unable to create sigma clip scratch buffer").arg(__FUNCTION__);
+                m_SigmaClip32FC4[ch] = cv::Mat::zeros(rows, cols, CV_32FC4);
+            }
+        }
 
-                        // Now process the data
-                        float median = Mathematics::RobustStatistics::ComputeLocation(
-                                                    Mathematics::RobustStatistics::LOCATION_MEDIAN, values);
+        // Work out how many rows of every sub fit in the memory budget once the final image
+        // and the sigma clip side buffers, which are held for the whole stack, are taken out
+        const qint64 pixels = static_cast<qint64>(rows) * cols;
+        const qint64 fixedBytes = pixels * m_Channels * static_cast<qint64>(sizeof(float) + sizeof(cv::Vec4f));
+        const qint64 budget = std::max<qint64>(0, static_cast<qint64>(m_StackData.memBudgetMB) * 1024 * 1024 - fixedBytes);
+        const qint64 bandBytes = std::max<qint64>(1, m_Spill->rowBytes() * numImages);
+        const int bandRows = static_cast<int>(std::clamp<qint64>(budget / bandBytes, 1, rows));
 
-                        float sum = 0.0, weightSum = 0.0, lower = -1.0, upper = -1.0;
-                        if (values.size() <= 3)
-                            // For small samples just use median
-                            pixelValue = median;
-                        else
-                        {
-                            // Sigma clipping
-                            auto const stddev = std::sqrt(Mathematics::RobustStatistics::ComputeScale(
-                                                    Mathematics::RobustStatistics::SCALE_VARIANCE, values));
-
-                            // Get the lower and upper bounds
-                            lower = std::max(0.0, median - (stddev * m_StackData.lowSigma));
-                            upper = median + (stddev * m_StackData.highSigma);
-
-                            for (unsigned int i = 0; i < values.size(); i++)
-                            {
-                                if (values[i] < lower || values[i] > upper)
-                                    continue;
-
-                                sum += values[i] * weights[i];
-                                weightSum += weights[i];
-                            }
-
-                            if (weightSum > 0.0)
-                                pixelValue = sum / weightSum;
-                            else
-                                pixelValue = median;
-                        }
-                        // Store intermediate calcs from this process, necessary for processing new subs
-                        cv::Vec4f sigmaClip;
-                        sigmaClip[0] = lower;
-                        sigmaClip[1] = upper;
-                        sigmaClip[2] = sum;
-                        sigmaClip[3] = weightSum;
-                        sigmaClipPtr[ch][x] = sigmaClip;
-
-                        // Update the pixel/channel with the calculated value
-                        finalImagePtr[x * m_Channels + ch] = pixelValue;
-                    }
+        qCDebug(KSTARS_FITS) << QString("Starting out-of-core sigma clipping: %1 subs in bands of %2 rows")
+                                .arg(numImages).arg(bandRows);
+
+        std::vector<const float *> imagesPtrs(numImages);
+        QVector<cv::Vec4f *> sigmaClipPtr(m_Channels);
+        for (int startRow = 0; startRow < rows; startRow += bandRows)
+        {
+            const int numRows = std::min(bandRows, rows - startRow);
+            for (int i = 0; i < numImages; i++)
+            {
+                imagesPtrs[i] = m_Spill->mapSubRows(m_StackImageData[i].spillIndex, startRow, numRows);
+                if (imagesPtrs[i] == nullptr)
+                {
+                    m_Spill->unmapSubs();
+                    qCDebug(KSTARS_FITS) << QString("%1 Unable to map sub %2 rows %3-%4").arg(__FUNCTION__)
+                                            .arg(i).arg(startRow).arg(startRow + numRows);
+                    return cv::Mat();
                 }
             }
+
+            float* finalImagePtr = finalImage.ptr<float>(startRow);
+            for (int ch = 0; ch < m_Channels; ch++)
+                sigmaClipPtr[ch] = m_SigmaClip32FC4[ch].ptr<cv::Vec4f>(startRow);
+
+            // Chunk up the band for available threads
+            const int bandPixels = numRows * cols;
+            const int chunkSize = std::max(1, bandPixels / (QThread::idealThreadCount() * 2));
+            QVector<QPair<int, int>> pixelChunks;
+            for (int start = 0; start < bandPixels; start += chunkSize)
+                pixelChunks.append(qMakePair(start, std::min(start + chunkSize, bandPixels)));
+
+            auto processPixelChunk = [&](const QPair<int, int>& chunk)
+            {
+                for (int x = chunk.first; x < chunk.second; x += SIGMA_CLIP_CANCEL_PIXELS)
+                {
+                    // Cancellation check between each batch of pixels
+                    if (QThread::currentThread()->isInterruptionRequested())
+                        return;
+
+                    stackSigmaClipPixels(x, std::min(x + SIGMA_CLIP_CANCEL_PIXELS, chunk.second), imagesPtrs,
+                                         finalImagePtr, sigmaClipPtr, weights);
+                }
+            };
+
+            QtConcurrent::blockingMap(pixelChunks, processPixelChunk);
+            m_Spill->unmapSubs();
         }
-        qCDebug(KSTARS_FITS) << QString("Sigma clipping completed in %1 ms").arg(timer.elapsed());
+        qCDebug(KSTARS_FITS) << QString("Out-of-core sigma clipping completed in %1 ms").arg(timer.elapsed());
         return finalImage;
     }
     catch (const cv::Exception &ex)
     {
+        m_Spill->unmapSubs();
         QString s1 = ex.what();
         qCDebug(KSTARS_FITS) << QString("openCV exception %1 called from %2").arg(s1).arg(__FUNCTION__);
         return cv::Mat();
     }
 }
 
-// This function does the pixel level sigma clipping and Winsorization
-void FITSStack::stackSigmaClipPixel(int x, const std::vector<const float *> &imagesPtrs, float* finalImagePtr,
-                                    const QVector<cv::Vec4f *> &sigmaClipPtr, const QVector<float> &weights)
+// Out-of-core stacking is used for the initial sigma clipping stack when the subs held in memory
+// would exceed the user's memory budget. A budget of 0 means always stack in memory.
+bool FITSStack::useOutOfCore() const
 {
-    int numImages = imagesPtrs.size();
-    std::vector<float> values(numImages);
+    if (m_StackData.memBudgetMB <= 0 || getInitialStackDone() || useStreaming())
+        return false;
+
+    if (m_StackData.stackingMethod != LiveStackStackingMethod::SIGMA &&
+            m_StackData.stackingMethod != LiveStackStackingMethod::WINDSOR)
+        return false;
+
+    const qint64 subBytes = static_cast<qint64>(m_Width) * m_Height * m_Channels * sizeof(float);
+    const qint64 budget = static_cast<qint64>(m_StackData.memBudgetMB) * 1024 * 1024;
+    return subBytes * m_StackData.numInMem > budget;
+}
+
+// This function does the pixel level sigma clipping and Winsorization for pixels [start, end).
+// The work is done by the vectorized kernel in LiveStackKernels
+void FITSStack::stackSigmaClipPixels(int start, int end, const std::vector<const float *> &imagesPtrs,
+                                     float* finalImagePtr, const QVector<cv::Vec4f *> &sigmaClipPtr,
+                                     const QVector<float> &weights)
+{
+    const LiveStackKernels::SigmaClipParams params = sigmaClipParams();
+
+    // cv::Vec4f is laid out as 4 contiguous floats
+    std::vector<float *> sigmaClip(m_Channels);
     for (int ch = 0; ch < m_Channels; ch++)
-    {
-        for (int image = 0; image < numImages; image++)
-            values[image] = imagesPtrs[image][x * m_Channels + ch];
+        sigmaClip[ch] = reinterpret_cast<float *>(sigmaClipPtr[ch]);
+
+    LiveStackKernels::sigmaClip(imagesPtrs, weights.constData(), m_Channels, start, end, params, finalImagePtr,
+                                sigmaClip.data());
+}
+
+LiveStackKernels::SigmaClipParams FITSStack::sigmaClipParams() const
+{
+    LiveStackKernels::SigmaClipParams params;
+    params.winsorize = (m_StackData.stackingMethod == LiveStackStackingMethod::WINDSOR);
+    params.windsorCutoff = m_StackData.windsorCutoff;
+    params.lowSigma = m_StackData.lowSigma;
+    params.highSigma = m_StackData.highSigma;
+    return params;
+}
+
+// Streaming applies to Sigma Clipping and Windsorization. The other stacking methods are unaffected
+bool FITSStack::useStreaming() const
+{
+    return m_StackData.streaming && (m_StackData.stackingMethod == LiveStackStackingMethod::SIGMA ||
+                                     m_StackData.stackingMethod == LiveStackStackingMethod::WINDSOR);
+}
 
-        float pixelValue = 0.0;
+// Streaming sigma clipping. Rather than clipping across a set of subs held in memory, each sub is
+// merged into per pixel running estimates and then released. Memory use is therefore fixed (plus the
+// optional reservoir) however many subs are stacked, and each sub is merged in constant time.
+cv::Mat FITSStack::stackSubsStreaming(const QVector<float> &weights)
+{
+    try
+    {
+        QElapsedTimer timer;
+        timer.start();
 
-        if (m_StackData.stackingMethod == LiveStackStackingMethod::WINDSOR)
+        if (m_StackImageData.size() != weights.size())
         {
-            // Winsorize the data
-            float median = Mathematics::RobustStatistics::ComputeLocation(
-                Mathematics::RobustStatistics::LOCATION_MEDIAN, values);
-            auto const stddev = std::sqrt(Mathematics::RobustStatistics::ComputeScale(
-                Mathematics::RobustStatistics::SCALE_VARIANCE, values));
+            qCDebug(KSTARS_FITS) << QString("Inconsistent subs and weights in %1").arg(__FUNCTION__);
+            return m_StackedImage32F;
+        }
 
-            float lower = std::max(0.0, median - (stddev * m_StackData.windsorCutoff));
-            float upper = median + (stddev * m_StackData.windsorCutoff);
+        const int rows = m_StackImageData[0].image.rows;
+        const int cols = m_StackImageData[0].image.cols;
+        const int reservoirSize = std::clamp(m_StackData.reservoirSize, 0, LiveStackKernels::MAX_RESERVOIR_SIZE);
 
-            for (unsigned int i = 0; i < values.size(); i++)
+        // Setup the running estimates when the first sub arrives
+        if (m_StackedImage32F.empty() || m_StreamStats32FC4.size() != m_Channels)
+        {
+            m_StackedImage32F = cv::Mat::zeros(rows, cols, m_CVType);
+            m_SigmaClip32FC4.clear();
+            m_SigmaClip32FC4.resize(m_Channels);
+            m_StreamStats32FC4.clear();
+            m_StreamStats32FC4.resize(m_Channels);
+            m_StreamReservoir32F.clear();
+            m_StreamReservoir32F.resize(reservoirSize > 0 ? m_Channels : 0);
+            for (int ch = 0; ch < m_Channels; ch++)
             {
-                if (values[i] < lower)
-                    values[i] = lower;
-                else if (values[i] > upper)
-                    values[i] = upper;
+                m_SigmaClip32FC4[ch] = cv::Mat::zeros(rows, cols, CV_32FC4);
+                m_StreamStats32FC4[ch] = cv::Mat::zeros(rows, cols, CV_32FC4);
+                if (reservoirSize > 0)
+                    m_StreamReservoir32F[ch] = cv::Mat::zeros(rows, cols, CV_32FC(reservoirSize));
             }
         }
 
-        // Now process the data
-        float median = Mathematics::RobustStatistics::ComputeLocation(
-            Mathematics::RobustStatistics::LOCATION_MEDIAN, values);
-
-        float sum = 0.0, weightSum = 0.0, lower = -1.0, upper = -1.0;
-        if (values.size() <= 3)
-            // For small samples just use median
-            pixelValue = median;
-        else
+        // All the running estimates are allocated above so are continuous
+        std::vector<float *> sigmaClipPtr(m_Channels), statsPtr(m_Channels), reservoirPtr(m_Channels, nullptr);
+        for (int ch = 0; ch < m_Channels; ch++)
         {
-            // Sigma clipping
-            auto const stddev = std::sqrt(Mathematics::RobustStatistics::ComputeScale(
-                Mathematics::RobustStatistics::SCALE_VARIANCE, values));
+            sigmaClipPtr[ch] = m_SigmaClip32FC4[ch].ptr<float>(0);
+            statsPtr[ch] = m_StreamStats32FC4[ch].ptr<float>(0);
+            if (reservoirSize > 0)
+                reservoirPtr[ch] = m_StreamReservoir32F[ch].ptr<float>(0);
+        }
+        float *finalImagePtr = m_StackedImage32F.ptr<float>(0);
 
-            // Get the lower and upper bounds
-            lower = std::max(0.0, median - (stddev * m_StackData.lowSigma));
-            upper = median + (stddev * m_StackData.highSigma);
+        const int pixels = rows * cols;
+        const int chunkSize = std::max(1, pixels / (QThread::idealThreadCount() * 2));
+        QVector<QPair<int, int>> pixelChunks;
+        for (int start = 0; start < pixels; start += chunkSize)
+            pixelChunks.append(qMakePair(start, std::min(start + chunkSize, pixels)));
 
-            for (unsigned int i = 0; i < values.size(); i++)
+        const LiveStackKernels::SigmaClipParams params = sigmaClipParams();
+        for (int i = 0; i < m_StackImageData.size(); i++)
+        {
+            cv::Mat image = m_StackImageData[i].image.isContinuous() ? m_StackImageData[i].image
+                                                                     : m_StackImageData[i].image.clone();
+            const float *imagePtr = image.ptr<float>(0);
+            const float weight = weights[i];
+
+            auto processPixelChunk = [&](const QPair<int, int>& chunk)
             {
-                if (values[i] < lower || values[i] > upper)
-                    continue;
+                for (int x = chunk.first; x < chunk.second; x += SIGMA_CLIP_CANCEL_PIXELS)
+                {
+                    // Cancellation check between each batch of pixels
+                    if (QThread::currentThread()->isInterruptionRequested())
+                        return;
 
-                sum += values[i] * weights[i];
-                weightSum += weights[i];
-            }
+                    LiveStackKernels::streamingSigmaClip(imagePtr, weight, m_Channels, x,
+                                                         std::min(x + SIGMA_CLIP_CANCEL_PIXELS, chunk.second),
+                                                         params, reservoirSize, finalImagePtr, sigmaClipPtr.data(),
+                                                         statsPtr.data(), reservoirPtr.data());
+                }
+            };
+            QtConcurrent::blockingMap(pixelChunks, processPixelChunk);
 
-            if (weightSum > 0.0)
-                pixelValue = sum / weightSum;
-            else
-                pixelValue = median;
+            // The sub has been merged so release it straight away
+            m_StackImageData[i].image.release();
         }
 
-        // Store intermediate calcs from this process
-        cv::Vec4f sigmaClip;
-        sigmaClip[0] = lower;
-        sigmaClip[1] = upper;
-        sigmaClip[2] = sum;
-        sigmaClip[3] = weightSum;
-        sigmaClipPtr[ch][x] = sigmaClip;
-
-        // Update the pixel/channel with the calculated value
-        finalImagePtr[x * m_Channels + ch] = pixelValue;
+        qCDebug(KSTARS_FITS) << QString("Streaming sigma clipping of %1 subs completed in %2 ms")
+                                .arg(m_StackImageData.size()).arg(timer.elapsed());
+        return m_StackedImage32F;
+    }
+    catch (const cv::Exception &ex)
+    {
+        QString s1 = ex.what();
+        qCDebug(KSTARS_FITS) << QString("openCV exception %1 called from %2").arg(s1).arg(__FUNCTION__);
+        return m_StackedImage32F;
     }
 }
 
@@ -2361,15 +2524,15 @@ void FITSStack::setupRunningStack(const int numSubs, const float totalWeight)
     m_RunningStackImageData.ref_numStars = 0;
     m_RunningStackImageData.totalWeight = totalWeight;
 
-    // Initialize latent for incremental ImageMM
-    if (!m_StackedImage32F.empty())
-        m_RunningStackImageData.imageMMState.latent = m_StackedImage32F.clone();
-    else
-        m_RunningStackImageData.imageMMState.latent = cv::Mat::zeros(
-            m_StackImageData[0].image.size(), m_StackImageData[0].image.type());
-
     if (m_StackData.stackingMethod == LiveStackStackingMethod::IMAGEMM)
     {
+        // Initialize latent for incremental ImageMM
+        if (!m_StackedImage32F.empty())
+            m_RunningStackImageData.imageMMState.latent = m_StackedImage32F.clone();
+        else
+            m_RunningStackImageData.imageMMState.latent = cv::Mat::zeros(
+                m_StackImageData[0].image.size(), m_StackImageData[0].image.type());
+
         // Copy subs to running buffer for ImageMM
         m_RunningStackImageData.runningSubs.clear();
         for (int i = 0; i < numSubs; ++i)
@@ -2449,6 +2612,10 @@ void FITSStack::tidyUpInitalStack()
         m_StackImageData[i].psfKernel.release();
     }
     m_StackImageData.clear();
+
+    // Remove any subs spilled to disk. Scratch buffers are kept for the running stack
+    if (m_Spill)
+        m_Spill->releaseSubs();
 }
 
 // Release FITS and openCV memory used in the running stack
@@ -22,6 +22,8 @@
 #include "ekos/auxiliary/solverutils.h"
 #include "fits_debug.h"
 #include "fitsstackmonitor.h"
+#include "fitsstackspill.h"
+#include "livestackkernels.h"
 
 #include <QObject>
 #include <QPointer>
@@ -92,6 +94,8 @@ class StellarSolverProfileEditor;
  *   subs. These are added to the existing stack, intermediate results updated and the stack
  *   displayed. The system then repeats until all subs have been processed, then waits for new
  *   subs to arrives and adds these to the stack.
+ *   Sigma clipping can alternatively stream: each sub is merged into per pixel running estimates as
+ *   it is stacked and then released, so only a couple of subs are ever held in memory.
  *
  * - **Live Output**: The integrated stack is updated after new subs are added.
  *
@@ -257,6 +261,23 @@ class FITSStack : public QObject
             return m_MaxSubSNR;
         }
 
+        /**
+         * @brief Wall time in ms spent in each stage of the pipeline since the stack was created
+         */
+        struct StageTimes
+        {
+            double load { 0 };
+            double calibrate { 0 };
+            double align { 0 };
+            double stack { 0 };
+            double postProcess { 0 };
+        };
+
+        const StageTimes &getStageTimes() const
+        {
+            return m_StageTimes;
+        }
+
       signals:
         /**
          * @brief Update the Stack Monitor
@@ -294,6 +315,7 @@ class FITSStack : public QObject
             double hfr = -1;
             int numStars = 0;
             float weight = -1.0f;
+            int spillIndex = -1;
         };
 
         /**
@@ -388,15 +410,49 @@ class FITSStack : public QObject
         cv::Mat stackSubsSigmaClipping(const QVector<float> &weights);
 
         /**
-         * @brief Called by stackSubsSigmaClipping to do the sigma clipping on pixel at position x
-         * @param x position to process
+         * @brief Out-of-core version of stackSubsSigmaClipping. Subs are read from the disk spill
+         * in bands of rows sized to fit the user memory budget. Output is identical to the in-memory path.
+         * @param weights of each sub for the stack
+         * @return stack is returned to the caller
+         */
+        cv::Mat stackSubsSigmaClippingTiled(const QVector<float> &weights);
+
+        /**
+         * @brief Check whether subs should be spilled to disk rather than held in memory
+         * @return use out-of-core stacking (or not)
+         */
+        bool useOutOfCore() const;
+
+        /**
+         * @brief Sigma clipping parameters for the kernels from the user options
+         */
+        LiveStackKernels::SigmaClipParams sigmaClipParams() const;
+
+        /**
+         * @brief Check whether sigma clipping should use the streaming estimator
+         * @return use streaming (or not)
+         */
+        bool useStreaming() const;
+
+        /**
+         * @brief Merge each sub into the streaming sigma clipping estimates and release it.
+         * Used for both the initial and incremental stacks when streaming.
+         * @param weights of each sub for the stack
+         * @return stack
+         */
+        cv::Mat stackSubsStreaming(const QVector<float> &weights);
+
+        /**
+         * @brief Called by stackSubsSigmaClipping to do the sigma clipping on pixels in [start, end)
+         * @param start first pixel position to process
+         * @param end one past the last pixel position to process
          * @param imagesPtrs array of pointers to each image
          * @param finalImagePtr results image
          * @param sigmaClipPtr intermediate results pointer
          * @param weights to apply to sigma clipping
          */
-        void stackSigmaClipPixel(int x, const std::vector<const float *> &imagesPtrs, float* finalImagePtr,
-                                 const QVector<cv::Vec4f *> &sigmaClipPtr, const QVector<float> &weights);
+        void stackSigmaClipPixels(int start, int end, const std::vector<const float *> &imagesPtrs, float* finalImagePtr,
+                                  const QVector<cv::Vec4f *> &sigmaClipPtr, const QVector<float> &weights);
 
         /**
          * @brief Stack the passed in vector of subs to an existing stack using Sigma Clipping
@@ -627,6 +683,7 @@ class FITSStack : public QObject
         double m_MeanSubSNR { 0 };
         double m_MinSubSNR { 0 };
         double m_MaxSubSNR { 0 };
+        StageTimes m_StageTimes;
 
         // Stack status
         bool m_StackInProgress { false };
@@ -645,9 +702,14 @@ class FITSStack : public QObject
         // Aligning
         QSharedPointer<wcsprm> m_AlignMasterWCS;
 
+        // Out-of-core stacking
+        std::unique_ptr<FITSStackSpill> m_Spill;
+
         // Stacking
         cv::Mat m_StackedImage32F;
         QVector<cv::Mat> m_SigmaClip32FC4;
+        QVector<cv::Mat> m_StreamStats32FC4;
+        QVector<cv::Mat> m_StreamReservoir32F;
         cv::Mat m_StackedImageFinal;
         double m_ImageMMLastSigma = -1.0;
         float m_ImageMMTotalWeight = 0.0f;
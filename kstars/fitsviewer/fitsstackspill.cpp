@@ -0,0 +1,156 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fitsstackspill.h"
+#include <fits_debug.h>
+
+#include <QDir>
+
+FITSStackSpill::FITSStackSpill(const int rows, const int cols, const int channels)
+    : m_Rows(rows), m_Cols(cols), m_Channels(channels)
+{
+    m_RowBytes = static_cast<qint64>(cols) * channels * sizeof(float);
+}
+
+FITSStackSpill::~FITSStackSpill()
+{
+    releaseSubs();
+    releaseScratch();
+}
+
+QSharedPointer<QTemporaryFile> FITSStackSpill::createFile(const qint64 size)
+{
+    QSharedPointer<QTemporaryFile> file(new QTemporaryFile(QDir::tempPath() + "/kstars_stack_XXXXXX.raw"));
+    if (!file->open())
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 unable to create scratch file %2").arg(__FUNCTION__).arg(file->errorString());
+        return QSharedPointer<QTemporaryFile>();
+    }
+    if (!file->resize(size))
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 unable to resize scratch file to %2 bytes").arg(__FUNCTION__).arg(size);
+        return QSharedPointer<QTemporaryFile>();
+    }
+    return file;
+}
+
+int FITSStackSpill::addSub(const cv::Mat &image)
+{
+    auto file = createFile(m_RowBytes * m_Rows);
+    if (file.isNull())
+        return -1;
+
+    m_SubFiles.push_back(file);
+    int index = m_SubFiles.size() - 1;
+    if (!writeSub(index, image))
+    {
+        // Don't leave a sub that was never written in the spill; this also removes its file
+        m_SubFiles.removeLast();
+        return -1;
+    }
+    return index;
+}
+
+bool FITSStackSpill::writeSub(const int index, const cv::Mat &image)
+{
+    if (index < 0 || index >= m_SubFiles.size() || m_SubFiles[index].isNull())
+        return false;
+
+    if (image.rows != m_Rows || image.cols != m_Cols || image.type() != CV_MAKETYPE(CV_32F, m_Channels))
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 sub inconsistent with spill").arg(__FUNCTION__);
+        return false;
+    }
+
+    QTemporaryFile *file = m_SubFiles[index].data();
+    if (!file->seek(0))
+        return false;
+
+    // Write a row at a time so non-continuous Mats (e.g. ROIs) are handled
+    for (int y = 0; y < m_Rows; y++)
+    {
+        if (file->write(reinterpret_cast<const char *>(image.ptr<float>(y)), m_RowBytes) != m_RowBytes)
+        {
+            qCDebug(KSTARS_FITS) << QString("%1 write failed %2").arg(__FUNCTION__).arg(file->errorString());
+            return false;
+        }
+    }
+    return file->flush();
+}
+
+cv::Mat FITSStackSpill::readSub(const int index)
+{
+    if (index < 0 || index >= m_SubFiles.size() || m_SubFiles[index].isNull())
+        return cv::Mat();
+
+    QTemporaryFile *file = m_SubFiles[index].data();
+    cv::Mat image(m_Rows, m_Cols, CV_MAKETYPE(CV_32F, m_Channels));
+    if (!file->seek(0) ||
+            file->read(reinterpret_cast<char *>(image.ptr<float>(0)), m_RowBytes * m_Rows) != m_RowBytes * m_Rows)
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 read failed %2").arg(__FUNCTION__).arg(file->errorString());
+        return cv::Mat();
+    }
+    return image;
+}
+
+const float *FITSStackSpill::mapSubRows(const int index, const int startRow, const int numRows)
+{
+    if (index < 0 || index >= m_SubFiles.size() || m_SubFiles[index].isNull())
+        return nullptr;
+    if (startRow < 0 || numRows <= 0 || startRow + numRows > m_Rows)
+        return nullptr;
+
+    // QFile::map handles page alignment of the offset internally
+    uchar *ptr = m_SubFiles[index]->map(m_RowBytes * startRow, m_RowBytes * numRows);
+    if (ptr == nullptr)
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 map failed %2").arg(__FUNCTION__).arg(m_SubFiles[index]->errorString());
+        return nullptr;
+    }
+    m_SubMaps.push_back(qMakePair(index, ptr));
+    return reinterpret_cast<const float *>(ptr);
+}
+
+void FITSStackSpill::unmapSubs()
+{
+    for (auto &subMap : m_SubMaps)
+    {
+        if (subMap.first >= 0 && subMap.first < m_SubFiles.size() && !m_SubFiles[subMap.first].isNull())
+            m_SubFiles[subMap.first]->unmap(subMap.second);
+    }
+    m_SubMaps.clear();
+}
+
+void FITSStackSpill::releaseSubs()
+{
+    unmapSubs();
+    // QTemporaryFile removes the file from disk when destroyed
+    m_SubFiles.clear();
+}
+
+cv::Mat FITSStackSpill::createScratchMat(const int rows, const int cols, const int type)
+{
+    const qint64 size = static_cast<qint64>(rows) * cols * CV_ELEM_SIZE(type);
+    auto file = createFile(size);
+    if (file.isNull())
+        return cv::Mat();
+
+    // The file is sparse and zero filled after the resize so the Mat is zero initialised.
+    // The mapping stays valid until the file is unmapped or closed in releaseScratch.
+    uchar *ptr = file->map(0, size);
+    if (ptr == nullptr)
+    {
+        qCDebug(KSTARS_FITS) << QString("%1 map failed %2").arg(__FUNCTION__).arg(file->errorString());
+        return cv::Mat();
+    }
+    m_ScratchFiles.push_back(file);
+    return cv::Mat(rows, cols, type, ptr);
+}
+
+void FITSStackSpill::releaseScratch()
+{
+    // Closing the file unmaps any mapped regions
+    m_ScratchFiles.clear();
+}
@@ -0,0 +1,126 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QVector>
+#include <QSharedPointer>
+#include <QTemporaryFile>
+
+#ifdef _WIN32
+#pragma push_macro("NOMINMAX")
+#define NOMINMAX
+#endif
+
+#include "opencv2/core.hpp"
+
+#ifdef _WIN32
+#pragma pop_macro("NOMINMAX")
+#endif
+
+/**
+ * @class FITSStackSpill
+ * @brief Disk backed storage for Live Stacking subs used by the out-of-core stacking mode.
+ *
+ * Each sub is written to its own scratch file as raw, continuous float32 (interleaved channels).
+ * During stacking the subs are memory mapped back in horizontal bands of rows so that only a
+ * band of each sub needs to be resident at any one time. The class can also provide cv::Mat
+ * headers over memory mapped scratch files for large intermediate buffers, e.g. the sigma
+ * clipping side buffers, so the OS can page them out under memory pressure.
+ *
+ * All scratch files are temporary and are removed when released or when the object is destroyed.
+ */
+class FITSStackSpill
+{
+    public:
+        FITSStackSpill(const int rows, const int cols, const int channels);
+        ~FITSStackSpill();
+
+        /**
+         * @brief Write a sub to a new scratch file
+         * @param image to write. Must be CV_32F with the channels / size set in the constructor
+         * @return index of the sub in the spill (-1 on failure)
+         */
+        int addSub(const cv::Mat &image);
+
+        /**
+         * @brief Overwrite a previously spilled sub, e.g. after calibration and alignment
+         * @param index of the sub returned by addSub
+         * @param image to write
+         * @return success (or not)
+         */
+        bool writeSub(const int index, const cv::Mat &image);
+
+        /**
+         * @brief Read a previously spilled sub back into memory
+         * @param index of the sub returned by addSub
+         * @return image (empty Mat on failure)
+         */
+        cv::Mat readSub(const int index);
+
+        /**
+         * @brief Memory map a band of rows of a spilled sub. The mapping remains valid until
+         * unmapSubs() or releaseSubs() is called.
+         * @param index of the sub returned by addSub
+         * @param startRow first row of the band
+         * @param numRows in the band
+         * @return pointer to the first pixel of the band (nullptr on failure)
+         */
+        const float *mapSubRows(const int index, const int startRow, const int numRows);
+
+        /**
+         * @brief Unmap all bands mapped by mapSubRows
+         */
+        void unmapSubs();
+
+        /**
+         * @brief Remove all spilled subs
+         */
+        void releaseSubs();
+
+        /**
+         * @brief Create a cv::Mat whose data lives in a memory mapped scratch file. The Mat does
+         * not own the memory so it must not be used after releaseScratch() is called.
+         * @param rows of the Mat
+         * @param cols of the Mat
+         * @param type of the Mat
+         * @return zero initialised Mat (empty Mat on failure)
+         */
+        cv::Mat createScratchMat(const int rows, const int cols, const int type);
+
+        /**
+         * @brief Remove all scratch Mats created with createScratchMat
+         */
+        void releaseScratch();
+
+        /**
+         * @brief Size in bytes of a single row of a sub
+         */
+        qint64 rowBytes() const
+        {
+            return m_RowBytes;
+        }
+
+        int rows() const
+        {
+            return m_Rows;
+        }
+
+        int cols() const
+        {
+            return m_Cols;
+        }
+
+    private:
+        QSharedPointer<QTemporaryFile> createFile(const qint64 size);
+
+        int m_Rows { 0 };
+        int m_Cols { 0 };
+        int m_Channels { 0 };
+        qint64 m_RowBytes { 0 };
+
+        QVector<QSharedPointer<QTemporaryFile>> m_SubFiles;
+        QVector<QPair<int, uchar *>> m_SubMaps;
+        QVector<QSharedPointer<QTemporaryFile>> m_ScratchFiles;
+};
@@ -0,0 +1,435 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fitsstatistics.h"
+
+#include <QThread>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace FITSStatistics
+{
+
+namespace
+{
+// Independent accumulators per block. 16 lanes fills an AVX-512 register of floats
+constexpr int LANES = 16;
+
+// Samples reduced and then histogrammed together; small enough to still be in L1 cache
+constexpr uint32_t BLOCK = 4096;
+
+// Don't split channels into chunks smaller than this
+constexpr uint32_t MIN_CHUNK = 1 << 16;
+
+constexpr int BIN_BITS = 16;
+constexpr uint32_t BINS = 1 << BIN_BITS;
+
+// Per type details. Key is an unsigned integer with the same ordering as the values.
+// Acc is the type sums are accumulated in within a block.
+template <typename T> struct Traits;
+
+template <> struct Traits<uint8_t>
+{
+    using Key = uint32_t;
+    using Acc = int64_t;
+    static constexpr int KEY_BITS = 8;
+    static Key key(const uint8_t v)
+    {
+        return v;
+    }
+    static uint8_t value(const Key k)
+    {
+        return static_cast<uint8_t>(k);
+    }
+};
+
+template <> struct Traits<int16_t>
+{
+    using Key = uint32_t;
+    using Acc = int64_t;
+    static constexpr int KEY_BITS = 16;
+    static Key key(const int16_t v)
+    {
+        return static_cast<uint16_t>(v) ^ 0x8000u;
+    }
+    static int16_t value(const Key k)
+    {
+        return static_cast<int16_t>(static_cast<uint16_t>(k ^ 0x8000u));
+    }
+};
+
+template <> struct Traits<uint16_t>
+{
+    using Key = uint32_t;
+    using Acc = int64_t;
+    static constexpr int KEY_BITS = 16;
+    static Key key(const uint16_t v)
+    {
+        return v;
+    }
+    static uint16_t value(const Key k)
+    {
+        return static_cast<uint16_t>(k);
+    }
+};
+
+template <> struct Traits<int32_t>
+{
+    using Key = uint32_t;
+    using Acc = double;
+    static constexpr int KEY_BITS = 32;
+    static Key key(const int32_t v)
+    {
+        return static_cast<uint32_t>(v) ^ 0x80000000u;
+    }
+    static int32_t value(const Key k)
+    {
+        return static_cast<int32_t>(k ^ 0x80000000u);
+    }
+};
+
+template <> struct Traits<uint32_t>
+{
+    using Key = uint32_t;
+    using Acc = double;
+    static constexpr int KEY_BITS = 32;
+    static Key key(const uint32_t v)
+    {
+        return v;
+    }
+    static uint32_t value(const Key k)
+    {
+        return k;
+    }
+};
+
+template <> struct Traits<float>
+{
+    using Key = uint32_t;
+    using Acc = double;
+    static constexpr int KEY_BITS = 32;
+    // Flip all bits of negative values and just the sign bit of positive values
+    static Key key(const float v)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+    static float value(const Key k)
+    {
+        const uint32_t bits = (k & 0x80000000u) ? (k & 0x7fffffffu) : ~k;
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+};
+
+template <> struct Traits<int64_t>
+{
+    using Key = uint64_t;
+    using Acc = double;
+    static constexpr int KEY_BITS = 64;
+    static Key key(const int64_t v)
+    {
+        return static_cast<uint64_t>(v) ^ 0x8000000000000000ull;
+    }
+    static int64_t value(const Key k)
+    {
+        return static_cast<int64_t>(k ^ 0x8000000000000000ull);
+    }
+};
+
+template <> struct Traits<double>
+{
+    using Key = uint64_t;
+    using Acc = double;
+    static constexpr int KEY_BITS = 64;
+    static Key key(const double v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+    }
+    static double value(const Key k)
+    {
+        const uint64_t bits = (k & 0x8000000000000000ull) ? (k & 0x7fffffffffffffffull) : ~k;
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+};
+
+// Results for one chunk of a channel
+template <typename T>
+struct Partial
+{
+    uint32_t start { 0 };
+    uint32_t end { 0 };
+    T min { std::numeric_limits<T>::max() };
+    T max { std::numeric_limits<T>::lowest() };
+    // Samples reduced, which leaves out the non-finite samples of floating point channels
+    uint64_t count { 0 };
+    double sum { 0 };
+    double squaredSum { 0 };
+    std::vector<uint32_t> histogram;
+};
+
+// Min, max, sum and sum of squares of a block
+template <typename T>
+void reduceBlock(const T *data, const uint32_t n, Partial<T> &partial)
+{
+    using Acc = typename Traits<T>::Acc;
+    if constexpr (Traits<T>::KEY_BITS <= BIN_BITS)
+    {
+        // Integer reductions are exact so the compiler vectorizes a plain loop
+        T min = partial.min, max = partial.max;
+        Acc sum = 0, squaredSum = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            const T v = data[i];
+            min = (v < min) ? v : min;
+            max = (v > max) ? v : max;
+            sum += v;
+            squaredSum += static_cast<Acc>(v) * v;
+        }
+        partial.min = min;
+        partial.max = max;
+        partial.count += n;
+        partial.sum += static_cast<double>(sum);
+        partial.squaredSum += static_cast<double>(squaredSum);
+    }
+    else
+    {
+        // Floating point sums can't be reordered by the compiler so use independent lanes.
+        // Each lane loop is branch-free so it vectorizes. NaN and infinite samples are skipped.
+        T mins[LANES], maxs[LANES];
+        Acc sums[LANES] = {}, squaredSums[LANES] = {};
+        uint32_t counts[LANES] = {};
+        std::fill(mins, mins + LANES, partial.min);
+        std::fill(maxs, maxs + LANES, partial.max);
+
+        uint32_t i = 0;
+        for (; i + LANES <= n; i += LANES)
+        {
+            for (int l = 0; l < LANES; l++)
+            {
+                const T v = data[i + l];
+                const bool finite = std::isfinite(v);
+                mins[l] = (finite && v < mins[l]) ? v : mins[l];
+                maxs[l] = (finite && v > maxs[l]) ? v : maxs[l];
+                const Acc a = finite ? static_cast<Acc>(v) : 0;
+                sums[l] += a;
+                squaredSums[l] += a * a;
+                counts[l] += finite;
+            }
+        }
+        for (; i < n; i++)
+        {
+            const T v = data[i];
+            const bool finite = std::isfinite(v);
+            mins[0] = (finite && v < mins[0]) ? v : mins[0];
+            maxs[0] = (finite && v > maxs[0]) ? v : maxs[0];
+            const Acc a = finite ? static_cast<Acc>(v) : 0;
+            sums[0] += a;
+            squaredSums[0] += a * a;
+            counts[0] += finite;
+        }
+
+        for (int l = 0; l < LANES; l++)
+        {
+            partial.min = std::min(partial.min, mins[l]);
+            partial.max = std::max(partial.max, maxs[l]);
+            partial.count += counts[l];
+            partial.sum += sums[l];
+            partial.squaredSum += squaredSums[l];
+        }
+    }
+}
+
+// Bin of a key in the first level histogram
+template <typename T>
+inline uint32_t topBin(const typename Traits<T>::Key key)
+{
+    if constexpr (Traits<T>::KEY_BITS <= BIN_BITS)
+        return static_cast<uint32_t>(key);
+    else
+        return static_cast<uint32_t>(key >> (Traits<T>::KEY_BITS - BIN_BITS));
+}
+
+// Find the bin holding the rank'th (0 based) sample. rank is updated to the rank within the bin
+uint32_t findBin(const std::vector<uint32_t> &histogram, uint64_t &rank)
+{
+    for (uint32_t bin = 0; bin < histogram.size(); bin++)
+    {
+        if (rank < histogram[bin])
+            return bin;
+        rank -= histogram[bin];
+    }
+    return histogram.size() - 1;
+}
+
+// Refine the keys of the two median samples with further passes over the data, each pass
+// histogramming the next BIN_BITS of the keys that share the prefix found so far
+template <typename T>
+void refineMedianKeys(const T *data, QVector<Partial<T>> &partials, typename Traits<T>::Key &keyLow,
+                      uint64_t rankLow, typename Traits<T>::Key &keyHigh, uint64_t rankHigh)
+{
+    using Key = typename Traits<T>::Key;
+    for (int known = BIN_BITS; known < Traits<T>::KEY_BITS; known += BIN_BITS)
+    {
+        const int shift = Traits<T>::KEY_BITS - known - BIN_BITS;
+        const Key prefixLow = keyLow;
+        const Key prefixHigh = keyHigh;
+        const bool same = (prefixLow == prefixHigh);
+
+        QtConcurrent::blockingMap(partials, [&](Partial<T> &partial)
+        {
+            partial.histogram.assign(same ? BINS : 2 * BINS, 0);
+            uint32_t *low = partial.histogram.data();
+            uint32_t *high = same ? low : low + BINS;
+            for (uint32_t i = partial.start; i < partial.end; i++)
+            {
+                const Key key = Traits<T>::key(data[i]);
+                const Key prefix = key >> (shift + BIN_BITS);
+                const uint32_t bin = static_cast<uint32_t>(key >> shift) & (BINS - 1);
+                if (prefix == prefixLow)
+                    low[bin]++;
+                else if (prefix == prefixHigh)
+                    high[bin]++;
+            }
+        });
+
+        std::vector<uint32_t> low(BINS, 0), high(same ? 0 : BINS, 0);
+        for (const auto &partial : partials)
+        {
+            for (uint32_t bin = 0; bin < BINS; bin++)
+                low[bin] += partial.histogram[bin];
+            if (!same)
+                for (uint32_t bin = 0; bin < BINS; bin++)
+                    high[bin] += partial.histogram[BINS + bin];
+        }
+
+        keyLow = (prefixLow << BIN_BITS) | findBin(low, rankLow);
+        keyHigh = (prefixHigh << BIN_BITS) | findBin(same ? low : high, rankHigh);
+    }
+}
+}
+
+template <typename T>
+ChannelStatistics computeChannel(const T *data, const uint32_t samples, const int fields)
+{
+    using Key = typename Traits<T>::Key;
+    ChannelStatistics result;
+    if (data == nullptr || samples == 0)
+        return result;
+
+    const bool reduce = fields & (MIN_MAX | MEAN_STDDEV);
+    const bool median = fields & MEDIAN;
+    const uint32_t bins = (Traits<T>::KEY_BITS <= BIN_BITS) ? (1u << Traits<T>::KEY_BITS) : BINS;
+
+    // Split the channel into chunks for the available threads
+    const uint32_t chunks = std::max(1u, std::min(static_cast<uint32_t>(QThread::idealThreadCount() * 2),
+                                     samples / MIN_CHUNK));
+    const uint32_t chunkSize = (samples + chunks - 1) / chunks;
+    QVector<Partial<T>> partials;
+    for (uint32_t start = 0; start < samples; start += chunkSize)
+    {
+        Partial<T> partial;
+        partial.start = start;
+        partial.end = std::min(samples, start + chunkSize);
+        partials.push_back(partial);
+    }
+
+    // The sweep. Reduce each block then histogram it while it is still in cache
+    QtConcurrent::blockingMap(partials, [&](Partial<T> &partial)
+    {
+        if (median)
+            partial.histogram.assign(bins, 0);
+        uint32_t *histogram = partial.histogram.data();
+        for (uint32_t block = partial.start; block < partial.end; block += BLOCK)
+        {
+            const uint32_t n = std::min(BLOCK, partial.end - block);
+            const T *blockData = data + block;
+            if (reduce)
+                reduceBlock(blockData, n, partial);
+            if (median)
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    if constexpr (std::is_floating_point<T>::value)
+                        if (!std::isfinite(blockData[i]))
+                            continue;
+                    histogram[topBin<T>(Traits<T>::key(blockData[i]))]++;
+                }
+        }
+    });
+
+    if (reduce)
+    {
+        T min = partials[0].min, max = partials[0].max;
+        uint64_t count = 0;
+        double sum = 0, squaredSum = 0;
+        for (const auto &partial : partials)
+        {
+            min = std::min(min, partial.min);
+            max = std::max(max, partial.max);
+            count += partial.count;
+            sum += partial.sum;
+            squaredSum += partial.squaredSum;
+        }
+        if (count > 0 && (fields & MIN_MAX))
+        {
+            result.min = min;
+            result.max = max;
+        }
+        if (count > 0 && (fields & MEAN_STDDEV))
+        {
+            result.mean = sum / count;
+            result.stddev = std::sqrt(std::max(0.0, squaredSum / count - result.mean * result.mean));
+        }
+    }
+
+    if (median)
+    {
+        std::vector<uint32_t> histogram(bins, 0);
+        uint64_t count = 0;
+        for (const auto &partial : partials)
+            for (uint32_t bin = 0; bin < bins; bin++)
+            {
+                histogram[bin] += partial.histogram[bin];
+                count += partial.histogram[bin];
+            }
+        if (count == 0)
+            return result;
+
+        // The two middle samples, which are the same sample for odd sample counts. Non-finite samples
+        // are not histogrammed, and never share a first level bin with a finite one in refinement.
+        uint64_t rankLow = (count - 1) / 2;
+        uint64_t rankHigh = count / 2;
+        Key keyLow = findBin(histogram, rankLow);
+        Key keyHigh = findBin(histogram, rankHigh);
+        if constexpr (Traits<T>::KEY_BITS > BIN_BITS)
+            refineMedianKeys(data, partials, keyLow, rankLow, keyHigh, rankHigh);
+
+        result.median = (static_cast<double>(Traits<T>::value(keyLow)) +
+                         static_cast<double>(Traits<T>::value(keyHigh))) / 2.0;
+    }
+    return result;
+}
+
+template ChannelStatistics computeChannel<uint8_t>(const uint8_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<int16_t>(const int16_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<uint16_t>(const uint16_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<int32_t>(const int32_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<uint32_t>(const uint32_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<float>(const float *, const uint32_t, const int);
+template ChannelStatistics computeChannel<int64_t>(const int64_t *, const uint32_t, const int);
+template ChannelStatistics computeChannel<double>(const double *, const uint32_t, const int);
+
+}
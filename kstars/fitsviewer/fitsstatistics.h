@@ -0,0 +1,54 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @namespace FITSStatistics
+ * @brief Image statistics for FITSData computed in a single sweep over each channel.
+ *
+ * Min, max, mean, standard deviation and an exact median are gathered together. The channel is
+ * split into chunks processed in parallel, and each chunk is walked in small blocks: a block is
+ * first reduced for min / max / sums (written as fixed width lane loops so the compiler vectorizes
+ * them) and then, while it is still in L1 cache, added to a histogram for the median.
+ *
+ * 8 and 16 bit data are binned on the full value so the median comes straight from the histogram.
+ * Wider types are binned on the top 16 bits of an order preserving key and the bin(s) holding the
+ * median are resolved with a second, much cheaper, pass.
+ */
+namespace FITSStatistics
+{
+
+// Statistics to compute, so values already known from the FITS header can be skipped
+enum Fields
+{
+    MIN_MAX     = 1 << 0,
+    MEDIAN      = 1 << 1,
+    MEAN_STDDEV = 1 << 2,
+    ALL         = MIN_MAX | MEDIAN | MEAN_STDDEV
+};
+
+struct ChannelStatistics
+{
+    double min { 0 };
+    double max { 0 };
+    double mean { 0 };
+    double stddev { 0 };
+    double median { 0 };
+};
+
+/**
+ * @brief Compute statistics for a single channel
+ * @param data first sample of the channel
+ * @param samples in the channel
+ * @param fields to compute (bitwise or of Fields). Other members of the result are left at 0
+ * @return statistics. Standard deviation is the population standard deviation. NaN and infinite samples
+ * are skipped, and a channel without finite samples has all statistics at 0.
+ */
+template <typename T>
+ChannelStatistics computeChannel(const T *data, const uint32_t samples, const int fields = ALL);
+
+}
@@ -191,24 +191,16 @@ void FITSStretchUI::setupHistoSlider()
     // We need this released callback since if Options::stretchPreviewSampling() is > 1,
     // then when the sliders are dragged, the stretched image is rendered in lower resolution.
     // However when the dragging is done (and the mouse is released) we want to end by rendering
-    // in full resolution.
+    // in full resolution. This is done even if the parameters didn't change since the last move,
+    // as while dragging only the visible part of the image is stretched.
     connect(histoSlider, &ctk3Slider::released, this, [ = ](int minValue, int midValue, int maxValue)
     {
         StretchParams params = m_View->getStretchParams();
-        const double shadowValue = minValue / HISTO_SLIDER_MAX;
-        const double middleValue = midValueFcn(midValue);
-        const double highValue = maxValue / HISTO_SLIDER_MAX;
-
-        if (middleValue != params.grey_red.midtones ||
-                highValue != params.grey_red.highlights ||
-                shadowValue != params.grey_red.shadows)
-        {
-            params.grey_red.shadows = shadowValue;
-            params.grey_red.midtones = middleValue;
-            params.grey_red.highlights = highValue;
-            m_View->setPreviewSampling(0);
-            m_View->setStretchParams(params);
-        }
+        params.grey_red.shadows = minValue / HISTO_SLIDER_MAX;
+        params.grey_red.midtones = midValueFcn(midValue);
+        params.grey_red.highlights = maxValue / HISTO_SLIDER_MAX;
+        m_View->setPreviewSampling(0);
+        m_View->setStretchParams(params);
     });
 }
 
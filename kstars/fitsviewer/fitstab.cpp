@@ -993,6 +993,9 @@ void FITSTab::initSettings()
     m_LiveStackingUI.MasterFlat->setText(Options::fitsLSMasterFlat());
     m_LiveStackingUI.AlignMethod->setCurrentIndex(Options::fitsLSAlignMethod());
     m_LiveStackingUI.NumInMem->setValue(Options::fitsLSNumInMem());
+    m_LiveStackingUI.MemBudget->setValue(Options::fitsLSMemBudget());
+    m_LiveStackingUI.ClipMode->setCurrentIndex(Options::fitsLSStreaming() ? 1 : 0);
+    m_LiveStackingUI.Reservoir->setValue(Options::fitsLSReservoir());
     m_LiveStackingUI.LSDownscale->setCurrentIndex(Options::fitsLSDownscale());
     m_LiveStackingUI.Weighting->setCurrentIndex(Options::fitsLSWeighting());
     m_LiveStackingUI.StackingMethod->setCurrentIndex(Options::fitsLSStackingMethod());
@@ -1022,6 +1025,9 @@ void FITSTab::saveSettings()
     Options::setFitsLSMasterFlat(m_LiveStackingUI.MasterFlat->text());
     Options::setFitsLSAlignMethod(m_LiveStackingUI.AlignMethod->currentIndex());
     Options::setFitsLSNumInMem(m_LiveStackingUI.NumInMem->value());
+    Options::setFitsLSMemBudget(m_LiveStackingUI.MemBudget->value());
+    Options::setFitsLSStreaming(m_LiveStackingUI.ClipMode->currentIndex() == 1);
+    Options::setFitsLSReservoir(m_LiveStackingUI.Reservoir->value());
     Options::setFitsLSDownscale(m_LiveStackingUI.LSDownscale->currentIndex());
     Options::setFitsLSWeighting(m_LiveStackingUI.Weighting->currentIndex());
     Options::setFitsLSStackingMethod(m_LiveStackingUI.StackingMethod->currentIndex());
@@ -1075,9 +1081,15 @@ LiveStackData FITSTab::getAllSettings()
     data.alignMaster = m_LiveStackingUI.AlignMaster->text();
     data.alignMethod = static_cast<LiveStackAlignMethod>(m_LiveStackingUI.AlignMethod->currentIndex());
     data.numInMem = m_LiveStackingUI.NumInMem->value();
+    data.memBudgetMB = m_LiveStackingUI.MemBudget->value();
     data.downscale = static_cast<LiveStackDownscale>(m_LiveStackingUI.LSDownscale->currentIndex());
     data.weighting = static_cast<LiveStackFrameWeighting>(m_LiveStackingUI.Weighting->currentIndex());
     data.stackingMethod = static_cast<LiveStackStackingMethod>(m_LiveStackingUI.StackingMethod->currentIndex());
+    // Streaming only applies to sigma clipping methods
+    data.streaming = (m_LiveStackingUI.ClipMode->currentIndex() == 1) &&
+                     (data.stackingMethod == LiveStackStackingMethod::SIGMA ||
+                      data.stackingMethod == LiveStackStackingMethod::WINDSOR);
+    data.reservoirSize = m_LiveStackingUI.Reservoir->value();
     data.lowSigma = m_LiveStackingUI.LowSigma->value();
     data.highSigma = m_LiveStackingUI.HighSigma->value();
     data.windsorCutoff = m_LiveStackingUI.WinsorCutoff->value();
@@ -1116,6 +1128,9 @@ void FITSTab::stackMethodChanged(int index)
             m_LiveStackingUI.Alpha->hide(); m_LiveStackingUI.AlphaLabel->hide();
             m_LiveStackingUI.Sigma->hide(); m_LiveStackingUI.SigmaLabel->hide();
             m_LiveStackingUI.PSFUpdate->hide(); m_LiveStackingUI.PSFUpdateLabel->hide();
+            m_LiveStackingUI.MemBudget->hide(); m_LiveStackingUI.MemBudgetLabel->hide();
+            m_LiveStackingUI.ClipMode->hide(); m_LiveStackingUI.ClipModeLabel->hide();
+            m_LiveStackingUI.Reservoir->hide(); m_LiveStackingUI.ReservoirLabel->hide();
             break;
         case LiveStackStackingMethod::SIGMA:
             m_LiveStackingUI.LowSigma->show(); m_LiveStackingUI.LowSigmaLabel->show();
@@ -1126,6 +1141,9 @@ void FITSTab::stackMethodChanged(int index)
             m_LiveStackingUI.Alpha->hide(); m_LiveStackingUI.AlphaLabel->hide();
             m_LiveStackingUI.Sigma->hide(); m_LiveStackingUI.SigmaLabel->hide();
             m_LiveStackingUI.PSFUpdate->hide(); m_LiveStackingUI.PSFUpdateLabel->hide();
+            m_LiveStackingUI.MemBudget->show(); m_LiveStackingUI.MemBudgetLabel->show();
+            m_LiveStackingUI.ClipMode->show(); m_LiveStackingUI.ClipModeLabel->show();
+            m_LiveStackingUI.Reservoir->show(); m_LiveStackingUI.ReservoirLabel->show();
             break;
         case LiveStackStackingMethod::WINDSOR:
             m_LiveStackingUI.LowSigma->show(); m_LiveStackingUI.LowSigmaLabel->show();
@@ -1136,6 +1154,9 @@ void FITSTab::stackMethodChanged(int index)
             m_LiveStackingUI.Alpha->hide(); m_LiveStackingUI.AlphaLabel->hide();
             m_LiveStackingUI.Sigma->hide(); m_LiveStackingUI.SigmaLabel->hide();
             m_LiveStackingUI.PSFUpdate->hide(); m_LiveStackingUI.PSFUpdateLabel->hide();
+            m_LiveStackingUI.MemBudget->show(); m_LiveStackingUI.MemBudgetLabel->show();
+            m_LiveStackingUI.ClipMode->show(); m_LiveStackingUI.ClipModeLabel->show();
+            m_LiveStackingUI.Reservoir->show(); m_LiveStackingUI.ReservoirLabel->show();
             break;
         case LiveStackStackingMethod::IMAGEMM:
             m_LiveStackingUI.LowSigma->hide(); m_LiveStackingUI.LowSigmaLabel->hide();
@@ -1146,6 +1167,9 @@ void FITSTab::stackMethodChanged(int index)
             m_LiveStackingUI.Alpha->show(); m_LiveStackingUI.AlphaLabel->show();
             m_LiveStackingUI.Sigma->show(); m_LiveStackingUI.SigmaLabel->show();
             m_LiveStackingUI.PSFUpdate->show(); m_LiveStackingUI.PSFUpdateLabel->show();
+            m_LiveStackingUI.MemBudget->hide(); m_LiveStackingUI.MemBudgetLabel->hide();
+            m_LiveStackingUI.ClipMode->hide(); m_LiveStackingUI.ClipModeLabel->hide();
+            m_LiveStackingUI.Reservoir->hide(); m_LiveStackingUI.ReservoirLabel->hide();
             break;
         default:
             break;
@@ -1611,6 +1635,9 @@ void FITSTab::liveStack()
             << " | Sigma: " << lsd.sigma
             << " | PSF Update: " << lsd.PSFUpdate
             << " | NumInMem: " << lsd.numInMem
+            << " | MemBudget: " << lsd.memBudgetMB << "MB"
+            << " | Streaming: " << (lsd.streaming ? "On" : "Off")
+            << " | Reservoir: " << lsd.reservoirSize
             << " | PostProc: " << (lsd.postProcessing.postProcess ? "On" : "Off")
             << " [Deconv=" << lsd.postProcessing.deconvAmt
             << ", PSFSigma=" << lsd.postProcessing.PSFSigma
@@ -87,10 +87,20 @@ void ComputeGBStretchParams(const StretchParams &newParams, StretchParams* param
 // We call stretch even if we're not stretching, as the stretch code still
 // converts the image to the uint8 output image which will be displayed.
 // In that case, it will use an identity stretch.
+// Only tiles which aren't already stretched with the same parameters are stretched, and while the
+// user is dragging the stretch sliders only the visible ones.
 void FITSView::doStretch(QImage *outputImage)
 {
     if (outputImage->isNull() || m_ImageData.isNull())
         return;
+
+    // The pixels may have been changed in place without dataChanged, e.g. by dark subtraction or debayering
+    if (m_ImageData->dataGeneration() != m_StretchedDataGeneration)
+    {
+        invalidateStretch();
+        m_StretchedDataGeneration = m_ImageData->dataGeneration();
+    }
+
     Stretch stretch(static_cast<int>(m_ImageData->width()),
                     static_cast<int>(m_ImageData->height()),
                     m_ImageData->channels(), m_ImageData->dataType());
@@ -100,8 +110,13 @@ void FITSView::doStretch(QImage *outputImage)
         tempParams = StretchParams();  // Keeping it linear
     else if (autoStretch)
     {
-        // Compute new auto-stretch params.
-        stretchParams = stretch.computeParams(m_ImageData->getImageBuffer(), m_AutoStretchPreset);
+        // Compute new auto-stretch params, unless they are known for this data.
+        if (m_AutoStretchParamsPreset != m_AutoStretchPreset)
+        {
+            m_AutoStretchParams = stretch.computeParams(m_ImageData->getImageBuffer(), m_AutoStretchPreset);
+            m_AutoStretchParamsPreset = m_AutoStretchPreset;
+        }
+        stretchParams = m_AutoStretchParams;
         emit newStretch(stretchParams);
         tempParams = stretchParams;
     }
@@ -109,8 +124,91 @@ void FITSView::doStretch(QImage *outputImage)
         // Use the existing stretch params.
         tempParams = stretchParams;
 
+    if (outputImage != &rawImage)
+    {
+        stretch.setParams(tempParams);
+        stretch.run(m_ImageData->getImageBuffer(), outputImage, m_PreviewSampling);
+        return;
+    }
+
+    if (tempParams != m_StretchedParams)
+    {
+        m_StretchedTiles.fill(false);
+        m_StretchedParams = tempParams;
+    }
+
+    const QRect visible = m_StretchingInProgress ? visibleImageRect() : QRect();
+    QVector<QRect> tiles;
+    bool complete = true;
+    for (int i = 0; i < m_StretchTiles.size(); i++)
+    {
+        if (m_StretchedTiles[i])
+            continue;
+        if (visible.isValid() && !visible.intersects(m_StretchTiles[i]))
+        {
+            complete = false;
+            continue;
+        }
+        tiles.append(m_StretchTiles[i]);
+        m_StretchedTiles[i] = true;
+    }
+    if (tiles.isEmpty())
+        return;
+
+    // The pyramid, and a build of it still running, share rawImage's pixels. Release them here on the GUI thread,
+    // or each stretch worker would detach its own copy of the image while writing its tiles.
+    m_Pyramid.clear();
+    rawImage.detach();
+
     stretch.setParams(tempParams);
-    stretch.run(m_ImageData->getImageBuffer(), outputImage, m_PreviewSampling);
+    stretch.run(m_ImageData->getImageBuffer(), outputImage, m_PreviewSampling, tiles);
+    m_ScaledImage = QImage();
+
+    // Only build the pyramid of a fully stretched image, not while the stretch is being adjusted
+    if (complete)
+        m_Pyramid.build(rawImage);
+}
+
+// Forget all the stretched tiles and auto-stretch parameters, after the image data changed.
+void FITSView::invalidateStretch()
+{
+    m_StretchedTiles.fill(false);
+    m_AutoStretchParamsPreset = 0;
+    m_ScaledImage = QImage();
+    m_Pyramid.clear();
+}
+
+// Whether anything is drawn over rawImage to make the display pixmap.
+bool FITSView::hasOverlays()
+{
+    const bool masked = dynamic_cast<ImageMosaicMask *>(m_ImageMask.get()) != nullptr ||
+                        (m_ImageMask && dynamic_cast<ImageRingMask *>(m_ImageMask.get()) != nullptr && m_ImageMask->active());
+
+    return masked || showHiPSOverlay || (trackingBoxEnabled && getCursorMode() != FITSView::scopeCursor) ||
+           !markerCrosshair.isNull() || showCrosshair || showObjects || showEQGrid || showPixelGrid || markStars ||
+           showClipping || showMagnifyingGlass;
+}
+
+QImage FITSView::getScaledDisplayImage(int width, Qt::TransformationMode mode)
+{
+    if (displayPixmap.width() <= width)
+        return displayPixmap.toImage();
+    if (!hasOverlays() && !rawImage.isNull())
+        return m_Pyramid.isReady() ? m_Pyramid.scaledToWidth(width, mode) : rawImage.scaledToWidth(width, mode);
+    return displayPixmap.scaledToWidth(width, mode).toImage();
+}
+
+// The part of rawImage visible in the viewport, or an invalid rectangle if it can't be told.
+QRect FITSView::visibleImageRect()
+{
+    if (m_ImageFrame.isNull() || currentZoom <= 0 || dynamic_cast<ImageMosaicMask *>(m_ImageMask.get()) != nullptr)
+        return QRect();
+
+    // Size on screen of a rawImage pixel
+    const double scale = m_PreviewSampling * currentZoom / ZOOM_DEFAULT;
+    const QRectF visible(horizontalScrollBar()->value() / scale, verticalScrollBar()->value() / scale,
+                         viewport()->width() / scale, viewport()->height() / scale);
+    return visible.toAlignedRect().adjusted(-1, -1, 1, 1);
 }
 
 // Store stretch parameters, and turn on stretching if it isn't already on.
@@ -591,8 +689,10 @@ bool FITSView::processData()
     if (!m_ImageData)
         return false;
 
+    invalidateStretch();
     connect(m_ImageData.data(), &FITSData::dataChanged, this, [this]()
     {
+        invalidateStretch();
         rescale(ZOOM_KEEP_LEVEL);
         updateFrame();
     });
@@ -1104,8 +1204,15 @@ void FITSView::updateFrameSmallImage()
 {
     if (m_ImageFrame.isNull())
         return;
-    QImage scaledImage = rawImage.scaled(currentWidth, currentHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    if (!initDisplayPixmap(scaledImage, currentZoom / ZOOM_DEFAULT))
+    // Overlays are redrawn far more often than the image is zoomed or stretched, keep the scaled image
+    if (m_ScaledImage.isNull() || m_ScaledImageSize != QSize(currentWidth, currentHeight))
+    {
+        m_ScaledImage = m_Pyramid.isReady() ?
+                        m_Pyramid.scaled(QSize(currentWidth, currentHeight)) :
+                        rawImage.scaled(currentWidth, currentHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        m_ScaledImageSize = QSize(currentWidth, currentHeight);
+    }
+    if (!initDisplayPixmap(m_ScaledImage, currentZoom / ZOOM_DEFAULT))
         return;
 
     QPainter painter(&displayPixmap);
@@ -2651,6 +2758,15 @@ void FITSView::initDisplayImage()
     int w = (m_ImageData->width() + m_PreviewSampling - 1) / m_PreviewSampling;
     int h = (m_ImageData->height() + m_PreviewSampling - 1) / m_PreviewSampling;
 
+    // Keep the image, and its stretched tiles, if it is still the right size.
+    const QImage::Format format = m_ImageData->channels() == 1 ? QImage::Format_Indexed8 : QImage::Format_RGB32;
+    if (rawImage.width() == w && rawImage.height() == h && rawImage.format() == format)
+        return;
+
+    m_StretchTiles = Stretch::tiles(QSize(w, h));
+    m_StretchedTiles.fill(false, m_StretchTiles.size());
+    m_ScaledImage = QImage();
+
     if (m_ImageData->channels() == 1)
     {
         rawImage = QImage(w, h, QImage::Format_Indexed8);
@@ -13,6 +13,7 @@
 
 #include <config-kstars.h>
 #include "stretch.h"
+#include "imagepyramid.h"
 
 #ifdef HAVE_DATAVISUALIZATION
 #include "starprofileviewer.h"
@@ -133,6 +134,12 @@ class FITSView : public QScrollArea
         {
             return displayPixmap;
         }
+        /**
+         * @brief getScaledDisplayImage Get the displayed image reduced to a width, for previews.
+         * Unless overlays are drawn on the image, it is scaled from the image pyramid rather than
+         * from the full display pixmap.
+         */
+        QImage getScaledDisplayImage(int width, Qt::TransformationMode mode = Qt::SmoothTransformation);
 
         // Tracking square
         void setTrackingBoxEnabled(bool enable);
@@ -417,6 +424,9 @@ class FITSView : public QScrollArea
     private:
         bool processData();
         void doStretch(QImage *outputImage);
+        void invalidateStretch();
+        bool hasOverlays();
+        QRect visibleImageRect();
         double scaleSize(double size);
         bool isLargeImage();
         bool initDisplayPixmap(QImage &image, float space);
@@ -439,6 +449,21 @@ class FITSView : public QScrollArea
 
         // Original full-size image
         QImage rawImage;
+        // Tiles of rawImage, and whether each is stretched with m_StretchedParams. Tiles are only
+        // stretched again when the data, the stretch parameters or the sampling change.
+        QVector<QRect> m_StretchTiles;
+        QVector<bool> m_StretchedTiles;
+        StretchParams m_StretchedParams;
+        // Auto-stretch parameters of the current data, and the preset they were computed for (0 if none)
+        StretchParams m_AutoStretchParams;
+        int m_AutoStretchParamsPreset { 0 };
+        // Data generation the tiles and auto-stretch parameters are for
+        uint32_t m_StretchedDataGeneration { 0 };
+        // Reduced copies of rawImage, built in the background once all its tiles are stretched
+        ImagePyramid m_Pyramid;
+        // rawImage scaled for the current zoom, for small images. Null when it needs to be scaled again.
+        QImage m_ScaledImage;
+        QSize m_ScaledImageSize;
         // Actual pixmap after all the overlays
         QPixmap displayPixmap;
 
@@ -0,0 +1,87 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "framebufferpool.h"
+
+#include "fits_debug.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+FrameBufferPool *FrameBufferPool::Instance()
+{
+    // Never destroyed: frames may still be released while static objects are being torn down
+    static FrameBufferPool *pool = new FrameBufferPool();
+    return pool;
+}
+
+QSharedPointer<FrameBuffer> FrameBufferPool::acquire(const char *data, size_t size)
+{
+    std::unique_ptr<FrameBuffer> buffer;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+
+        // Take the smallest free buffer large enough, frames usually keep the same size
+        auto best = m_FreeBuffers.end();
+        for (auto it = m_FreeBuffers.begin(); it != m_FreeBuffers.end(); ++it)
+        {
+            if ((*it)->m_Capacity >= size && (best == m_FreeBuffers.end() || (*it)->m_Capacity < (*best)->m_Capacity))
+                best = it;
+        }
+
+        if (best != m_FreeBuffers.end())
+        {
+            buffer = std::move(*best);
+            m_FreeBuffers.erase(best);
+        }
+    }
+
+    if (!buffer)
+    {
+        buffer.reset(new FrameBuffer());
+        buffer->m_Data.reset(new (std::nothrow) char[size]);
+        if (!buffer->m_Data)
+        {
+            qCCritical(KSTARS_FITS) << "Failed to allocate a frame buffer of" << size << "bytes";
+            return QSharedPointer<FrameBuffer>();
+        }
+        buffer->m_Capacity = size;
+    }
+
+    buffer->m_Size = size;
+    memcpy(buffer->m_Data.get(), data, size);
+
+    return QSharedPointer<FrameBuffer>(buffer.release(), [](FrameBuffer * released)
+    {
+        FrameBufferPool::Instance()->release(released);
+    });
+}
+
+void FrameBufferPool::release(FrameBuffer *buffer)
+{
+    std::unique_ptr<FrameBuffer> released(buffer);
+
+    QMutexLocker locker(&m_Mutex);
+    m_FreeBuffers.push_back(std::move(released));
+
+    // Drop the smallest buffer when there are too many, large frames are the costly ones to allocate
+    if (m_FreeBuffers.size() > MAX_FREE_BUFFERS)
+    {
+        auto smallest = std::min_element(m_FreeBuffers.begin(), m_FreeBuffers.end(), [](const auto & a, const auto & b)
+        {
+            return a->m_Capacity < b->m_Capacity;
+        });
+        m_FreeBuffers.erase(smallest);
+    }
+}
+
+void FrameBufferPool::clear()
+{
+    QMutexLocker locker(&m_Mutex);
+    m_FreeBuffers.clear();
+}
@@ -0,0 +1,97 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+/**
+ * @class FrameBuffer
+ * @short Memory holding one frame received from a camera.
+ *
+ * Frame buffers are obtained from FrameBufferPool and shared through QSharedPointer. Once the
+ * last reference is dropped the memory goes back to the pool to receive a later frame.
+ */
+class FrameBuffer
+{
+    public:
+        char *data()
+        {
+            return m_Data.get();
+        }
+        const char *data() const
+        {
+            return m_Data.get();
+        }
+        size_t size() const
+        {
+            return m_Size;
+        }
+
+        /**
+         * @return the frame as a QByteArray which does not copy the data. It is only valid while
+         * a reference to this frame buffer is held. Empty if the frame is too large for a QByteArray.
+         */
+        QByteArray bytes() const
+        {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            using Size = qsizetype;
+#else
+            using Size = int;
+#endif
+            if (m_Size > static_cast<size_t>(std::numeric_limits<Size>::max()))
+                return QByteArray();
+            return QByteArray::fromRawData(m_Data.get(), static_cast<Size>(m_Size));
+        }
+
+    private:
+        friend class FrameBufferPool;
+
+        std::unique_ptr<char[]> m_Data;
+        size_t m_Capacity { 0 };
+        size_t m_Size { 0 };
+};
+
+/**
+ * @class FrameBufferPool
+ * @short Recycles the memory of camera frames.
+ *
+ * A frame received from INDI is copied once into a pooled FrameBuffer. The same buffer is then
+ * decoded by FITSData and written to disk in the background. Whichever finishes last returns it
+ * to the pool, so back-to-back frames of the same size reuse the same few allocations.
+ */
+class FrameBufferPool
+{
+    public:
+        static FrameBufferPool *Instance();
+
+        /**
+         * @brief Get a buffer holding a copy of @p data
+         * @param data first byte to copy
+         * @param size of the data in bytes
+         * @return a shared frame buffer, or a null pointer if memory could not be allocated
+         */
+        QSharedPointer<FrameBuffer> acquire(const char *data, size_t size);
+
+        /** @brief Free the memory of the buffers which are not in use */
+        void clear();
+
+    private:
+        FrameBufferPool() = default;
+
+        void release(FrameBuffer *buffer);
+
+        // Released buffers kept for reuse. A few are enough to cover a frame being decoded and a
+        // couple being written while the next one arrives.
+        static constexpr size_t MAX_FREE_BUFFERS = 4;
+
+        QMutex m_Mutex;
+        std::vector<std::unique_ptr<FrameBuffer>> m_FreeBuffers;
+};
@@ -0,0 +1,137 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "imagepyramid.h"
+
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+ImagePyramid::ImagePyramid() : m_State(new State())
+{
+}
+
+void ImagePyramid::build(const QImage &image)
+{
+    quint64 generation;
+    {
+        QMutexLocker locker(&m_State->mutex);
+        m_State->image = image;
+        m_State->levels.clear();
+        m_State->ready = false;
+        generation = ++m_State->generation;
+    }
+
+    if (image.isNull())
+        return;
+
+    QSharedPointer<State> state = m_State;
+    QtConcurrent::run([state, image, generation]()
+    {
+        QVector<QImage> levels;
+        QImage level = image;
+        while (level.width() / 2 >= MIN_LEVEL_SIZE && level.height() / 2 >= MIN_LEVEL_SIZE)
+        {
+            // Give up early if a newer image came in
+            if (state->generation != generation)
+                return;
+            level = halve(level);
+            levels.append(level);
+        }
+
+        QMutexLocker locker(&state->mutex);
+        if (state->generation != generation)
+            return;
+        state->levels = levels;
+        state->ready = true;
+    });
+}
+
+void ImagePyramid::clear()
+{
+    QMutexLocker locker(&m_State->mutex);
+    m_State->image = QImage();
+    m_State->levels.clear();
+    m_State->ready = false;
+    ++m_State->generation;
+}
+
+bool ImagePyramid::isReady() const
+{
+    QMutexLocker locker(&m_State->mutex);
+    return m_State->ready;
+}
+
+QImage ImagePyramid::source(const QSize &size) const
+{
+    QMutexLocker locker(&m_State->mutex);
+    // Levels get smaller, keep the last one still large enough
+    QImage result = m_State->image;
+    for (const auto &level : m_State->levels)
+    {
+        if (level.width() < size.width() || level.height() < size.height())
+            break;
+        result = level;
+    }
+    return result;
+}
+
+QImage ImagePyramid::scaled(const QSize &size, Qt::TransformationMode mode) const
+{
+    const QImage image = source(size);
+    if (image.isNull() || image.size() == size)
+        return image;
+    return image.scaled(size, Qt::KeepAspectRatio, mode);
+}
+
+QImage ImagePyramid::scaledToWidth(int width, Qt::TransformationMode mode) const
+{
+    QImage image;
+    {
+        QMutexLocker locker(&m_State->mutex);
+        image = m_State->image;
+    }
+    if (image.isNull() || image.width() <= 0)
+        return image;
+
+    const int height = std::max(1, static_cast<int>(static_cast<qint64>(image.height()) * width / image.width()));
+    return scaled(QSize(width, height), mode);
+}
+
+QImage ImagePyramid::halve(const QImage &image)
+{
+    const int width = image.width() / 2;
+    const int height = image.height() / 2;
+
+    if (image.format() == QImage::Format_Indexed8)
+    {
+        QImage result(width, height, QImage::Format_Indexed8);
+        result.setColorTable(image.colorTable());
+        for (int y = 0; y < height; y++)
+        {
+            const uchar *top = image.constScanLine(2 * y);
+            const uchar *bottom = image.constScanLine(2 * y + 1);
+            uchar *out = result.scanLine(y);
+            for (int x = 0; x < width; x++)
+                out[x] = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) / 4;
+        }
+        return result;
+    }
+
+    const QImage rgb = image.format() == QImage::Format_RGB32 ? image : image.convertToFormat(QImage::Format_RGB32);
+    QImage result(width, height, QImage::Format_RGB32);
+    for (int y = 0; y < height; y++)
+    {
+        const QRgb *top = reinterpret_cast<const QRgb *>(rgb.constScanLine(2 * y));
+        const QRgb *bottom = reinterpret_cast<const QRgb *>(rgb.constScanLine(2 * y + 1));
+        QRgb *out = reinterpret_cast<QRgb *>(result.scanLine(y));
+        for (int x = 0; x < width; x++)
+        {
+            const QRgb a = top[2 * x], b = top[2 * x + 1], c = bottom[2 * x], d = bottom[2 * x + 1];
+            out[x] = qRgb((qRed(a) + qRed(b) + qRed(c) + qRed(d) + 2) / 4,
+                          (qGreen(a) + qGreen(b) + qGreen(c) + qGreen(d) + 2) / 4,
+                          (qBlue(a) + qBlue(b) + qBlue(c) + qBlue(d) + 2) / 4);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,72 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QImage>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <atomic>
+
+/**
+ * @class ImagePyramid
+ * @short Reduced copies of a display image, each half the size of the previous one.
+ *
+ * The levels are built in the background once the display image is ready. A smaller copy of the
+ * image is then scaled from the closest level larger than it, rather than from the full frame.
+ * Until the levels are built, the full image is scaled instead.
+ */
+class ImagePyramid
+{
+    public:
+        ImagePyramid();
+
+        /**
+         * @brief build Drop the current levels and start building those of a new image.
+         * @param image display image, in Format_Indexed8 greyscale or Format_RGB32. It is shared,
+         * not copied, so the caller must clear() the pyramid and detach its image before writing to it
+         * from several threads.
+         */
+        void build(const QImage &image);
+
+        /** @brief clear Drop the image and its levels */
+        void clear();
+
+        /** @return true once the levels of the current image are built */
+        bool isReady() const;
+
+        /**
+         * @brief scaled Scale the image to fit in a size, keeping its aspect ratio.
+         * @param size of the result
+         * @param mode transformation used from the closest larger level
+         */
+        QImage scaled(const QSize &size, Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+
+        /** @brief scaledToWidth Same as scaled(), keeping the aspect ratio for the given width */
+        QImage scaledToWidth(int width, Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+
+        /** @brief Halve an image, averaging each 2x2 block of pixels */
+        static QImage halve(const QImage &image);
+
+    private:
+        // Levels get no smaller than this in either dimension
+        static constexpr int MIN_LEVEL_SIZE = 64;
+
+        // Shared with the background build, so a build outliving the pyramid is harmless
+        struct State
+        {
+            QMutex mutex;
+            QImage image;
+            QVector<QImage> levels;
+            // Incremented for each new image, a build finishing for an older one is dropped
+            std::atomic<quint64> generation { 0 };
+            bool ready { false };
+        };
+        QSharedPointer<State> m_State;
+
+        // Smallest image, full or reduced, at least as large as size in both dimensions
+        QImage source(const QSize &size) const;
+};
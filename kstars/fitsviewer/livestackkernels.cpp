@@ -0,0 +1,414 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "livestackkernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// Runtime dispatch. GCC builds a clone of the kernel per target and selects one when the
+// program loads (via ifunc), so only ELF platforms are supported. Elsewhere the kernel is
+// compiled once for the baseline instruction set.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define LIVESTACK_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#define LIVESTACK_HAVE_TARGET_CLONES
+#else
+#define LIVESTACK_TARGET_CLONES
+#endif
+
+namespace LiveStackKernels
+{
+
+namespace
+{
+// Number of adjacent pixels processed together; 16 floats fills an AVX-512 register
+constexpr int BLOCK = 16;
+
+// Above this many subs a per-pixel selection is cheaper than a full sorting network
+constexpr int MAX_NETWORK_SUBS = 32;
+
+using Network = std::vector<std::pair<int, int>>;
+
+// Batcher's odd-even merge sort network for n elements (n need not be a power of 2)
+Network buildNetwork(const int n)
+{
+    Network network;
+    for (int p = 1; p < n; p += p)
+        for (int k = p; k > 0; k /= 2)
+            for (int j = k % p; j + k < n; j += k + k)
+                for (int i = 0; i < std::min(k, n - j - k); i++)
+                    if ((i + j) / (p + p) == (i + j + k) / (p + p))
+                        network.push_back(std::make_pair(i + j, i + j + k));
+    return network;
+}
+
+// Samples needed before streamingSigmaClip starts to reject values
+constexpr int MIN_STREAMING_SAMPLES = 3;
+
+// Samples in the reservoir used by streamingSigmaClip to re-check the warm up values
+constexpr int ROBUST_STREAMING_SAMPLES = 8;
+
+// Scale factor from the median absolute deviation to the standard deviation of a normal distribution
+constexpr float MAD_TO_SIGMA = 1.4826f;
+
+// SplitMix64 finalizer. A stateless hash so reservoir sampling is repeatable and thread safe
+inline uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Median of the first n values (n > 0). Reorders values
+inline float median(float *values, const int n)
+{
+    const int mid = n / 2;
+    std::nth_element(values, values + mid, values + n);
+    if (n % 2)
+        return values[mid];
+    const float below = *std::max_element(values, values + mid);
+    return 0.5f * (below + values[mid]);
+}
+
+// Weighted Welford update. stat is count, weightSum, mean, M2 (count is not changed)
+inline void welford(float *stat, const float value, const float weight)
+{
+    const float weightSum = stat[1] + weight;
+    const float delta = value - stat[2];
+    stat[2] += delta * weight / weightSum;
+    stat[3] += weight * delta * (value - stat[2]);
+    stat[1] = weightSum;
+}
+
+// Rebuild the running estimate and stack for a pixel from the first count values, all of which are
+// still in the reservoir. Values further than the sigma clipping bounds from the median (using the
+// MAD as the scale) are dropped. Individual weights aren't kept so the average weight is used.
+void recheckWarmUp(const float *pixelReservoir, const int count, const SigmaClipParams &params, float *scratch,
+                   float *stat, float *clip)
+{
+    std::copy(pixelReservoir, pixelReservoir + count, scratch);
+    const float centre = median(scratch, count);
+    for (int i = 0; i < count; i++)
+        scratch[i] = std::fabs(pixelReservoir[i] - centre);
+    const float scale = MAD_TO_SIGMA * median(scratch, count);
+    if (scale <= 0.0f)
+        return;
+
+    const float lower = centre - params.lowSigma * scale;
+    const float upper = centre + params.highSigma * scale;
+    const float weight = stat[1] / count;
+    float newStat[4] = { stat[0], 0.0f, 0.0f, 0.0f };
+    float sum = 0.0f, weightSum = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        float value = pixelReservoir[i];
+        if (params.winsorize)
+            value = std::clamp(value, centre - params.windsorCutoff * scale, centre + params.windsorCutoff * scale);
+        if (value >= lower && value <= upper)
+        {
+            sum += value * weight;
+            weightSum += weight;
+        }
+        welford(newStat, std::clamp(value, lower, upper), weight);
+    }
+    if (weightSum <= 0.0f)
+        return;
+
+    std::copy(newStat, newStat + 4, stat);
+    clip[2] = sum;
+    clip[3] = weightSum;
+}
+}
+
+namespace detail
+{
+// The kernel. Each loop over l runs across the BLOCK pixels so it is branch-free and vectorizes.
+LIVESTACK_TARGET_CLONES
+void sigmaClipBlocks(const float * const *images, const int numImages, const float *weights, const int channels,
+                     const int start, const int end, const SigmaClipParams &params,
+                     const bool useNetwork, const std::pair<int, int> *network, const int networkSize,
+                     float *out, float * const *sigmaClip)
+{
+    // values[sub][lane] are in sub order so they stay matched with the weights
+    std::vector<float> values(static_cast<size_t>(numImages) * BLOCK);
+    std::vector<float> sorted(useNetwork ? values.size() : 0);
+    std::vector<float> selection(useNetwork ? 0 : numImages);
+
+    alignas(64) float midLow[BLOCK], midHigh[BLOCK], median[BLOCK], stddev[BLOCK];
+    alignas(64) float lower[BLOCK], upper[BLOCK], sum[BLOCK], weightSum[BLOCK], pixel[BLOCK];
+
+    const int mid = numImages / 2;
+    const bool even = (numImages % 2) == 0;
+    const float invN = 1.0f / numImages;
+    const float invN1 = (numImages > 1) ? 1.0f / (numImages - 1) : 0.0f;
+
+    // Sample standard deviation (n - 1) of values for each lane
+    auto computeStdDev = [&]()
+    {
+        alignas(64) float mean[BLOCK] = {}, var[BLOCK] = {};
+        for (int i = 0; i < numImages; i++)
+        {
+            const float *v = &values[static_cast<size_t>(i) * BLOCK];
+            for (int l = 0; l < BLOCK; l++)
+                mean[l] += v[l];
+        }
+        for (int l = 0; l < BLOCK; l++)
+            mean[l] *= invN;
+        for (int i = 0; i < numImages; i++)
+        {
+            const float *v = &values[static_cast<size_t>(i) * BLOCK];
+            for (int l = 0; l < BLOCK; l++)
+            {
+                const float d = v[l] - mean[l];
+                var[l] += d * d;
+            }
+        }
+        for (int l = 0; l < BLOCK; l++)
+            stddev[l] = std::sqrt(var[l] * invN1);
+    };
+
+    for (int x0 = start; x0 < end; x0 += BLOCK)
+    {
+        const int lanes = std::min(BLOCK, end - x0);
+        for (int ch = 0; ch < channels; ch++)
+        {
+            // Gather the block. Unused lanes in a final partial block repeat the last pixel
+            for (int i = 0; i < numImages; i++)
+            {
+                const float *src = images[i] + static_cast<size_t>(x0) * channels + ch;
+                float *dst = &values[static_cast<size_t>(i) * BLOCK];
+                if (lanes == BLOCK)
+                {
+                    for (int l = 0; l < BLOCK; l++)
+                        dst[l] = src[l * channels];
+                }
+                else
+                {
+                    for (int l = 0; l < BLOCK; l++)
+                        dst[l] = src[std::min(l, lanes - 1) * channels];
+                }
+            }
+
+            // The two middle values of each lane, equal when the number of subs is odd
+            if (useNetwork)
+            {
+                std::copy(values.begin(), values.end(), sorted.begin());
+                for (int c = 0; c < networkSize; c++)
+                {
+                    float *a = &sorted[static_cast<size_t>(network[c].first) * BLOCK];
+                    float *b = &sorted[static_cast<size_t>(network[c].second) * BLOCK];
+                    for (int l = 0; l < BLOCK; l++)
+                    {
+                        const float lo = std::min(a[l], b[l]);
+                        const float hi = std::max(a[l], b[l]);
+                        a[l] = lo;
+                        b[l] = hi;
+                    }
+                }
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    midHigh[l] = sorted[static_cast<size_t>(mid) * BLOCK + l];
+                    midLow[l] = even ? sorted[static_cast<size_t>(mid - 1) * BLOCK + l] : midHigh[l];
+                }
+            }
+            else
+            {
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    for (int i = 0; i < numImages; i++)
+                        selection[i] = values[static_cast<size_t>(i) * BLOCK + l];
+                    std::nth_element(selection.begin(), selection.begin() + mid, selection.end());
+                    midHigh[l] = selection[mid];
+                    midLow[l] = even ? *std::max_element(selection.begin(), selection.begin() + mid) : midHigh[l];
+                }
+            }
+
+            if (params.winsorize)
+            {
+                // Clamp outliers to median +/- cutoff * sigma. Clamping doesn't change the order of the
+                // values so the middle values of the Winsorized data are the clamped middle values
+                for (int l = 0; l < BLOCK; l++)
+                    median[l] = 0.5f * (midLow[l] + midHigh[l]);
+                computeStdDev();
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    lower[l] = std::max(0.0f, median[l] - stddev[l] * params.windsorCutoff);
+                    upper[l] = median[l] + stddev[l] * params.windsorCutoff;
+                }
+                for (int i = 0; i < numImages; i++)
+                {
+                    float *v = &values[static_cast<size_t>(i) * BLOCK];
+                    for (int l = 0; l < BLOCK; l++)
+                        v[l] = std::min(std::max(v[l], lower[l]), upper[l]);
+                }
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    midLow[l] = std::min(std::max(midLow[l], lower[l]), upper[l]);
+                    midHigh[l] = std::min(std::max(midHigh[l], lower[l]), upper[l]);
+                }
+            }
+
+            for (int l = 0; l < BLOCK; l++)
+                median[l] = 0.5f * (midLow[l] + midHigh[l]);
+
+            if (numImages <= 3)
+            {
+                // For small samples just use median
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    pixel[l] = median[l];
+                    lower[l] = upper[l] = -1.0f;
+                    sum[l] = weightSum[l] = 0.0f;
+                }
+            }
+            else
+            {
+                computeStdDev();
+                for (int l = 0; l < BLOCK; l++)
+                {
+                    lower[l] = std::max(0.0f, median[l] - stddev[l] * params.lowSigma);
+                    upper[l] = median[l] + stddev[l] * params.highSigma;
+                    sum[l] = weightSum[l] = 0.0f;
+                }
+
+                // Branch-free clipping mask
+                for (int i = 0; i < numImages; i++)
+                {
+                    const float *v = &values[static_cast<size_t>(i) * BLOCK];
+                    const float w = weights[i];
+                    for (int l = 0; l < BLOCK; l++)
+                    {
+                        const bool keep = (v[l] >= lower[l]) & (v[l] <= upper[l]);
+                        sum[l] += keep ? v[l] * w : 0.0f;
+                        weightSum[l] += keep ? w : 0.0f;
+                    }
+                }
+                for (int l = 0; l < BLOCK; l++)
+                    pixel[l] = (weightSum[l] > 0.0f) ? sum[l] / weightSum[l] : median[l];
+            }
+
+            // Scatter results
+            float *sc = sigmaClip[ch];
+            for (int l = 0; l < lanes; l++)
+            {
+                const size_t x = static_cast<size_t>(x0 + l);
+                out[x * channels + ch] = pixel[l];
+                sc[x * 4 + 0] = lower[l];
+                sc[x * 4 + 1] = upper[l];
+                sc[x * 4 + 2] = sum[l];
+                sc[x * 4 + 3] = weightSum[l];
+            }
+        }
+    }
+}
+}
+
+void sigmaClip(const std::vector<const float *> &images, const float *weights, const int channels,
+               const int start, const int end, const SigmaClipParams &params, float *out,
+               float * const *sigmaClip)
+{
+    const int numImages = images.size();
+    if (numImages <= 0 || end <= start)
+        return;
+
+    const bool useNetwork = numImages <= MAX_NETWORK_SUBS;
+    const Network network = useNetwork ? buildNetwork(numImages) : Network();
+
+    detail::sigmaClipBlocks(images.data(), numImages, weights, channels, start, end, params, useNetwork,
+                            network.data(), network.size(), out, sigmaClip);
+}
+
+void streamingSigmaClip(const float *image, const float weight, const int channels, const int start, const int end,
+                        const SigmaClipParams &params, const int reservoirSize, float *out,
+                        float * const *sigmaClip, float * const *stats, float * const *reservoir)
+{
+    const int samples = std::max(0, std::min(reservoirSize, MAX_RESERVOIR_SIZE));
+    // With a reservoir, the values accepted during warm up are re-checked once there are enough samples
+    const int recheckCount = std::max(MIN_STREAMING_SAMPLES, std::min(samples, ROBUST_STREAMING_SAMPLES));
+    const bool recheck = samples >= recheckCount;
+    float scratch[MAX_RESERVOIR_SIZE];
+
+    for (int x = start; x < end; x++)
+    {
+        for (int ch = 0; ch < channels; ch++)
+        {
+            const int offset = x * channels + ch;
+            float *stat = stats[ch] + 4 * x;
+            float *clip = sigmaClip[ch] + 4 * x;
+            float *pixelReservoir = (samples > 0) ? reservoir[ch] + static_cast<size_t>(x) * samples : nullptr;
+            const float pixel = image[offset];
+            const int count = static_cast<int>(stat[0]);
+
+            // The reservoir holds every value seen so far. Redo the stack of those values using the
+            // median and MAD so outliers that arrived before clipping started are removed
+            if (recheck && count == recheckCount)
+                recheckWarmUp(pixelReservoir, count, params, scratch, stat, clip);
+
+            float value = pixel;
+            float update = pixel;
+            bool accept = true;
+            if (count >= MIN_STREAMING_SAMPLES)
+            {
+                float centre = stat[2];
+                if (samples > 0)
+                {
+                    const int n = std::min(count, samples);
+                    std::copy(pixelReservoir, pixelReservoir + n, scratch);
+                    centre = median(scratch, n);
+                }
+                const float stddev = std::sqrt(std::max(0.0f, stat[3] / stat[1]));
+
+                if (params.winsorize)
+                    value = std::clamp(value, centre - params.windsorCutoff * stddev,
+                                       centre + params.windsorCutoff * stddev);
+
+                clip[0] = centre - params.lowSigma * stddev;
+                clip[1] = centre + params.highSigma * stddev;
+                accept = (value >= clip[0] && value <= clip[1]);
+                update = std::clamp(value, clip[0], clip[1]);
+            }
+
+            if (accept)
+            {
+                clip[2] += value * weight;
+                clip[3] += weight;
+            }
+
+            // Weighted Welford update of the running mean and sum of squared deviations
+            welford(stat, update, weight);
+
+            // Reservoir sampling (Algorithm R) so the reservoir is a uniform sample of all values so far
+            if (samples > 0)
+            {
+                const uint64_t seen = static_cast<uint64_t>(count);
+                uint64_t slot = seen;
+                if (count >= samples)
+                    slot = mix64((seen << 32) ^ static_cast<uint64_t>(offset)) % (seen + 1);
+                if (slot < static_cast<uint64_t>(samples))
+                    pixelReservoir[slot] = pixel;
+            }
+            stat[0] = count + 1;
+
+            out[offset] = (clip[3] > 0.0f) ? clip[2] / clip[3] : stat[2];
+        }
+    }
+}
+
+const char *simdLevel()
+{
+#ifdef LIVESTACK_HAVE_TARGET_CLONES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return "AVX-512";
+    if (__builtin_cpu_supports("avx2"))
+        return "AVX2";
+    if (__builtin_cpu_supports("sse4.2"))
+        return "SSE4.2";
+#endif
+    return "Baseline";
+}
+
+}
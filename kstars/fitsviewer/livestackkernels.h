@@ -0,0 +1,86 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <vector>
+
+/**
+ * @namespace LiveStackKernels
+ * @brief Per-pixel rejection kernels used by FITSStack for Sigma Clipping and Windsorization.
+ *
+ * The kernels take a stack of aligned subs (float, interleaved channels) and combine a range of
+ * pixels. sigmaClip() processes blocks of adjacent pixels at once: values for the block are laid
+ * out sub-major so every step (sorting network for the median, mean / variance, Winsorization and
+ * the clipping mask) is a branch-free loop over the pixels in the block that the compiler can
+ * vectorize. On x86-64 Linux builds with GCC the kernel is compiled for AVX-512, AVX2 and SSE4.2
+ * as well as the baseline ISA and the best version is picked at runtime.
+ *
+ * sigmaClipReference() is the original per-pixel implementation using RobustStatistics. It is kept
+ * for testing and benchmarking the vectorized kernel.
+ *
+ * streamingSigmaClip() is used when the stack is built one sub at a time without keeping the subs.
+ */
+namespace LiveStackKernels
+{
+
+struct SigmaClipParams
+{
+    bool winsorize { false };
+    float windsorCutoff { 3.0f };
+    float lowSigma { 3.0f };
+    float highSigma { 3.0f };
+};
+
+/**
+ * @brief Sigma clip (and optionally Winsorize) pixels [start, end) across a stack of subs
+ * @param images pointer to the first pixel of each sub. Channels are interleaved
+ * @param weights of each sub
+ * @param channels in each sub
+ * @param start first pixel to process
+ * @param end one past the last pixel to process
+ * @param params for the sigma clipping
+ * @param out stacked image (interleaved channels)
+ * @param sigmaClip per channel intermediate results, 4 floats per pixel: lower, upper, sum, weightSum
+ */
+void sigmaClip(const std::vector<const float *> &images, const float *weights, const int channels,
+               const int start, const int end, const SigmaClipParams &params, float *out,
+               float * const *sigmaClip);
+
+// Upper limit on the reservoir size for streamingSigmaClip
+constexpr int MAX_RESERVOIR_SIZE = 64;
+
+/**
+ * @brief Merge a single sub into a streaming sigma clipped stack for pixels [start, end)
+ *
+ * Each pixel / channel keeps a weighted running (Welford) mean and variance. Once a few samples
+ * have been seen, a new value (Winsorized first if requested) is only added to the stack if it
+ * is within the sigma clipping bounds around the centre. Values outside the bounds are clamped to
+ * the bounds before updating the running estimate so a single outlier cannot inflate the variance
+ * but the estimate can still follow a slowly changing sky. If reservoirSize > 0 a uniform random
+ * sample of upto reservoirSize values is kept per pixel and its median is used as the centre.
+ *
+ * Memory and time per pixel are constant however many subs have been merged.
+ * @param image sub to merge. Channels are interleaved
+ * @param weight of the sub
+ * @param channels in the sub
+ * @param start first pixel to process
+ * @param end one past the last pixel to process
+ * @param params for the sigma clipping
+ * @param reservoirSize number of samples per pixel in the reservoir (0 = no reservoir)
+ * @param out stacked image (interleaved channels)
+ * @param sigmaClip per channel, 4 floats per pixel: lower, upper, sum, weightSum
+ * @param stats per channel running estimate, 4 floats per pixel: count, weightSum, mean, M2
+ * @param reservoir per channel, reservoirSize floats per pixel (ignored if reservoirSize is 0)
+ */
+void streamingSigmaClip(const float *image, const float weight, const int channels, const int start, const int end,
+                        const SigmaClipParams &params, const int reservoirSize, float *out,
+                        float * const *sigmaClip, float * const *stats, float * const *reservoir);
+
+/**
+ * @brief Name of the instruction set selected at runtime for sigmaClip, for logging
+ */
+const char *simdLevel();
+
+}
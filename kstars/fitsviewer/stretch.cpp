@@ -10,6 +10,9 @@
 #include <QtConcurrent>
 #include "Options.h"
 
+#include <limits>
+#include <type_traits>
+
 int Stretch::m_NumPresets = 7;
 
 namespace
@@ -48,178 +51,160 @@ T median(T const *values, int size, int sampleBy)
     return median(samples);
 }
 
-// This stretches one channel given the input parameters.
+// Stretches the samples of one channel given the input parameters.
 // Based on the spec in section 8.5.6
 // https://pixinsight.com/doc/docs/XISF-1.0-spec/XISF-1.0-spec.html
-// Uses multiple threads, blocks until done.
 // The extension parameters are not used.
-// Sampling is applied to the output (that is, with sampling=2, we compute every other output
-// sample both in width and height, so the output would have about 4X fewer pixels.
 template <typename T>
-void stretchOneChannel(T *input_buffer, QImage *output_image,
-                       const StretchParams &stretch_params,
-                       int input_range, int image_height, int image_width, int sampling)
+class ChannelStretch
 {
-    QVector<QFuture<void>> futures;
-
-    // We're outputting uint8, so the max output is 255.
-    constexpr int maxOutput = 255;
-
-    // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
-    const float maxInput = input_range > 1 ? input_range - 1 : input_range;
-
-    const float midtones   = stretch_params.grey_red.midtones;
-    const float highlights = stretch_params.grey_red.highlights;
-    const float shadows    = stretch_params.grey_red.shadows;
-
-    // Precomputed expressions moved out of the loop.
-    // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
-    const float hsRangeFactor = highlights == shadows ? 1.0f : 1.0f / (highlights - shadows);
-    // Shadow and highlight values translated to the ADU scale.
-    const T nativeShadows = shadows * maxInput;
-    const T nativeHighlights = highlights * maxInput;
-    // Constants based on above needed for the stretch calculations.
-    const float k1 = (midtones - 1) * hsRangeFactor * maxOutput / maxInput;
-    const float k2 = ((2 * midtones) - 1) * hsRangeFactor / maxInput;
-
-    // Increment the input index by the sampling, the output index increments by 1.
-    for (int j = 0, jout = 0; j < image_height; j += sampling, jout++)
-    {
-        futures.append(QtConcurrent::run([ = ]()
+    public:
+        ChannelStretch(const StretchParams1Channel &params, int input_range)
         {
-            T * inputLine  = input_buffer + j * image_width;
-            auto * scanLine = output_image->scanLine(jout);
+            // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
+            const float maxInput = input_range > 1 ? input_range - 1 : input_range;
+
+            midtones = params.midtones;
+            // Precomputed expressions moved out of the loop.
+            // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
+            const float hsRangeFactor = params.highlights == params.shadows ? 1.0f : 1.0f / (params.highlights - params.shadows);
+            // Shadow and highlight values translated to the ADU scale.
+            nativeShadows = params.shadows * maxInput;
+            nativeHighlights = params.highlights * maxInput;
+            // Constants based on above needed for the stretch calculations.
+            k1 = (midtones - 1) * hsRangeFactor * maxOutput / maxInput;
+            k2 = ((2 * midtones) - 1) * hsRangeFactor / maxInput;
+        }
 
-            for (int i = 0, iout = 0; i < image_width; i += sampling, iout++)
-            {
-                const T input = inputLine[i];
-                if (input < nativeShadows) scanLine[iout] = 0;
-                else if (input >= nativeHighlights) scanLine[iout] = maxOutput;
-                else
-                {
-                    const T inputFloored = (input - nativeShadows);
-                    scanLine[iout] = (inputFloored * k1) / (inputFloored * k2 - midtones);
-                }
-            }
-        }));
-    }
-    for(QFuture<void> future : futures)
-        future.waitForFinished();
+        // Written without branches so that loops over floating point samples vectorize.
+        uint8_t operator()(T input) const
+        {
+            const T inputFloored = (input - nativeShadows);
+            const auto stretched = (inputFloored * k1) / (inputFloored * k2 - midtones);
+            return input < nativeShadows ? 0 : (input >= nativeHighlights ? maxOutput : stretched);
+        }
+
+    private:
+        // We're outputting uint8, so the max output is 255.
+        static constexpr int maxOutput = 255;
+
+        T nativeShadows, nativeHighlights;
+        float k1, k2, midtones;
+};
+
+// 8 and 16 bit samples are stretched with a lookup table holding the output of every input value,
+// which is much cheaper than evaluating the stretch once the image is larger than the table.
+template <typename T>
+constexpr bool useLookupTable()
+{
+    return std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value;
 }
 
-// This is like the above 1-channel stretch, but extended for 3 channels.
-// This could have been more modular, but the three channels are combined
-// into a single qRgb value at the end, so it seems the simplest thing is to
-// replicate the code. It is assume the colors are not interleaved--the red image
-// is stored fully, then the green, then the blue.
+template <typename T>
+class ChannelLookup
+{
+    public:
+        ChannelLookup(const StretchParams1Channel &params, int input_range)
+        {
+            const ChannelStretch<T> stretch(params, input_range);
+            table.resize(std::numeric_limits<T>::max() + 1);
+            for (size_t value = 0; value < table.size(); ++value)
+                table[value] = stretch(static_cast<T>(value));
+        }
+
+        uint8_t operator()(T input) const
+        {
+            return table[input];
+        }
+
+    private:
+        std::vector<uint8_t> table;
+};
+
+template <typename T>
+using ChannelMap = std::conditional_t<useLookupTable<T>(), ChannelLookup<T>, ChannelStretch<T>>;
+
+// Stretches the given tiles of the output image, each tile on its own thread. Blocks until done.
 // Sampling is applied to the output (that is, with sampling=2, we compute every other output
 // sample both in width and height, so the output would have about 4X fewer pixels.
+// 3-channel images are assumed not interleaved--the red image is stored fully, then the green,
+// then the blue--and the three channels are combined into a single qRgb value.
 template <typename T>
-void stretchThreeChannels(T *inputBuffer, QImage *outputImage,
-                          const StretchParams &stretchParams,
-                          int inputRange, int imageHeight, int imageWidth, int sampling)
+void stretchChannels(T const *input_buffer, QImage *output_image,
+                     const StretchParams &stretch_params,
+                     int input_range, int image_height, int image_width, int num_channels, int sampling,
+                     QVector<QRect> tiles)
 {
-    QVector<QFuture<void>> futures;
-
-    // We're outputting uint8, so the max output is 255.
-    constexpr int maxOutput = 255;
-
-    // Maximum possible input value (e.g. 1024*64 - 1 for a 16 bit unsigned int).
-    const float maxInput = inputRange > 1 ? inputRange - 1 : inputRange;
-
-    const float midtonesR   = stretchParams.grey_red.midtones;
-    const float highlightsR = stretchParams.grey_red.highlights;
-    const float shadowsR    = stretchParams.grey_red.shadows;
-    const float midtonesG   = stretchParams.green.midtones;
-    const float highlightsG = stretchParams.green.highlights;
-    const float shadowsG    = stretchParams.green.shadows;
-    const float midtonesB   = stretchParams.blue.midtones;
-    const float highlightsB = stretchParams.blue.highlights;
-    const float shadowsB    = stretchParams.blue.shadows;
-
-    // Precomputed expressions moved out of the loop.
-    // highlights - shadows, protecting for divide-by-0, in a 0->1.0 scale.
-    const float hsRangeFactorR = highlightsR == shadowsR ? 1.0f : 1.0f / (highlightsR - shadowsR);
-    const float hsRangeFactorG = highlightsG == shadowsG ? 1.0f : 1.0f / (highlightsG - shadowsG);
-    const float hsRangeFactorB = highlightsB == shadowsB ? 1.0f : 1.0f / (highlightsB - shadowsB);
-    // Shadow and highlight values translated to the ADU scale.
-    const T nativeShadowsR = shadowsR * maxInput;
-    const T nativeShadowsG = shadowsG * maxInput;
-    const T nativeShadowsB = shadowsB * maxInput;
-    const T nativeHighlightsR = highlightsR * maxInput;
-    const T nativeHighlightsG = highlightsG * maxInput;
-    const T nativeHighlightsB = highlightsB * maxInput;
-    // Constants based on above needed for the stretch calculations.
-    const float k1R = (midtonesR - 1) * hsRangeFactorR * maxOutput / maxInput;
-    const float k1G = (midtonesG - 1) * hsRangeFactorG * maxOutput / maxInput;
-    const float k1B = (midtonesB - 1) * hsRangeFactorB * maxOutput / maxInput;
-    const float k2R = ((2 * midtonesR) - 1) * hsRangeFactorR / maxInput;
-    const float k2G = ((2 * midtonesG) - 1) * hsRangeFactorG / maxInput;
-    const float k2B = ((2 * midtonesB) - 1) * hsRangeFactorB / maxInput;
-
-    const int size = imageWidth * imageHeight;
-
-    for (int j = 0, jout = 0; j < imageHeight; j += sampling, jout++)
+    if (num_channels != 1 && num_channels != 3)
+        return;
+
+    const ChannelMap<T> red(stretch_params.grey_red, input_range);
+    const std::unique_ptr<ChannelMap<T>> green(num_channels == 3 ? new ChannelMap<T>(stretch_params.green, input_range) : nullptr);
+    const std::unique_ptr<ChannelMap<T>> blue(num_channels == 3 ? new ChannelMap<T>(stretch_params.blue, input_range) : nullptr);
+
+    const size_t size = static_cast<size_t>(image_width) * image_height;
+
+    QtConcurrent::blockingMap(tiles, [&](const QRect & tile)
     {
-        futures.append(QtConcurrent::run([ = ]()
+        // Increment the input index by the sampling, the output index increments by 1.
+        for (int jout = tile.top(); jout <= tile.bottom(); jout++)
         {
-            // R, G, B input images are stored one after another.
-            T * inputLineR  = inputBuffer + j * imageWidth;
-            T * inputLineG  = inputLineR + size;
-            T * inputLineB  = inputLineG + size;
-
-            auto * scanLine = reinterpret_cast<QRgb*>(outputImage->scanLine(jout));
+            T const *inputLine = input_buffer + static_cast<size_t>(jout) * sampling * image_width;
 
-            for (int i = 0, iout = 0; i < imageWidth; i += sampling, iout++)
+            if (num_channels == 1)
             {
-                const T inputR = inputLineR[i];
-                const T inputG = inputLineG[i];
-                const T inputB = inputLineB[i];
-
-                uint8_t red, green, blue;
-
-                if (inputR < nativeShadowsR) red = 0;
-                else if (inputR >= nativeHighlightsR) red = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputR - nativeShadowsR);
-                    red = (inputFloored * k1R) / (inputFloored * k2R - midtonesR);
-                }
-
-                if (inputG < nativeShadowsG) green = 0;
-                else if (inputG >= nativeHighlightsG) green = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputG - nativeShadowsG);
-                    green = (inputFloored * k1G) / (inputFloored * k2G - midtonesG);
-                }
-
-                if (inputB < nativeShadowsB) blue = 0;
-                else if (inputB >= nativeHighlightsB) blue = maxOutput;
-                else
-                {
-                    const T inputFloored = (inputB - nativeShadowsB);
-                    blue = (inputFloored * k1B) / (inputFloored * k2B - midtonesB);
-                }
-                scanLine[iout] = qRgb(red, green, blue);
+                auto * scanLine = output_image->scanLine(jout);
+                for (int iout = tile.left(), i = iout * sampling; iout <= tile.right(); iout++, i += sampling)
+                    scanLine[iout] = red(inputLine[i]);
             }
-        }));
-    }
-    for(QFuture<void> future : futures)
-        future.waitForFinished();
+            else
+            {
+                // R, G, B input images are stored one after another.
+                T const *inputLineG = inputLine + size;
+                T const *inputLineB = inputLineG + size;
+                auto * scanLine = reinterpret_cast<QRgb*>(output_image->scanLine(jout));
+                for (int iout = tile.left(), i = iout * sampling; iout <= tile.right(); iout++, i += sampling)
+                    scanLine[iout] = qRgb(red(inputLine[i]), (*green)(inputLineG[i]), (*blue)(inputLineB[i]));
+            }
+        }
+    });
 }
 
+// Finds the median of the values, and the median of their absolute deviation from it, using
+// histograms. Gives the same results as median() on the values sampled by sampleBy.
 template <typename T>
-void stretchChannels(T *input_buffer, QImage *output_image,
-                     const StretchParams &stretch_params,
-                     int input_range, int image_height, int image_width, int num_channels, int sampling)
+void histogramMedians(T const *values, int size, int sampleBy, T *medianValue, T *medianDeviation)
 {
-    if (num_channels == 1)
-        stretchOneChannel(input_buffer, output_image, stretch_params, input_range,
-                          image_height, image_width, sampling);
-    else if (num_channels == 3)
-        stretchThreeChannels(input_buffer, output_image, stretch_params, input_range,
-                             image_height, image_width, sampling);
+    const int numSamples = size / sampleBy;
+    const int middle = numSamples / 2;
+    if (numSamples <= 0)
+    {
+        *medianValue = 0;
+        *medianDeviation = 0;
+        return;
+    }
+
+    std::vector<uint32_t> histogram(std::numeric_limits<T>::max() + 1, 0);
+    for (int index = 0, i = 0; i < numSamples; ++i, index += sampleBy)
+        histogram[values[index]]++;
+
+    int value = 0;
+    for (int count = 0; (count += histogram[value]) <= middle; ++value) {}
+
+    // Samples with a deviation d from the median are those at median - d and median + d.
+    int deviation = 0;
+    for (int count = 0;; ++deviation)
+    {
+        if (value + deviation < static_cast<int>(histogram.size()))
+            count += histogram[value + deviation];
+        if (deviation > 0 && value - deviation >= 0)
+            count += histogram[value - deviation];
+        if (count > middle)
+            break;
+    }
+
+    *medianValue = value;
+    *medianDeviation = deviation;
 }
 
 // See section 8.5.7 in above link  https://pixinsight.com/doc/docs/XISF-1.0-spec/XISF-1.0-spec.html
@@ -231,20 +216,32 @@ void computeParamsOneChannel(T const *buffer, StretchParams1Channel *params,
     constexpr int maxSamples = 500000;
     const int sampleBy = width * height < maxSamples ? 1 : width * height / maxSamples;
 
-    T medianSample = median(buffer, width * height, sampleBy);
-    // Find the Median deviation: 1.4826 * median of abs(sample[i] - median).
-    const int numSamples = width * height / sampleBy;
-    std::vector<T> deviations(numSamples);
-    for (int index = 0, i = 0; i < numSamples; ++i, index += sampleBy)
+    T medianSample;
+    float medDev;
+    if constexpr (useLookupTable<T>())
+    {
+        // 8 and 16 bit samples are counted in histograms instead of being copied and sorted.
+        T medianDeviation;
+        histogramMedians(buffer, width * height, sampleBy, &medianSample, &medianDeviation);
+        medDev = medianDeviation;
+    }
+    else
     {
-        if (medianSample > buffer[index])
-            deviations[i] = medianSample - buffer[index];
-        else
-            deviations[i] = buffer[index] - medianSample;
+        medianSample = median(buffer, width * height, sampleBy);
+        // Find the Median deviation: 1.4826 * median of abs(sample[i] - median).
+        const int numSamples = width * height / sampleBy;
+        std::vector<T> deviations(numSamples);
+        for (int index = 0, i = 0; i < numSamples; ++i, index += sampleBy)
+        {
+            if (medianSample > buffer[index])
+                deviations[i] = medianSample - buffer[index];
+            else
+                deviations[i] = buffer[index] - medianSample;
+        }
+        medDev = median(deviations);
     }
 
     // Shift everything to 0 -> 1.0.
-    const float medDev = median(deviations);
     const float normalizedMedian = medianSample / static_cast<float>(inputRange);
     const float MADN = 1.4826 * medDev / static_cast<float>(inputRange);
 
@@ -310,6 +307,16 @@ int getRange(int data_type)
 
 }  // namespace
 
+void Stretch::medians(uint8_t const *values, int size, int sampleBy, uint8_t *median, uint8_t *deviation)
+{
+    histogramMedians(values, size, sampleBy, median, deviation);
+}
+
+void Stretch::medians(uint16_t const *values, int size, int sampleBy, uint16_t *median, uint16_t *deviation)
+{
+    histogramMedians(values, size, sampleBy, median, deviation);
+}
+
 Stretch::Stretch(int width, int height, int channels, int data_type)
 {
     image_width = width;
@@ -320,6 +327,11 @@ Stretch::Stretch(int width, int height, int channels, int data_type)
 }
 
 void Stretch::run(uint8_t const *input, QImage *outputImage, int sampling)
+{
+    run(input, outputImage, sampling, tiles(outputImage->size()));
+}
+
+void Stretch::run(uint8_t const *input, QImage *outputImage, int sampling, const QVector<QRect> &tiles)
 {
     Q_ASSERT(outputImage->width() == (image_width + sampling - 1) / sampling);
     Q_ASSERT(outputImage->height() == (image_height + sampling - 1) / sampling);
@@ -329,37 +341,46 @@ void Stretch::run(uint8_t const *input, QImage *outputImage, int sampling)
     {
         case TBYTE:
             stretchChannels(reinterpret_cast<uint8_t const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TSHORT:
             stretchChannels(reinterpret_cast<short const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TUSHORT:
             stretchChannels(reinterpret_cast<unsigned short const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TLONG:
             stretchChannels(reinterpret_cast<long const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TFLOAT:
             stretchChannels(reinterpret_cast<float const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TLONGLONG:
             stretchChannels(reinterpret_cast<long long const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         case TDOUBLE:
             stretchChannels(reinterpret_cast<double const*>(input), outputImage, params,
-                            input_range, image_height, image_width, image_channels, sampling);
+                            input_range, image_height, image_width, image_channels, sampling, tiles);
             break;
         default:
             break;
     }
 }
 
+QVector<QRect> Stretch::tiles(const QSize &size)
+{
+    QVector<QRect> result;
+    for (int y = 0; y < size.height(); y += TILE_SIZE)
+        for (int x = 0; x < size.width(); x += TILE_SIZE)
+            result.append(QRect(x, y, std::min(TILE_SIZE, size.width() - x), std::min(TILE_SIZE, size.height() - y)));
+    return result;
+}
+
 // The input range for float/double is ambiguous, and we can't tell without the buffer,
 // so we set it to 64K and possibly reduce it when we see the data.
 void Stretch::recalculateInputRange(uint8_t const *input)
@@ -7,6 +7,8 @@
 
 #include <memory>
 #include <QImage>
+#include <QRect>
+#include <QVector>
 
 struct StretchParams1Channel
 {
@@ -27,11 +29,30 @@ struct StretchParams1Channel
         shadows_expansion = 0.0;
         highlights_expansion = 1.0;
     }
+
+    bool operator==(const StretchParams1Channel &other) const
+    {
+        return shadows == other.shadows && highlights == other.highlights && midtones == other.midtones &&
+               shadows_expansion == other.shadows_expansion && highlights_expansion == other.highlights_expansion;
+    }
+    bool operator!=(const StretchParams1Channel &other) const
+    {
+        return !(*this == other);
+    }
 };
 
 struct StretchParams
 {
     StretchParams1Channel grey_red, green, blue;
+
+    bool operator==(const StretchParams &other) const
+    {
+        return grey_red == other.grey_red && green == other.green && blue == other.blue;
+    }
+    bool operator!=(const StretchParams &other) const
+    {
+        return !(*this == other);
+    }
 };
 
 class Stretch
@@ -87,6 +108,30 @@ class Stretch
          */
         void run(uint8_t const *input, QImage *output_image, int sampling = 1);
 
+        /**
+         * @brief run Same as above, but only stretches some tiles of the output image.
+         * The tiles are stretched in parallel, and the rest of the output image is left untouched.
+         * @param tiles rectangles of the output image, usually taken from tiles().
+         */
+        void run(uint8_t const *input, QImage *output_image, int sampling, const QVector<QRect> &tiles);
+
+        /**
+         * @brief tiles Cuts an image into tiles of at most TILE_SIZE x TILE_SIZE pixels.
+         * @param size the size of the output image.
+         */
+        static QVector<QRect> tiles(const QSize &size);
+
+        // Small enough for a tile of input and output to stay in cache, large enough to keep the
+        // number of tiles of a 60 MP image in the low thousands.
+        static constexpr int TILE_SIZE = 256;
+
+        /**
+         * @brief medians Finds the median of every sampleBy'th value of an 8 or 16 bit channel, and the
+         * median of their absolute deviation from it, as computeParams() does. Both are 0 without samples.
+         */
+        static void medians(uint8_t const *values, int size, int sampleBy, uint8_t *median, uint8_t *deviation);
+        static void medians(uint16_t const *values, int size, int sampleBy, uint16_t *median, uint16_t *deviation);
+
         static int numPresets()
         {
             return m_NumPresets;
@@ -47,4 +47,15 @@ typedef struct
 
 Q_DECLARE_METATYPE(pixCacheKey_t)
 
+/**
+ * Pack a key into 64 bits for hashing. level and pix are combined into the HEALPix
+ * NUNIQ number (4 * 4^level + pix), which is unique over all levels and needs at most
+ * 40 bits for the orders used here. The uid goes into the remaining upper bits, so it
+ * has to be a small serial number rather than a hash.
+ */
+inline quint64 pixCacheKeyPack(const pixCacheKey_t &key)
+{
+  return (quint64(key.uid) << 40) | ((quint64(4) << (2 * key.level)) + quint64(key.pix));
+}
+
 #endif // HIPS_H
@@ -22,21 +22,12 @@
 #include <QHash>
 #include <QNetworkDiskCache>
 #include <QPainter>
+#include <QThread>
+#include <QtConcurrent>
 
 static QNetworkDiskCache *g_discCache = nullptr;
 static UrlFileDownload *g_download = nullptr;
 
-static int qHash(const pixCacheKey_t &key, uint seed)
-{
-    return qHash(QString("%1_%2_%3").arg(key.level).arg(key.pix).arg(key.uid), seed);
-}
-
-
-inline bool operator==(const pixCacheKey_t &k1, const pixCacheKey_t &k2)
-{
-    return (k1.uid == k2.uid) && (k1.level == k2.level) && (k1.pix == k2.pix);
-}
-
 HIPSManager * HIPSManager::_HIPSManager = nullptr;
 
 HIPSManager *HIPSManager::Instance()
@@ -79,7 +70,8 @@ HIPSManager::HIPSManager() : QObject(KStars::Instance())
     value = Options::hIPSMemoryCache() * 1024 * 1024;
     m_cache.setMaxCost(Options::hIPSMemoryCache() * 1024 * 1024);
 
-
+    // Leave a core for the GUI thread, more threads than this just compete with rendering
+    m_decodePool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 4));
 
 }
 
@@ -170,9 +162,11 @@ QImage *HIPSManager::getPix(bool allsky, int level, int pix, bool &freeImage)
 
     pixCacheItem_t *item = getCacheItem(key);
 
-    if (m_downloadMap.contains(key))
+    if (m_downloadMap.contains(pixCacheKeyPack(key)))
     {
         // downloading
+        if (allsky)
+            return nullptr;
 
         // try render (level - 1) while downloading
         key.level = level - 1;
@@ -239,7 +233,7 @@ QImage *HIPSManager::getPix(bool allsky, int level, int pix, bool &freeImage)
     QUrl downloadURL(m_currentURL);
     downloadURL.setPath(downloadURL.path() + path);
     g_download->begin(downloadURL, key);
-    m_downloadMap.insert(key);
+    m_downloadMap.insert(pixCacheKeyPack(key));
 
     return nullptr;
 }
@@ -348,28 +342,26 @@ void HIPSManager::slotDone(QNetworkReply::NetworkError error, QByteArray &data,
 {
     if (error == QNetworkReply::NoError)
     {
-        m_downloadMap.remove(key);
-
-        auto *item = new pixCacheItem_t;
-
-        item->image = new QImage();
-        if (item->image->loadFromData(data))
+        // Decoding a tile takes a few ms, do it in the pool so panning does not stutter.
+        // The key stays in m_downloadMap until the image is published in addDecodedTile().
+        const pixCacheKey_t tileKey = key;
+        QtConcurrent::run(&m_decodePool, [this, data, tileKey]()
         {
-            addToMemoryCache(key, item);
+            QImage image;
+            if (!image.loadFromData(data))
+                qCWarning(KSTARS) << "no image. Data size: " << data.length();
 
-            //SkyMap::Instance()->forceUpdate();
-        }
-        else
-        {
-            delete item;
-            qCWarning(KSTARS) << "no image. Data size: " << data.length();
-        }
+            QMetaObject::invokeMethod(this, [this, image, tileKey]()
+            {
+                addDecodedTile(image, tileKey);
+            }, Qt::QueuedConnection);
+        });
     }
     else
     {
         if (error == QNetworkReply::OperationCanceledError)
         {
-            m_downloadMap.remove(key);
+            m_downloadMap.remove(pixCacheKeyPack(key));
         }
         else
         {
@@ -380,9 +372,24 @@ void HIPSManager::slotDone(QNetworkReply::NetworkError error, QByteArray &data,
     }
 }
 
+void HIPSManager::addDecodedTile(const QImage &image, const pixCacheKey_t &key)
+{
+    m_downloadMap.remove(pixCacheKeyPack(key));
+
+    if (image.isNull())
+        return;
+
+    auto *item = new pixCacheItem_t;
+    item->image = new QImage(image);
+    addToMemoryCache(key, item);
+
+    //SkyMap::Instance()->forceUpdate();
+    emit sigRepaint();
+}
+
 void HIPSManager::removeTimer(pixCacheKey_t &key)
 {
-    m_downloadMap.remove(key);
+    m_downloadMap.remove(pixCacheKeyPack(key));
     sender()->deleteLater();
     emit sigRepaint();
 }
@@ -397,7 +404,7 @@ void HIPSManager::addToMemoryCache(pixCacheKey_t &key, pixCacheItem_t *item)
     Q_ASSERT(item);
     Q_ASSERT(item->image);
 
-    int cost = item->image->sizeInBytes();
+    int cost = PixCache::itemCost(item);
 
     m_cache.add(key, item, cost);
 }
@@ -431,7 +438,7 @@ bool HIPSManager::setCurrentSource(const QString &title)
         m_currentURL = QUrl(Options::hIPSOfflinePath());
         m_currentURL.setScheme("file");
         m_currentOrder = m_OfflineLevelsMap.lastKey();
-        m_uid = qHash(m_currentURL);
+        m_uid = sourceUID(m_currentURL);
         Options::setShowHIPS(true);
         // N.B. Only DSS Colored catalog is supported for offline source
         Options::setHIPSSource("DSS Colored");
@@ -465,7 +472,7 @@ bool HIPSManager::setCurrentSource(const QString &title)
                 m_currentFrame = HIPS_OTHER_FRAME;
 
             m_currentURL = QUrl(source.value("hips_service_url"));
-            m_uid = qHash(m_currentURL);
+            m_uid = sourceUID(m_currentURL);
 
             Options::setHIPSSource(title);
             Options::setShowHIPS(true);
@@ -477,6 +484,15 @@ bool HIPSManager::setCurrentSource(const QString &title)
     return false;
 }
 
+qint64 HIPSManager::sourceUID(const QUrl &url)
+{
+    auto it = m_sourceUIDs.find(url);
+    if (it == m_sourceUIDs.end())
+        it = m_sourceUIDs.insert(url, m_sourceUIDs.size() + 1);
+
+    return it.value();
+}
+
 // Extract which levels are available for offline use.
 void HIPSManager::setOfflineLevels(const QStringList &value)
 {
@@ -14,6 +14,7 @@
 #include "urlfiledownload.h"
 
 #include <QObject>
+#include <QThreadPool>
 
 #include <memory>
 
@@ -116,10 +117,15 @@ class HIPSManager : public QObject
 
         // Cache
         PixCache m_cache;
-        QSet <pixCacheKey_t> m_downloadMap;
+        // Tiles being downloaded or decoded, by pixCacheKeyPack()
+        QSet <quint64> m_downloadMap;
+        // Downloaded tiles are decoded here, off the GUI thread
+        QThreadPool m_decodePool;
 
         void addToMemoryCache(pixCacheKey_t &key, pixCacheItem_t *item);
         pixCacheItem_t *getCacheItem(pixCacheKey_t &key);
+        void addDecodedTile(const QImage &image, const pixCacheKey_t &key);
+        qint64 sourceUID(const QUrl &url);
 
         // List of all sources in the database
         QList<QMap<QString, QString>> m_hipsSources;
@@ -139,4 +145,6 @@ class HIPSManager : public QObject
         uint16_t m_currentTileWidth { 0 };
         QUrl m_currentURL;
         QMap<int, int> m_OfflineLevelsMap;
+        // Serial numbers given to source URLs, used as uid in cache keys
+        QHash<QUrl, qint64> m_sourceUIDs;
 };
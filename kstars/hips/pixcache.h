@@ -15,13 +15,15 @@ class PixCache
 public:
   PixCache() = default;
 
-  void add(pixCacheKey_t &key, pixCacheItem_t *item, int cost);
-  pixCacheItem_t *get(pixCacheKey_t &key);
+  // Cost is the memory used by the item in bytes, see itemCost()
+  void add(const pixCacheKey_t &key, pixCacheItem_t *item, int cost);
+  pixCacheItem_t *get(const pixCacheKey_t &key);
   void setMaxCost(int maxCost);
   void printCache();
   int  used();
 
+  static int itemCost(const pixCacheItem_t *item);
+
 private:  
-  QCache <pixCacheKey_t, pixCacheItem_t> m_cache;
+  QCache <quint64, pixCacheItem_t> m_cache;
 };
-
@@ -0,0 +1,230 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "imagewritequeue.h"
+
+#include "indi_debug.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+namespace ISD
+{
+
+namespace
+{
+// Frames are written in large sequential chunks straight from the frame buffer
+constexpr qint64 WRITE_CHUNK = 16 * 1024 * 1024;
+
+// Weight of the latest file in the average write rate
+constexpr double THROUGHPUT_SMOOTHING = 0.25;
+}
+
+ImageWriteQueue::ImageWriteQueue()
+{
+    m_Pool.setMaxThreadCount(1);
+    // Keep the writer thread around between frames of a sequence
+    m_Pool.setExpiryTimeout(60000);
+}
+
+ImageWriteQueue::~ImageWriteQueue()
+{
+    waitForDone();
+}
+
+void ImageWriteQueue::enqueue(const QString &filename, const QSharedPointer<FrameBuffer> &frame)
+{
+    {
+        QMutexLocker locker(&m_Mutex);
+
+        QElapsedTimer stall;
+        stall.start();
+        while (m_Statistics.pending >= m_Depth)
+            m_Room.wait(&m_Mutex);
+
+        m_Statistics.lastStallTime = stall.nsecsElapsed() / 1e6;
+        m_Statistics.totalStallTime += m_Statistics.lastStallTime;
+        m_Statistics.pending++;
+        m_Statistics.pendingBytes += frame->size();
+
+        if (m_Statistics.lastStallTime >= 1)
+            qCDebug(KSTARS_INDI) << "Waited" << m_Statistics.lastStallTime << "ms for room to queue" << filename;
+    }
+
+    QtConcurrent::run(&m_Pool, [this, filename, frame]()
+    {
+        write(filename, frame);
+    });
+}
+
+void ImageWriteQueue::waitForDone()
+{
+    m_Pool.waitForDone();
+    // The writer thread is idle now, so the files it left can be synced from here
+    syncFiles();
+}
+
+void ImageWriteQueue::sync()
+{
+    QtConcurrent::run(&m_Pool, [this]()
+    {
+        syncFiles();
+    });
+}
+
+void ImageWriteQueue::setDepth(int depth)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_Depth = std::max(1, depth);
+    m_Room.wakeAll();
+}
+
+int ImageWriteQueue::depth() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_Depth;
+}
+
+void ImageWriteQueue::setSyncBatch(int files)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_SyncBatch = std::max(0, files);
+}
+
+int ImageWriteQueue::syncBatch() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_SyncBatch;
+}
+
+void ImageWriteQueue::setDropCache(bool drop)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_DropCache = drop;
+}
+
+bool ImageWriteQueue::dropCache() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_DropCache;
+}
+
+ImageWriteQueue::Statistics ImageWriteQueue::statistics() const
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_Statistics;
+}
+
+bool ImageWriteQueue::writeFile(QFile &file, const char *buffer, size_t size)
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
+    {
+        qCCritical(KSTARS_INDI) << "ISD:CCD Error: Unable to open write file: " << file.fileName();
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    // Reserve the whole file at once so it is laid out contiguously. Unlike posix_fallocate this
+    // does nothing, rather than writing zeros, on file systems which can't reserve space.
+    fallocate(file.handle(), 0, 0, static_cast<off_t>(size));
+#endif
+
+    bool ok = true;
+    for (size_t offset = 0; offset < size;)
+    {
+        const qint64 n = file.write(buffer + offset, std::min<qint64>(WRITE_CHUNK, size - offset));
+        if (n <= 0)
+        {
+            ok = false;
+            break;
+        }
+        offset += n;
+    }
+
+    file.setPermissions(QFileDevice::ReadUser |
+                        QFileDevice::WriteUser |
+                        QFileDevice::ReadGroup |
+                        QFileDevice::ReadOther);
+    return ok;
+}
+
+void ImageWriteQueue::write(const QString &filename, const QSharedPointer<FrameBuffer> &frame)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    std::unique_ptr<QFile> file(new QFile(filename));
+    const bool ok = writeFile(*file, frame->data(), frame->size());
+    const double elapsed = timer.nsecsElapsed() / 1e6;
+
+    int syncBatch = 0;
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Statistics.pending--;
+        m_Statistics.pendingBytes -= frame->size();
+        if (ok)
+        {
+            const double rate = frame->size() / (1024.0 * 1024.0) / std::max(elapsed / 1000.0, 1e-6);
+            m_Statistics.written++;
+            m_Statistics.lastWriteTime = elapsed;
+            m_Statistics.throughput = m_Statistics.written == 1 ? rate :
+                                      THROUGHPUT_SMOOTHING * rate + (1 - THROUGHPUT_SMOOTHING) * m_Statistics.throughput;
+        }
+        else
+            m_Statistics.failed++;
+        syncBatch = m_SyncBatch;
+        m_Room.wakeAll();
+    }
+
+    if (!ok)
+    {
+        file->close();
+        if (m_FailureHandler)
+            m_FailureHandler(filename);
+    }
+    else if (syncBatch > 0)
+        m_UnsyncedFiles.push_back(std::move(file));
+    else
+        file->close();
+
+    if (!m_UnsyncedFiles.empty() && static_cast<int>(m_UnsyncedFiles.size()) >= syncBatch)
+        syncFiles();
+}
+
+void ImageWriteQueue::syncFiles()
+{
+#ifdef Q_OS_LINUX
+    const bool dropCache = this->dropCache();
+#endif
+    for (auto &file : m_UnsyncedFiles)
+    {
+#if defined(Q_OS_UNIX)
+        if (::fsync(file->handle()) != 0)
+            qCWarning(KSTARS_INDI) << "Failed to sync" << file->fileName();
+#ifdef Q_OS_LINUX
+        // The file is on storage now, don't let it push more useful data out of the page cache
+        if (dropCache)
+            posix_fadvise(file->handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+#elif defined(Q_OS_WIN)
+        if (::_commit(file->handle()) != 0)
+            qCWarning(KSTARS_INDI) << "Failed to sync" << file->fileName();
+#endif
+        file->close();
+    }
+    m_UnsyncedFiles.clear();
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "fitsviewer/framebufferpool.h"
+
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QFile;
+
+namespace ISD
+{
+
+/**
+ * @class ImageWriteQueue
+ * @short Writes captured frames to disk behind the capture.
+ *
+ * Frames are written in the order they are queued by a single thread, straight from their
+ * FrameBuffer. At most depth() frames may be waiting; queuing another one blocks until the oldest
+ * is written, which bounds the memory held by frames when storage is slower than the camera.
+ *
+ * Written files can be synced to storage in batches: they are kept open and synced together once
+ * syncBatch() files are waiting, when sync() is called at the end of a sequence, or when the queue
+ * is destroyed, rather than syncing after every file.
+ */
+class ImageWriteQueue
+{
+    public:
+        struct Statistics
+        {
+            /// Frames queued or being written
+            int pending { 0 };
+            /// Bytes of the frames queued or being written
+            qint64 pendingBytes { 0 };
+            /// Files written, and files which could not be written
+            int written { 0 };
+            int failed { 0 };
+            /// Time taken by the last file, in milliseconds
+            double lastWriteTime { 0 };
+            /// Write rate, averaged over the last few files, in MiB/s
+            double throughput { 0 };
+            /// How long queuing the last frame waited for room, and the total over all frames, in milliseconds
+            double lastStallTime { 0 };
+            double totalStallTime { 0 };
+        };
+
+        ImageWriteQueue();
+        /** Waits until all queued frames are written */
+        ~ImageWriteQueue();
+
+        /**
+         * @brief Queue a frame to be written
+         * @param filename of the file to create
+         * @param frame holding the file contents. A reference is held until it is written.
+         */
+        void enqueue(const QString &filename, const QSharedPointer<FrameBuffer> &frame);
+
+        /** @brief Block until all queued frames are written and synced */
+        void waitForDone();
+
+        /** @brief Sync the written files once the frames queued so far are written, without waiting for it */
+        void sync();
+
+        /** @brief Set how many frames may wait to be written, at least 1 */
+        void setDepth(int depth);
+        int depth() const;
+
+        /** @brief Set after how many files written files are synced to storage, 0 to leave it to the system */
+        void setSyncBatch(int files);
+        int syncBatch() const;
+
+        /** @brief Set whether synced files are dropped from the page cache, so they don't push out more useful data */
+        void setDropCache(bool drop);
+        bool dropCache() const;
+
+        /** @brief Set a function called from the writer thread with the name of each file that failed */
+        void setFailureHandler(const std::function<void(const QString &)> &handler)
+        {
+            m_FailureHandler = handler;
+        }
+
+        /** @return a snapshot of the queue statistics */
+        Statistics statistics() const;
+
+        /**
+         * @brief Write a buffer to a file
+         * @param file which is opened for writing and left open
+         * @return true if all the data was written
+         */
+        static bool writeFile(QFile &file, const char *buffer, size_t size);
+
+    private:
+        void write(const QString &filename, const QSharedPointer<FrameBuffer> &frame);
+        void syncFiles();
+
+        QThreadPool m_Pool;
+        mutable QMutex m_Mutex;
+        QWaitCondition m_Room;
+        Statistics m_Statistics;
+        int m_Depth { 3 };
+        int m_SyncBatch { 0 };
+        bool m_DropCache { false };
+        std::function<void(const QString &)> m_FailureHandler;
+
+        // Written files waiting for the next batch sync, only used from the writer thread
+        std::vector<std::unique_ptr<QFile>> m_UnsyncedFiles;
+};
+
+}
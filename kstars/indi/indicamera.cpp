@@ -49,16 +49,24 @@ Camera::Camera(GenericDevice *parent) : ConcreteDevice(parent)
 
     connect(m_Parent->getClientManager(), &ClientManager::newBLOBManager, this, &Camera::setBLOBManager, Qt::UniqueConnection);
     m_LastNotificationTS = QDateTime::currentDateTime();
+
+    m_WriteQueue.setFailureHandler([this](const QString & filename)
+    {
+        QMetaObject::invokeMethod(this, [this, filename]()
+        {
+            qCCritical(KSTARS_INDI) << "Failed writing image to" << filename;
+            emit error(ERROR_SAVE);
+        }, Qt::QueuedConnection);
+    });
 }
 
 Camera::~Camera()
 {
     if (m_ImageViewerWindow)
         m_ImageViewerWindow->close();
-    if (fileWriteThread.isRunning())
-        fileWriteThread.waitForFinished();
-    if (fileWriteBuffer != nullptr)
-        delete [] fileWriteBuffer;
+    m_WriteQueue.waitForDone();
+    m_FrameBuffer.reset();
+    FrameBufferPool::Instance()->clear();
 }
 
 void Camera::setBLOBManager(const char *device, INDI::Property prop)
@@ -509,6 +517,11 @@ void Camera::processSwitch(INDI::Property prop)
             m_OffsetPermission = IP_RO;
 
             primaryCCDBLOB = INDI::Property();
+
+            // Give back the memory of the pooled frames once the pending images are written
+            m_FrameBuffer.reset();
+            m_WriteQueue.waitForDone();
+            FrameBufferPool::Instance()->clear();
         }
     }
 }
@@ -574,61 +587,25 @@ void Camera::processStream(INDI::Property prop)
     emit showVideoFrame(prop, streamW, streamH);
 }
 
-void ISD::Camera::updateFileBuffer(INDI::Property prop, bool is_fits)
+void ISD::Camera::updateFileBuffer(INDI::Property prop)
 {
-    if (is_fits)
-    {
-        // Check if the last write is still ongoing, and if so wait.
-        // It is using the fileWriteBuffer.
-        if (fileWriteThread.isRunning())
-        {
-            fileWriteThread.waitForFinished();
-        }
-    }
-
-    // Will write blob data in a separate thread, and can't depend on the blob
-    // memory, so copy it first.
-
+    // The blob memory belongs to the INDI client and is reused for the next frame, so copy it once
+    // into a pooled buffer. FITSData decodes from it and the file is written from it.
     auto bp = prop.getBLOB()->at(0);
-    // Check buffer size.
-    if (fileWriteBufferSize != bp->getBlobLen())
-    {
-        if (fileWriteBuffer != nullptr)
-            delete [] fileWriteBuffer;
-        fileWriteBufferSize = bp->getBlobLen();
-        fileWriteBuffer = new char[fileWriteBufferSize];
-    }
-
-    // Copy memory, and write file on a separate thread.
-    // Probably too late to return an error if the file couldn't write.
-    memcpy(fileWriteBuffer, bp->getBlob(), bp->getBlobLen());
+    m_FrameBuffer = FrameBufferPool::Instance()->acquire(static_cast<const char *>(bp->getBlob()), bp->getBlobLen());
 }
 
 bool Camera::saveCurrentImage(QString &filename)
 {
-    // TODO: Not yet threading the writes for non-fits files.
-    // Would need to deal with the raw conversion, etc.
-    if (BType == BLOB_FITS)
-    {
-        // Check if the last write is still ongoing, and if so wait.
-        // It is using the fileWriteBuffer.
-        if (fileWriteThread.isRunning())
-        {
-            fileWriteThread.waitForFinished();
-        }
-
-        // Wait until the file is written before overwriting the filename.
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        fileWriteThread = QtConcurrent::run(&ISD::Camera::WriteImageFileInternal, this, filename, fileWriteBuffer,
-                                            fileWriteBufferSize);
-#else
-        fileWriteThread = QtConcurrent::run(this, &ISD::Camera::WriteImageFileInternal, filename, fileWriteBuffer,
-                                            fileWriteBufferSize);
-#endif
-    }
-    else if (!WriteImageFileInternal(filename, static_cast<char *>(fileWriteBuffer), fileWriteBufferSize))
+    if (m_FrameBuffer.isNull())
         return false;
 
+    // The blob is written as received whatever its format, so all of them can be written in the
+    // background. The queue holds its own reference to the frame until it is written.
+    m_WriteQueue.setDepth(Options::captureWriteQueueDepth());
+    m_WriteQueue.setSyncBatch(Options::captureWriteSyncBatch());
+    m_WriteQueue.setDropCache(Options::captureWriteDropCache());
+    m_WriteQueue.enqueue(filename, m_FrameBuffer);
     return true;
 }
 
@@ -684,7 +661,12 @@ bool Camera::processBLOB(INDI::Property prop)
     // 1. file is preview or batch mode is not enabled
     // 2. file type is not FITS_NORMAL (focus, guide..etc)
     // create the file buffer only, saving the image file must be triggered from outside.
-    updateFileBuffer(prop, BType == BLOB_FITS);
+    updateFileBuffer(prop);
+    if (m_FrameBuffer.isNull())
+    {
+        emit error(ERROR_LOAD);
+        return true;
+    }
 
     // Don't spam, just one notification per 3 seconds
     if (QDateTime::currentDateTime().secsTo(m_LastNotificationTS) <= -3)
@@ -693,7 +675,6 @@ bool Camera::processBLOB(INDI::Property prop)
         m_LastNotificationTS = QDateTime::currentDateTime();
     }
 
-    QByteArray buffer = QByteArray::fromRawData(reinterpret_cast<char *>(bvp[0].getBlob()), size);
     QSharedPointer<FITSData> imageData;
     imageData.reset(new FITSData(targetChip->getCaptureMode()), &QObject::deleteLater);
     imageData->setExtension(shortFormat);
@@ -703,7 +684,7 @@ bool Camera::processBLOB(INDI::Property prop)
     // so that we do not incur delays in loading from buffer that may delay the sequence unnecessairly.
     if ((Options::useFITSViewer() || Options::useSummaryPreview() || targetChip->getCaptureMode() != FITS_NORMAL
             || !targetChip->isBatchMode()) &&
-            !imageData->loadFromBuffer(buffer))
+            !imageData->loadFromBuffer(m_FrameBuffer))
     {
         emit error(ERROR_LOAD);
         return true;
@@ -1593,37 +1574,6 @@ bool Camera::setScopeInfo(double focalLength, double aperture)
     return true;
 }
 
-// Internal function to write an image blob to disk.
-bool Camera::WriteImageFileInternal(const QString &filename, char *buffer, const size_t size)
-{
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly))
-    {
-        qCCritical(KSTARS_INDI) << "ISD:CCD Error: Unable to open write file: " <<
-                                filename;
-        return false;
-    }
-    int n = 0;
-    QDataStream out(&file);
-    bool ok = true;
-    for (size_t nr = 0; nr < size; nr += n)
-    {
-        n = out.writeRawData(buffer + nr, size - nr);
-        if (n < 0)
-        {
-            ok = false;
-            break;
-        }
-    }
-    ok = file.flush() && ok;
-    file.close();
-    file.setPermissions(QFileDevice::ReadUser |
-                        QFileDevice::WriteUser |
-                        QFileDevice::ReadGroup |
-                        QFileDevice::ReadOther);
-    return ok;
-}
-
 QString Camera::getCaptureFormat() const
 {
     if (m_CaptureFormatIndex < 0 || m_CaptureFormats.isEmpty() || m_CaptureFormatIndex >= m_CaptureFormats.size())
@@ -9,6 +9,7 @@
 #include "fitsviewer/fitsdata.h"
 #include "indiconcretedevice.h"
 #include "indicamerachip.h"
+#include "imagewritequeue.h"
 
 #include "wsmedia.h"
 #include "auxiliary/imageviewer.h"
@@ -231,6 +232,23 @@ class Camera : public ConcreteDevice
          */
         bool saveCurrentImage(QString &filename);
 
+        /**
+         * @brief imageWriteStatistics Get the state of the queue of image files being written.
+         * @return pending frames, write rate and how long saving images waited for the queue.
+         */
+        ImageWriteQueue::Statistics imageWriteStatistics() const
+        {
+            return m_WriteQueue.statistics();
+        }
+
+        /**
+         * @brief syncImageFiles Sync the image files written so far to storage, in the background.
+         */
+        void syncImageFiles()
+        {
+            m_WriteQueue.sync();
+        }
+
 
     public slots:
         void StreamWindowHidden();
@@ -263,7 +281,6 @@ class Camera : public ConcreteDevice
 
     private:
         void processStream(INDI::Property prop);
-        bool WriteImageFileInternal(const QString &filename, char *buffer, const size_t size);
 
         bool HasGuideHead { false };
         bool HasCooler { false };
@@ -331,11 +348,11 @@ class Camera : public ConcreteDevice
         QMap<QString, double> m_ExposurePresets;
         QPair<double, double> m_ExposurePresetsMinMax;
 
-        // Used when writing the image fits file to disk in a separate thread.
-        void updateFileBuffer(INDI::Property prop, bool is_fits);
-        char *fileWriteBuffer { nullptr };
-        int fileWriteBufferSize { 0 };
-        QString fileWriteFilename;
-        QFuture<void> fileWriteThread;
+        // The last frame received, shared by its FITSData and the writes of the image file to disk.
+        void updateFileBuffer(INDI::Property prop);
+        QSharedPointer<FrameBuffer> m_FrameBuffer;
+
+        // Image files are written behind the capture, in the order they are saved.
+        ImageWriteQueue m_WriteQueue;
 };
 }
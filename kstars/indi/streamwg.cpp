@@ -125,6 +125,10 @@ StreamWG::StreamWG(ISD::Camera *ccd) : QDialog(KStars::Instance())
 
     connect(videoFrame, &VideoWG::newSelection, this, &StreamWG::setStreamingFrame);
     connect(videoFrame, &VideoWG::imageChanged, this, &StreamWG::imageChanged);
+    connect(videoFrame, &VideoWG::newFrameRates, this, [this](double received, double displayed)
+    {
+        displayFPS->setText(QString("%1 / %2").arg(received, 0, 'f', 1).arg(displayed, 0, 'f', 1));
+    });
 
     resize(Options::streamWindowWidth(), Options::streamWindowHeight());
 
@@ -306,6 +310,7 @@ void StreamWG::enableStream(bool enable)
         processStream = false;
         //instFPS->setText("--");
         avgFPS->setText("--");
+        displayFPS->setText("--");
         hide();
     }
 }
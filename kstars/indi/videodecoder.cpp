@@ -0,0 +1,243 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "videodecoder.h"
+
+#include "kstars_debug.h"
+
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+#include <cstring>
+
+VideoDecoder::VideoDecoder(QObject *parent) : QObject(parent)
+{
+    // One worker, so frames are decoded in order and the ring has a single consumer
+    m_Pool.setMaxThreadCount(1);
+    m_Pool.setExpiryTimeout(60000);
+
+    m_GrayTable.resize(256);
+    for (int i = 0; i < 256; i++)
+        m_GrayTable[i] = qRgb(i, i, i);
+}
+
+VideoDecoder::~VideoDecoder()
+{
+    m_Pool.waitForDone();
+}
+
+bool VideoDecoder::push(const IBLOB *bp, uint16_t width, uint16_t height, bool debayer, const BayerParams &params)
+{
+    if (bp->size <= 0)
+        return false;
+
+    const uint32_t head = m_Head.load(std::memory_order_relaxed);
+    if (head - m_Tail.load(std::memory_order_acquire) >= RING_SIZE)
+    {
+        m_Dropped++;
+        return false;
+    }
+
+    // The slot keeps its buffer from frame to frame, so this is a plain copy once streaming started
+    Slot &slot = m_Ring[head % RING_SIZE];
+    slot.data.resize(bp->size);
+    memcpy(slot.data.data(), bp->blob, bp->size);
+    slot.format = QByteArray(bp->format);
+    slot.width = width;
+    slot.height = height;
+    slot.debayer = debayer;
+    slot.params = params;
+    m_Head.store(head + 1, std::memory_order_release);
+
+    if (!m_Scheduled.exchange(true))
+    {
+        QtConcurrent::run(&m_Pool, [this]()
+        {
+            process();
+        });
+    }
+
+    return true;
+}
+
+void VideoDecoder::setDisplay(const QSize &size, bool crop, double scale, double offsetX, double offsetY)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_Display.size = size;
+    m_Display.crop = crop;
+    m_Display.scale = scale;
+    m_Display.offsetX = offsetX;
+    m_Display.offsetY = offsetY;
+}
+
+bool VideoDecoder::takeFrame(QSharedPointer<QImage> &image, QImage &display)
+{
+    QMutexLocker locker(&m_Mutex);
+    if (!m_Ready)
+        return false;
+
+    image = m_Image;
+    display = m_DisplayImage;
+    m_DisplayImage = QImage();
+    m_Ready = false;
+    return true;
+}
+
+void VideoDecoder::process()
+{
+    // Cleared first, so a frame pushed while the last one is decoded is never left behind
+    m_Scheduled = false;
+
+    while (true)
+    {
+        uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+        const uint32_t head = m_Head.load(std::memory_order_acquire);
+        if (tail == head)
+            return;
+
+        // Only the newest frame will be shown, skip the older ones
+        if (head - tail > 1)
+        {
+            m_Dropped += head - tail - 1;
+            tail = head - 1;
+        }
+
+        QSharedPointer<QImage> image = decode(m_Ring[tail % RING_SIZE]);
+        m_Tail.store(tail + 1, std::memory_order_release);
+
+        if (image.isNull() || image->isNull())
+        {
+            qCWarning(KSTARS) << "Failed to load video frame.";
+            continue;
+        }
+
+        Display display;
+        {
+            QMutexLocker locker(&m_Mutex);
+            display = m_Display;
+        }
+
+        const QImage displayImage = scaled(*image, display);
+
+        bool replaced = false;
+        {
+            QMutexLocker locker(&m_Mutex);
+            replaced = m_Ready;
+            m_Image = image;
+            m_DisplayImage = displayImage;
+            m_Ready = true;
+        }
+
+        // The display did not take the previous frame, it already has a signal pending for this one
+        if (replaced)
+            m_Dropped++;
+        else
+            emit frameReady();
+    }
+}
+
+QSharedPointer<QImage> VideoDecoder::decode(const Slot &slot)
+{
+    if (slot.debayer)
+        return debayer(slot);
+
+    if (slot.format != m_RawFormat)
+    {
+        m_RawFormat = slot.format;
+        QByteArray format = slot.format;
+        format.replace(".", "");
+        format.replace("stream_", "");
+        m_RawFormatSupported = QImageReader::supportedImageFormats().contains(format);
+    }
+
+    QSharedPointer<QImage> image(new QImage());
+    const uint32_t count = slot.width * slot.height;
+    const uint32_t size = static_cast<uint32_t>(slot.data.size());
+
+    if (m_RawFormatSupported)
+    {
+        image->loadFromData(reinterpret_cast<const uchar *>(slot.data.constData()), slot.data.size());
+        return image;
+    }
+
+    QImage::Format format;
+    int bytesPerPixel;
+    if (count > 0 && size == count)
+    {
+        format = QImage::Format_Indexed8;
+        bytesPerPixel = 1;
+    }
+    else if (count > 0 && size == count * 3)
+    {
+        format = QImage::Format_RGB888;
+        bytesPerPixel = 3;
+    }
+    else
+        return image;
+
+    // The slot is reused for later frames, so the image gets its own copy of the pixels
+    *image = QImage(slot.width, slot.height, format);
+    if (format == QImage::Format_Indexed8)
+        image->setColorTable(m_GrayTable);
+
+    const int lineSize = slot.width * bytesPerPixel;
+    for (int y = 0; y < slot.height; y++)
+        memcpy(image->scanLine(y), slot.data.constData() + y * lineSize, lineSize);
+
+    return image;
+}
+
+QSharedPointer<QImage> VideoDecoder::debayer(const Slot &slot)
+{
+    const uint32_t width = slot.width;
+    uint32_t height = slot.height;
+    if (static_cast<uint32_t>(slot.data.size()) < width * height)
+        return QSharedPointer<QImage>();
+
+    const size_t rgbSize = width * height * 3;
+    if (m_BayerBuffer.size() < rgbSize)
+        m_BayerBuffer.resize(rgbSize);
+
+    const uint8_t *source = reinterpret_cast<const uint8_t *>(slot.data.constData());
+    if (slot.params.offsetY == 1)
+    {
+        source += width;
+        height--;
+    }
+    if (slot.params.offsetX == 1)
+        source++;
+
+    dc1394error_t error_code = dc1394_bayer_decoding_8bit(source, m_BayerBuffer.data(), width, height,
+                               slot.params.filter, slot.params.method);
+
+    if (error_code != DC1394_SUCCESS)
+    {
+        qCCritical(KSTARS) << "Debayer failed" << error_code;
+        return QSharedPointer<QImage>();
+    }
+
+    QSharedPointer<QImage> image(new QImage(slot.width, slot.height, QImage::Format_RGB888));
+    const int lineSize = slot.width * 3;
+    for (int y = 0; y < slot.height; y++)
+        memcpy(image->scanLine(y), m_BayerBuffer.data() + y * lineSize, lineSize);
+
+    return image;
+}
+
+QImage VideoDecoder::scaled(const QImage &image, const Display &display)
+{
+    if (display.size.isEmpty())
+        return QImage();
+
+    if (display.crop)
+    {
+        int offX = display.offsetX + (image.width() - image.width() * display.scale) * 0.5;
+        int offY = display.offsetY + (image.height() - image.height() * display.scale) * 0.5;
+        return image.copy(offX, offY, image.width() * display.scale, image.height() * display.scale)
+               .scaled(display.size, Qt::KeepAspectRatio);
+    }
+
+    return image.scaled(display.size, Qt::KeepAspectRatio);
+}
@@ -0,0 +1,134 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "fitsviewer/bayer.h"
+
+#include <indidevapi.h>
+
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+ * @class VideoDecoder
+ * @short Decodes video stream frames off the GUI thread.
+ *
+ * Frames are copied out of the INDI blob into a small lock-free ring as they arrive, and a single
+ * worker thread decodes, debayers and scales them to the size they are displayed at. The worker
+ * always moves on to the newest frame in the ring, and a decoded frame not yet taken for display
+ * is replaced by the next one, so a stream faster than the display never queues up behind it.
+ */
+class VideoDecoder : public QObject
+{
+        Q_OBJECT
+
+    public:
+        explicit VideoDecoder(QObject *parent = nullptr);
+        virtual ~VideoDecoder() override;
+
+        /**
+         * @brief push Copy a new frame into the ring and wake the worker up. GUI thread only.
+         * @param bp blob of the frame, it may be reused by the client as soon as this returns.
+         * @param width width of raw frames.
+         * @param height height of raw frames.
+         * @param debayer true if the frame is a raw 8-bit bayer frame.
+         * @param params debayer parameters, ignored if debayer is false.
+         * @return false if the ring is full and the frame is dropped.
+         */
+        bool push(const IBLOB *bp, uint16_t width, uint16_t height, bool debayer, const BayerParams &params);
+
+        /**
+         * @brief setDisplay Set how the next frames are displayed.
+         * @param size size of the widget, frames are scaled to fit in it.
+         * @param crop true to display only the zoomed part of the frames.
+         * @param scale zoom factor of the cropped part, 1 for the whole frame.
+         * @param offsetX horizontal offset of the cropped part from the center, in frame pixels.
+         * @param offsetY vertical offset of the cropped part from the center, in frame pixels.
+         */
+        void setDisplay(const QSize &size, bool crop, double scale, double offsetX, double offsetY);
+
+        /**
+         * @brief takeFrame Take the latest decoded frame.
+         * @param image full resolution frame.
+         * @param display frame scaled for display.
+         * @return false if no frame was decoded since the last call.
+         */
+        bool takeFrame(QSharedPointer<QImage> &image, QImage &display);
+
+        /** @return number of frames dropped, either before or after decoding, since the last reset */
+        uint32_t dropped() const
+        {
+            return m_Dropped;
+        }
+        void resetDropped()
+        {
+            m_Dropped = 0;
+        }
+
+    signals:
+        /** Emitted from the worker thread when takeFrame() has a frame ready */
+        void frameReady();
+
+    private:
+        struct Slot
+        {
+            QByteArray data;
+            QByteArray format;
+            uint16_t width { 0 };
+            uint16_t height { 0 };
+            bool debayer { false };
+            BayerParams params;
+        };
+
+        struct Display
+        {
+            QSize size;
+            bool crop { false };
+            double scale { 1 };
+            double offsetX { 0 };
+            double offsetY { 0 };
+        };
+
+        // Decodes the frames in the ring until it is empty. Worker thread only.
+        void process();
+        QSharedPointer<QImage> decode(const Slot &slot);
+        QSharedPointer<QImage> debayer(const Slot &slot);
+        static QImage scaled(const QImage &image, const Display &display);
+
+        // Frames in flight, more than a few only add latency
+        static constexpr uint32_t RING_SIZE = 4;
+
+        // Single producer, single consumer ring. The GUI thread fills the slot at m_Head and then
+        // moves it, the worker decodes the slot before m_Head and only then moves m_Tail past it.
+        std::array<Slot, RING_SIZE> m_Ring;
+        std::atomic<uint32_t> m_Head { 0 };
+        std::atomic<uint32_t> m_Tail { 0 };
+        // Set while a call to process() is queued or running, so that frames don't queue more calls
+        std::atomic<bool> m_Scheduled { false };
+        std::atomic<uint32_t> m_Dropped { 0 };
+
+        QThreadPool m_Pool;
+
+        // Worker thread only
+        QByteArray m_RawFormat;
+        bool m_RawFormatSupported { false };
+        std::vector<uint8_t> m_BayerBuffer;
+        QVector<QRgb> m_GrayTable;
+
+        QMutex m_Mutex;
+        Display m_Display;
+        QSharedPointer<QImage> m_Image;
+        QImage m_DisplayImage;
+        bool m_Ready { false };
+};
@@ -11,10 +11,11 @@
 #include "kstarsdata.h"
 #include "kstars.h"
 
-#include <QImageReader>
+#include <QGuiApplication>
 #include <QMouseEvent>
 #include <QResizeEvent>
 #include <QRubberBand>
+#include <QScreen>
 #include <QSqlTableModel>
 #include <QSqlRecord>
 #include <QtMath>
@@ -23,68 +24,91 @@ VideoWG::VideoWG(QWidget *parent) : QLabel(parent)
 {
     streamImage.reset(new QImage());
 
-    grayTable.resize(256);
+    connect(&m_Decoder, &VideoDecoder::frameReady, this, &VideoWG::displayFrame);
 
-    for (int i = 0; i < 256; i++)
-        grayTable[i] = qRgb(i, i, i);
+    m_DisplayTimer.setSingleShot(true);
+    connect(&m_DisplayTimer, &QTimer::timeout, this, &VideoWG::displayFrame);
 }
 
 bool VideoWG::newBayerFrame(IBLOB *bp, const BayerParams &params)
 {
-    return debayer(bp, params);
+    return pushFrame(bp, true, params);
 }
 
 bool VideoWG::newFrame(IBLOB *bp)
+{
+    return pushFrame(bp, false, BayerParams());
+}
+
+bool VideoWG::pushFrame(IBLOB *bp, bool debayer, const BayerParams &params)
 {
     if (bp->size <= 0)
         return false;
 
-    bool rc = false;
-    QString format(bp->format);
-    if (m_RawFormat != format)
-    {
-        format.remove('.');
-        format.remove("stream_");
-        m_RawFormatSupported = QImageReader::supportedImageFormats().contains(format.toLatin1());
-        m_RawFormat = format;
-    }
+    m_Received++;
+    updateFrameRates();
 
-    if (m_RawFormatSupported)
-        rc = streamImage->loadFromData(static_cast<uchar *>(bp->blob), bp->size);
-    else if (static_cast<uint32_t>(bp->size) == totalBaseCount)
-    {
-        streamImage.reset(new QImage(static_cast<uchar *>(bp->blob), streamW, streamH, QImage::Format_Indexed8));
-        streamImage->setColorTable(grayTable);
-        rc = !streamImage->isNull();
-    }
-    else if (static_cast<uint32_t>(bp->size) == totalBaseCount * 3)
+    m_Decoder.setDisplay(size(), overlayEnabled, drawScale, drawOffsetX, drawOffsetY);
+    // A full ring only means the display is behind, the frame is dropped but that is no error
+    m_Decoder.push(bp, streamW, streamH, debayer, params);
+    return true;
+}
+
+void VideoWG::displayFrame()
+{
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    const double refreshRate = (screen && screen->refreshRate() > 0) ? screen->refreshRate() : 60;
+    const qint64 interval = qRound(1000 / refreshRate);
+
+    // Frames decoded faster than the screen refreshes would never be seen, show the latest on the next refresh
+    if (m_LastDisplay.isValid() && m_LastDisplay.elapsed() < interval)
     {
-        streamImage.reset(new QImage(static_cast<uchar *>(bp->blob), streamW, streamH, QImage::Format_RGB888));
-        rc = !streamImage->isNull();
+        if (!m_DisplayTimer.isActive())
+            m_DisplayTimer.start(interval - m_LastDisplay.elapsed());
+        return;
     }
 
-    if (rc)
+    QSharedPointer<QImage> image;
+    QImage displayImage;
+    if (!m_Decoder.takeFrame(image, displayImage))
+        return;
+
+    m_LastDisplay.start();
+    streamImage = image;
+
+    if (!displayImage.isNull())
     {
-        if(overlayEnabled)
-        {
-            int offX = drawOffsetX + (streamImage->width() - streamImage->width() * drawScale) * 0.5;
-            int offY = drawOffsetY + (streamImage->height() - streamImage->height() * drawScale) * 0.5;
-            QImage tmp = streamImage->copy(offX, offY, streamImage->width() * drawScale, streamImage->height() * drawScale);
-            kPix = QPixmap::fromImage(tmp.scaled(size(), Qt::KeepAspectRatio));
-        }
-        else
-        {
-            kPix = QPixmap::fromImage(streamImage->scaled(size(), Qt::KeepAspectRatio));
-        }
+        kPix = QPixmap::fromImage(displayImage);
 
         paintOverlay(kPix);
 
         setPixmap(kPix);
+        m_Displayed++;
     }
 
     emit imageChanged(streamImage);
 
-    return rc;
+    updateFrameRates();
+}
+
+void VideoWG::updateFrameRates()
+{
+    if (!m_RatesTimer.isValid())
+    {
+        m_RatesTimer.start();
+        return;
+    }
+
+    const qint64 elapsed = m_RatesTimer.elapsed();
+    if (elapsed < 1000)
+        return;
+
+    emit newFrameRates(m_Received * 1000.0 / elapsed, m_Displayed * 1000.0 / elapsed);
+    if (m_Decoder.dropped() > 0)
+        qCDebug(KSTARS) << "Video stream dropped" << m_Decoder.dropped() << "of" << m_Received << "frames to keep up with the display.";
+    m_Received = m_Displayed = 0;
+    m_Decoder.resetDropped();
+    m_RatesTimer.restart();
 }
 
 bool VideoWG::save(const QString &filename, const char *format)
@@ -94,9 +118,8 @@ bool VideoWG::save(const QString &filename, const char *format)
 
 void VideoWG::setSize(uint16_t w, uint16_t h)
 {
-    streamW        = w;
-    streamH        = h;
-    totalBaseCount = w * h;
+    streamW = w;
+    streamH = h;
 }
 
 //void VideoWG::resizeEvent(QResizeEvent *ev)
@@ -179,57 +202,6 @@ void VideoWG::wheelEvent(QWheelEvent *event)
     }
 }
 
-bool VideoWG::debayer(const IBLOB *bp, const BayerParams &params)
-{
-    uint32_t rgb_size = streamW * streamH * 3;
-    auto * destinationBuffer = new uint8_t[rgb_size];
-
-    if (destinationBuffer == nullptr)
-    {
-        qCCritical(KSTARS) << "Unable to allocate memory for temporary bayer buffer.";
-        return false;
-    }
-
-    int ds1394_height = streamH;
-
-    uint8_t * dc1394_source = reinterpret_cast<uint8_t*>(bp->blob);
-    if (params.offsetY == 1)
-    {
-        dc1394_source += streamW;
-        ds1394_height--;
-    }
-    if (params.offsetX == 1)
-    {
-        dc1394_source++;
-    }
-    dc1394error_t error_code = dc1394_bayer_decoding_8bit(dc1394_source, destinationBuffer, streamW, ds1394_height,
-                               params.filter, params.method);
-
-    if (error_code != DC1394_SUCCESS)
-    {
-        qCCritical(KSTARS) << "Debayer failed" << error_code;
-        delete[] destinationBuffer;
-        return false;
-    }
-
-    streamImage.reset(new QImage(destinationBuffer, streamW, streamH, QImage::Format_RGB888));
-    bool rc = !streamImage->isNull();
-
-    if (rc)
-    {
-        kPix = QPixmap::fromImage(streamImage->scaled(size(), Qt::KeepAspectRatio));
-
-        paintOverlay(kPix);
-
-        setPixmap(kPix);
-    }
-
-    emit imageChanged(streamImage);
-
-    delete[] destinationBuffer;
-    return rc;
-}
-
 void VideoWG::paintOverlay(QPixmap &imagePix)
 {
     if (!overlayEnabled || m_EnabledOverlayElements.count() == 0) return;
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "fitsviewer/bayer.h"
+#include "videodecoder.h"
 
 #include <indidevapi.h>
 
@@ -17,6 +18,8 @@
 #include <QSqlDatabase>
 #include <QPen>
 #include <QPainter>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include <memory>
 #include <mutex>
@@ -56,20 +59,28 @@ class VideoWG : public QLabel
     signals:
         void newSelection(QRect);
         void imageChanged(const QSharedPointer<QImage> &frame);
+        /** Frames received from the camera and frames displayed per second, measured every second */
+        void newFrameRates(double received, double displayed);
 
     private:
-        bool debayer(const IBLOB *bp, const BayerParams &params);
+        bool pushFrame(IBLOB *bp, bool debayer, const BayerParams &params);
+        // Show the latest decoded frame, at most once per display refresh
+        void displayFrame();
+        void updateFrameRates();
 
         uint16_t streamW { 0 };
         uint16_t streamH { 0 };
-        uint32_t totalBaseCount { 0 };
-        QVector<QRgb> grayTable;
         QSharedPointer<QImage> streamImage;
         QPixmap kPix;
         QRubberBand *rubberBand { nullptr };
         QPoint origin;
-        QString m_RawFormat;
-        bool m_RawFormatSupported { false };
+
+        VideoDecoder m_Decoder;
+        QElapsedTimer m_LastDisplay;
+        QTimer m_DisplayTimer;
+        QElapsedTimer m_RatesTimer;
+        uint32_t m_Received { 0 };
+        uint32_t m_Displayed { 0 };
 
         // Collimation Overlay
         void setupOverlay();
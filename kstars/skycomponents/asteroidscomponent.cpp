@@ -17,6 +17,7 @@
 #include "solarsystemcomposite.h"
 #include "skycomponent.h"
 #include "skylabeler.h"
+#include "skymesh.h"
 #ifndef KSTARS_LITE
 #include "skymap.h"
 #else
@@ -26,6 +27,7 @@
 #include "auxiliary/kspaths.h"
 #include "auxiliary/ksnotification.h"
 #include "auxiliary/filedownloader.h"
+#include "htmesh/MeshIterator.h"
 #include "projections/projector.h"
 
 #include <KLocalizedString>
@@ -80,6 +82,7 @@ bool AsteroidsComponent::selected()
  */
 void AsteroidsComponent::loadDataFromText()
 {
+    clearBodies();
     clear();
     objectNames(SkyObject::ASTEROID).clear();
     objectLists(SkyObject::ASTEROID).clear();
@@ -187,6 +190,12 @@ void AsteroidsComponent::loadDataFromText()
     }
 }
 
+void AsteroidsComponent::clearData()
+{
+    clearBodies();
+    BinaryListComponent::clearData();
+}
+
 void AsteroidsComponent::draw(SkyPainter *skyp)
 {
     Q_UNUSED(skyp)
@@ -212,47 +221,36 @@ void AsteroidsComponent::draw(SkyPainter *skyp)
     // It is however assured that labelMagLimit <= showMagLimit.
     labelMagLimit = showMagLimit - 20.0 / densityLabelFactor + std::max(zoomLimit, labelMagLimit);
 
-    foreach (SkyObject *so, m_ObjectList)
+    if (m_BodyIndex.isEmpty())
+        return;
+
+    MeshIterator region(m_skyMesh, DRAW_BUF);
+    while (region.hasNext())
     {
-        KSAsteroid *ast = dynamic_cast<KSAsteroid *>(so);
+        for (auto so : m_BodyIndex.at(region.next()))
+        {
+            KSAsteroid *ast = static_cast<KSAsteroid *>(so);
 
-        if (!ast->toDraw() || std::isnan(ast->mag()) || ast->mag() > showMagLimit)
-            continue;
+            if (!ast->toDraw() || std::isnan(ast->mag()) || ast->mag() > showMagLimit)
+                continue;
 
-        bool drawn = false;
+            bool drawn = false;
 
-        if (ast->image().isNull() == false)
-            drawn = skyp->drawPlanet(ast);
-        else
-            drawn = skyp->drawAsteroid(ast);
+            if (ast->image().isNull() == false)
+                drawn = skyp->drawPlanet(ast);
+            else
+                drawn = skyp->drawAsteroid(ast);
 
-        if (drawn && !hideLabels && ast->mag() <= labelMagLimit)
-            SkyLabeler::AddLabel(ast, SkyLabeler::ASTEROID_LABEL);
+            if (drawn && !hideLabels && ast->mag() <= labelMagLimit)
+                SkyLabeler::AddLabel(ast, SkyLabeler::ASTEROID_LABEL);
+        }
     }
 #endif
 }
 
-SkyObject *AsteroidsComponent::objectNearest(SkyPoint *p, double &maxrad)
+bool AsteroidsComponent::isIndexed(SkyObject *body)
 {
-    SkyObject *oBest = nullptr;
-
-    if (!selected())
-        return nullptr;
-
-    for (auto o : m_ObjectList)
-    {
-        if (!((dynamic_cast<KSAsteroid*>(o)->toDraw())))
-            continue;
-
-        double r = o->angularDistanceTo(p).Degrees();
-        if (r < maxrad)
-        {
-            oBest  = o;
-            maxrad = r;
-        }
-    }
-
-    return oBest;
+    return static_cast<KSAsteroid *>(body)->toDraw();
 }
 
 void AsteroidsComponent::updateDataFile(bool isAutoUpdate)
@@ -40,7 +40,6 @@ class AsteroidsComponent : public QObject, public SolarSystemListComponent,
 
         void draw(SkyPainter *skyp) override;
         bool selected() override;
-        SkyObject *objectNearest(SkyPoint *p, double &maxrad) override;
 
         void updateDataFile(bool isAutoUpdate = false);
 
@@ -48,8 +47,12 @@ class AsteroidsComponent : public QObject, public SolarSystemListComponent,
         void downloadReady();
         void downloadError(const QString &errorString);
 
+    protected:
+        bool isIndexed(SkyObject *body) override;
+
     private:
         void loadDataFromText() override;
+        void clearData() override;
 
         QPointer<FileDownloader> downloadJob;
 };
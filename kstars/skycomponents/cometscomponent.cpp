@@ -22,10 +22,12 @@
 #endif
 #include "Options.h"
 #include "skylabeler.h"
+#include "skymesh.h"
 #include "skypainter.h"
 #include "solarsystemcomposite.h"
 #include "auxiliary/filedownloader.h"
 #include "auxiliary/kspaths.h"
+#include "htmesh/MeshIterator.h"
 #include "projections/projector.h"
 #include "skyobjects/kscomet.h"
 
@@ -83,6 +85,7 @@ void CometsComponent::loadData()
     emitProgressText(i18n("Loading comets"));
     qCInfo(KSTARS) << "Loading comets";
 
+    clearBodies();
     clear();
     objectNames(SkyObject::COMET).clear();
     objectLists(SkyObject::COMET).clear();
@@ -261,15 +264,22 @@ void CometsComponent::draw(SkyPainter *skyp)
     skyp->setPen(QPen(QColor("transparent")));
     skyp->setBrush(QBrush(QColor("white")));
 
-    for (auto so : m_ObjectList)
+    if (m_BodyIndex.isEmpty())
+        return;
+
+    MeshIterator region(m_skyMesh, DRAW_BUF);
+    while (region.hasNext())
     {
-        KSComet *com = dynamic_cast<KSComet *>(so);
-        double mag   = com->mag();
-        if (std::isnan(mag) == 0)
+        for (auto so : m_BodyIndex.at(region.next()))
         {
-            bool drawn = skyp->drawComet(com);
-            if (drawn && !(hideLabels || com->rsun() >= rsunLabelLimit))
-                SkyLabeler::AddLabel(com, SkyLabeler::COMET_LABEL);
+            KSComet *com = static_cast<KSComet *>(so);
+            double mag   = com->mag();
+            if (std::isnan(mag) == 0)
+            {
+                bool drawn = skyp->drawComet(com);
+                if (drawn && !(hideLabels || com->rsun() >= rsunLabelLimit))
+                    SkyLabeler::AddLabel(com, SkyLabeler::COMET_LABEL);
+            }
         }
     }
 #endif
@@ -29,6 +29,16 @@
 #include <windows.h>
 #endif
 
+namespace
+{
+// How far ahead, in ms, to predict the focus while slewing
+constexpr qint64 PREFETCH_LOOKAHEAD = 500;
+// Draws further apart than this (ms) are not used to estimate the slew velocity
+constexpr qint64 PREFETCH_MAX_INTERVAL = 1000;
+// Touch one byte per page to bring the mapped catalog data into memory
+constexpr int PREFETCH_PAGE_SIZE = 4096;
+}
+
 DeepStarComponent::DeepStarComponent(SkyComposite *parent, QString fileName, float trigMag, bool staticstars)
     : ListComponent(parent), m_reindexNum(J2000), triggerMag(trigMag), m_FaintMagnitude(-5.0), staticStars(staticstars),
       dataFileName(fileName)
@@ -42,6 +52,8 @@ DeepStarComponent::DeepStarComponent(SkyComposite *parent, QString fileName, flo
 
 DeepStarComponent::~DeepStarComponent()
 {
+    // The prefetch reads from the mapping of the file
+    m_PrefetchFuture.waitForFinished();
     if (fileOpened)
         starReader.closeFile();
     fileOpened = false;
@@ -246,8 +258,6 @@ void DeepStarComponent::draw(SkyPainter *skyp)
     StarObject::starsUpdated        = 0;
 #endif
     SkyMap *map       = SkyMap::Instance();
-    KStarsData *data  = KStarsData::Instance();
-    UpdateID updateID = data->updateID();
 
     //FIXME_FOV -- maybe not clamp like that...
     float radius = map->projector()->fov();
@@ -302,6 +312,12 @@ void DeepStarComponent::draw(SkyPainter *skyp)
 
     t.start();
 
+    // While slewing, trixels whose data is not in memory yet are drawn with the stars already loaded and
+    // prefetched in the background, so the frame does not wait for the disk. Once the slew stops everything
+    // is loaded as usual.
+    const bool prefetching = !staticStars && m_Prefetched && map->isSlewing();
+    QVector<Trixel> prefetchTrixels;
+
     // Mark used blocks in the LRU Cache. Not required for static stars
     if (!staticStars)
     {
@@ -341,7 +357,9 @@ void DeepStarComponent::draw(SkyPainter *skyp)
         if (currentRegion >= m_starBlockList.size())
             continue;
 
-        if (!staticStars)
+        if (prefetching && !m_Prefetched[currentRegion].load(std::memory_order_acquire))
+            prefetchTrixels.append(currentRegion);
+        else if (!staticStars)
         {
             m_starBlockList.at(currentRegion)->fillToMag(maglim);
         }
@@ -357,16 +375,10 @@ void DeepStarComponent::draw(SkyPainter *skyp)
         //        qDebug() << Q_FUNC_INFO << "Drawing SBL for trixel " << currentRegion << ", SBL has "
         //                 <<  m_starBlockList[ currentRegion ]->getBlockCount() << " blocks";
 
-        // REMARK: The following should never carry state, except for const parameters like updateID and maglim
-        std::function<void(std::shared_ptr<StarBlock>)> mapFunction = [&updateID, &maglim](std::shared_ptr<StarBlock> myBlock)
+        // REMARK: The following should never carry state, except for const parameters like maglim
+        std::function<void(std::shared_ptr<StarBlock>)> mapFunction = [&maglim](std::shared_ptr<StarBlock> myBlock)
         {
-            for (StarObject &star : myBlock->contents())
-            {
-                if (star.updateID != updateID)
-                    star.JITupdate();
-                if (star.mag() > maglim)
-                    break;
-            }
+            myBlock->JITupdate(maglim);
         };
 
         QtConcurrent::blockingMap(m_starBlockList.at(currentRegion)->contents(), mapFunction);
@@ -397,6 +409,17 @@ void DeepStarComponent::draw(SkyPainter *skyp)
         //        verifySBLIntegrity();
         t_drawUnnamed += t.restart();
     }
+
+    if (m_Prefetched)
+    {
+        // Always track the focus so the velocity is known as soon as a slew starts
+        if (prefetching)
+            predictAperture(focus, radius + 1.0, prefetchTrixels);
+        else
+            m_LastFocusTimer.start();
+        m_LastFocus = *focus;
+        prefetch(prefetchTrixels);
+    }
     m_skyMesh->inDraw(false);
 #ifdef PROFILE_SINCOS
     trig_calls_here += dms::trig_function_calls;
@@ -462,6 +485,11 @@ bool DeepStarComponent::openDataFile()
         if (starReader.getByteSwap())
             MSpT = bswap_16(MSpT);
         fileOpened = true;
+        // Dynamically loaded stars are read from a mapping of the file, see StarBlockList::fillToMag()
+        if (!staticStars && !starReader.mapFile())
+            qCWarning(KSTARS) << "Could not map deep star catalog " << dataFileName << ", reading it from the file instead.";
+        else if (!staticStars)
+            m_Prefetched.reset(new std::atomic<bool>[m_skyMesh->size()]());
         qCInfo(KSTARS) << "  Sky Mesh Size: " << m_skyMesh->size();
         for (long int i = 0; i < m_skyMesh->size(); i++)
         {
@@ -598,6 +626,75 @@ bool DeepStarComponent::starsInAperture(QList<StarObject *> &list, const SkyPoin
     return true;
 }
 
+void DeepStarComponent::prefetch(const QVector<Trixel> &trixels)
+{
+    if (trixels.isEmpty() || m_PrefetchFuture.isRunning())
+        return;
+
+    const char *data     = starReader.getMappedData();
+    const int recordSize = starReader.guessRecordSize();
+
+    m_PrefetchFuture = QtConcurrent::run([this, trixels, data, recordSize]()
+    {
+        for (Trixel trixel : trixels)
+        {
+            if (m_Prefetched[trixel].load(std::memory_order_acquire))
+                continue;
+
+            const volatile char *start = data + starReader.getOffset(trixel);
+            const volatile char *end   = start + static_cast<qint64>(starReader.getRecordCount(trixel)) * recordSize;
+            for (const volatile char *page = start; page < end; page += PREFETCH_PAGE_SIZE)
+                (void)*page;
+            if (end > start)
+                (void)*(end - 1);
+
+            m_Prefetched[trixel].store(true, std::memory_order_release);
+        }
+    });
+}
+
+void DeepStarComponent::releasePrefetched(Trixel trixel)
+{
+    if (m_Prefetched && trixel < static_cast<Trixel>(m_starBlockList.size()))
+        m_Prefetched[trixel].store(false, std::memory_order_release);
+}
+
+void DeepStarComponent::predictAperture(const SkyPoint *focus, float radius, QVector<Trixel> &trixels)
+{
+    if (!m_LastFocusTimer.isValid())
+    {
+        m_LastFocusTimer.start();
+        return;
+    }
+
+    const qint64 elapsed = m_LastFocusTimer.restart();
+    if (elapsed <= 0 || elapsed > PREFETCH_MAX_INTERVAL)
+        return;
+
+    // Extrapolate the motion of the focus since the last draw
+    double dRA = focus->ra().Degrees() - m_LastFocus.ra().Degrees();
+    if (dRA > 180.0)
+        dRA -= 360.0;
+    else if (dRA < -180.0)
+        dRA += 360.0;
+    const double dDec  = focus->dec().Degrees() - m_LastFocus.dec().Degrees();
+    const double scale = static_cast<double>(PREFETCH_LOOKAHEAD) / elapsed;
+
+    SkyPoint ahead(dms(focus->ra().Degrees() + dRA * scale).reduce(),
+                   dms(qBound(-90.0, focus->dec().Degrees() + dDec * scale, 90.0)));
+    // Same as SkyMesh::aperture(), which can't be used as it increments the drawID
+    ahead.catalogueCoord(KStarsData::Instance()->updateNum()->julianDay());
+    m_skyMesh->intersect(ahead.ra().Degrees(), ahead.dec().Degrees(), radius, (BufNum)PREFETCH_BUF);
+
+    MeshIterator region(m_skyMesh, PREFETCH_BUF);
+    while (region.hasNext())
+    {
+        Trixel trixel = region.next();
+        if (trixel < static_cast<Trixel>(m_starBlockList.size()) && !m_Prefetched[trixel].load(std::memory_order_acquire))
+            trixels.append(trixel);
+    }
+}
+
 void DeepStarComponent::byteSwap(DeepStarData *stardata)
 {
     stardata->RA   = bswap_32(stardata->RA);
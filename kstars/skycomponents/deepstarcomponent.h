@@ -21,6 +21,13 @@
 #include "starblockfactory.h"
 #include "skyobjects/deepstardata.h"
 #include "skyobjects/stardata.h"
+#include "skyobjects/skypoint.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+
+#include <atomic>
+#include <memory>
 
 class SkyLabeler;
 class SkyMesh;
@@ -99,9 +106,36 @@ class DeepStarComponent : public ListComponent
     static void byteSwap(DeepStarData *stardata);
     static void byteSwap(StarData *stardata);
 
+    /**
+     * @short Mark the catalog data of a trixel as not read ahead anymore
+     *
+     * Called when the StarBlockList of the trixel releases its blocks, so the trixel is prefetched again
+     * the next time a slew approaches it.
+     */
+    void releasePrefetched(Trixel trixel);
+
     static StarBlockFactory m_StarBlockFactory;
 
   private:
+    /**
+     * @short Read the catalog data of the given trixels into memory in the background
+     *
+     * Only the pages of the mapped catalog file are touched, so the stars themselves are still created by
+     * StarBlockList::fillToMag() on the drawing thread, but without waiting for the disk.
+     * Does nothing if the previous prefetch is still running.
+     */
+    void prefetch(const QVector<Trixel> &trixels);
+
+    /**
+     * @short Add the trixels of the aperture the focus is expected to reach shortly to the list
+     *
+     * The slew velocity is estimated from the focus at the previous draw.
+     * @param focus current focus of the sky map
+     * @param radius of the aperture in degrees
+     * @param trixels list to add to. Trixels already prefetched are not added
+     */
+    void predictAperture(const SkyPoint *focus, float radius, QVector<Trixel> &trixels);
+
     SkyMesh *m_skyMesh { nullptr };
     KSNumbers m_reindexNum;
 
@@ -131,4 +165,12 @@ class DeepStarComponent : public ListComponent
     StarData stardata;
     BinFileHelper starReader;
     QString dataFileName;
+
+    // Prefetching of dynamically loaded stars
+    /// Per trixel, has its data been read ahead? nullptr if the catalog is not mapped
+    std::unique_ptr<std::atomic<bool>[]> m_Prefetched;
+    QFuture<void> m_PrefetchFuture;
+    /// Focus at the last draw and the time since, to estimate where a slew is heading
+    SkyPoint m_LastFocus;
+    QElapsedTimer m_LastFocusTimer;
 };
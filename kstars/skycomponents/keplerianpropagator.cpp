@@ -0,0 +1,284 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "keplerianpropagator.h"
+
+#include "ksnumbers.h"
+#include "Options.h"
+#include "skyobjects/ksasteroid.h"
+#include "skyobjects/kscomet.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+// Bodies solved together. Small enough for the per-block scratch arrays to stay in L1 cache,
+// large enough for the thread pool overhead not to matter.
+constexpr uint32_t BLOCK_SIZE = 256;
+
+// Newton iterations stop once the largest correction in the block is below this (radians, ~0.02")
+constexpr double KEPLER_TOLERANCE = 1e-7;
+constexpr int KEPLER_MAX_ITERATIONS = 50;
+
+// Eccentricity above which comets use the near-parabolic approximation, as in KSComet
+constexpr double NEAR_PARABOLIC = 0.98;
+
+// Gauss gravitational constant
+constexpr double GAUSS_K = 0.01720209895;
+
+/**
+ * @short Fill the perihelion (P) and in-plane normal (Q) unit vectors for an orbit
+ * @param i inclination
+ * @param w argument of perihelion
+ * @param N longitude of the ascending node
+ */
+void orbitAxes(const dms &i, const dms &w, const dms &N, double P[3], double Q[3])
+{
+    double sini, cosi, sinw, cosw, sinN, cosN;
+    i.SinCos(sini, cosi);
+    w.SinCos(sinw, cosw);
+    N.SinCos(sinN, cosN);
+
+    P[0] = cosN * cosw - sinN * sinw * cosi;
+    P[1] = sinN * cosw + cosN * sinw * cosi;
+    P[2] = sinw * sini;
+    Q[0] = -cosN * sinw - sinN * cosw * cosi;
+    Q[1] = -sinN * sinw + cosN * cosw * cosi;
+    Q[2] = cosw * sini;
+}
+}
+
+void KeplerianPropagator::clear()
+{
+    m_Bodies.clear();
+    m_EllipticCount = 0;
+    for (auto array : { &m_Epoch, &m_M0, &m_N, &m_A, &m_B, &m_E, &m_Px, &m_Py, &m_Pz, &m_Qx, &m_Qy, &m_Qz })
+        array->clear();
+    m_Selected.clear();
+}
+
+void KeplerianPropagator::setBodies(const QList<SkyObject *> &bodies)
+{
+    clear();
+
+    struct Elements
+    {
+        KSPlanetBase *body;
+        double epoch, m0, n, a, b, e;
+        double P[3], Q[3];
+    };
+    std::vector<Elements> elliptic, parabolic;
+    elliptic.reserve(bodies.size());
+
+    for (auto object : bodies)
+    {
+        Elements el;
+        el.body = static_cast<KSPlanetBase *>(object);
+
+        if (object->type() == SkyObject::ASTEROID)
+        {
+            auto asteroid = static_cast<KSAsteroid *>(object);
+            el.epoch = asteroid->JD;
+            el.m0    = asteroid->M.radians();
+            el.n     = 2.0 * dms::PI / asteroid->P;
+            el.a     = asteroid->a;
+            el.e     = asteroid->e;
+            el.b     = el.a * sqrt(1.0 - el.e * el.e);
+            orbitAxes(asteroid->i, asteroid->w, asteroid->N, el.P, el.Q);
+            elliptic.push_back(el);
+        }
+        else if (object->type() == SkyObject::COMET)
+        {
+            auto comet = static_cast<KSComet *>(object);
+            el.epoch = comet->JDp;
+            el.m0    = 0;
+            el.e     = comet->e;
+            orbitAxes(comet->i, comet->w, comet->N, el.P, el.Q);
+            if (el.e > NEAR_PARABOLIC)
+            {
+                el.n = 0;
+                el.a = comet->q;
+                el.b = 0;
+                parabolic.push_back(el);
+            }
+            else
+            {
+                el.n = 2.0 * dms::PI / comet->P;
+                el.a = comet->a;
+                el.b = el.a * sqrt(1.0 - el.e * el.e);
+                elliptic.push_back(el);
+            }
+        }
+    }
+
+    m_EllipticCount = elliptic.size();
+    elliptic.insert(elliptic.end(), parabolic.begin(), parabolic.end());
+
+    m_Bodies.reserve(elliptic.size());
+    for (auto array : { &m_Epoch, &m_M0, &m_N, &m_A, &m_B, &m_E, &m_Px, &m_Py, &m_Pz, &m_Qx, &m_Qy, &m_Qz })
+        array->reserve(elliptic.size());
+
+    for (const auto &el : elliptic)
+    {
+        m_Bodies.push_back(el.body);
+        m_Epoch.push_back(el.epoch);
+        m_M0.push_back(el.m0);
+        m_N.push_back(el.n);
+        m_A.push_back(el.a);
+        m_B.push_back(el.b);
+        m_E.push_back(el.e);
+        m_Px.push_back(el.P[0]);
+        m_Py.push_back(el.P[1]);
+        m_Pz.push_back(el.P[2]);
+        m_Qx.push_back(el.Q[0]);
+        m_Qy.push_back(el.Q[1]);
+        m_Qz.push_back(el.Q[2]);
+    }
+}
+
+void KeplerianPropagator::update(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST,
+                                 const KSPlanetBase *Earth)
+{
+    // Bodies with a trail are updated on this thread, the others are propagated in blocks
+    m_Selected.clear();
+    for (uint32_t k = 0; k < m_Bodies.size(); ++k)
+    {
+        KSPlanetBase *body = m_Bodies[k];
+
+        if (body->hasTrail())
+        {
+            body->findPosition(num, lat, LST, Earth);
+            body->EquatorialToHorizontal(LST, lat);
+            body->updateTrail(LST, lat);
+            continue;
+        }
+
+        m_Selected.push_back(k);
+    }
+
+    if (m_Selected.empty())
+        return;
+
+    // The lazy lookup of the Sun for the light deflection must not happen on the worker threads
+    if (Options::useRelativistic())
+        SkyPoint::findSun();
+
+    //xe, ye, ze are the Earth's heliocentric cartesian coords
+    double earth[3];
+    double cosBe, sinBe, cosLe, sinLe;
+    Earth->ecLong().SinCos(sinLe, cosLe);
+    Earth->ecLat().SinCos(sinBe, cosBe);
+    earth[0] = Earth->rsun() * cosBe * cosLe;
+    earth[1] = Earth->rsun() * cosBe * sinLe;
+    earth[2] = Earth->rsun() * sinBe;
+
+    std::vector<Block> blocks;
+    blocks.reserve(m_Selected.size() / BLOCK_SIZE + 1);
+    for (uint32_t begin = 0; begin < m_Selected.size(); begin += BLOCK_SIZE)
+        blocks.push_back({ begin, std::min<uint32_t>(begin + BLOCK_SIZE, m_Selected.size()) });
+
+    if (blocks.size() == 1)
+        propagate(blocks.front(), num, lat, LST, earth);
+    else
+        QtConcurrent::blockingMap(blocks, [&](const Block & block)
+        {
+            propagate(block, num, lat, LST, earth);
+        });
+}
+
+void KeplerianPropagator::propagate(const Block &block, const KSNumbers *num, const CachingDms *lat,
+                                    const CachingDms *LST, const double earth[3]) const
+{
+    const double jd = static_cast<double>(num->julianDay());
+    const uint32_t count = block.end - block.begin;
+    const uint32_t *selected = m_Selected.data() + block.begin;
+
+    // Orbit-plane coordinates of each body, x towards the perihelion
+    std::array<double, BLOCK_SIZE> xv, yv;
+
+    // Selected bodies are in packing order, so the elliptic ones come first
+    uint32_t elliptic = 0;
+    while (elliptic < count && selected[elliptic] < m_EllipticCount)
+        ++elliptic;
+
+    if (elliptic > 0)
+    {
+        std::array<double, BLOCK_SIZE> M, E, e;
+
+        for (uint32_t k = 0; k < elliptic; ++k)
+        {
+            const uint32_t j = selected[k];
+            M[k] = std::remainder(m_M0[j] + m_N[j] * (jd - m_Epoch[j]), 2.0 * dms::PI);
+            e[k] = m_E[j];
+            // Starting value which makes Newton's method converge for any eccentricity below 1
+            E[k] = M[k] + std::copysign(0.85 * e[k], M[k]);
+        }
+
+        // Newton's method for E - e sin E = M, in lock-step over the block
+        for (int iteration = 0; iteration < KEPLER_MAX_ITERATIONS; ++iteration)
+        {
+            double largest = 0;
+            for (uint32_t k = 0; k < elliptic; ++k)
+            {
+                const double dE = (E[k] - e[k] * std::sin(E[k]) - M[k]) / (1.0 - e[k] * std::cos(E[k]));
+                E[k] -= dE;
+                largest = std::max(largest, std::fabs(dE));
+            }
+            if (largest < KEPLER_TOLERANCE)
+                break;
+        }
+
+        for (uint32_t k = 0; k < elliptic; ++k)
+        {
+            const uint32_t j = selected[k];
+            xv[k] = m_A[j] * (std::cos(E[k]) - e[k]);
+            yv[k] = m_B[j] * std::sin(E[k]);
+        }
+    }
+
+    // Near-parabolic comets, with the approximation used by KSComet
+    for (uint32_t k = elliptic; k < count; ++k)
+    {
+        const uint32_t j = selected[k];
+        const double e = m_E[j];
+        const double q = m_A[j];
+
+        double a = 0.75 * (jd - m_Epoch[j]) * GAUSS_K * sqrt((1 + e) / (q * q * q));
+        double b = sqrt(1.0 + a * a);
+        double W = pow((b + a), 1.0 / 3.0) - pow((b - a), 1.0 / 3.0);
+        double c = 1.0 + 1.0 / (W * W);
+        double f = (1.0 - e) / (1.0 + e);
+        double g = f / (c * c);
+
+        double a1 = (2.0 / 3.0) + (2.0 * W * W / 5.0);
+        double a2 = (7.0 / 5.0) + (33.0 * W * W / 35.0) + (37.0 * W * W * W * W / 175.0);
+        double a3 = W * W * ((432.0 / 175.0) + (956.0 * W * W / 1125.0) + (84.0 * W * W * W * W / 1575.0));
+        double w  = W * (1.0 + g * c * (a1 + a2 * g + a3 * g * g));
+
+        // true anomaly and distance from the Sun
+        double v = 2.0 * atan(w);
+        double r = q * (1.0 + w * w) / (1.0 + w * w * f);
+        xv[k] = r * cos(v);
+        yv[k] = r * sin(v);
+    }
+
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        const uint32_t j = selected[k];
+        const double helio[3] =
+        {
+            xv[k] * m_Px[j] + yv[k] * m_Qx[j],
+            xv[k] * m_Py[j] + yv[k] * m_Qy[j],
+            xv[k] * m_Pz[j] + yv[k] * m_Qz[j]
+        };
+
+        KSPlanetBase *body = m_Bodies[j];
+        body->setHeliocentricPosition(num, lat, LST, helio, earth);
+        body->EquatorialToHorizontal(LST, lat);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QList>
+
+#include <cstdint>
+#include <vector>
+
+class CachingDms;
+class KSNumbers;
+class KSPlanetBase;
+class SkyObject;
+
+/**
+ * @class KeplerianPropagator
+ * @short Finds the positions of many asteroids and comets at once from their orbital elements.
+ *
+ * The elements of the bodies are packed into arrays, one per element, when the bodies are set.
+ * Each update walks those arrays in blocks spread over worker threads: Kepler's equation is solved
+ * for a whole block with Newton iterations that run in lock-step over the block (plain loops
+ * over the arrays which the compiler can vectorize), and the resulting heliocentric positions are
+ * then handed to KSPlanetBase::setHeliocentricPosition() for the apparent and horizontal
+ * coordinates, magnitude and so on.
+ *
+ * Every body is propagated, including asteroids fainter than the magnitude limit, so that their
+ * positions and magnitudes stay current; the magnitude limit only decides which ones are indexed
+ * and drawn. Bodies with a trail are updated one by one with KSPlanetBase::findPosition() so their
+ * trail keeps growing.
+ *
+ * Comets on near-parabolic orbits (e > 0.98) use the same approximation as KSComet.
+ */
+class KeplerianPropagator
+{
+  public:
+    /** Forget all bodies. Must be called before the bodies that were set are deleted. */
+    void clear();
+
+    /** @return true if no body is set */
+    bool isEmpty() const { return m_Bodies.empty(); }
+
+    /**
+     * @short Pack the orbital elements of @p bodies.
+     * Objects other than KSAsteroid and KSComet are ignored.
+     */
+    void setBodies(const QList<SkyObject *> &bodies);
+
+    /**
+     * @short Update the position of the bodies for the date of @p num
+     * @param num KSNumbers for the target date/time
+     * @param lat geographic latitude, used for the topocentric and horizontal coordinates
+     * @param LST local sidereal time, used for the topocentric and horizontal coordinates
+     * @param Earth planet Earth, whose position must already be up to date
+     */
+    void update(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST, const KSPlanetBase *Earth);
+
+  private:
+    struct Block
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    /** Solve the orbits of the bodies in m_Selected in [block.begin, block.end) and write them back */
+    void propagate(const Block &block, const KSNumbers *num, const CachingDms *lat, const CachingDms *LST,
+                   const double earth[3]) const;
+
+    // Elliptic orbits are packed first, near-parabolic ones after m_EllipticCount
+    std::vector<KSPlanetBase *> m_Bodies;
+    uint32_t m_EllipticCount { 0 };
+
+    // Elliptic orbits: mean anomaly m0 (rad) at epoch, mean motion n (rad/day), semi-major and
+    // semi-minor axes (AU) and eccentricity
+    // Near-parabolic orbits: time of perihelion as epoch, perihelion distance in a, eccentricity
+    std::vector<double> m_Epoch, m_M0, m_N, m_A, m_B, m_E;
+    // Unit vectors to the perihelion (P) and 90 degrees ahead of it in the orbital plane (Q),
+    // in the heliocentric ecliptic J2000 frame
+    std::vector<double> m_Px, m_Py, m_Pz, m_Qx, m_Qy, m_Qz;
+
+    // Indices of the bodies without a trail, propagated in the current update
+    std::vector<uint32_t> m_Selected;
+};
@@ -7,6 +7,7 @@
 #include "skymapcomposite.h"
 
 #include "artificialhorizoncomponent.h"
+#include "asteroidscomponent.h"
 #include "catalogsdb.h"
 #include "constellationartcomponent.h"
 #include "constellationboundarylines.h"
@@ -15,6 +16,7 @@
 #include "culturelist.h"
 #include "deepstarcomponent.h"
 #include "catalogscomponent.h"
+#include "cometscomponent.h"
 #include "ecliptic.h"
 #include "equator.h"
 #include "equatorialcoordinategrid.h"
@@ -557,6 +559,10 @@ QList<SkyObject *> SkyMapComposite::findObjectsInArea(const SkyPoint &p1,
         m_Stars->objectsInArea(list, region);
     if (m_Catalogs->selected())
         m_Catalogs->objectsInArea(list, region);
+    if (m_SolarSystem->asteroidsComponent()->selected())
+        m_SolarSystem->asteroidsComponent()->objectsInArea(list, region);
+    if (m_SolarSystem->cometsComponent()->selected())
+        m_SolarSystem->cometsComponent()->objectsInArea(list, region);
     return list;
 }
 
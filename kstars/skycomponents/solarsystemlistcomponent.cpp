@@ -11,6 +11,8 @@
 #ifndef KSTARS_LITE
 #include "skymap.h"
 #endif
+#include "skymesh.h"
+#include "htmesh/MeshIterator.h"
 #include "solarsystemcomposite.h"
 #include "skyobjects/ksplanet.h"
 #include "skyobjects/ksplanetbase.h"
@@ -19,7 +21,8 @@
 
 #include <QPen>
 
-SolarSystemListComponent::SolarSystemListComponent(SolarSystemComposite *p) : ListComponent(p), m_Earth(p->earth())
+SolarSystemListComponent::SolarSystemListComponent(SolarSystemComposite *p)
+    : ListComponent(p), m_skyMesh(SkyMesh::Instance()), m_Earth(p->earth())
 {
 }
 
@@ -49,16 +52,85 @@ void SolarSystemListComponent::updateSolarSystemBodies(KSNumbers *num)
     if (selected())
     {
         KStarsData *data = KStarsData::Instance();
-        foreach (SkyObject *o, m_ObjectList)
-        {
-            KSPlanetBase *p = (KSPlanetBase *)o;
-            p->findPosition(num, data->geo()->lat(), data->lst(), m_Earth);
-            p->EquatorialToHorizontal(data->lst(), data->geo()->lat());
 
-            if (p->hasTrail())
-                p->updateTrail(data->lst(), data->geo()->lat());
+        if (m_Propagator.isEmpty())
+            m_Propagator.setBodies(m_ObjectList);
+
+        m_Propagator.update(num, data->geo()->lat(), data->lst(), m_Earth);
+        updateIndex();
+    }
+}
+
+bool SolarSystemListComponent::isIndexed(SkyObject *)
+{
+    return true;
+}
+
+void SolarSystemListComponent::clearBodies()
+{
+    m_Propagator.clear();
+    m_BodyIndex.clear();
+    m_BodyTrixels.clear();
+}
+
+void SolarSystemListComponent::updateIndex()
+{
+    if (m_BodyTrixels.size() != m_ObjectList.size())
+    {
+        m_BodyIndex = QVector<QList<SkyObject *>>(m_skyMesh->size());
+        m_BodyTrixels.fill(-1, m_ObjectList.size());
+    }
+
+    // Bodies move slowly compared to the size of a trixel, so few of them change lists
+    for (int k = 0; k < m_ObjectList.size(); ++k)
+    {
+        SkyObject *body = m_ObjectList.at(k);
+        const Trixel trixel = isIndexed(body) ? m_skyMesh->index(body) : -1;
+        Trixel &current = m_BodyTrixels[k];
+
+        if (trixel == current)
+            continue;
+
+        if (current >= 0)
+            m_BodyIndex[current].removeOne(body);
+        if (trixel >= 0)
+            m_BodyIndex[trixel].append(body);
+        current = trixel;
+    }
+}
+
+SkyObject *SolarSystemListComponent::objectNearest(SkyPoint *p, double &maxrad)
+{
+    if (!selected() || m_BodyIndex.isEmpty())
+        return nullptr;
+
+    SkyObject *oBest = nullptr;
+    m_skyMesh->aperture(p, maxrad + 1.0, OBJ_NEAREST_BUF);
+    MeshIterator region(m_skyMesh, OBJ_NEAREST_BUF);
+
+    while (region.hasNext())
+    {
+        for (auto &body : m_BodyIndex.at(region.next()))
+        {
+            double r = body->angularDistanceTo(p).Degrees();
+            if (r < maxrad)
+            {
+                oBest  = body;
+                maxrad = r;
+            }
         }
     }
+
+    return oBest;
+}
+
+void SolarSystemListComponent::objectsInArea(QList<SkyObject *> &list, const SkyRegion &region)
+{
+    if (m_BodyIndex.isEmpty())
+        return;
+
+    for (SkyRegion::const_iterator it = region.constBegin(); it != region.constEnd(); ++it)
+        list.append(m_BodyIndex.at(it.key()));
 }
 
 void SolarSystemListComponent::drawTrails(SkyPainter *skyp)
@@ -6,9 +6,12 @@
 
 #pragma once
 
+#include "keplerianpropagator.h"
 #include "listcomponent.h"
+#include "typedef.h"
 
 class KSPlanet;
+class SkyMesh;
 class SolarSystemComposite;
 
 /**
@@ -35,9 +38,43 @@ class SolarSystemListComponent : public ListComponent
      */
     void updateSolarSystemBodies(KSNumbers *num) override;
 
+    /**
+     * @short Find the nearest indexed body to @p p.
+     * Only the trixels within @p maxrad of @p p, plus a degree of margin, are searched.
+     */
+    SkyObject *objectNearest(SkyPoint *p, double &maxrad) override;
+
+    void objectsInArea(QList<SkyObject *> &list, const SkyRegion &region) override;
+
   protected:
     void drawTrails(SkyPainter *skyp) override;
 
+    /**
+     * @return true if @p body is to be drawn and found on the map with its position from the
+     * last update. Other bodies are left out of the index. All bodies are indexed by default.
+     */
+    virtual bool isIndexed(SkyObject *body);
+
+    /**
+     * @short Forget the packed orbits and the index of the bodies.
+     * Must be called whenever m_ObjectList is cleared; both are rebuilt on the next update.
+     */
+    void clearBodies();
+
+    SkyMesh *m_skyMesh { nullptr };
+
+    /** Indexed bodies, by the trixel of their J2000 position. Empty until the first update. */
+    QVector<QList<SkyObject *>> m_BodyIndex;
+
   private:
+    /** Move the bodies whose trixel changed in the last update. */
+    void updateIndex();
+
     KSPlanet *m_Earth { nullptr };
+
+    /** Propagates the orbits of the bodies in m_ObjectList */
+    KeplerianPropagator m_Propagator;
+
+    /** Trixel of each body in m_ObjectList, or -1 if it is not indexed */
+    QVector<Trixel> m_BodyTrixels;
 };
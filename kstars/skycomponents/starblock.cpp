@@ -5,12 +5,19 @@
 */
 
 #include <QDebug>
+#include <QVarLengthArray>
 
 #include "starblock.h"
 #include "skyobjects/starobject.h"
 #include "starcomponent.h"
 #include "skyobjects/stardata.h"
 #include "skyobjects/deepstardata.h"
+#include "auxiliary/dms.h"
+#include "kstarsdata.h"
+#include "ksnumbers.h"
+#include "Options.h"
+
+#include <cmath>
 
 #ifdef KSTARS_LITE
 #include "skymaplite.h"
@@ -110,3 +117,183 @@ StarObject *StarBlock::addStar(const DeepStarData &data)
     return &star;
 }
 #endif
+
+void StarBlock::JITupdate(float maglim)
+{
+    static KStarsData *data = KStarsData::Instance();
+
+    JITupdate(data->updateNum(), data->lst(), data->geo()->lat(), data->updateNumID(), data->updateID(), maglim);
+}
+
+void StarBlock::JITupdate(const KSNumbers *num, const CachingDms *LST, const CachingDms *lat, quint64 updateNumID,
+                          quint64 updateID, float maglim)
+{
+    // Stars are sorted by magnitude. Like the original per star loop, the first star past maglim is updated too.
+    int count = 0;
+    while (count < nStars)
+    {
+        if (starObject(count++).mag() > maglim)
+            break;
+    }
+
+    // Light bending is only implemented per star, and the libnova implementation differs from the one below
+    if (Options::useRelativistic() || SkyPoint::implementationIsLibnova)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            StarObject &star = starObject(i);
+            if (star.updateID == updateID)
+                continue;
+            if (star.updateNumID != updateNumID)
+            {
+                star.updateCoords(num);
+                star.updateNumID = updateNumID;
+            }
+            star.EquatorialToHorizontal(LST, lat);
+            star.updateID = updateID;
+        }
+        return;
+    }
+
+    // Stars that need their RA / Dec recomputed, see StarObject::JITupdate()
+    const bool alwaysRecompute = Options::alwaysRecomputeCoordinates();
+    const long double jd       = num->getJD();
+    QVarLengthArray<int, 128> recompute;
+    QVarLengthArray<int, 128> update;
+    for (int i = 0; i < count; i++)
+    {
+        StarObject &star = starObject(i);
+        if (star.updateID == updateID)
+            continue;
+        if (star.updateNumID != updateNumID)
+        {
+            if (alwaysRecompute || std::abs(star.lastPrecessJD - jd) >= 0.00069444)
+                recompute.append(i);
+            star.updateNumID = updateNumID;
+        }
+        update.append(i);
+    }
+
+    const int nRecompute = recompute.size();
+    if (nRecompute > 0)
+    {
+        // Proper motion and precession, see StarObject::getIndexCoords() and SkyPoint::precess()
+        // The catalog coordinates cache their sine and cosine, so this needs no trigonometry.
+        // The proper motion is in mas per year, i.e. arcsec per millennium, with pmRA already scaled by cos(dec).
+        const double t = num->julianMillenia();
+        const double scale = M_PI / (180.0 * 3600.0);
+        const Eigen::Matrix3d &p = num->p2();
+        QVarLengthArray<double, 128> vx(nRecompute), vy(nRecompute), vz(nRecompute);
+        for (int k = 0; k < nRecompute; k++)
+        {
+            const StarObject &star = starObject(recompute[k]);
+            const double sinRa = star.ra0().sin(), cosRa = star.ra0().cos();
+            const double sinDec = star.dec0().sin(), cosDec = star.dec0().cos();
+            double x = cosDec * cosRa, y = cosDec * sinRa, z = sinDec;
+            const double pmSquared = star.pmMagnitudeSquared();
+            if (!(std::isnan(pmSquared) || pmSquared * t * t < .01))
+            {
+                const double pmRA = star.pmRA() * scale * t, pmDec = star.pmDec() * scale * t;
+                x += - pmRA * sinRa - pmDec * sinDec * cosRa;
+                y += pmRA * cosRa - pmDec * sinDec * sinRa;
+                z += pmDec * cosDec;
+                const double norm = 1.0 / std::sqrt(x * x + y * y + z * z);
+                x *= norm;
+                y *= norm;
+                z *= norm;
+            }
+            vx[k] = p(0, 0) * x + p(0, 1) * y + p(0, 2) * z;
+            vy[k] = p(1, 0) * x + p(1, 1) * y + p(1, 2) * z;
+            vz[k] = p(2, 0) * x + p(2, 1) * y + p(2, 2) * z;
+        }
+
+        // Nutation and aberration, see SkyPoint::nutate() and SkyPoint::aberrate()
+        double sinOb, cosOb, sinL, cosL, sinP, cosP;
+        num->obliquity()->SinCos(sinOb, cosOb);
+        num->sunTrueLongitude().SinCos(sinL, cosL);
+        num->earthPerihelionLongitude().SinCos(sinP, cosP);
+        const double dEcLong = num->dEcLong(), dObliq = num->dObliq();
+        const double K = num->constAberr().Degrees(), e = num->earthEccentricity();
+        const double cosTerm = e * cosP - cosL, sinTerm = e * sinP - sinL;
+
+        for (int k = 0; k < nRecompute; k++)
+        {
+            StarObject &star = starObject(recompute[k]);
+
+            CachingDms ra, dec;
+            ra.setUsing_atan2(vy[k], vx[k]);
+            ra.reduceToRange(dms::ZERO_TO_2PI);
+            dec.setUsing_asin(vz[k]);
+
+            // The approximate nutation and aberration do not hold near the poles
+            if (std::abs(dec.Degrees()) >= 80.0)
+            {
+                star.updateCoords(num);
+                continue;
+            }
+
+            double sinRA = ra.sin(), cosRA = ra.cos(), sinDec = dec.sin(), cosDec = dec.cos();
+            double tanDec = sinDec / cosDec;
+            ra.setD(ra.Degrees() + dEcLong * (cosOb + sinOb * sinRA * tanDec) - dObliq * cosRA * tanDec);
+            dec.setD(dec.Degrees() + dEcLong * (sinOb * cosRA) + dObliq * sinRA);
+
+            if (std::abs(dec.Degrees()) >= 80.0)
+            {
+                star.updateCoords(num);
+                continue;
+            }
+
+            sinRA = ra.sin(), cosRA = ra.cos(), sinDec = dec.sin(), cosDec = dec.cos();
+            ra.setD(ra.Degrees() + (K / cosDec) * (cosRA * cosOb * cosTerm + sinRA * sinTerm));
+            dec.setD(dec.Degrees() + K * ((sinOb * cosDec - cosOb * sinDec * sinRA) * cosTerm + cosRA * sinDec * sinTerm));
+
+            star.setRA(ra);
+            star.setDec(dec);
+            star.lastPrecessJD = jd;
+        }
+    }
+
+    // Horizontal coordinates, see SkyPoint::EquatorialToHorizontal()
+    const int nUpdate = update.size();
+    double sinLat, cosLat, sinLST, cosLST;
+    lat->SinCos(sinLat, cosLat);
+    LST->SinCos(sinLST, cosLST);
+    QVarLengthArray<double, 128> sinAlt(nUpdate), sinHA(nUpdate), sinDec(nUpdate);
+    for (int k = 0; k < nUpdate; k++)
+    {
+        const StarObject &star = starObject(update[k]);
+        const double sinRA = star.ra().sin(), cosRA = star.ra().cos();
+        const double cosDec = star.dec().cos();
+        const double cosHA = cosLST * cosRA + sinLST * sinRA;
+        sinHA[k]  = sinLST * cosRA - cosLST * sinRA;
+        sinDec[k] = star.dec().sin();
+        sinAlt[k] = sinDec[k] * sinLat + cosDec * cosLat * cosHA;
+    }
+
+    for (int k = 0; k < nUpdate; k++)
+    {
+        StarObject &star = starObject(update[k]);
+        const double altRad = asin(sinAlt[k]);
+        double cosAlt = std::sqrt(1 - sinAlt[k] * sinAlt[k]);
+        if (cosAlt == 0.)
+            cosAlt = cos(altRad);
+
+        const double arg = (sinDec[k] - sinLat * sinAlt[k]) / (cosLat * cosAlt);
+        double azRad;
+        if (arg <= -1.0)
+            azRad = dms::PI;
+        else if (arg >= 1.0)
+            azRad = 0.0;
+        else
+            azRad = acos(arg);
+        if (sinHA[k] > 0.0 && azRad != 0.0)
+            azRad = 2.0 * dms::PI - azRad;
+
+        dms alt, az;
+        alt.setRadians(altRad);
+        az.setRadians(azRad);
+        star.setAlt(alt);
+        star.setAz(az);
+        star.updateID = updateID;
+    }
+}
@@ -12,6 +12,8 @@
 
 #include <QVector>
 
+class CachingDms;
+class KSNumbers;
 class StarBlockList;
 class PointSourceNode;
 struct StarData;
@@ -152,6 +154,25 @@ class StarBlock
         /** @short  Reset this StarBlock's data, for reuse of the StarBlock */
         void reset();
 
+        /**
+         * @short Update the coordinates of the stars for the current draw, see StarObject::JITupdate()
+         *
+         * Stars are updated in order up to and including the first star fainter than maglim.
+         * @param maglim Magnitude limit of the draw
+         */
+        void JITupdate(float maglim);
+
+        /**
+         * @short JITupdate() with the epoch, location and update IDs given explicitly
+         *
+         * Proper motion, precession, nutation, aberration and the conversion to horizontal coordinates are
+         * done as passes over the whole block rather than star by star through SkyPoint. Stars within 10 degrees
+         * of a celestial pole, and all stars if relativistic corrections are enabled, are updated with
+         * StarObject::updateCoords() as before.
+         */
+        void JITupdate(const KSNumbers *num, const CachingDms *LST, const CachingDms *lat, quint64 updateNumID,
+                       quint64 updateID, float maglim);
+
         float faintMag { 0 };
         float brightMag { 0 };
         StarBlockList *parent;
@@ -164,6 +185,15 @@ class StarBlock
         StarBlock(const StarBlock &);
         StarBlock &operator=(const StarBlock &);
 
+        inline StarObject &starObject(int i)
+        {
+#ifdef KSTARS_LITE
+            return stars[i].star;
+#else
+            return stars[i];
+#endif
+        }
+
         /** Number of initialized stars in StarBlock. */
         int nStars { 0 };
         /** Array of stars. */
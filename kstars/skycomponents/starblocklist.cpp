@@ -17,6 +17,41 @@
 #endif
 
 #include <QDebug>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+/**
+ * @short Add records from a mapped catalog file to a block until the block is full or the stars get fainter than maglim
+ *
+ * The records are copied out and byte swapped together before being added, so the work per star is just
+ * StarBlock::addStar().
+ * @return the number of records used
+ */
+template <typename T>
+int addRecords(StarBlock *block, const char *data, const int count, const bool byteSwap, const float maglim)
+{
+    QVarLengthArray<T, 128> records(count);
+    std::memcpy(records.data(), data, count * sizeof(T));
+    if (byteSwap)
+    {
+        for (auto &record : records)
+            DeepStarComponent::byteSwap(&record);
+    }
+
+    int added = 0;
+    while (added < count)
+    {
+        block->addStar(records[added++]);
+        if (block->getFaintMag() > maglim)
+            break;
+    }
+    return added;
+}
+}
 
 StarBlockList::StarBlockList(const Trixel &tr, DeepStarComponent *parent)
 {
@@ -48,6 +83,7 @@ int StarBlockList::releaseBlock(StarBlock *block)
         nStars -= block->getStarCount();
 
         readOffset -= parent->getStarReader()->guessRecordSize() * block->getStarCount();
+        parent->releasePrefetched(trixel);
         if (nBlocks <= 0)
             faintMag = -5.0;
         else
@@ -92,7 +128,21 @@ bool StarBlockList::fillToMag(float maglim)
 
     Q_ASSERT(nBlocks == (unsigned int)blocks.size());
 
-    BinFileHelper::unsigned_KDE_fseek(dataFile, readOffset, SEEK_SET);
+    // Read straight from the mapping if the catalog is mapped, else fall back to reading the file record by record
+    const char *mappedData = dSReader->getMappedData();
+    const int recordSize   = dSReader->guessRecordSize();
+    const unsigned int recordCount = dSReader->getRecordCount(trixelId);
+
+    if (mappedData)
+    {
+        if (readOffset + static_cast<qint64>(recordCount - nStars) * recordSize > dSReader->getMappedSize())
+        {
+            qDebug() << Q_FUNC_INFO << "Records of trixel" << trixel << "extend past the end of the data file!";
+            return false;
+        }
+    }
+    else
+        BinFileHelper::unsigned_KDE_fseek(dataFile, readOffset, SEEK_SET);
 
     /*
     qDebug() << Q_FUNC_INFO << "Reading trixel" << trixel << ", id on disk =" << trixelId << ", currently nStars =" << nStars
@@ -100,7 +150,7 @@ bool StarBlockList::fillToMag(float maglim)
              << "to maglim =" << maglim << "with current faintMag =" << faintMag;
     */
 
-    while (maglim >= faintMag && nStars < dSReader->getRecordCount(trixelId))
+    while (maglim >= faintMag && nStars < recordCount)
     {
         int ret = 0;
 
@@ -123,8 +173,26 @@ bool StarBlockList::fillToMag(float maglim)
 
             ++nBlocks;
         }
+        if (mappedData)
+        {
+            // Decode as many records as fit in the block at once
+            StarBlock *block = blocks[nBlocks - 1].get();
+            const int count  = std::min<unsigned long>(block->size() - block->getStarCount(), recordCount - nStars);
+            int added        = 0;
+
+            if (recordSize == 32)
+                added = addRecords<StarData>(block, mappedData + readOffset, count, dSReader->getByteSwap(), maglim);
+            else
+                added = addRecords<DeepStarData>(block, mappedData + readOffset, count, dSReader->getByteSwap(), maglim);
+
+            readOffset += added * recordSize;
+            faintMag = block->getFaintMag();
+            nStars += added;
+            continue;
+        }
+
         // TODO: Make this more general
-        if (dSReader->guessRecordSize() == 32)
+        if (recordSize == 32)
         {
             ret = fread(&stardata, sizeof(StarData), 1, dataFile);
             if (dSReader->getByteSwap())
@@ -220,6 +220,9 @@ class KSAsteroid : public KSPlanetBase
     friend QDataStream &operator<<(QDataStream &out, const KSAsteroid &asteroid);
     friend QDataStream &operator>>(QDataStream &in, KSAsteroid *&asteroid);
 
+    /** Packs the orbital elements to propagate many bodies at once */
+    friend class KeplerianPropagator;
+
     void findMagnitude(const KSNumbers *) override;
 
     int catN { 0 };
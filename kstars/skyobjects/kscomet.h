@@ -179,9 +179,12 @@ class KSComet : public KSPlanetBase
      * @short Estimate physical parameters of the comet such as coma size, tail length and size of the nucleus
      * @note invoked from findGeocentricPosition in order
      */
-    void findPhysicalParameters();
+    void findPhysicalParameters() override;
 
   private:
+    /** Packs the orbital elements to propagate many bodies at once */
+    friend class KeplerianPropagator;
+
     void findMagnitude(const KSNumbers *) override;
 
     long double JDp { 0 };
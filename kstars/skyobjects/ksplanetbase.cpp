@@ -113,11 +113,7 @@ void KSPlanetBase::findPosition(const KSNumbers *num, const CachingDms *lat, con
     lastPrecessJD = num->julianDay();
 
     findGeocentricPosition(num, Earth); //private function, reimplemented in each subclass
-    findPhase();
-    setAngularSize(findAngularSize()); //angular size in arcmin
-
-    if (lat && LST)
-        localizeCoords(num, lat, LST); //correct for figure-of-the-Earth
+    findDerivedQuantities(num, lat, LST);
 
     if (hasTrail())
     {
@@ -126,6 +122,53 @@ void KSPlanetBase::findPosition(const KSNumbers *num, const CachingDms *lat, con
         if (Trail.size() > TrailObject::MaxTrail)
             clipTrail();
     }
+}
+
+void KSPlanetBase::setHeliocentricPosition(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST,
+        const double helio[3], const double earth[3])
+{
+    lastPrecessJD = num->julianDay();
+
+    helEcPos.longitude.setRadians(atan2(helio[1], helio[0]));
+    helEcPos.longitude.reduceToRange(dms::ZERO_TO_2PI);
+    // Same latitude as KSAsteroid and KSComet find, so both paths give the same phase and magnitude
+    const double r = sqrt(helio[0] * helio[0] + helio[1] * helio[1] + helio[2] * helio[2]);
+    helEcPos.latitude.setRadians(atan2(helio[2], r));
+    setRsun(r);
+
+    //geocentric ecliptic cartesian coordinates
+    const double x = helio[0] - earth[0];
+    const double y = helio[1] - earth[1];
+    const double z = helio[2] - earth[2];
+
+    ep.longitude.setRadians(atan2(y, x));
+    ep.longitude.reduceToRange(dms::ZERO_TO_2PI);
+    ep.latitude.setRadians(atan2(z, sqrt(x * x + y * y)));
+    Rearth = sqrt(x * x + y * y + z * z);
+
+    EclipticToEquatorial(num->obliquity());
+
+    // The position is J2000, so precess, nutate and aberrate it as apparentCoord() would,
+    // but without constructing new KSNumbers for the date
+    setRA0(ra());
+    setDec0(dec());
+    precess(num);
+    nutate(num);
+    if (Options::useRelativistic() && checkBendLight())
+        bendlight();
+    aberrate(num);
+
+    findPhysicalParameters();
+    findDerivedQuantities(num, lat, LST);
+}
+
+void KSPlanetBase::findDerivedQuantities(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST)
+{
+    findPhase();
+    setAngularSize(findAngularSize()); //angular size in arcmin
+
+    if (lat && LST)
+        localizeCoords(num, lat, LST); //correct for figure-of-the-Earth
 
     findMagnitude(num);
 
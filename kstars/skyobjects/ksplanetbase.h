@@ -171,6 +171,21 @@ class KSPlanetBase : public TrailObject
     void findPosition(const KSNumbers *num, const CachingDms *lat = nullptr, const CachingDms *LST = nullptr,
                       const KSPlanetBase *Earth = nullptr);
 
+    /**
+     * @short Set the position from heliocentric cartesian coordinates computed elsewhere, and
+     * derive everything findPosition() would from them.
+     *
+     * This is used by KeplerianPropagator, which solves the orbits of many minor bodies at once.
+     * The apparent coordinates are found with @p num itself and the trail is left alone.
+     * @param num KSNumbers pointer for the target date/time
+     * @param lat pointer to the geographic latitude; if nullptr, we skip localizeCoords()
+     * @param LST pointer to the local sidereal time; if nullptr, we skip localizeCoords()
+     * @param helio heliocentric ecliptic J2000 x, y, z of the body, in AU
+     * @param earth heliocentric ecliptic x, y, z of the Earth, in AU
+     */
+    void setHeliocentricPosition(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST,
+                                 const double helio[3], const double earth[3]);
+
     /** @return the Planet's position angle. */
     double pa() const override { return PositionAngle; }
 
@@ -250,6 +265,10 @@ class KSPlanetBase : public TrailObject
     virtual void findPhase();
 
     virtual double findAngularSize() { return  asin(physicalSize() / Rearth / AU_KM) * 60. * 180. / dms::PI; }
+
+    /** Estimate sizes which depend on the distance from the Sun. Does nothing by default. */
+    virtual void findPhysicalParameters() {}
+
     // Geocentric ecliptic position, but distance to the Sun
     EclipticPosition ep;
 
@@ -272,6 +291,12 @@ class KSPlanetBase : public TrailObject
      */
     void localizeCoords(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST);
 
+    /**
+     * @short Derive phase, angular size, topocentric position and magnitude once the geocentric
+     * position is known. Shared by findPosition() and setHeliocentricPosition().
+     */
+    void findDerivedQuantities(const KSNumbers *num, const CachingDms *lat, const CachingDms *LST);
+
     double PositionAngle, AngularSize, PhysicalSize;
     QColor m_Color;
 };
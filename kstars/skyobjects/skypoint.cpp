@@ -416,14 +416,8 @@ SkyPoint SkyPoint::moveAway(const SkyPoint &from, double dist) const
     return SkyPoint(ra() + dtheta, lat1);
 }
 
-bool SkyPoint::checkBendLight()
+bool SkyPoint::findSun()
 {
-    // First see if we are close enough to the sun to bother about the
-    // gravitational lensing effect. We correct for the effect at
-    // least till b = 10 solar radii, where the effect is only about
-    // 0.06".  Assuming min. sun-earth distance is 200 solar radii.
-    static const dms maxAngle(1.75 * (30.0 / 200.0) / dms::DegToRad);
-
     if (!m_Sun)
     {
         SkyComposite *skycomopsite = KStarsData::Instance()->skyComposite();
@@ -432,11 +426,22 @@ bool SkyPoint::checkBendLight()
             return false;
 
         m_Sun = dynamic_cast<KSSun *>(skycomopsite->findByName(i18n("Sun")));
-
-        if (m_Sun == nullptr)
-            return false;
     }
 
+    return m_Sun != nullptr;
+}
+
+bool SkyPoint::checkBendLight()
+{
+    // First see if we are close enough to the sun to bother about the
+    // gravitational lensing effect. We correct for the effect at
+    // least till b = 10 solar radii, where the effect is only about
+    // 0.06".  Assuming min. sun-earth distance is 200 solar radii.
+    static const dms maxAngle(1.75 * (30.0 / 200.0) / dms::DegToRad);
+
+    if (!findSun())
+        return false;
+
     // TODO: This can be optimized further. We only need a ballpark estimate of the distance to the sun to start with.
     return (fabs(angularDistanceTo(static_cast<const SkyPoint *>(m_Sun)).Degrees()) <=
             maxAngle.Degrees()); // NOTE: dynamic_cast is slow and not important here.
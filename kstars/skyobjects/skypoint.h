@@ -452,6 +452,13 @@ class SkyPoint
          */
         bool checkBendLight();
 
+        /**
+         * @short Look up the Sun used by checkBendLight() and bendlight()
+         * The lookup is not thread safe, so call this before computing positions on worker threads.
+         * @return true if the Sun was found
+         */
+        static bool findSun();
+
         /**
          * Correct for the effect of "bending" of light around the sun for
          * positions near the sun.
@@ -291,6 +291,9 @@ class StarObject : public SkyObject
     quint64 updateID { 0 };
     quint64 updateNumID { 0 };
 
+    // Batch version of JITupdate()
+    friend class StarBlock;
+
 #ifdef PROFILE_UPDATECOORDS
     static double updateCoordsCpuTime;
     static unsigned int starsUpdated;
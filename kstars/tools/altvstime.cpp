@@ -6,6 +6,7 @@
 
 #include "altvstime.h"
 
+#include "altitudesolver.h"
 #include "avtplotwidget.h"
 #include "dms.h"
 #include "ksalmanac.h"
@@ -415,9 +416,10 @@ void AltVsTime::processObject(SkyObject *o, bool forceAdd)
         // time range: 24h
 
         int offset = 3;
-        for (double h = -12.0, i = 0; h <= 12.0; h += 0.25, i++)
+        const QVector<double> altitudes = findAltitudes(o);
+        for (int i = 0; i < altitudes.size(); i++)
         {
-            y[i] = findAltitude(o, h);
+            y[i] = altitudes[i];
             if (y[i] > maxAlt)
                 maxAlt = y[i];
             if (y[i] < minAlt)
@@ -464,16 +466,14 @@ void AltVsTime::processObject(SkyObject *o, bool forceAdd)
     delete num;
 }
 
-double AltVsTime::findAltitude(SkyPoint *p, double hour)
+QVector<double> AltVsTime::findAltitudes(SkyPoint *p)
 {
-    hour += 24.0 * DayOffset;
-
-    //getDate converts the user-entered local time to UT
-    KStarsDateTime ut = getDate().addSecs(hour * 3600.0);
-
-    CachingDms LST = geo->GSTtoLST(ut.gst());
-    p->EquatorialToHorizontal(&LST, geo->lat());
-    return p->alt().Degrees();
+    // Every 15 minutes, from 12 hours before to 12 hours after the date
+    AltitudeSolver solver;
+    solver.setTimes(getDate().addSecs((24.0 * DayOffset - 12.0) * 3600.0), 900, 97, geo);
+    solver.setTargets({ *p });
+    solver.solve();
+    return solver.altitudes(0);
 }
 
 void AltVsTime::slotHighlight(int row)
@@ -938,15 +938,16 @@ void AltVsTime::slotUpdateDateLoc()
             // compute the new graph values:
             // time range: 24h
             int offset = 3;
-            for (double h = -12.0, i = 0; h <= 12.0; h += 0.25, i++)
+            const QVector<double> altitudes = findAltitudes(o);
+            for (int sample = 0; sample < altitudes.size(); sample++)
             {
-                point_altitudeValue = findAltitude(o, h);
+                point_altitudeValue = altitudes[sample];
                 altitude_dataSet.push_back(point_altitudeValue);
                 if (point_altitudeValue > maxAlt)
                     maxAlt = point_altitudeValue;
                 if (point_altitudeValue < minAlt)
                     minAlt = point_altitudeValue;
-                point_timeValue = i * 900 + 43200;
+                point_timeValue = sample * 900 + 43200;
                 time_dataSet.push_back(point_timeValue);
             }
 
@@ -990,15 +991,16 @@ void AltVsTime::slotUpdateDateLoc()
             // compute the new graph values:
             // time range: 24h
             int offset = 3;
-            for (double h = -12.0, i = 0; h <= 12.0; h += 0.25, i++)
+            const QVector<double> altitudes = findAltitudes(pList.at(i));
+            for (int sample = 0; sample < altitudes.size(); sample++)
             {
-                point_altitudeValue = findAltitude(pList.at(i), h);
+                point_altitudeValue = altitudes[sample];
                 altitude_dataSet.push_back(point_altitudeValue);
                 if (point_altitudeValue > maxAlt)
                     maxAlt = point_altitudeValue;
                 if (point_altitudeValue < minAlt)
                     minAlt = point_altitudeValue;
-                point_timeValue = i * 900 + 43200;
+                point_timeValue = sample * 900 + 43200;
                 time_dataSet.push_back(point_timeValue);
             }
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <QList>
+#include <QVector>
 #include <QDialog>
 
 #include "ui_altvstime.h"
@@ -79,16 +80,12 @@ class AltVsTime : public QDialog
     void processObject(SkyObject *o, bool forceAdd = false);
 
     /**
-     * @short Determine the altitude coordinate of a SkyPoint,
-     * given an hour of the day.
-     *
-     * This is called for every 30-minute interval in the displayed Day,
-     * in order to construct the altitude curve for a given object.
-     * @param p the skypoint whose altitude is to be found
-     * @param hour the time in the displayed day, expressed in hours
-     * @return the Altitude, expressed in degrees
+     * @short Determine the altitude curve of a SkyPoint over the displayed day,
+     * one altitude every 15 minutes from 12 hours before to 12 hours after the date.
+     * @param p the skypoint whose altitudes are to be found
+     * @return the altitudes, expressed in degrees
      */
-    double findAltitude(SkyPoint *p, double hour);
+    QVector<double> findAltitudes(SkyPoint *p);
 
     /**
      * @short get object name. If star has no name, generate a name based on catalog number.
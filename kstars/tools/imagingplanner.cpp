@@ -9,6 +9,7 @@
 #include <kio_version.h>
 #include <KLocalizedString>
 
+#include "altitudesolver.h"
 #include "artificialhorizoncomponent.h"
 #include "auxiliary/screencapture.h"
 #include "auxiliary/thememanager.h"
@@ -744,16 +745,9 @@ QString shortCoordString(const dms &ra, const dms &dec)
            .arg(dec.Degrees() < 0 ? "-" : "").arg(abs(dec.degree())).arg(abs(dec.arcmin()));
 }
 
-double getAltitude(GeoLocation *geo, SkyPoint &p, const QDateTime &time)
-{
-    auto ut2 = geo->LTtoUT(KStarsDateTime(time));
-    CachingDms LST = geo->GSTtoLST(ut2.gst());
-    p.EquatorialToHorizontal(&LST, geo->lat());
-    return p.alt().Degrees();
-}
-
-double getMaxAltitude(const KSAlmanac &ksal, const QDate &date, GeoLocation *geo, const SkyObject &object,
-                      double hoursAfterDusk = 0, double hoursBeforeDawn = 0)
+// Highest altitude of each of the objects during the night, between dusk and dawn.
+QVector<double> getMaxAltitudes(const KSAlmanac &ksal, const QDate &date, GeoLocation *geo, const QVector<SkyPoint> &objects,
+                                double hoursAfterDusk = 0, double hoursBeforeDawn = 0)
 {
     auto tz = QTimeZone(geo->TZ() * 3600);
     KStarsDateTime midnight = KStarsDateTime(date.addDays(1), QTime(0, 1));
@@ -770,23 +764,23 @@ double getMaxAltitude(const KSAlmanac &ksal, const QDate &date, GeoLocation *geo
     auto end = dawn.addSecs(-hoursBeforeDawn * 3600);
     end.setTimeZone(tz);
 
-    SkyPoint coords = object;
-    double maxAlt = -90;
-    auto t = start;
-    t.setTimeZone(tz);
-    QDateTime maxTime = t;
+    // Sampled every 20 minutes, the culminations between the samples are solved for.
+    const int count = std::max(0, static_cast<int>(std::ceil(start.secsTo(end) / (20 * 60.0))));
+    AltitudeSolver solver;
+    solver.setTimes(geo->LTtoUT(KStarsDateTime(start)), 20 * 60, count, geo);
+    solver.setTargets(objects);
+    solver.solve();
 
-    while (t.secsTo(end) > 0)
-    {
-        double alt = getAltitude(geo, coords, t);
-        if (alt > maxAlt)
-        {
-            maxAlt = alt;
-            maxTime = t;
-        }
-        t = t.addSecs(60 * 20);
-    }
-    return maxAlt;
+    QVector<double> maxAlts(objects.size());
+    for (int i = 0; i < objects.size(); ++i)
+        maxAlts[i] = solver.maxAltitude(i);
+    return maxAlts;
+}
+
+double getMaxAltitude(const KSAlmanac &ksal, const QDate &date, GeoLocation *geo, const SkyObject &object,
+                      double hoursAfterDusk = 0, double hoursBeforeDawn = 0)
+{
+    return getMaxAltitudes(ksal, date, geo, { object }, hoursAfterDusk, hoursBeforeDawn).first();
 }
 
 }  // namespace
@@ -2005,6 +1999,15 @@ void ImagingPlanner::recompute()
     KStarsDateTime ut  = getGeo()->LTtoUT(KStarsDateTime(midnight));
     KSAlmanac ksal(ut, getGeo());
 
+    // The altitudes of all the objects are computed at once.
+    QVector<SkyPoint> coords;
+    for (int i = 0; i < m_CatalogModel->rowCount(); ++i)
+    {
+        const CatalogObject *catalogEntry = getObject(m_CatalogModel->item(i, 0)->text());
+        coords.push_back(catalogEntry ? SkyPoint(*catalogEntry) : SkyPoint());
+    }
+    const QVector<double> maxAltitudes = getMaxAltitudes(ksal, getDate(), getGeo(), coords, 0, 0);
+
     for (int i = 0; i < m_CatalogModel->rowCount(); ++i)
     {
         const QString &name = m_CatalogModel->item(i, 0)->text();
@@ -2024,8 +2027,7 @@ void ImagingPlanner::recompute()
         m_CatalogModel->setItem(i, HOURS_COLUMN, hItem);
 
 
-        const auto time = KStarsDateTime(QDateTime(getDate(), QTime(12, 0)));
-        const double altitude = getMaxAltitude(ksal, getDate(), getGeo(), *catalogEntry, 0, 0);
+        const double altitude = maxAltitudes[i];
         QString altText = QString("%1º").arg(altitude, 0, 'f', 0);
         auto altItem = new QStandardItem(altText);
         altItem->setData(altText, Qt::UserRole);
@@ -3160,11 +3162,14 @@ void ImagingPlanner::plotAltitudeGraph(const QDate &date, const dms &ra, const d
     auto plotEnd = dawn.addSecs(1 * 3600);
     plotEnd.setTimeZone(tz);
 
-    while (t.secsTo(plotEnd) > 0)
+    const int count = std::max(0, static_cast<int>(std::ceil(t.secsTo(plotEnd) / (10 * 60.0))));
+    AltitudeSolver solver;
+    solver.setTimes(getGeo()->LTtoUT(KStarsDateTime(t)), 10 * 60, count, getGeo());
+    solver.setTargets({ job.getTargetCoords() });
+    solver.solve();
+    alts = solver.altitudes(0);
+    for (int i = 0; i < count; ++i)
     {
-        SkyPoint coords = job.getTargetCoords();
-        double alt = getAltitude(getGeo(), coords, t);
-        alts.push_back(alt);
         double hour = midnight.secsTo(t) / 3600.0;
         times.push_back(hour);
         t = t.addSecs(60 * 10);
@@ -3187,10 +3192,10 @@ void ImagingPlanner::plotAltitudeGraph(const QDate &date, const dms &ra, const d
         t.setTimeZone(tz);
         //t.setTimeZone(jobStartTimes[0].timeZone());
 
+        // The runs lie within the plot, so their altitudes come from the solver of the plot
         while (t.secsTo(stopTime) > 0)
         {
-            SkyPoint coords = job.getTargetCoords();
-            double alt = getAltitude(getGeo(), coords, t);
+            double alt = solver.altitudeAt(0, plotStart.secsTo(t));
             runAlts.push_back(alt);
             double hour = midnight.secsTo(t) / 3600.0;
             runTimes.push_back(hour);